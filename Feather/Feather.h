@@ -12,6 +12,10 @@
 
 #import "MPManagedObject.h"
 #import "MPManagedObjectsController.h"
+#import "MPManagedObjectCache.h"
+#import "MPQueryResultCache.h"
+#import "MPAsyncRequest.h"
+#import "MPLiveObjectCollection.h"
 #import "MPManagedObject+Mixin.h"
 #import "MPEmbeddedObject.h"
 
@@ -22,8 +26,11 @@
 #import "MPContributorsController.h"
 
 #import "MPDatabase.h"
+#import "MPDatabaseReaderPool.h"
 #import "MPDatabasePackageController.h"
+#import "MPAutosaveScheduler.h"
 #import "MPShoeboxPackageController.h"
+#import "MPStartupTracer.h"
 
 #import "MPPlaceHolding.h"
 #import "MPTreeItem.h"
@@ -37,6 +44,7 @@
 #import "NSNotificationCenter+MPManagedObjectExtensions.h"
 #import "NSDictionary+MPManagedObjectExtensions.h"
 #import "NSArray+MPManagedObjectExtensions.h"
+#import "NSString+MPSearchIndex.h"
 
 #import "MPException.h"
 #import "MPAssert.h"
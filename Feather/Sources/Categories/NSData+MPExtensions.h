@@ -32,6 +32,15 @@
 
 - (nullable NSString *)stringByDecodingAsUTF8;
 
+/** Enumerates the elements of a top level JSON array contained in the receiver without deserializing the array as a whole.
+  * Each element is passed to the block as data referring to the receiver's bytes (not copied, so valid only as long as the receiver is),
+  * ready to be deserialized with NSJSONSerialization.
+  * Intended to be used with memory mapped data (NSDataReadingMappedAlways), so that only the pages of elements being processed are resident.
+  * @param block Called with each element's data and the range of the element in the receiver. Set *stop to YES to stop enumerating.
+  * @return NO if the receiver is not a well formed JSON array at its top level, setting the error pointer (NSCocoaErrorDomain). */
+- (BOOL)enumerateJSONArrayElementsUsingBlock:(nonnull void (^)(NSData *_Nonnull elementData, NSRange range, BOOL *_Nonnull stop))block
+                                       error:(NSError *_Nullable *_Nullable)error;
+
 @end
 
 @interface NSData (AESAdditions)
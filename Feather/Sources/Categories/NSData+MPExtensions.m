@@ -120,6 +120,129 @@
     return s;
 }
 
+static inline BOOL MPIsJSONWhitespace(uint8_t c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static NSError *MPJSONArrayScanError(NSUInteger offset, NSString *reason)
+{
+    return [NSError errorWithDomain:NSCocoaErrorDomain
+                               code:NSPropertyListReadCorruptError
+                           userInfo:@{ NSLocalizedDescriptionKey :
+                                           [NSString stringWithFormat:@"Invalid JSON array at offset %lu: %@", offset, reason] }];
+}
+
+- (BOOL)enumerateJSONArrayElementsUsingBlock:(void (^)(NSData *, NSRange, BOOL *))block error:(NSError **)error
+{
+    NSParameterAssert(block);
+    
+    const uint8_t *bytes = self.bytes;
+    const NSUInteger length = self.length;
+    NSUInteger i = 0;
+    
+    // UTF-8 byte order mark.
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+        i = 3;
+    
+    while (i < length && MPIsJSONWhitespace(bytes[i]))
+        i++;
+    
+    if (i == length || bytes[i] != '[') {
+        if (error)
+            *error = MPJSONArrayScanError(i, @"expecting '['");
+        return NO;
+    }
+    i++;
+    
+    BOOL expectsElement = NO; // YES after a comma.
+    
+    while (YES) {
+        while (i < length && MPIsJSONWhitespace(bytes[i]))
+            i++;
+        
+        if (i == length) {
+            if (error)
+                *error = MPJSONArrayScanError(i, @"unterminated array");
+            return NO;
+        }
+        
+        if (bytes[i] == ']') {
+            if (expectsElement) {
+                if (error)
+                    *error = MPJSONArrayScanError(i, @"trailing comma");
+                return NO;
+            }
+            return YES;
+        }
+        
+        // scan to the end of the element: the next comma or closing bracket outside of strings and nested containers.
+        NSUInteger start = i;
+        NSUInteger depth = 0;
+        BOOL inString = NO;
+        
+        for (; i < length; i++) {
+            uint8_t c = bytes[i];
+            
+            if (inString) {
+                if (c == '\\')
+                    i++;
+                else if (c == '"')
+                    inString = NO;
+                continue;
+            }
+            
+            if (c == '"')
+                inString = YES;
+            else if (c == '{' || c == '[')
+                depth++;
+            else if (c == '}' || c == ']') {
+                if (depth == 0)
+                    break;
+                depth--;
+            }
+            else if (c == ',' && depth == 0)
+                break;
+        }
+        
+        if (i >= length) {
+            if (error)
+                *error = MPJSONArrayScanError(start, @"unterminated element");
+            return NO;
+        }
+        
+        if (bytes[i] == '}') {
+            if (error)
+                *error = MPJSONArrayScanError(i, @"unbalanced '}'");
+            return NO;
+        }
+        
+        NSUInteger end = i;
+        while (end > start && MPIsJSONWhitespace(bytes[end - 1]))
+            end--;
+        
+        if (end == start) {
+            if (error)
+                *error = MPJSONArrayScanError(start, @"empty element");
+            return NO;
+        }
+        
+        NSRange range = NSMakeRange(start, end - start);
+        BOOL stop = NO;
+        @autoreleasepool {
+            NSData *elementData = [NSData dataWithBytesNoCopy:(void *)(bytes + range.location) length:range.length freeWhenDone:NO];
+            block(elementData, range, &stop);
+        }
+        
+        if (stop)
+            return YES;
+        
+        expectsElement = bytes[i] == ',';
+        if (expectsElement)
+            i++;
+    }
+}
+
 @end
 
 
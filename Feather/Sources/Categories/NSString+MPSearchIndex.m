@@ -8,17 +8,109 @@
 
 #import "NSString+MPSearchIndex.h"
 
+/** Strings up to this length are normalized in a stack buffer. */
+#define MPFullTextNormalizationStackBufferLength 256
+
+/** One in each 16-bit lane of a 64-bit word. */
+static const uint64_t MPUTF16Lanes = 0x0001000100010001ULL;
+
+/** Index of the first non-ASCII UTF-16 unit in [location, length), testing four units per word. */
+NS_INLINE NSUInteger MPFirstNonASCIICharacterIndex(const unichar *characters, NSUInteger location, NSUInteger length)
+{
+    NSUInteger i = location;
+
+    for (; i + 4 <= length; i += 4) {
+        uint64_t word;
+        memcpy(&word, characters + i, sizeof(word));
+        if (word & (0xFF80 * MPUTF16Lanes))
+            break;
+    }
+
+    for (; i < length; i++) {
+        if (characters[i] > 0x7F)
+            return i;
+    }
+
+    return length;
+}
+
+NS_INLINE NSUInteger MPFirstASCIICharacterIndex(const unichar *characters, NSUInteger location, NSUInteger length)
+{
+    for (NSUInteger i = location; i < length; i++) {
+        if (characters[i] <= 0x7F)
+            return i;
+    }
+
+    return length;
+}
+
+/** Lower cases ASCII characters in place, four per word: as each unit is below 0x80, adding to a lane never carries into the next. */
+NS_INLINE void MPLowercaseASCIICharacters(unichar *characters, NSUInteger length)
+{
+    NSUInteger i = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        uint64_t word;
+        memcpy(&word, characters + i, sizeof(word));
+
+        uint64_t atLeastA = word + (0x80 - 'A') * MPUTF16Lanes;
+        uint64_t aboveZ = word + (0x80 - 'Z' - 1) * MPUTF16Lanes;
+        uint64_t upperCase = (atLeastA ^ aboveZ) & (0x0080 * MPUTF16Lanes);
+        word |= upperCase >> 2;
+
+        memcpy(characters + i, &word, sizeof(word));
+    }
+
+    for (; i < length; i++) {
+        if (characters[i] >= 'A' && characters[i] <= 'Z')
+            characters[i] += 'a' - 'A';
+    }
+}
+
 @implementation NSString (MPSearchIndex)
 
 - (NSString*)fullTextNormalizedString
 {
-    NSMutableString *result = [NSMutableString stringWithString:self];
-    CFStringNormalize((__bridge CFMutableStringRef)result, kCFStringNormalizationFormD);
-    CFStringFold((__bridge CFMutableStringRef)result,
-                 kCFCompareCaseInsensitive
-                 | kCFCompareDiacriticInsensitive
-                 | kCFCompareWidthInsensitive, NULL);
-    
+    NSUInteger length = self.length;
+
+    unichar stackBuffer[MPFullTextNormalizationStackBufferLength];
+    unichar *characters = length <= MPFullTextNormalizationStackBufferLength ? stackBuffer : malloc(length * sizeof(unichar));
+    [self getCharacters:characters range:NSMakeRange(0, length)];
+
+    NSMutableString *result = [NSMutableString stringWithCapacity:length];
+    NSUInteger location = 0;
+
+    // ASCII is unchanged by decomposition, and folding it only lower cases it, so only the non-ASCII runs go through CFStringNormalize & CFStringFold.
+    while (location < length) {
+        NSUInteger nonASCIILocation = MPFirstNonASCIICharacterIndex(characters, location, length);
+
+        // the ASCII character before a non-ASCII run can be the base of combining marks in it, and is folded with them.
+        NSUInteger runLocation = (nonASCIILocation < length && nonASCIILocation > location) ? nonASCIILocation - 1 : nonASCIILocation;
+
+        if (runLocation > location) {
+            MPLowercaseASCIICharacters(characters + location, runLocation - location);
+            CFStringAppendCharacters((__bridge CFMutableStringRef)result, characters + location, runLocation - location);
+        }
+
+        if (runLocation == length)
+            break;
+
+        NSUInteger runEnd = MPFirstASCIICharacterIndex(characters, nonASCIILocation, length);
+
+        NSMutableString *run = [[NSMutableString alloc] initWithCharacters:characters + runLocation length:runEnd - runLocation];
+        CFStringNormalize((__bridge CFMutableStringRef)run, kCFStringNormalizationFormD);
+        CFStringFold((__bridge CFMutableStringRef)run,
+                     kCFCompareCaseInsensitive
+                     | kCFCompareDiacriticInsensitive
+                     | kCFCompareWidthInsensitive, NULL);
+        [result appendString:run];
+
+        location = runEnd;
+    }
+
+    if (characters != stackBuffer)
+        free(characters);
+
     return result;
 }
 
@@ -0,0 +1,69 @@
+//
+//  MPAutosaveScheduler.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MPDatabasePackageController;
+@class MPManagedObject;
+
+/** Saves the changed autosaving objects of a database package together: instead of each object saving itself in a
+  * transaction of its own as it changes, the objects are collected and saved with one transaction per database
+  * once -interval has passed since the first of them changed, or as soon as -dirtyCountThreshold of them are waiting.
+  * A flush saves like -[MPDatabasePackageController performBatchUpdates:error:], with a single batch change notification,
+  * and is made on the main thread. Pending objects are also flushed when the package is saved or closed. */
+@interface MPAutosaveScheduler : NSObject
+
+- (nonnull instancetype)initWithPackageController:(nonnull MPDatabasePackageController *)packageController NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly, weak, nullable) MPDatabasePackageController *packageController;
+
+/** The longest time an object waits to be saved after it changes (default: 1 second). */
+@property (readwrite) NSTimeInterval interval;
+
+/** The number of waiting objects that triggers a flush without waiting for the interval (default: 500, 0 meaning no threshold). */
+@property (readwrite) NSUInteger dirtyCountThreshold;
+
+/** Schedules a changed object to be saved with the next flush. */
+- (void)scheduleSaveOfObject:(nonnull MPManagedObject *)object;
+
+/** The number of objects waiting to be saved. */
+@property (readonly) NSUInteger pendingObjectCount;
+
+/** Saves the waiting objects that still need saving, with one transaction per database.
+  * On failure all of the objects are left waiting, and those still needing saving are retried after -interval. */
+- (BOOL)flush:(NSError *__nullable *__nullable)error;
+
+#pragma mark - Metrics
+
+/** The number of flushes that saved objects. */
+@property (readonly) NSUInteger flushCount;
+
+/** The number of objects saved by flushes. */
+@property (readonly) NSUInteger savedObjectCount;
+
+/** The number of objects saved by the last flush. */
+@property (readonly) NSUInteger lastBatchSize;
+
+@property (readonly) NSUInteger largestBatchSize;
+
+/** Time taken to save the objects of the last flush. */
+@property (readonly) NSTimeInterval lastCommitDuration;
+
+/** Mean time taken to save the objects of a flush. */
+@property (readonly) NSTimeInterval averageCommitDuration;
+
+/** Time from the first object of the last flush being scheduled to its save completing. */
+@property (readonly) NSTimeInterval lastCommitLatency;
+
+@property (readonly) NSTimeInterval largestCommitLatency;
+
+- (void)resetMetrics;
+
+@end
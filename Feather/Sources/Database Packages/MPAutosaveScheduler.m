@@ -0,0 +1,204 @@
+//
+//  MPAutosaveScheduler.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPAutosaveScheduler.h"
+#import "MPDatabasePackageController.h"
+#import "MPDatabasePackageController+Protected.h"
+#import "MPManagedObject.h"
+#import "MPException.h"
+
+#import "NSNotificationCenter+ErrorNotification.h"
+
+@interface MPAutosaveScheduler ()
+{
+    NSMutableOrderedSet<MPManagedObject *> *_pendingObjects;
+
+    /** System uptime when the first of the pending objects was scheduled. */
+    NSTimeInterval _firstScheduledTime;
+
+    BOOL _flushScheduled;
+
+    NSTimeInterval _totalCommitDuration;
+}
+
+@property (readwrite) NSUInteger flushCount;
+@property (readwrite) NSUInteger savedObjectCount;
+@property (readwrite) NSUInteger lastBatchSize;
+@property (readwrite) NSUInteger largestBatchSize;
+@property (readwrite) NSTimeInterval lastCommitDuration;
+@property (readwrite) NSTimeInterval lastCommitLatency;
+@property (readwrite) NSTimeInterval largestCommitLatency;
+
+@end
+
+@implementation MPAutosaveScheduler
+
+- (instancetype)init {
+    @throw MPInvalidInitException;
+}
+
+- (instancetype)initWithPackageController:(MPDatabasePackageController *)packageController
+{
+    NSParameterAssert(packageController);
+
+    if (self = [super init]) {
+        _packageController = packageController;
+        _pendingObjects = [NSMutableOrderedSet new];
+        _interval = 1.0;
+        _dirtyCountThreshold = 500;
+    }
+    return self;
+}
+
+- (void)scheduleSaveOfObject:(MPManagedObject *)object
+{
+    NSParameterAssert(object);
+
+    BOOL scheduleFlush = NO;
+    BOOL flushNow = NO;
+    @synchronized (self) {
+        if (_pendingObjects.count == 0)
+            _firstScheduledTime = [NSProcessInfo processInfo].systemUptime;
+
+        [_pendingObjects addObject:object];
+
+        flushNow = _dirtyCountThreshold > 0 && _pendingObjects.count >= _dirtyCountThreshold;
+        if (!_flushScheduled || flushNow) {
+            _flushScheduled = YES;
+            scheduleFlush = YES;
+        }
+    }
+
+    if (!scheduleFlush)
+        return;
+
+    // flushed asynchronously even when over the threshold, so that an object is not saved in the middle of being changed.
+    __weak MPAutosaveScheduler *weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)((flushNow ? 0 : _interval) * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [weakSelf flushScheduledObjects];
+    });
+}
+
+- (void)flushScheduledObjects
+{
+    @synchronized (self) {
+        if (!_flushScheduled)
+            return;
+    }
+
+    NSError *err = nil;
+    if (![self flush:&err])
+        [self.packageController.notificationCenter postErrorNotification:err];
+}
+
+- (NSUInteger)pendingObjectCount
+{
+    @synchronized (self) {
+        return _pendingObjects.count;
+    }
+}
+
+- (BOOL)flush:(NSError **)error
+{
+    NSAssert([NSThread isMainThread], @"Autosaved objects should be flushed on the main thread.");
+
+    NSArray<MPManagedObject *> *objects = nil;
+    NSTimeInterval firstScheduledTime = 0;
+    @synchronized (self) {
+        objects = _pendingObjects.array;
+        firstScheduledTime = _firstScheduledTime;
+        [_pendingObjects removeAllObjects];
+        _flushScheduled = NO;
+    }
+
+    // objects saved or deleted since being scheduled no longer need saving.
+    NSMutableArray<MPManagedObject *> *dirtyObjects = [NSMutableArray arrayWithCapacity:objects.count];
+    for (MPManagedObject *mo in objects) {
+        if (mo.needsSave && !mo.isDeleted)
+            [dirtyObjects addObject:mo];
+    }
+
+    if (dirtyObjects.count == 0)
+        return YES;
+
+    MPDatabasePackageController *pkgc = self.packageController;
+    if (!pkgc)
+        return YES;
+
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    BOOL success = [pkgc saveObjects:dirtyObjects error:error];
+    NSTimeInterval end = [NSProcessInfo processInfo].systemUptime;
+
+    NSUInteger savedCount = 0;
+    for (MPManagedObject *mo in dirtyObjects) {
+        if (!mo.needsSave)
+            savedCount++;
+    }
+
+    // after a failure all of the objects are retried, the next flush skipping those that were saved.
+    NSArray<MPManagedObject *> *retriedObjects = success ? @[] : dirtyObjects;
+
+    BOOL scheduleRetry = NO;
+    @synchronized (self) {
+        if (savedCount > 0) {
+            self.flushCount++;
+            self.savedObjectCount += savedCount;
+            self.lastBatchSize = savedCount;
+            self.largestBatchSize = MAX(self.largestBatchSize, savedCount);
+            self.lastCommitDuration = end - start;
+            _totalCommitDuration += end - start;
+            self.lastCommitLatency = end - firstScheduledTime;
+            self.largestCommitLatency = MAX(self.largestCommitLatency, end - firstScheduledTime);
+        }
+
+        // objects left unsaved by a failure stay dirty, so they will not schedule a flush of their own: retry them after an interval.
+        if (retriedObjects.count > 0) {
+            NSMutableOrderedSet *pendingObjects = [NSMutableOrderedSet orderedSetWithArray:retriedObjects];
+            [pendingObjects unionOrderedSet:_pendingObjects];
+            _pendingObjects = pendingObjects;
+            _firstScheduledTime = firstScheduledTime;
+
+            if (!_flushScheduled) {
+                _flushScheduled = YES;
+                scheduleRetry = YES;
+            }
+        }
+    }
+
+    if (scheduleRetry) {
+        __weak MPAutosaveScheduler *weakSelf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_interval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [weakSelf flushScheduledObjects];
+        });
+    }
+
+    return success;
+}
+
+- (NSTimeInterval)averageCommitDuration
+{
+    @synchronized (self) {
+        return _flushCount > 0 ? _totalCommitDuration / _flushCount : 0;
+    }
+}
+
+- (void)resetMetrics
+{
+    @synchronized (self) {
+        self.flushCount = 0;
+        self.savedObjectCount = 0;
+        self.lastBatchSize = 0;
+        self.largestBatchSize = 0;
+        self.lastCommitDuration = 0;
+        self.lastCommitLatency = 0;
+        self.largestCommitLatency = 0;
+        _totalCommitDuration = 0;
+    }
+}
+
+@end
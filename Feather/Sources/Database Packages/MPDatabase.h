@@ -22,6 +22,7 @@ typedef enum MPDatabaseErrorCode
 } MPDatabaseErrorCode;
 
 @class MPDatabasePackageController;
+@class MPDatabaseReaderPool;
 @class MPMetadata;
 @class MPManagedObject;
 
@@ -127,6 +128,34 @@ typedef enum MPDatabaseErrorCode
 /** Filter block with a given name, stored in the database's private design document. */
 - (CBLFilterBlock _Nonnull )filterWithQualifiedName:(NSString *_Nonnull)name;
 
+/** Defines a view lazily: its map and reduce blocks are only set on the CBLView, and the view created in the database,
+  * when it is first requested with -viewNamed:. This keeps registering views off the package opening path.
+  * A view that has already been requested is redefined immediately.
+  * Views defined this way need to be requested with -viewNamed: rather than from the CBLDatabase. */
+- (void)defineViewNamed:(NSString *_Nonnull)name
+               mapBlock:(CBLMapBlock _Nonnull)mapBlock
+            reduceBlock:(CBLReduceBlock _Nullable)reduceBlock
+                version:(NSString *_Nonnull)version;
+
+/** The view with the given name, with its definition applied first if it was defined with -defineViewNamed:mapBlock:reduceBlock:version:.
+  * Other views are returned if they exist in the database, nil otherwise. */
+- (CBLView *_Nullable)viewNamed:(NSString *_Nonnull)name;
+
+/** Names of the views defined with -defineViewNamed:mapBlock:reduceBlock:version:. */
+@property (readonly, nonnull) NSSet<NSString *> *definedViewNames;
+
+/** A query of the view returned by -viewNamed:, which in a read-only database returns the rows last indexed without updating the index. */
+- (CBLQuery *_Nullable)createQueryForViewNamed:(NSString *_Nonnull)name;
+
+/** Read-only connections to the database file for reading documents from any thread without going through the server queue, each read seeing a consistent snapshot of the database.
+  * Created when first requested, and closed when the package is. */
+@property (readonly, nonnull) MPDatabaseReaderPool *readerPool;
+
+- (void)closeReaderPool;
+
+/** YES if the database belongs to a read-only package: it is not created if missing, revisions are not validated, and views are neither created nor indexed. */
+@property (readonly, getter=isReadOnly) BOOL readOnly;
+
 /** The default replication URL for this database, used by -syncWithRemoteWithCompletionHandler: , -pushToRemoteWithCompletionHandler: and -pullFromremoteWithCompletionHandler: . Derived from database controller's remote URL and the database name. */
 @property (nullable, readonly, strong) NSURL *remoteDatabaseURL;
 
@@ -152,6 +181,15 @@ typedef enum MPDatabaseErrorCode
 
 @end
 
+/** The default number of query rows materialized per autorelease pool when enumerating query rows. */
+extern const NSUInteger MPDatabaseQueryRowChunkSize;
+
+/** A block called for every row of an enumerated query. Set *stop to YES to end the enumeration early. */
+typedef void (^MPQueryRowBlock)(CBLQueryRow *_Nonnull row, BOOL *_Nonnull stop);
+
+/** A block called for every row of an enumerated query with its managed object, which is nil if the row has no document or its document is deleted. Set *stop to YES to end the enumeration early. */
+typedef void (^MPManagedObjectQueryRowBlock)(CBLQueryRow *_Nonnull row, MPManagedObject *_Nullable object, BOOL *_Nonnull stop);
+
 /** A MPDatabase utility category for CBLDatabase. */
 @interface CBLDatabase (MPDatabase)
 
@@ -169,6 +207,20 @@ typedef enum MPDatabaseErrorCode
 /** Get plain JSON encodable objects for query enumerator. */
 - (NSArray <CBLQueryRow *> *_Nonnull)plainObjectsFromQueryEnumeratorKeys:(CBLQueryEnumerator *_Nonnull)rows;
 
+/** Enumerates the remaining rows of a query enumerator in a single hop to the database's server queue,
+ * draining an autorelease pool after every chunk of chunkSize rows. The block is called on the server queue. */
+- (void)enumerateQueryEnumerator:(CBLQueryEnumerator *_Nonnull)rows
+                       chunkSize:(NSUInteger)chunkSize
+                      usingBlock:(MPQueryRowBlock _Nonnull)block;
+
+/** Materializes managed objects for the remaining rows of a query enumerator, with the same single hop and chunking as -enumerateQueryEnumerator:chunkSize:usingBlock:.
+ * A model object already attached to a row's document is used as is. Otherwise cachedObjectBlock (if given) is asked for a registered
+ * object before a new model object is created for a non-deleted document. The block is called on the server queue. */
+- (void)enumerateManagedObjectsForQueryEnumerator:(CBLQueryEnumerator *_Nonnull)rows
+                                        chunkSize:(NSUInteger)chunkSize
+                                cachedObjectBlock:(MPManagedObject *_Nullable (^_Nullable)(NSString *_Nonnull documentID))cachedObjectBlock
+                                       usingBlock:(MPManagedObjectQueryRowBlock _Nonnull)block;
+
 @end
 
 @interface CBLManager (MPDatabase)
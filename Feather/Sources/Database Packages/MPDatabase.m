@@ -17,6 +17,7 @@
 #import <Feather/MPManagedObject+Protected.h>
 
 #import "NSArray+MPExtensions.h"
+#import "MPDatabaseReaderPool.h"
 #import "MPException.h"
 
 @import FeatherExtensions;
@@ -27,8 +28,40 @@
 NSString * const MPDatabaseErrorDomain = @"MPDatabaseErrorDomain";
 NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; //same name used in serverside CouchDB.
 
+const NSUInteger MPDatabaseQueryRowChunkSize = 512;
+
+/** A view definition not yet applied to its CBLView. */
+@interface MPViewDefinition : NSObject
+@property (readonly, copy) CBLMapBlock mapBlock;
+@property (readonly, copy) CBLReduceBlock reduceBlock;
+@property (readonly, copy) NSString *version;
+@end
+
+@implementation MPViewDefinition
+
+- (instancetype)initWithMapBlock:(CBLMapBlock)mapBlock reduceBlock:(CBLReduceBlock)reduceBlock version:(NSString *)version
+{
+    if (self = [super init])
+    {
+        _mapBlock = [mapBlock copy];
+        _reduceBlock = [reduceBlock copy];
+        _version = [version copy];
+    }
+
+    return self;
+}
+
+@end
+
 @interface MPDatabase ()
 {
+    /** View definitions not yet applied, by view name. Accessed on the server queue. */
+    NSMutableDictionary<NSString *, MPViewDefinition *> *_pendingViewDefinitions;
+
+    /** Names of all the views defined with -defineViewNamed:..., applied or not. Accessed on the server queue. */
+    NSMutableSet<NSString *> *_definedViewNames;
+    
+    MPDatabaseReaderPool *_readerPool;
 }
 
 @property (readwrite, strong) MPMetadata *cachedMetadata;
@@ -84,10 +117,13 @@ NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; /
         
         assert(packageController);
         _packageController = packageController;
+        _readOnly = packageController.isReadOnly;
         
         __block NSError *e = nil;
         mp_dispatch_sync(_server.dispatchQueue, packageController.serverQueueToken, ^{
-            self->_database = [self->_server databaseNamed:[MPDatabase sanitizedDatabaseIDWithString:name] error:&e];
+            NSString *databaseID = [MPDatabase sanitizedDatabaseIDWithString:name];
+            self->_database = ensureCreated ? [self->_server databaseNamed:databaseID error:&e]
+                                            : [self->_server existingDatabaseNamed:databaseID error:&e];
         });
         
         if (!_database) {
@@ -101,6 +137,9 @@ NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; /
         
         objc_setAssociatedObject(_database, "dbp", self, OBJC_ASSOCIATION_ASSIGN);
         
+        _pendingViewDefinitions = [NSMutableDictionary dictionaryWithCapacity:32];
+        _definedViewNames = [NSMutableSet setWithCapacity:32];
+        
         _currentPulls = [NSMutableSet setWithCapacity:5];
         _currentPushes = [NSMutableSet setWithCapacity:5];
                         
@@ -114,6 +153,8 @@ NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; /
         
          __weak MPDatabase *slf = self;
          
+        // nothing is written to a read-only database that would need validating.
+        if (!_readOnly) {
          [self.database setValidationNamed:@"validate-managed-object"
          asBlock:^(CBLRevision *newRevision, id<CBLValidationContext> context) {
              MPDatabase *strongSelf = slf;
@@ -121,17 +162,16 @@ NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; /
                       @"Unexpected objectType: %@", newRevision.properties[@"objectType"]);
              [strongSelf validateRevision:newRevision validationContext:context];
          }];
+        }
          
          // used for backbone-couchdb bridging
         
-        mp_dispatch_sync(_server.dispatchQueue, [self.packageController serverQueueToken], ^{
-            [[self.database viewNamed:@"by-object-type"]
-             setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
-             {
-                 if (doc[@"objectType"])
-                     emit(doc[@"objectType"], doc);
-             } version:@"1.0"];
-        });
+        [self defineViewNamed:@"by-object-type"
+                     mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+         {
+             if (doc[@"objectType"])
+                 emit(doc[@"objectType"], doc);
+         } reduceBlock:nil version:@"1.0"];
     }
     
     return self;
@@ -239,8 +279,101 @@ NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; /
     [self.database setFilterNamed:name asBlock:block];
 }
 
+#pragma mark - Views
+
+- (void)defineViewNamed:(NSString *)name
+               mapBlock:(CBLMapBlock)mapBlock
+            reduceBlock:(CBLReduceBlock)reduceBlock
+                version:(NSString *)version
+{
+    NSParameterAssert(name);
+    NSParameterAssert(mapBlock);
+    NSParameterAssert(version);
+    
+    MPViewDefinition *definition = [[MPViewDefinition alloc] initWithMapBlock:mapBlock reduceBlock:reduceBlock version:version];
+    
+    mp_dispatch_sync(self.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        BOOL applied = [_definedViewNames containsObject:name] && !_pendingViewDefinitions[name];
+        [_definedViewNames addObject:name];
+        
+        if (applied)
+            [self applyViewDefinition:definition toViewNamed:name];
+        else
+            _pendingViewDefinitions[name] = definition;
+    });
+}
+
+- (CBLView *)viewNamed:(NSString *)name
+{
+    NSParameterAssert(name);
+    
+    __block CBLView *view = nil;
+    mp_dispatch_sync(self.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        MPViewDefinition *definition = _pendingViewDefinitions[name];
+        if (definition) {
+            [_pendingViewDefinitions removeObjectForKey:name];
+            view = [self applyViewDefinition:definition toViewNamed:name];
+        }
+        else if ([_definedViewNames containsObject:name] && !_readOnly) {
+            view = [self.database viewNamed:name];
+        }
+        else {
+            view = [self.database existingViewNamed:name];
+        }
+    });
+    
+    return view;
+}
+
+- (CBLView *)applyViewDefinition:(MPViewDefinition *)definition toViewNamed:(NSString *)name
+{
+    // a view is not created in a read-only database, and its index is only usable if it exists already.
+    CBLView *view = _readOnly ? [self.database existingViewNamed:name] : [self.database viewNamed:name];
+    [view setMapBlock:definition.mapBlock reduceBlock:definition.reduceBlock version:definition.version];
+    return view;
+}
+
+- (CBLQuery *)createQueryForViewNamed:(NSString *)name
+{
+    CBLQuery *query = [[self viewNamed:name] createQuery];
+    if (_readOnly)
+        query.indexUpdateMode = kCBLUpdateIndexNever;
+    return query;
+}
+
+- (NSSet<NSString *> *)definedViewNames
+{
+    __block NSSet *names = nil;
+    mp_dispatch_sync(self.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        names = [_definedViewNames copy];
+    });
+    return names;
+}
+
+#pragma mark - Readers
+
+- (MPDatabaseReaderPool *)readerPool
+{
+    @synchronized (self) {
+        if (!_readerPool) {
+            NSString *path = [[self.server.directory stringByAppendingPathComponent:self.database.name] stringByAppendingPathExtension:@"cblite"];
+            NSUInteger readerCount = MIN([[NSProcessInfo processInfo] activeProcessorCount], 4);
+            _readerPool = [[MPDatabaseReaderPool alloc] initWithPath:path maximumReaderCount:MAX(readerCount, 1)];
+        }
+        return _readerPool;
+    }
+}
+
+- (void)closeReaderPool
+{
+    @synchronized (self) {
+        [_readerPool close];
+    }
+}
+
 - (void)dealloc
 {
+    [_readerPool close];
     objc_removeAssociatedObjects(_database);
     
     for (id pull in _currentPulls)
@@ -487,36 +620,54 @@ NSString * const MPDatabaseReplicationFilterNameAcceptedObjects = @"accepted"; /
     NSAssert(db == self.database, @"Expecting %@ (%@) == %@ (%@)", db, db.name, self.database, self.database.name);
     
     BOOL isExternalChange = [notification.userInfo[@"external"] boolValue];
-    for (CBLDatabaseChange *change in notification.userInfo[@"changes"])
-    {
-        __block CBLDocument *doc = nil;
-        mp_dispatch_sync(self.database.manager.dispatchQueue,
-                         [self.packageController serverQueueToken],
-        ^{
-            doc = [self.database existingDocumentWithID:change.documentID];
-        });
+    MPManagedObjectChangeSource src = isExternalChange
+                                        ? MPManagedObjectChangeSourceExternal
+                                        : MPManagedObjectChangeSourceAPI;
+    
+    NSArray<CBLDatabaseChange *> *changes = notification.userInfo[@"changes"];
+    if (changes.count == 0)
+        return;
+    
+    // all of the notification's documents are resolved in one hop to the server queue, and handed over on it as they are confined to it.
+    mp_dispatch_sync(self.database.manager.dispatchQueue,
+                     [self.packageController serverQueueToken],
+    ^{
+        NSMutableArray<CBLDocument *> *docs = [NSMutableArray arrayWithCapacity:changes.count];
+        NSMutableArray<CBLDocument *> *deletedDocs = [NSMutableArray array];
+        NSMutableDictionary<NSString *, NSString *> *revisionIDsOfMissingDocs = [NSMutableDictionary dictionary];
         
-        MPManagedObjectChangeSource src = isExternalChange
-                                            ? MPManagedObjectChangeSourceExternal
-                                            : MPManagedObjectChangeSourceAPI;
+        for (CBLDatabaseChange *change in changes) {
+            CBLDocument *doc = [self.database existingDocumentWithID:change.documentID];
+            if (doc)
+                [docs addObject:doc];
+            else
+                revisionIDsOfMissingDocs[change.documentID] = change.revisionID;
+        }
         
-        if (!doc) {
-            Class cls = [MPManagedObject managedObjectClassFromDocumentID:change.documentID];
-            MPManagedObjectsController *moc = [self.packageController controllerForManagedObjectClass:cls];
+        if (revisionIDsOfMissingDocs.count > 0) {
+            CBLQuery *q = [self.database createAllDocumentsQuery];
+            q.keys = revisionIDsOfMissingDocs.allKeys;
+            q.prefetch = YES;
+            q.allDocsMode = kCBLIncludeDeleted;
             
-            // moc may be nil and the below code therefore not executed when change is for MPMetadata / MPLocalMetadata object.
-            CBLDocument *doc = [moc documentWithIdentifier:change.documentID allDocsMode:kCBLIncludeDeleted];
-            if ([doc.currentRevisionID isEqualToString:change.revisionID]) {
-                MPManagedObject *mo = [moc objectWithIdentifier:doc.documentID];
-                if (mo) {
-                    [moc didDeleteObject:mo];
-                }
+            NSError *err = nil;
+            for (CBLQueryRow *row in [q run:&err]) {
+                CBLDocument *doc = row.document;
+                
+                // MPMetadata / MPLocalMetadata have no managed objects controller and are skipped by the package controller.
+                if (doc && [doc.currentRevisionID isEqualToString:revisionIDsOfMissingDocs[doc.documentID]])
+                    [deletedDocs addObject:doc];
             }
+            
+            if (err)
+                NSLog(@"ERROR! Failed to resolve deleted documents %@: %@", revisionIDsOfMissingDocs.allKeys, err);
         }
-        else {
-            [_packageController didChangeDocument:doc source:src];
-        }
-    }
+        
+        [_packageController didChangeDocuments:docs
+                              deletedDocuments:deletedDocs
+                            lastSequenceNumber:self.database.lastSequenceNumber
+                                        source:src];
+    });
 }
 
 - (BOOL)ensureRemoteDatabaseCreated:(NSError **)err
@@ -725,22 +876,36 @@ typedef void (^CBLDatabaseDoAsyncHandler)(void);
 {
     assert([self packageController]);
     CBLQueryEnumerator *rows = [self getDocumentsWithIDs:ids];
-    NSMutableArray *objs = [NSMutableArray arrayWithCapacity:rows.count];
-    for (CBLQueryRow *row in rows) {
-        CBLDocument *doc = row.document;
-        
-        MPManagedObject *mo = nil;
-        if (!doc) {
-            mo = [[self packageController] objectWithIdentifier:row.key]; // can be in a different database, or the shared package.
+    
+    // slots hold either a model object, or the ID of an object not found in this database.
+    NSMutableArray *slots = [NSMutableArray arrayWithCapacity:rows.count];
+    [self enumerateManagedObjectsForQueryEnumerator:rows
+                                          chunkSize:MPDatabaseQueryRowChunkSize
+                                  cachedObjectBlock:nil
+                                         usingBlock:^(CBLQueryRow *row, MPManagedObject *mo, BOOL *stop) {
+        if (mo) {
+            [slots addObject:mo];
+        }
+        else if (!row.document && row.key) {
+            [slots addObject:row.key];
         }
         else {
-            mo = [[MPManagedObject managedObjectClassFromDocumentID:doc.documentID] modelForDocument:doc];
+            MPLog(@"WARNING: Failed to recover object by ID %@", row.documentID);
+        }
+    }];
+    
+    NSMutableArray *objs = [NSMutableArray arrayWithCapacity:slots.count];
+    for (id slot in slots) {
+        MPManagedObject *mo = slot;
+        if (![slot isKindOfClass:[MPManagedObject class]]) {
+            // can be in a different database, or the shared package (resolved here as the lookup may need other queues).
+            mo = [[self packageController] objectWithIdentifier:slot];
         }
         
         if (mo) {
             [objs addObject:mo];
         } else {
-            MPLog(@"WARNING: Failed to recover object by ID %@", row.documentID);
+            MPLog(@"WARNING: Failed to recover object by ID %@", slot);
         }
     }
     
@@ -767,13 +932,78 @@ typedef void (^CBLDatabaseDoAsyncHandler)(void);
 - (NSArray *)plainObjectsFromQueryEnumeratorKeys:(CBLQueryEnumerator *)rows
 {
     NSMutableArray* entries = [NSMutableArray arrayWithCapacity:rows.count];
-    for (CBLQueryRow *row in rows)
-    {
+    [self enumerateQueryEnumerator:rows chunkSize:MPDatabaseQueryRowChunkSize usingBlock:^(CBLQueryRow *row, BOOL *stop) {
         [entries addObject:row.key];
-    }
+    }];
     return entries;
 }
 
+- (void)enumerateQueryEnumerator:(CBLQueryEnumerator *)rows
+                       chunkSize:(NSUInteger)chunkSize
+                      usingBlock:(MPQueryRowBlock)block
+{
+    NSParameterAssert(block);
+    if (!rows)
+        return;
+    
+    if (chunkSize == 0)
+        chunkSize = MPDatabaseQueryRowChunkSize;
+    
+    mp_dispatch_sync(self.manager.dispatchQueue, [[self packageController] serverQueueToken], ^{
+        BOOL stop = NO;
+        BOOL exhausted = NO;
+        
+        while (!stop && !exhausted) {
+            @autoreleasepool {
+                for (NSUInteger i = 0; i < chunkSize && !stop; i++) {
+                    CBLQueryRow *row = [rows nextRow];
+                    if (!row) {
+                        exhausted = YES;
+                        break;
+                    }
+                    
+                    block(row, &stop);
+                }
+            }
+        }
+    });
+}
+
+- (void)enumerateManagedObjectsForQueryEnumerator:(CBLQueryEnumerator *)rows
+                                        chunkSize:(NSUInteger)chunkSize
+                                cachedObjectBlock:(MPManagedObject *(^)(NSString *documentID))cachedObjectBlock
+                                       usingBlock:(MPManagedObjectQueryRowBlock)block
+{
+    NSParameterAssert(block);
+    
+    [self enumerateQueryEnumerator:rows chunkSize:chunkSize usingBlock:^(CBLQueryRow *row, BOOL *stop) {
+        CBLDocument *doc = row.document;
+        MPManagedObject *modelObj = (MPManagedObject *)[doc modelObject];
+        
+        if (!modelObj && doc) {
+            modelObj = cachedObjectBlock ? cachedObjectBlock(doc.documentID) : nil;
+            modelObj.document = doc;
+            
+            if (!modelObj && ![doc isDeleted]) {
+                modelObj = [[doc managedObjectClass] modelForDocument:doc];
+            }
+        }
+        else if (modelObj) {
+            NSAssert(modelObj.document == doc,
+                     @"Unexpected row.document: %@ != %@ (%@ ; %@)",
+                     modelObj.document, doc,
+                     modelObj.propertiesToSave, doc.properties);
+        }
+        
+        if (modelObj) {
+            NSAssert([modelObj isKindOfClass:[MPManagedObject class]],
+                     @"Model object is of unexpected class: %@", modelObj);
+        }
+        
+        block(row, modelObj, stop);
+    }];
+}
+
 @end
 
 @implementation CBLManager (MPDatabase)
@@ -0,0 +1,51 @@
+//
+//  MPDatabaseBackup.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+@import Foundation;
+
+/** Default number of database pages copied per step by +backupDatabaseAtPath:toPath:pagesPerStep:error:. */
+extern const int MPDatabaseBackupDefaultPagesPerStep;
+
+/** A unit of work run by +performTasks:maximumConcurrentTaskCount:progressHandler:error:. */
+typedef BOOL (^MPDatabaseBackupTask)(NSError *__nullable *__nullable error);
+
+/** Called serially, on an arbitrary queue, after each completed task. Set stop to YES to cancel the remaining tasks. */
+typedef void (^MPDatabaseBackupProgressHandler)(double fractionCompleted, BOOL *__nonnull stop);
+
+/** File level operations for copying the databases of a package while they remain open and in use. */
+@interface MPDatabaseBackup : NSObject
+
+/** Copies the SQLite database at sourcePath with the SQLite online backup API, pagesPerStep pages at a time.
+  * The source is read through a connection of its own and its lock is released between steps, so that the database can be read and written meanwhile.
+  * The copy is written next to targetPath and moved into place only once complete, replacing any existing database (and its write-ahead log) at targetPath.
+  * Errors from SQLite are reported in the "SQLite" error domain with the SQLite result code. */
++ (BOOL)backupDatabaseAtPath:(nonnull NSString *)sourcePath
+                      toPath:(nonnull NSString *)targetPath
+                pagesPerStep:(int)pagesPerStep
+                       error:(NSError *__nullable *__nullable)error;
+
+/** Makes the attachments directory at targetURL contain the same blobs as the one at sourceURL.
+  * Attachment blobs are immutable and named by their digest: blobs already present at the target are left untouched, missing ones are hard linked (or copied when the directories are on different volumes), and ones no longer present in the source are removed. */
++ (BOOL)synchronizeAttachmentsAtURL:(nonnull NSURL *)sourceURL
+                              toURL:(nonnull NSURL *)targetURL
+                              error:(NSError *__nullable *__nullable)error;
+
+/** Copies the file at sourceURL to targetURL, replacing what is at targetURL, unless a regular file of the same size and modification date is already there. */
++ (BOOL)synchronizeFileAtURL:(nonnull NSURL *)sourceURL
+                       toURL:(nonnull NSURL *)targetURL
+                       error:(NSError *__nullable *__nullable)error;
+
+/** Runs the tasks concurrently on at most maximumConcurrentTaskCount background threads and waits for them to finish.
+  * No further tasks are started once a task fails or the progress handler stops the operation.
+  * @return NO with the error of the first failed task, or with NSUserCancelledError in NSCocoaErrorDomain if stopped by the progress handler. */
++ (BOOL)performTasks:(nonnull NSArray<MPDatabaseBackupTask> *)tasks
+maximumConcurrentTaskCount:(NSUInteger)maximumConcurrentTaskCount
+     progressHandler:(nullable MPDatabaseBackupProgressHandler)progressHandler
+               error:(NSError *__nullable *__nullable)error;
+
+@end
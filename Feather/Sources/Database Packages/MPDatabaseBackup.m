@@ -0,0 +1,255 @@
+//
+//  MPDatabaseBackup.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPDatabaseBackup.h"
+
+#import <sqlite3.h>
+
+const int MPDatabaseBackupDefaultPagesPerStep = 256;
+
+/** Number of times a backup is allowed to restart because the source was written to by another connection before the remaining pages are copied in one step. */
+static const NSUInteger MPDatabaseBackupMaximumRestartCount = 3;
+
+static NSError *MPSQLiteError(sqlite3 *db, int code, NSString *path)
+{
+    NSString *message = db ? @(sqlite3_errmsg(db)) : @(sqlite3_errstr(code));
+    return [NSError errorWithDomain:@"SQLite"
+                               code:code
+                           userInfo:@{NSLocalizedDescriptionKey:[NSString stringWithFormat:@"Failed to back up database to %@", path.lastPathComponent],
+                                      NSLocalizedFailureReasonErrorKey:message ?: @"Unknown SQLite error",
+                                      NSFilePathErrorKey:path}];
+}
+
+@implementation MPDatabaseBackup
+
++ (BOOL)backupDatabaseAtPath:(NSString *)sourcePath
+                      toPath:(NSString *)targetPath
+                pagesPerStep:(int)pagesPerStep
+                       error:(NSError **)error
+{
+    NSParameterAssert(sourcePath);
+    NSParameterAssert(targetPath);
+    NSParameterAssert(pagesPerStep != 0);
+
+    NSFileManager *fm = [NSFileManager new];
+    NSString *partialPath = [targetPath stringByAppendingPathExtension:@"partial"];
+    [fm removeItemAtPath:partialPath error:nil];
+
+    sqlite3 *source = NULL;
+    sqlite3 *target = NULL;
+    NSError *backupError = nil;
+
+    int rc = sqlite3_open_v2(sourcePath.fileSystemRepresentation, &source, SQLITE_OPEN_READONLY, NULL);
+    if (rc != SQLITE_OK)
+        backupError = MPSQLiteError(source, rc, sourcePath);
+
+    if (!backupError) {
+        rc = sqlite3_open_v2(partialPath.fileSystemRepresentation, &target, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+        if (rc != SQLITE_OK)
+            backupError = MPSQLiteError(target, rc, targetPath);
+    }
+
+    if (!backupError) {
+        sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main");
+        if (!backup) {
+            backupError = MPSQLiteError(target, sqlite3_errcode(target), targetPath);
+        }
+        else {
+            int previousRemaining = INT_MAX;
+            NSUInteger restartCount = 0;
+
+            do {
+                // a write through another connection restarts the backup from the first page:
+                // after a few restarts the rest is copied in one step, holding the read lock for its duration.
+                int pageCount = restartCount < MPDatabaseBackupMaximumRestartCount ? pagesPerStep : -1;
+                rc = sqlite3_backup_step(backup, pageCount);
+
+                int remaining = sqlite3_backup_remaining(backup);
+                if (remaining > previousRemaining)
+                    restartCount++;
+                previousRemaining = remaining;
+
+                if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+                    sqlite3_sleep(10);
+            } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+
+            int finishRC = sqlite3_backup_finish(backup);
+            if (rc == SQLITE_DONE)
+                rc = finishRC;
+
+            if (rc != SQLITE_OK)
+                backupError = MPSQLiteError(target, rc, targetPath);
+        }
+    }
+
+    sqlite3_close(source);
+    sqlite3_close(target);
+
+    if (backupError) {
+        [fm removeItemAtPath:partialPath error:nil];
+        if (error)
+            *error = backupError;
+        return NO;
+    }
+
+    // a log left next to the target would otherwise be replayed onto the new copy.
+    for (NSString *suffix in @[@"-wal", @"-shm", @"-journal"])
+        [fm removeItemAtPath:[targetPath stringByAppendingString:suffix] error:nil];
+
+    if (rename(partialPath.fileSystemRepresentation, targetPath.fileSystemRepresentation) != 0) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey:targetPath}];
+        [fm removeItemAtPath:partialPath error:nil];
+        return NO;
+    }
+
+    return YES;
+}
+
++ (BOOL)synchronizeAttachmentsAtURL:(NSURL *)sourceURL toURL:(NSURL *)targetURL error:(NSError **)error
+{
+    NSParameterAssert(sourceURL);
+    NSParameterAssert(targetURL);
+
+    NSFileManager *fm = [NSFileManager new];
+    NSArray<NSString *> *sourceNames = [fm contentsOfDirectoryAtPath:sourceURL.path error:error];
+    if (!sourceNames)
+        return NO;
+
+    if (![fm createDirectoryAtURL:targetURL withIntermediateDirectories:YES attributes:nil error:error])
+        return NO;
+
+    NSArray<NSString *> *targetNames = [fm contentsOfDirectoryAtPath:targetURL.path error:error];
+    if (!targetNames)
+        return NO;
+
+    NSSet<NSString *> *existingNames = [NSSet setWithArray:targetNames];
+
+    for (NSString *name in sourceNames) {
+        if ([existingNames containsObject:name])
+            continue;
+
+        NSURL *blobURL = [sourceURL URLByAppendingPathComponent:name];
+        NSURL *targetBlobURL = [targetURL URLByAppendingPathComponent:name];
+
+        if ([fm linkItemAtURL:blobURL toURL:targetBlobURL error:nil])
+            continue;
+
+        if (![fm copyItemAtURL:blobURL toURL:targetBlobURL error:error])
+            return NO;
+    }
+
+    NSSet<NSString *> *currentNames = [NSSet setWithArray:sourceNames];
+    for (NSString *name in targetNames) {
+        if ([currentNames containsObject:name])
+            continue;
+
+        if (![fm removeItemAtURL:[targetURL URLByAppendingPathComponent:name] error:error])
+            return NO;
+    }
+
+    return YES;
+}
+
++ (BOOL)synchronizeFileAtURL:(NSURL *)sourceURL toURL:(NSURL *)targetURL error:(NSError **)error
+{
+    NSFileManager *fm = [NSFileManager new];
+    NSDictionary *sourceAttributes = [fm attributesOfItemAtPath:sourceURL.path error:error];
+    if (!sourceAttributes)
+        return NO;
+
+    NSDictionary *targetAttributes = [fm attributesOfItemAtPath:targetURL.path error:nil];
+    if (targetAttributes) {
+        if ([sourceAttributes.fileType isEqualToString:NSFileTypeRegular]
+            && [targetAttributes.fileType isEqualToString:NSFileTypeRegular]
+            && sourceAttributes.fileSize == targetAttributes.fileSize
+            && [sourceAttributes.fileModificationDate isEqualToDate:targetAttributes.fileModificationDate])
+            return YES;
+
+        if (![fm removeItemAtURL:targetURL error:error])
+            return NO;
+    }
+
+    return [fm copyItemAtURL:sourceURL toURL:targetURL error:error];
+}
+
++ (BOOL)performTasks:(NSArray<MPDatabaseBackupTask> *)tasks
+maximumConcurrentTaskCount:(NSUInteger)maximumConcurrentTaskCount
+     progressHandler:(MPDatabaseBackupProgressHandler)progressHandler
+               error:(NSError **)error
+{
+    NSParameterAssert(tasks);
+
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+    dispatch_semaphore_t slots = dispatch_semaphore_create(MAX(maximumConcurrentTaskCount, 1));
+    dispatch_group_t group = dispatch_group_create();
+
+    NSObject *lock = [NSObject new];
+    __block NSUInteger completedCount = 0;
+    __block BOOL failed = NO;
+    __block BOOL cancelled = NO;
+    __block NSError *firstError = nil;
+
+    for (MPDatabaseBackupTask task in tasks) {
+        dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+
+        BOOL stopped;
+        @synchronized (lock) {
+            stopped = failed || cancelled;
+        }
+        if (stopped) {
+            dispatch_semaphore_signal(slots);
+            break;
+        }
+
+        dispatch_group_async(group, queue, ^{
+            NSError *taskError = nil;
+            BOOL success = task(&taskError);
+
+            @synchronized (lock) {
+                completedCount++;
+
+                if (!success && !failed && !cancelled) {
+                    failed = YES;
+                    firstError = taskError;
+                }
+
+                if (progressHandler && !failed && !cancelled) {
+                    BOOL stop = NO;
+                    progressHandler((double)completedCount / (double)tasks.count, &stop);
+                    cancelled = stop;
+                }
+            }
+
+            dispatch_semaphore_signal(slots);
+        });
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    if (tasks.count == 0 && progressHandler) {
+        BOOL stop = NO;
+        progressHandler(1.0, &stop);
+    }
+
+    if (failed) {
+        if (error)
+            *error = firstError;
+        return NO;
+    }
+
+    if (cancelled) {
+        if (error)
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil];
+        return NO;
+    }
+
+    return YES;
+}
+
+@end
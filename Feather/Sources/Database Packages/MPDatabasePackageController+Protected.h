@@ -31,6 +31,27 @@
 
 - (void)didChangeDocument:(CBLDocument *)document source:(MPManagedObjectChangeSource)source;
 
+/** Called by a database on its queue with the documents of one database change notification, resolved in one go.
+  * Deleted documents are those whose deletion revision is the current revision.
+  * The per-object notifications of the -postsPerObjectChangeNotifications compatibility mode are posted before returning,
+  * and the batch changes are delivered later on the main thread.
+  * The last sequence number is the database's when the documents were resolved, recorded as indexed once the changes are in the full-text index. */
+- (void)didChangeDocuments:(NSArray<CBLDocument *> *)documents
+          deletedDocuments:(NSArray<CBLDocument *> *)deletedDocuments
+        lastSequenceNumber:(UInt64)lastSequenceNumber
+                    source:(MPManagedObjectChangeSource)source;
+
+/** Returns NO with a MPDatabasePackageControllerErrorCodeReadOnly error if the package is read-only. */
+- (BOOL)ensureWritable:(NSError **)error;
+
+/** Saves the objects, which can be of any of the package's controllers, with one transaction per database,
+  * reporting the changes with a single MPDatabasePackageControllerDidPerformBatchUpdatesNotification as -performBatchUpdates:error: does.
+  * Databases saved before a failing one remain saved. The objects of the failing database are left needing saving, with their changes intact. */
+- (BOOL)saveObjects:(NSArray<MPManagedObject *> *)objects error:(NSError **)error;
+
+/** Called by a managed object whenever it is changed, to be saved by the -performBatchUpdates:error: in progress on the current thread, if any. */
+- (void)objectDidChange:(MPManagedObject *)object;
+
 /** Override in subclass if you want to use multiple CBLManagers in the database package. */
 - (CBLManager *)serverForDatabaseWithName:(NSString *)dbName;
 
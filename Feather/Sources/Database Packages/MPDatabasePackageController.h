@@ -24,6 +24,32 @@ typedef void (^MPPullCompletionHandler)(NSDictionary * __nullable errDict);
  */
 extern NSString *_Nonnull const MPDatabasePackageListenerDidStartNotification;
 
+/** 
+ * A notification posted once by -[MPDatabasePackageController performBatchUpdates:error:] after the batch has been saved.
+ * The userInfo dictionary contains the MPManagedObjectsBatchChange of each controller whose objects were saved under MPDatabasePackageControllerBatchChangesKey.
+ */
+extern NSString *_Nonnull const MPDatabasePackageControllerDidPerformBatchUpdatesNotification;
+extern NSString *_Nonnull const MPDatabasePackageControllerBatchChangesKey;
+
+/** A notification posted on the main thread once the views warmed in the background after opening the package have been indexed. */
+extern NSString *_Nonnull const MPDatabasePackageControllerDidWarmViewsNotification;
+
+/** A notification posted on the main thread once all the databases of a package controller opened in the background are open, and its controllers and root sections created. */
+extern NSString *_Nonnull const MPDatabasePackageControllerDidBecomeReadyNotification;
+
+/** A notification posted on the main thread if opening the databases of a package controller in the background fails. The userInfo dictionary contains the error under MPDatabasePackageControllerErrorKey. */
+extern NSString *_Nonnull const MPDatabasePackageControllerDidFailToOpenNotification;
+extern NSString *_Nonnull const MPDatabasePackageControllerErrorKey;
+
+/** How far a package controller has got in opening its databases. */
+typedef NS_ENUM(NSInteger, MPDatabasePackageControllerReadiness) {
+    MPDatabasePackageControllerReadinessOpening = 0,
+    /** The primary database is open, the others are being opened in the background. */
+    MPDatabasePackageControllerReadinessPrimaryDatabaseReady = 1,
+    MPDatabasePackageControllerReadinessReady = 2,
+    MPDatabasePackageControllerReadinessFailed = 3
+};
+
 /** A delegate protocol for MPDatabasePackageController's optional delegate. */
 @protocol MPDatabasePackageControllerDelegate <NSObject>
 
@@ -61,7 +87,11 @@ typedef enum MPDatabasePackageControllerErrorCode {
     MPDatabasePackageControllerErrorCodeOngoingTransaction = 8,
     MPDatabasePackageControllerErrorCodeRootURLMissing = 9,
     MPDatabasePackageControllerErrorCodeBundledDataInitializationFailed = 10,
-    MPDatabasePackageControllerErrorCodeMismatchingPackageIdentifier = 11
+    MPDatabasePackageControllerErrorCodeMismatchingPackageIdentifier = 11,
+    MPDatabasePackageControllerErrorCodeBatchUpdateFailed = 12,
+    MPDatabasePackageControllerErrorCodeFullTextIndexUnavailable = 13,
+    MPDatabasePackageControllerErrorCodeReadOnly = 14,
+    MPDatabasePackageControllerErrorCodeListenerUnavailable = 15
 } MPDatabasePackageControllerErrorCode;
 
 
@@ -69,6 +99,12 @@ typedef enum MPDatabasePackageControllerErrorCode {
 @class MPManagedObjectsController, MPSnapshotsController, MPDatabase;
 @class MPRootSection;
 @class MPContributor, MPContributorIdentity;
+@class MPDatabasePackageController;
+@class MPStartupTracer;
+@class MPAutosaveScheduler;
+
+/** Called on the main thread once a package controller's databases opened in the background are open, or have failed to open. */
+typedef void (^MPDatabasePackageControllerOpenCompletionHandler)(MPDatabasePackageController *_Nonnull packageController, NSError *_Nullable error);
 
 /** A MPDatabasePackageController manages a number of MPDatabase objects and MPManagedObjectsController, which in turn manage the MPManagedObject instances stored in the databases. The databases owned by a MPDatabasePackageController can be replicated with a remote CouchDB server. All of the databases of a MPDatabasePackageController are stored on the same CouchServer, also owned by the MPDatabasePackageController. This combination of databases under a shared server (either a shared filesystem root directory in the case of TouchDB, or a base URI in a remote CouchDB server) is called a _database package_.
  *
@@ -91,6 +127,7 @@ typedef enum MPDatabasePackageControllerErrorCode {
 /** All objects in the database package's databases (MPManagedObject and MPMetadata objects). No particular sort order is guaranteed. */
 @property (readonly, nonnull) NSArray<__kindof CBLModel *> *allObjects;
 
+/** The queue specific token of the dispatch queues of the package's database servers, passed to mp_dispatch_sync to run synchronously when already on a database's queue. */
 @property (readonly) unsigned long long serverQueueToken;
 
 /** The base remote URL for the document package. NOTE! An abstract method. */
@@ -119,6 +156,22 @@ typedef enum MPDatabasePackageControllerErrorCode {
   * Default implementation returns NO, overload to toggle on full-text indexing (see also MPManagedObject FTS indexing related properties and methods.) */
 @property (readonly) BOOL indexesObjectFullTextContents;
 
+/** IDs of the documents whose full-text indexed contents contain each word of the query as the beginning of a word, best match first.
+  * The index is kept in the package and updated as the databases change. It is rebuilt in the background for databases changed while it was not open, and for objects whose class's +indexablePropertyKeys have changed since they were indexed.
+  * Fails with MPDatabasePackageControllerErrorCodeFullTextIndexUnavailable unless the package -indexesObjectFullTextContents. */
+- (nullable NSArray<NSString *> *)documentIDsMatchingFullTextQuery:(nonnull NSString *)query
+                                                           offset:(NSUInteger)offset
+                                                            limit:(NSUInteger)limit
+                                                            error:(NSError *__nullable *__nullable)error;
+
+/** Indexes the full-text contents of all objects again, in the background. */
+- (void)rebuildFullTextIndex;
+
+/** Whether the indexes of the -prewarmedViewNames of the managed objects controllers are updated in the background after the package is opened (default: YES).
+  * Warming starts on the main queue turn after opening, so that it includes the controllers a subclass creates in -didOpenDatabases or in its initializer.
+  * Queries made meanwhile can pass MPQueryOptionsAllowStale to avoid waiting for an index being built. */
+@property (readonly) BOOL warmsViewsInBackground;
+
 /** List databases within the package that were determined to be corrupted during initialization, and hence were reset to an empty state.
     This is intended to give the owner of this database package controller the chance to restore database contents from a backup that is external to the database files.
  */
@@ -130,6 +183,16 @@ typedef enum MPDatabasePackageControllerErrorCode {
                                      failIfExists:(BOOL)failIfExists
                                             error:(NSError *__nonnull *__nonnull)error;
 
+/** Makes a copy of the package, without its snapshots, while its databases remain open.
+  * Each database is copied consistently with the SQLite online backup API, attachment blobs are hard linked, and the remaining files copied, concurrently.
+  * With overwrite, an existing copy at rootURL is updated in place: unchanged databases, blobs and files are not copied again, and items no longer in the package are removed.
+  * @param progressHandler An optional block called serially, on an arbitrary queue, with the fraction of the copy completed. Setting stop to YES cancels the copy, which then fails with NSUserCancelledError, leaving a partial copy at rootURL. */
+- (BOOL)makeTemporaryCopyIntoRootDirectoryWithURL:(nonnull NSURL *)rootURL
+                                overwriteIfExists:(BOOL)overwrite
+                                     failIfExists:(BOOL)failIfExists
+                                  progressHandler:(nullable void (^)(double fractionCompleted, BOOL *_Nonnull stop))progressHandler
+                                            error:(NSError *__nullable *__nullable)error;
+
 /** 
  * Initializes a database package controller at a given path, with an optional delegate and error pointer.
  * @param path The filesystem path for the root directory of the database pacakge.
@@ -139,7 +202,52 @@ typedef enum MPDatabasePackageControllerErrorCode {
 - (nullable instancetype)initWithPath:(nonnull NSString *)path
                              readOnly:(BOOL)readOnly
                              delegate:(nullable id<MPDatabasePackageControllerDelegate>)delegate
-                                error:(NSError *__nonnull __autoreleasing *__nonnull)err NS_DESIGNATED_INITIALIZER;
+                                error:(NSError *__nonnull __autoreleasing *__nonnull)err;
+
+/**
+ * Initializes a database package controller, optionally opening all but its primary database in the background.
+ * The database files are bootstrapped and checked for corruption concurrently in either case. The databases opened in the background share the serial queue of -server, so they are opened one after another unless -usesServerPerDatabase.
+ * When opening in the background, the initializer returns once the primary database is open (readiness MPDatabasePackageControllerReadinessPrimaryDatabaseReady):
+ * the properties of the other databases are nil, and the contributor, snapshot and other controllers, root sections and listener do not exist, until the package becomes ready.
+ * Controllers of secondary databases should be created in -didOpenDatabases, after which MPDatabasePackageControllerDidBecomeReadyNotification is posted and the completion handler called.
+ * @param opensDatabasesInBackground NO to open all databases before returning, as -initWithPath:readOnly:delegate:error: does.
+ * @param completionHandler Called on the main thread when the databases opened in the background are ready, or failed to open. Not called when opening synchronously.
+ * */
+- (nullable instancetype)initWithPath:(nonnull NSString *)path
+                             readOnly:(BOOL)readOnly
+                             delegate:(nullable id<MPDatabasePackageControllerDelegate>)delegate
+           opensDatabasesInBackground:(BOOL)opensDatabasesInBackground
+                    completionHandler:(nullable MPDatabasePackageControllerOpenCompletionHandler)completionHandler
+                                error:(NSError *__nullable __autoreleasing *__nullable)err NS_DESIGNATED_INITIALIZER;
+
+/** YES if the package was opened read-only: its databases are opened read-only and must exist, and neither validation, replication filters, the listener, the full-text index nor view warming are set up.
+  * Views are queried as last indexed, without updating their indexes, and saving or deleting objects fails with MPDatabasePackageControllerErrorCodeReadOnly. */
+@property (readonly, getter=isReadOnly) BOOL readOnly;
+
+/** Whether each database other than the primary database gets a CBLManager and serial dispatch queue of its own, rather than sharing -server and its queue (default: NO).
+  * Work on different databases, such as a snapshot being written while the primary database is read, then proceeds in parallel.
+  * Each queue is recognised by mp_dispatch_sync with the -serverQueueToken, so database access should dispatch to the queue of the database's own manager (db.database.manager.dispatchQueue), and must not synchronously dispatch from one database's queue to another's and back.
+  * The listener serves -server alone, so the other databases cannot be replicated peer-to-peer: opening a package which uses a server per database
+  * fails with MPDatabasePackageControllerErrorCodeListenerUnavailable if the package requires a listener (see -[MPDatabasePackageControllerDelegate packageControllerRequiresListener:]). */
+@property (readonly) BOOL usesServerPerDatabase;
+
+/** Whether the phases of opening the package are timed with a startupTracer (default: NO, overridable application wide with user default MPTracePackageOpening, or the -MPTracePackageOpening YES launch argument). */
+@property (readonly) BOOL tracesOpening;
+
+/** Wall and CPU time spent opening the package, by phase ("phase"), database ("database", "filters") and managed objects controller class ("controller", "bundledData"), with the whole open spanned under "package".
+  * nil unless the package -tracesOpening. */
+@property (readonly, strong, nullable) MPStartupTracer *startupTracer;
+
+/** Saves the objects of the package's controllers that -autosavesObjects together, with one transaction per database,
+  * at an interval and dirty count threshold configurable on the scheduler. Flushed when the package is saved and closed. */
+@property (readonly, strong, nonnull) MPAutosaveScheduler *autosaveScheduler;
+
+/** How far the package controller has got in opening its databases. Changes on the main thread, and is key-value observable. */
+@property (readonly) MPDatabasePackageControllerReadiness readiness;
+
+/** Called on the main thread once all databases are open and the base class controllers created, before the package becomes ready.
+  * Default implementation does nothing. When opening synchronously, it is called before the subclass initializer's call to super returns. */
+- (void)didOpenDatabases;
 
 - (nullable instancetype)initWithFileURL:(nonnull NSURL *)fileURL
                                 readOnly:(BOOL)isReadOnly
@@ -291,6 +399,14 @@ typedef enum MPDatabasePackageControllerErrorCode {
   * (for instance a database package controller used to back a NSDocument) can provide its own. */
 @property (strong, readonly, nonnull) NSNotificationCenter *notificationCenter;
 
+/** Database changes are delivered as one MPManagedObjectsBatchChange per managed objects controller per coalescing window (see MPManagedObjectsControllerDidChangeObjectsNotification).
+  * This is the length of that window in seconds (default: 0.016). Set to 0 to deliver each database change notification's batch on the next main queue turn. */
+@property (readwrite) NSTimeInterval changeCoalescingInterval;
+
+/** Compatibility mode: if YES, changes coming from the database are additionally posted as per-object recent and past change notifications,
+  * as well as bumping the delegate's change count for deletions, and so are the objects saved by -performBatchUpdates:error: and -saveObjects:error: (default: NO). */
+@property (readwrite) BOOL postsPerObjectChangeNotifications;
+
 /** The snapshot controller. */
 @property (strong, readonly, nonnull) MPSnapshotsController *snapshotsController;
 
@@ -304,6 +420,25 @@ typedef enum MPDatabasePackageControllerErrorCode {
  * @param err An error pointer. */
 - (BOOL)restoreFromSnapshotWithName:(nonnull NSString *)name error:(NSError *__nullable *__nullable)err;
 
+/** Restore the state of the database package using a named snapshot, reporting progress.
+ * Only objects changed since the snapshot are written, in one transaction per database, and objects created since the snapshot are deleted
+ * (except when restoring a snapshot taken before snapshots listed their contents, which only restores the objects it contains).
+ * The changed objects are found from the changes to the databases since the snapshot, so restoring a recent snapshot reads little more than what changed.
+ * @param name The name of the snapshot to restore the state for the package from.
+ * @param progressHandler An optional block called asynchronously on the main queue with the fraction of the changed objects restored,
+ * whenever it has advanced by at least a percent, and with 1.0 once all are restored.
+ * @param err An error pointer. */
+- (BOOL)restoreFromSnapshotWithName:(nonnull NSString *)name
+                    progressHandler:(nullable void (^)(double fractionCompleted))progressHandler
+                              error:(NSError *__nullable *__nullable)err;
+
+/** Restore the state of the database package using a named snapshot, as -restoreFromSnapshotWithName:progressHandler:error: does,
+ * with progress reported on the given queue (the main queue if nil). */
+- (BOOL)restoreFromSnapshotWithName:(nonnull NSString *)name
+                      progressQueue:(nullable dispatch_queue_t)progressQueue
+                    progressHandler:(nullable void (^)(double fractionCompleted))progressHandler
+                              error:(NSError *__nullable *__nullable)err;
+
 /** Returns a database package controller with the specified identifier, if one happens to be currently open. */
 + (nullable instancetype)databasePackageControllerWithFullyQualifiedIdentifier:(nonnull NSString *)identifier;
 
@@ -316,6 +451,19 @@ typedef enum MPDatabasePackageControllerErrorCode {
 /** Returns a managed object given the identifier. */
 - (nullable __kindof MPManagedObject *)objectWithIdentifier:(nonnull NSString *)identifier NS_SWIFT_NAME(object(withIdentifier:));
 
+/** Returns managed objects given their identifiers, which can be of any managed object class in the package.
+ * Cached objects are returned without a database access, and the rest are fetched with one prefetching query per database.
+ * @return The objects found, in the order of the identifiers given as argument. Identifiers with no matching object are skipped. */
+- (nonnull NSArray<__kindof MPManagedObject *> *)objectsWithIdentifiers:(nonnull NSArray<NSString *> *)identifiers NS_SWIFT_NAME(objects(withIdentifiers:));
+
+/** Performs the updates in the block, then saves the objects changed in it with one transaction per database.
+ * Controllers get their -willSaveObjects: and -didSaveObjects: hooks in bulk, a single MPDatabasePackageControllerDidPerformBatchUpdatesNotification is posted
+ * and the delegate's change count updated once. Batch updates can be nested on the same thread, in which case the outermost one saves.
+ * @param updates A block which modifies managed objects of any of the package's controllers.
+ * @param error An error pointer, set if saving one of the databases failed. Databases saved before the failing one remain saved,
+ * and the objects of the failing one are left needing saving. */
+- (BOOL)performBatchUpdates:(nonnull void (^)(void))updates error:(NSError *__nullable *__nullable)error;
+
 /** WAL Checkpoints the specified databases. */
 - (BOOL)checkpointDatabases:(nonnull NSArray<MPDatabase *>*)databases error:(NSError *__nullable *__nullable)err;
 
@@ -333,9 +481,14 @@ typedef enum MPDatabasePackageControllerErrorCode {
 
 #pragma mark - 
 
-/** Saves the database as well, a manifest, as well as a JSON dictionary representation. */
+/** Saves the database as well, a manifest, as well as a JSON dictionary representation.
+  * With savesDatabasesOnline, saving to the same URL again copies only databases which changed since and attachment blobs missing at the URL. */
 - (BOOL)saveToURL:(nonnull NSURL *)URL error:(NSError *__nullable *__nullable)error;
 
+/** If YES, -saveToURL:error: copies each database with the SQLite online backup API a number of pages at a time while the database stays open for reading and writing,
+  * and hard links its attachment blobs. If NO, the databases are checkpointed, their queues suspended, and the package copied as a whole (default: YES). */
+@property (readwrite) BOOL savesDatabasesOnline;
+
 /** Relative URL to a file that contains a preview of the database package.
   * URL is relative to the URL of the database package controller. */
 @property (readonly, nonnull) NSURL *relativePreviewURL;
@@ -362,6 +515,13 @@ typedef enum MPDatabasePackageControllerErrorCode {
 /** JSON encodable dictionary representation of all objects in the database package. */
 @property (readonly, nonnull) NSDictionary *dictionaryRepresentation;
 
+/** Writes the dictionary representation to dictionaryRepresentationURL in compact form, streaming each database's documents a page at a time rather than building dictionaryRepresentation in memory. */
+- (BOOL)saveDictionaryRepresentation:(NSError *__nullable *__nullable)error;
+
+/** If YES, -saveDictionaryRepresentation: writes out again only the databases changed since it last wrote the file, copying the others' parts of the file as they were (default: YES).
+  * The file is written in full the first time, and whenever it was modified by something else since. */
+@property (readwrite) BOOL updatesDictionaryRepresentationIncrementally;
+
 @end
 
 #pragma mark -
@@ -9,6 +9,7 @@
 #import "MPDatabase.h"
 #import "MPDatabasePackageController+Protected.h"
 #import "MPManagedObjectsController+Protected.h"
+#import "MPManagedObject+Protected.h"
 #import "MPSnapshot+Protected.h"
 
 @import FeatherExtensions;
@@ -18,6 +19,12 @@
 #import <Feather/Feather-Swift.h>
 
 #import "MPSnapshotsController.h"
+#import "MPSnapshotsController+Protected.h"
+#import "MPDatabaseBackup.h"
+#import "MPJSONStreamWriter.h"
+#import "MPFullTextIndex.h"
+#import "MPStartupTracer.h"
+#import "MPAutosaveScheduler.h"
 #import "MPException.h"
 
 #import "MPRootSection.h"
@@ -31,27 +38,68 @@
 #import <arpa/inet.h>
 #import <net/if.h>
 #import <ifaddrs.h>
+#import <sqlite3.h>
 
 NSString * const MPDatabasePackageListenerDidStartNotification = @"MPDatabasePackageListenerDidStartNotification";
+NSString * const MPDatabasePackageControllerDidPerformBatchUpdatesNotification = @"MPDatabasePackageControllerDidPerformBatchUpdatesNotification";
+NSString * const MPDatabasePackageControllerDidWarmViewsNotification = @"MPDatabasePackageControllerDidWarmViewsNotification";
+NSString * const MPDatabasePackageControllerBatchChangesKey = @"batchChanges";
+NSString * const MPDatabasePackageControllerDidBecomeReadyNotification = @"MPDatabasePackageControllerDidBecomeReadyNotification";
+NSString * const MPDatabasePackageControllerDidFailToOpenNotification = @"MPDatabasePackageControllerDidFailToOpenNotification";
+NSString * const MPDatabasePackageControllerErrorKey = @"error";
+
+static NSString * const MPCopiedSequenceNumberKey = @"sequenceNumber";
+
+/** Number of databases and files copied concurrently when saving or copying a package. */
+static const NSUInteger MPDatabasePackageCopyMaximumConcurrentTaskCount = 4;
+
+/** The part of the dictionary representation file holding a database's documents. */
+@interface MPDictionaryRepresentationSegment : NSObject
+@property (readonly) UInt64 lastSequenceNumber;
+@property (readonly) NSRange range;
+- (instancetype)initWithLastSequenceNumber:(UInt64)lastSequenceNumber range:(NSRange)range;
+@end
+
+@implementation MPDictionaryRepresentationSegment
+
+- (instancetype)initWithLastSequenceNumber:(UInt64)lastSequenceNumber range:(NSRange)range {
+    if (self = [super init]) {
+        _lastSequenceNumber = lastSequenceNumber;
+        _range = range;
+    }
+    return self;
+}
 
-@interface MPTemporaryDatabasePackageCopyFileManagerDelegate : NSObject <NSFileManagerDelegate>
 @end
 
-@implementation MPTemporaryDatabasePackageCopyFileManagerDelegate
+/** A changed document resolved on its database's queue, to be added to a batch change on the main thread without the CBLDocument. */
+@interface MPDocumentChange : NSObject
+@property (readonly) MPManagedObjectsController *controller;
+@property (readonly) NSString *documentID;
+@property (readonly) MPChangeType changeType;
 
-- (BOOL)fileManager:(NSFileManager *)fileManager shouldCopyItemAtURL:(NSURL *)sourceURL toURL:(NSURL *)destionationURL
-{
-    NSString *filename = sourceURL.path.lastPathComponent;
-    
-    if ([filename hasPrefix:@"snapshot"])
-    {
-        MPLog(@"Will skip snapshots %@ for temporary copies.", filename);
-        return NO;
+/** The document's model object, if it was loaded. */
+@property (readonly) MPManagedObject *object;
+
+- (instancetype)initWithController:(MPManagedObjectsController *)controller
+                        documentID:(NSString *)documentID
+                        changeType:(MPChangeType)changeType
+                            object:(MPManagedObject *)object;
+@end
+
+@implementation MPDocumentChange
+
+- (instancetype)initWithController:(MPManagedObjectsController *)controller
+                        documentID:(NSString *)documentID
+                        changeType:(MPChangeType)changeType
+                            object:(MPManagedObject *)object {
+    if (self = [super init]) {
+        _controller = controller;
+        _documentID = documentID;
+        _changeType = changeType;
+        _object = object;
     }
-    
-    MPLog(@"Will copy %@ to %@", filename, destionationURL.path);
-    
-    return YES;
+    return self;
 }
 
 @end
@@ -72,6 +120,29 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
     NSMutableDictionary *_controllerDictionary;
     
     NSString *_fullyQualifiedIdentifier;
+    
+    NSMapTable<MPManagedObjectsController *, MPManagedObjectsBatchChange *> *_pendingBatchChanges;
+    BOOL _batchChangeDeliveryScheduled;
+    
+    /** The thread dictionary key under which the objects changed in the current thread's batch updates are collected. */
+    NSString *_batchUpdatesThreadKey;
+    
+    /** Last sequence number of each database when it was last copied (under MPCopiedSequenceNumberKey), and the size, modification date
+      * and file number the copy had once made, keyed by the path it was copied to. */
+    NSMutableDictionary<NSString *, NSDictionary *> *_copiedDatabaseStatesByPath;
+    
+    /** Segments of the dictionary representation file as last written, by database name, and the attributes the file had then. */
+    NSDictionary<NSString *, MPDictionaryRepresentationSegment *> *_dictionaryRepresentationSegments;
+    NSDictionary<NSString *, id> *_dictionaryRepresentationFileAttributes;
+    
+    MPFullTextIndex *_fullTextIndex;
+    NSUInteger _fullTextIndexRebuildCount;
+    
+    /** Spans the package being opened, until it becomes ready or fails to open. */
+    MPStartupTraceSpan *_openSpan;
+    
+    /** Managers of the databases not on _server, by database name, if the package -usesServerPerDatabase. */
+    NSDictionary<NSString *, CBLManager *> *_databaseServers;
 }
 
 @property (strong, readwrite) MPDatabase *snapshotsDatabase;
@@ -83,6 +154,11 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
 
 @property (readwrite) TreeItemPool *treeItemPool;
 
+@property (readwrite) MPDatabasePackageControllerReadiness readiness;
+
+/** Whether the package is served by a listener, for peer-to-peer replication. */
+@property (readonly) BOOL requiresListener;
+
 @end
 
 @implementation MPDatabasePackageController
@@ -98,6 +174,20 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
                     readOnly:(BOOL)readOnly
                     delegate:(id<MPDatabasePackageControllerDelegate>)delegate
                        error:(NSError *__autoreleasing *)err {
+    return [self initWithPath:path
+                     readOnly:readOnly
+                     delegate:delegate
+   opensDatabasesInBackground:NO
+            completionHandler:nil
+                        error:err];
+}
+
+- (instancetype)initWithPath:(NSString *)path
+                    readOnly:(BOOL)readOnly
+                    delegate:(id<MPDatabasePackageControllerDelegate>)delegate
+  opensDatabasesInBackground:(BOOL)opensDatabasesInBackground
+           completionHandler:(MPDatabasePackageControllerOpenCompletionHandler)completionHandler
+                       error:(NSError *__autoreleasing *)err {
     // off-main thread access of MPDatabasePackageController is safe,
     // but initialisation is needed on main thread in order to call -didInitialize safely
     // after full initialization has finished
@@ -108,164 +198,446 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
         NSAssert(path, ([NSString stringWithFormat:@"Expecting a non-nil path -- package controller type: %@", NSStringFromClass([self class])]));
         
         _path = path.copy;
+        
+        if (self.tracesOpening) {
+            _startupTracer = [[MPStartupTracer alloc] init];
+            _openSpan = [_startupTracer beginSpanNamed:NSStringFromClass(self.class) category:@"package"];
+        }
+        
         _fullyQualifiedIdentifier = [[_path stringByAppendingString:@"::"] stringByAppendingString:[[NSUUID UUID] UUIDString]];
         
         _sessionID = [[[NSUUID UUID] UUIDString] copy];
         MPLog(@"Database package session ID is %@", _sessionID);
         
         _delegate = delegate;
+        _readOnly = readOnly;
+        _readiness = MPDatabasePackageControllerReadinessOpening;
         
         _controllerDictionary = [NSMutableDictionary dictionaryWithCapacity:20];
         
+        _changeCoalescingInterval = 0.016;
+        _pendingBatchChanges = [NSMapTable strongToStrongObjectsMapTable];
+        _batchUpdatesThreadKey = [NSString stringWithFormat:@"MPBatchUpdatesChangedObjects-%p", self];
+        _autosaveScheduler = [[MPAutosaveScheduler alloc] initWithPackageController:self];
+        
+        _savesDatabasesOnline = YES;
+        _copiedDatabaseStatesByPath = [NSMutableDictionary dictionary];
+        _updatesDictionaryRepresentationIncrementally = YES;
+        
         [self makeNotificationCenter];
 
-        CBLManagerOptions opts;
-        opts.readOnly = NO;
+        CBLManagerOptions opts = { .readOnly = readOnly };
         
         NSScanner *scanner = [NSScanner scannerWithString:[[NSUUID UUID] UUIDString]];
         [scanner scanHexLongLong:&_serverQueueToken];
         
-        _server = [[CBLManager alloc] initWithDirectory:_path options:&opts error:err];
-        objc_setAssociatedObject(_server, "dbp", self, OBJC_ASSOCIATION_ASSIGN);
-        
-        _server.dispatchQueue = mp_dispatch_queue_create(_path, _serverQueueToken, DISPATCH_QUEUE_SERIAL);
-        _server.etagPrefix = [[NSUUID UUID] UUIDString]; // TODO: persist the etag inside the package for added performance (this gives predictable behaviour: every app start effectively clears the cache).
-        
-        [_server.customHTTPHeaders addEntriesFromDictionary:[self databaseListenerHTTPHeaders]];
-        
-        _managedObjectsControllers = [NSMutableSet setWithCapacity:20];
-        NSMutableArray *didResetDatabases = [NSMutableArray new];
+        MPStartupTraceSpan *serverSpan = [_startupTracer beginSpanNamed:@"CBLManager" category:@"phase"];
+        _server = [self newServerWithQueueLabel:_path options:&opts error:err];
+        if (!_server)
+            return nil;
         
-        for (NSString *dbName in self.class.databaseNames)
+        if (self.usesServerPerDatabase)
         {
-            if (![self bootstrapDatabaseWithName:dbName error:err])
+            // the listener serves one manager, so the databases on managers of their own could not be replicated peer-to-peer.
+            if (self.requiresListener)
+            {
+                if (err)
+                    *err = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                               code:MPDatabasePackageControllerErrorCodeListenerUnavailable
+                                           userInfo:@{ NSLocalizedDescriptionKey : @"A package which uses a server per database cannot be served by a listener.",
+                                                       NSFilePathErrorKey : _path }];
                 return nil;
+            }
             
-            NSError *dbError = nil;
-            
-            CBLManager *server = [self serverForDatabaseWithName:dbName];
-            MPDatabase *db = [self initializeDatabaseNamed:dbName server:server error:&dbError];
+            NSMutableDictionary<NSString *, CBLManager *> *databaseServers = [NSMutableDictionary dictionary];
             
-            // If database file has been corrupted, replace it with a new one
-            if (!db && dbError && [dbError.domain isEqualToString:@"SQLite"] && dbError.code == 26)
+            // the primary database stays on the package's server, which the listener serves.
+            for (NSString *dbName in self.class.databaseNames)
             {
-                NSURL *databaseURL = [NSURL fileURLWithPath:[_server.directory stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.cblite", dbName]]];
-                NSFileManager *fm = [NSFileManager defaultManager];
-                
-                if ([fm fileExistsAtPath:databaseURL.path])
-                {
-                    if (![fm removeItemAtURL:databaseURL error:err]) {
-                        return nil;
-                    }
-                }
+                if ([dbName isEqualToString:self.class.primaryDatabaseName])
+                    continue;
                 
-                db = [self initializeDatabaseNamed:dbName server:server error:&dbError];
+                CBLManager *server = [self newServerWithQueueLabel:[_path stringByAppendingPathComponent:dbName] options:&opts error:err];
+                if (!server)
+                    return nil;
                 
-                if (db) {
-                    [didResetDatabases addObject:db];
-                }
+                databaseServers[dbName] = server;
             }
             
-            if (!db)
+            _databaseServers = databaseServers.copy;
+        }
+        [serverSpan end];
+        
+        _managedObjectsControllers = [NSMutableSet setWithCapacity:20];
+        
+        NSArray<NSString *> *dbNames = self.class.databaseNames.allObjects;
+        MPStartupTraceSpan *prepareSpan = [_startupTracer beginSpanNamed:@"bootstrap" category:@"phase"];
+        NSSet<NSString *> *replacedDatabaseNames = [self prepareDatabasesNamed:dbNames error:err];
+        if (!replacedDatabaseNames)
+            return nil;
+        [prepareSpan end];
+        
+        if (!opensDatabasesInBackground)
+        {
+            NSMutableArray *didResetDatabases = [NSMutableArray new];
+            
+            for (NSString *dbName in dbNames)
             {
-                if (err) {
-                    *err = dbError;
-                }
-                return nil;
+                BOOL didReset = NO;
+                MPDatabase *db = [self openDatabaseNamed:dbName didReset:&didReset error:err];
+                if (!db)
+                    return nil;
+                
+                if (didReset || [replacedDatabaseNames containsObject:dbName])
+                    [didResetDatabases addObject:db];
+                
+                [self didOpenDatabase:db];
             }
             
-            [self setValue:db forKey:[NSString stringWithFormat:@"%@Database", [self databasePropertyPrefixForDatabaseName:db.name]]];
-            
-            NSString *pushFilterName = [self pushFilterNameForDatabaseNamed:dbName];
-            if (pushFilterName) {
-                CBLFilterBlock filterBlock
-                    = [self pushFilterBlockWithName:pushFilterName forDatabase:db];
-                [db defineFilterNamed:pushFilterName block:filterBlock];
-            }
+            if (![self finishOpeningWithResetDatabases:didResetDatabases error:err])
+                return nil;
             
-            NSString *pullFilterName = [self pullFilterNameForDatabaseNamed:dbName];
-            if (pullFilterName) {
-                CBLFilterBlock filterBlock
-                    = [self pullFilterBlockWithName:pullFilterName forDatabase:db];
-                [db defineFilterNamed:pullFilterName block:filterBlock];
-            }
+            _readiness = MPDatabasePackageControllerReadinessReady;
+            [_openSpan end];
+            return self;
         }
         
-        if (didResetDatabases.count > 0) {
-            _databasesResetDuringInitialization = [didResetDatabases copy];
-        }
+        // the primary database is opened before returning, so that controllers of its objects can be created right away.
+        NSString *primaryDatabaseName = self.class.primaryDatabaseName;
+        NSMutableArray *didResetDatabases = [NSMutableArray new];
         
-#ifdef DEBUG
-        for (NSString *dbName in [[self class] databaseNames])
+        if (primaryDatabaseName)
         {
-            id dbObj = [self valueForKey:[NSString stringWithFormat:@"%@Database", [self databasePropertyPrefixForDatabaseName:dbName]]];
-            assert([dbObj isKindOfClass:[MPDatabase class]]);
+            BOOL didReset = NO;
+            MPDatabase *db = [self openDatabaseNamed:primaryDatabaseName didReset:&didReset error:err];
+            if (!db)
+                return nil;
+            
+            if (didReset || [replacedDatabaseNames containsObject:primaryDatabaseName])
+                [didResetDatabases addObject:db];
+            
+            [self didOpenDatabase:db];
         }
-#endif
-        
-        _contributorsController = [[MPContributorsController alloc] initWithPackageController:self
-                                                                                      database:self.primaryDatabase error:err];
-        if (!_contributorsController)
-            return nil;
-        
-        _contributorIdentitiesController = [[MPContributorIdentitiesController alloc] initWithPackageController:self
-                                                                                                       database:self.primaryDatabase error:err];
-        if (!_contributorIdentitiesController)
-            return nil;
         
-        assert(_snapshotsDatabase);
-        _snapshotsController
-            = [[MPSnapshotsController alloc] initWithPackageController:self database:_snapshotsDatabase error:err];
-        if (!_snapshotsController)
-            return nil;
+        _readiness = MPDatabasePackageControllerReadinessPrimaryDatabaseReady;
         
-        _treeItemPool = [[TreeItemPool alloc] init];
+        NSArray<NSString *> *remainingDBNames = [dbNames filteredArrayUsingPredicate:
+                                                 [NSPredicate predicateWithBlock:^BOOL(NSString *dbName, NSDictionary *bindings) {
+            return ![dbName isEqualToString:primaryDatabaseName];
+        }]];
         
-        _pulls = [[NSMutableArray alloc] initWithCapacity:[[[self class] databaseNames] count]];
-        _completedPulls = [[NSMutableArray alloc] initWithCapacity:[[[self class] databaseNames] count]];
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            NSMutableArray *openedDatabases = [NSMutableArray arrayWithCapacity:remainingDBNames.count];
+            for (NSUInteger i = 0; i < remainingDBNames.count; i++)
+                [openedDatabases addObject:[NSNull null]];
+            
+            __block NSError *openError = nil;
+            
+            // databases of a manager are opened on its serial queue, so they are opened in parallel only if each has a manager of its own.
+            void (^openDatabase)(size_t) = ^(size_t i) {
+                NSError *dbError = nil;
+                BOOL didReset = NO;
+                MPDatabase *db = [self openDatabaseNamed:remainingDBNames[i] didReset:&didReset error:&dbError];
+                
+                @synchronized (openedDatabases) {
+                    if (db)
+                        openedDatabases[i] = db;
+                    else if (!openError)
+                        openError = dbError;
+                    
+                    if (db && (didReset || [replacedDatabaseNames containsObject:db.name]))
+                        [didResetDatabases addObject:db];
+                }
+            };
+            
+            if (self.usesServerPerDatabase)
+                dispatch_apply(remainingDBNames.count, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), openDatabase);
+            else
+                for (size_t i = 0; i < remainingDBNames.count; i++)
+                    openDatabase(i);
+            
+            dispatch_async(dispatch_get_main_queue(), ^{
+                NSError *finishError = openError;
+                
+                if (!finishError)
+                {
+                    for (MPDatabase *db in openedDatabases)
+                        [self didOpenDatabase:db];
+                    
+                    [self finishOpeningWithResetDatabases:didResetDatabases error:&finishError];
+                }
+                
+                if (finishError)
+                {
+                    MPLog(@"Failed to open the databases of package %@: %@", self.path, finishError);
+                    self.readiness = MPDatabasePackageControllerReadinessFailed;
+                    [self->_openSpan end];
+                    [self.notificationCenter postNotificationName:MPDatabasePackageControllerDidFailToOpenNotification
+                                                           object:self
+                                                         userInfo:@{ MPDatabasePackageControllerErrorKey : finishError }];
+                }
+                else
+                {
+                    self.readiness = MPDatabasePackageControllerReadinessReady;
+                    [self->_openSpan end];
+                    [self.notificationCenter postNotificationName:MPDatabasePackageControllerDidBecomeReadyNotification object:self];
+                }
+                
+                if (completionHandler)
+                    completionHandler(self, finishError);
+            });
+        });
+    }
+    
+    return self;
+}
+
+/** A manager of the package's directory with a serial queue of its own, recognised by mp_dispatch_sync with the -serverQueueToken. */
+- (CBLManager *)newServerWithQueueLabel:(NSString *)label options:(CBLManagerOptions *)options error:(NSError **)err {
+    CBLManager *server = [[CBLManager alloc] initWithDirectory:_path options:options error:err];
+    if (!server)
+        return nil;
+    
+    objc_setAssociatedObject(server, "dbp", self, OBJC_ASSOCIATION_ASSIGN);
+    
+    server.dispatchQueue = mp_dispatch_queue_create(label, _serverQueueToken, DISPATCH_QUEUE_SERIAL);
+    server.etagPrefix = [[NSUUID UUID] UUIDString]; // TODO: persist the etag inside the package for added performance (this gives predictable behaviour: every app start effectively clears the cache).
+    
+    [server.customHTTPHeaders addEntriesFromDictionary:[self databaseListenerHTTPHeaders]];
+    
+    return server;
+}
+
+/** Bootstraps the databases, and checks concurrently that the existing database files are SQLite databases, removing those that are not.
+  * @return The names of the databases whose files were removed, or nil if a database could not be bootstrapped. */
+- (NSSet<NSString *> *)prepareDatabasesNamed:(NSArray<NSString *> *)dbNames error:(NSError **)err {
+    // a read-only package is opened as it is.
+    if (_readOnly)
+        return [NSSet set];
+    
+    NSMutableSet<NSString *> *replacedDatabaseNames = [NSMutableSet new];
+    __block NSError *prepareError = nil;
+    
+    dispatch_apply(dbNames.count, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        NSString *dbName = dbNames[i];
+        NSError *dbError = nil;
+        BOOL replaced = NO;
         
-        BOOL requiresListener = ![NSBundle isCommandLineTool] && // FIXME: manuel will need to serve static resources to equation compilers somehow
-                                ![NSBundle isXPCService] &&
-                                [self synchronizesPeerlessly];
+        BOOL success = [self bootstrapDatabaseWithName:dbName error:&dbError]
+                    && [self validateDatabaseFileNamed:dbName replaced:&replaced error:&dbError];
         
-        if ([self.delegate respondsToSelector:@selector(packageControllerRequiresListener:)]) {
-            requiresListener = [self.delegate packageControllerRequiresListener:self];
+        @synchronized (replacedDatabaseNames) {
+            if (!success && !prepareError)
+                prepareError = dbError;
+            if (replaced)
+                [replacedDatabaseNames addObject:dbName];
         }
+    });
+    
+    if (prepareError) {
+        if (err)
+            *err = prepareError;
+        return nil;
+    }
+    
+    return replacedDatabaseNames.copy;
+}
+
+- (NSURL *)databaseFileURLForDatabaseNamed:(NSString *)dbName {
+    return [NSURL fileURLWithPath:[_server.directory stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.cblite", dbName]]];
+}
+
+/** Removes the database's file if it exists but is not a database (it has been corrupted), so that an empty database is created in its place. */
+- (BOOL)validateDatabaseFileNamed:(NSString *)dbName replaced:(BOOL *)replaced error:(NSError **)err {
+    NSURL *databaseURL = [self databaseFileURLForDatabaseNamed:dbName];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    
+    if (![fm fileExistsAtPath:databaseURL.path])
+        return YES;
+    
+    sqlite3 *db = NULL;
+    int result = sqlite3_open_v2(databaseURL.fileSystemRepresentation, &db, SQLITE_OPEN_READONLY, NULL);
+    if (result == SQLITE_OK)
+        result = sqlite3_exec(db, "PRAGMA schema_version", NULL, NULL, NULL);
+    sqlite3_close(db);
+    
+    // other errors, such as a busy database, are left for CouchbaseLite to report when opening it.
+    if (result != SQLITE_NOTADB)
+        return YES;
+    
+    MPLog(@"Database file %@ is not a database, replacing it with an empty database.", databaseURL.path);
+    if (![fm removeItemAtURL:databaseURL error:err])
+        return NO;
+    
+    *replaced = YES;
+    return YES;
+}
+
+/** Opens a database, replacing its file with an empty database if CouchbaseLite finds it corrupted. Safe to call off the main thread. */
+- (MPDatabase *)openDatabaseNamed:(NSString *)dbName didReset:(BOOL *)didReset error:(NSError **)err {
+    MPStartupTraceSpan *span = [_startupTracer beginSpanNamed:dbName category:@"database"];
+    NSError *dbError = nil;
+    
+    CBLManager *server = [self serverForDatabaseWithName:dbName];
+    MPDatabase *db = [self initializeDatabaseNamed:dbName server:server error:&dbError];
+    
+    // If database file has been corrupted, replace it with a new one
+    if (!db && !_readOnly && dbError && [dbError.domain isEqualToString:@"SQLite"] && dbError.code == SQLITE_NOTADB)
+    {
+        NSURL *databaseURL = [self databaseFileURLForDatabaseNamed:dbName];
+        NSFileManager *fm = [NSFileManager defaultManager];
         
-        if (requiresListener) {
-            __weak typeof(self) weakSelf = self;
-            [self startListenerWithCompletionHandler:^(NSError *err)
-            {
-                __strong typeof(weakSelf) strongSelf = weakSelf;
-                [strongSelf.notificationCenter postNotificationName:MPDatabasePackageListenerDidStartNotification object:self];
-            }];
+        if ([fm fileExistsAtPath:databaseURL.path])
+        {
+            if (![fm removeItemAtURL:databaseURL error:err]) {
+                return nil;
+            }
         }
         
-        // populate root section properties
-        _rootSections = [self newRootSections];
+        db = [self initializeDatabaseNamed:dbName server:server error:&dbError];
         
-        _registeredViewNames = [NSMutableSet setWithCapacity:128];
-        
-        [self.class registerDatabasePackageController:self];
-
-        [[self class] didOpenPackage];
-        
-        // state initialisation done on a subsequent event loop cycle such that potential assignments
-        // (such as to a singleton reference to this object) exists.
-        
-        if (![NSBundle inTestSuite]) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self ensureInitialStateInitialized];
-                
-                if ([self.delegate respondsToSelector:@selector(packageControllerRequiresPlaceholderContent:)]
-                    && [self.delegate packageControllerRequiresPlaceholderContent:self]) {
-                    [self ensurePlaceholderInitialized];
-                }
-            });
+        if (db) {
+            *didReset = YES;
         }
     }
     
-    return self;
+    if (!db)
+    {
+        if (err) {
+            *err = dbError;
+        }
+        return nil;
+    }
+    
+    [span end];
+    return db;
+}
+
+/** Assigns an opened database to its property, and defines its replication filters unless the package is read-only. */
+- (void)didOpenDatabase:(MPDatabase *)db {
+    NSParameterAssert([NSThread isMainThread]);
+    
+    [self setValue:db forKey:[NSString stringWithFormat:@"%@Database", [self databasePropertyPrefixForDatabaseName:db.name]]];
+    
+    if (_readOnly)
+        return;
+    
+    MPStartupTraceSpan *span = [_startupTracer beginSpanNamed:db.name category:@"filters"];
+    
+    NSString *pushFilterName = [self pushFilterNameForDatabaseNamed:db.name];
+    if (pushFilterName) {
+        CBLFilterBlock filterBlock
+            = [self pushFilterBlockWithName:pushFilterName forDatabase:db];
+        [db defineFilterNamed:pushFilterName block:filterBlock];
+    }
+    
+    NSString *pullFilterName = [self pullFilterNameForDatabaseNamed:db.name];
+    if (pullFilterName) {
+        CBLFilterBlock filterBlock
+            = [self pullFilterBlockWithName:pullFilterName forDatabase:db];
+        [db defineFilterNamed:pullFilterName block:filterBlock];
+    }
+    
+    [span end];
+}
+
+/** Creates the controllers, root sections and services of the package once all of its databases are open. */
+- (BOOL)finishOpeningWithResetDatabases:(NSArray<MPDatabase *> *)didResetDatabases error:(NSError **)err {
+    NSParameterAssert([NSThread isMainThread]);
+    
+    if (didResetDatabases.count > 0) {
+        _databasesResetDuringInitialization = [didResetDatabases copy];
+    }
+    
+#ifdef DEBUG
+    for (NSString *dbName in [[self class] databaseNames])
+    {
+        id dbObj = [self valueForKey:[NSString stringWithFormat:@"%@Database", [self databasePropertyPrefixForDatabaseName:dbName]]];
+        assert([dbObj isKindOfClass:[MPDatabase class]]);
+    }
+#endif
+    
+    _contributorsController = [[MPContributorsController alloc] initWithPackageController:self
+                                                                                  database:self.primaryDatabase error:err];
+    if (!_contributorsController)
+        return NO;
+    
+    _contributorIdentitiesController = [[MPContributorIdentitiesController alloc] initWithPackageController:self
+                                                                                                   database:self.primaryDatabase error:err];
+    if (!_contributorIdentitiesController)
+        return NO;
+    
+    assert(_snapshotsDatabase);
+    _snapshotsController
+        = [[MPSnapshotsController alloc] initWithPackageController:self database:_snapshotsDatabase error:err];
+    if (!_snapshotsController)
+        return NO;
+    
+    _treeItemPool = [[TreeItemPool alloc] init];
+    
+    _pulls = [[NSMutableArray alloc] initWithCapacity:[[[self class] databaseNames] count]];
+    _completedPulls = [[NSMutableArray alloc] initWithCapacity:[[[self class] databaseNames] count]];
+    
+    if (self.requiresListener) {
+        MPStartupTraceSpan *listenerSpan = [_startupTracer beginSpanNamed:@"listener" category:@"phase"];
+        __weak typeof(self) weakSelf = self;
+        [self startListenerWithCompletionHandler:^(NSError *err)
+        {
+            __strong typeof(weakSelf) strongSelf = weakSelf;
+            [listenerSpan end];
+            [strongSelf.notificationCenter postNotificationName:MPDatabasePackageListenerDidStartNotification object:self];
+        }];
+    }
+    
+    // populate root section properties
+    MPStartupTraceSpan *rootSectionsSpan = [_startupTracer beginSpanNamed:@"rootSections" category:@"phase"];
+    _rootSections = [self newRootSections];
+    [rootSectionsSpan end];
+    
+    // the index and view warming (below) both write to the package.
+    if (self.indexesObjectFullTextContents && !_readOnly) {
+        MPStartupTraceSpan *fullTextIndexSpan = [_startupTracer beginSpanNamed:@"fullTextIndex" category:@"phase"];
+        [self openFullTextIndex];
+        [fullTextIndexSpan end];
+    }
+    
+    _registeredViewNames = [NSMutableSet setWithCapacity:128];
+    
+    [self.class registerDatabasePackageController:self];
+
+    [[self class] didOpenPackage];
+    
+    [self didOpenDatabases];
+    
+    // warmed on the next event loop cycle, once a subclass has created its controllers (in -didOpenDatabases, or after its call to super returns).
+    if (self.warmsViewsInBackground && !_readOnly) {
+        __weak typeof(self) weakSelf = self;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakSelf warmViewsInBackground];
+        });
+    }
+    
+    // state initialisation done on a subsequent event loop cycle such that potential assignments
+    // (such as to a singleton reference to this object) exists.
+    
+    if (![NSBundle inTestSuite]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            MPStartupTraceSpan *initialStateSpan = [self.startupTracer beginSpanNamed:@"initialState" category:@"phase"];
+            [self ensureInitialStateInitialized];
+            [initialStateSpan end];
+            
+            if ([self.delegate respondsToSelector:@selector(packageControllerRequiresPlaceholderContent:)]
+                && [self.delegate packageControllerRequiresPlaceholderContent:self]) {
+                [self ensurePlaceholderInitialized];
+            }
+        });
+    }
+    
+    return YES;
+}
+
+- (void)didOpenDatabases {
+    // override in subclass
 }
 
 - (void)setPath:(NSString * _Nonnull)path {
@@ -307,7 +679,7 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
     MPDatabase *db = [[MPDatabase alloc] initWithServer:server ?: _server
                                       packageController:self
                                                    name:dbName
-                                          ensureCreated:YES
+                                          ensureCreated:!_readOnly
                                          pushFilterName:pushFilterName
                                          pullFilterName:[self pullFilterNameForDatabaseNamed:dbName]
                                                   error:error];
@@ -449,6 +821,25 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
 
 - (BOOL)synchronizesPeerlessly { return YES; }
 
+- (BOOL)usesServerPerDatabase { return NO; }
+
+- (BOOL)requiresListener {
+    // a read-only package is not served: replication through the listener would write to it.
+    if (_readOnly)
+        return NO;
+    
+    if ([self.delegate respondsToSelector:@selector(packageControllerRequiresListener:)])
+        return [self.delegate packageControllerRequiresListener:self];
+    
+    return ![NSBundle isCommandLineTool] && // FIXME: manuel will need to serve static resources to equation compilers somehow
+           ![NSBundle isXPCService] &&
+           [self synchronizesPeerlessly];
+}
+
+- (BOOL)tracesOpening {
+    return [[NSUserDefaults standardUserDefaults] boolForKey:@"MPTracePackageOpening"];
+}
+
 - (BOOL)synchronizesUsingCloudKit { return NO; }
 
 - (BOOL)controllerExistsForManagedObjectClass:(Class)class
@@ -590,41 +981,147 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
     return moc;
 }
 
+/** The controller of a managed object with the document ID, resolved from the ID's class prefix without loading the document.
+  * Nil for documents which are not managed objects (e.g. MPMetadata, MPLocalMetadata, design documents). */
+- (MPManagedObjectsController *)controllerForDocumentID:(NSString *)documentID
+{
+    NSRange separatorRange = [documentID rangeOfString:@":"];
+    if (separatorRange.location == NSNotFound)
+        return nil;
+    
+    Class cls = NSClassFromString([documentID substringToIndex:separatorRange.location]);
+    if (![cls isSubclassOfClass:MPManagedObject.class] || ![self controllerExistsForManagedObjectClass:cls])
+        return nil;
+    
+    return [self controllerForManagedObjectClass:cls];
+}
+
 - (id)objectWithIdentifier:(NSString *)identifier {
     NSAssert(identifier, @"Expecting identifier (%@)", self.class);
     
     Class moClass = [MPManagedObject managedObjectClassFromDocumentID:identifier];
     MPManagedObjectsController *moc = [self controllerForManagedObjectClass:moClass];
     MPManagedObject *mo = [moc objectWithIdentifier:identifier];
-    
+
     return mo;
 }
 
-- (NSNotificationCenter *)notificationCenter
-{
-    return [NSNotificationCenter defaultCenter]; // subclass can provide its own notification center
-}
+- (NSArray *)objectsWithIdentifiers:(NSArray<NSString *> *)identifiers {
+    NSParameterAssert(identifiers);
+    if (identifiers.count == 0)
+        return @[];
 
-#pragma mark - Temporary copy creation
+    NSMutableDictionary<NSString *, MPManagedObject *> *objectsByID = [NSMutableDictionary dictionaryWithCapacity:identifiers.count];
 
-// TODO: replace BOOL flags with a option bits argument, include a sync-by-overwriting-differing-contained-items option (for updates of the bundled shared stuff)
-- (BOOL)makeTemporaryCopyIntoRootDirectoryWithURL:(NSURL *)rootURL
-                                overwriteIfExists:(BOOL)overwrite
-                                     failIfExists:(BOOL)failIfExists
-                                            error:(NSError *__autoreleasing *)error
-{
-    if (!rootURL) {
-        if (error) {
-            *error = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
-                                         code:MPDatabasePackageControllerErrorCodeRootURLMissing
-                                     userInfo:@{NSLocalizedDescriptionKey:@"Making a temporary copy of manuscript failed",
-                                                NSLocalizedFailureReasonErrorKey:@"Please contact support@manuscriptsapp.com if you continue to see this."}];
+    // cache misses are grouped by database, with the first controller of each database used to query it.
+    NSMapTable<MPDatabase *, MPManagedObjectsController *> *controllerByDatabase = [NSMapTable strongToStrongObjectsMapTable];
+    NSMapTable<MPDatabase *, NSMutableOrderedSet *> *missingIDsByDatabase = [NSMapTable strongToStrongObjectsMapTable];
+    NSMutableDictionary<NSString *, MPManagedObjectsController *> *controllerByID = [NSMutableDictionary dictionaryWithCapacity:identifiers.count];
+
+    for (NSString *identifier in identifiers) {
+        if (objectsByID[identifier] || controllerByID[identifier])
+            continue;
+
+        Class moClass = [MPManagedObject managedObjectClassFromDocumentID:identifier];
+        MPManagedObjectsController *moc = [self controllerForManagedObjectClass:moClass];
+        if (!moc) {
+            MPLog(@"WARNING! No managed objects controller for ID %@", identifier);
+            continue;
         }
-        return NO;
-    }
-    
-    NSFileManager *fm = [[NSFileManager alloc] init];
-    BOOL isDirectory, exists = [fm fileExistsAtPath:rootURL.path isDirectory:&isDirectory];
+
+        MPManagedObject *mo = [moc cachedObjectWithIdentifier:identifier];
+        if (mo) {
+            objectsByID[identifier] = mo;
+            continue;
+        }
+
+        controllerByID[identifier] = moc;
+
+        NSMutableOrderedSet *missingIDs = [missingIDsByDatabase objectForKey:moc.db];
+        if (!missingIDs) {
+            missingIDs = [NSMutableOrderedSet orderedSet];
+            [missingIDsByDatabase setObject:missingIDs forKey:moc.db];
+            [controllerByDatabase setObject:moc forKey:moc.db];
+        }
+        [missingIDs addObject:identifier];
+    }
+
+    for (MPDatabase *db in missingIDsByDatabase) {
+        MPManagedObjectsController *moc = [controllerByDatabase objectForKey:db];
+        NSArray *missingIDs = [[missingIDsByDatabase objectForKey:db] array];
+        [objectsByID addEntriesFromDictionary:[moc fetchedObjectsByIdentifierForIdentifiers:missingIDs]];
+    }
+
+    // objects not found in this package can still be relayed to the shared package by their own controllers.
+    NSMapTable<MPManagedObjectsController *, NSMutableArray *> *relayedIDsByController = [NSMapTable strongToStrongObjectsMapTable];
+    for (NSString *identifier in controllerByID) {
+        if (objectsByID[identifier])
+            continue;
+
+        MPManagedObjectsController *moc = controllerByID[identifier];
+        if (!moc.relaysFetchingByIdentifier)
+            continue;
+
+        NSMutableArray *relayedIDs = [relayedIDsByController objectForKey:moc];
+        if (!relayedIDs) {
+            relayedIDs = [NSMutableArray new];
+            [relayedIDsByController setObject:relayedIDs forKey:moc];
+        }
+        [relayedIDs addObject:identifier];
+    }
+
+    for (MPManagedObjectsController *moc in relayedIDsByController) {
+        [objectsByID addEntriesFromDictionary:[moc relayedObjectsByIdentifierForIdentifiers:[relayedIDsByController objectForKey:moc]]];
+    }
+
+    NSMutableArray *objs = [NSMutableArray arrayWithCapacity:identifiers.count];
+    for (NSString *identifier in identifiers) {
+        MPManagedObject *mo = objectsByID[identifier];
+        if (mo)
+            [objs addObject:mo];
+    }
+
+    return [objs copy];
+}
+
+- (NSNotificationCenter *)notificationCenter
+{
+    return [NSNotificationCenter defaultCenter]; // subclass can provide its own notification center
+}
+
+#pragma mark - Temporary copy creation
+
+- (BOOL)makeTemporaryCopyIntoRootDirectoryWithURL:(NSURL *)rootURL
+                                overwriteIfExists:(BOOL)overwrite
+                                     failIfExists:(BOOL)failIfExists
+                                            error:(NSError *__autoreleasing *)error
+{
+    return [self makeTemporaryCopyIntoRootDirectoryWithURL:rootURL
+                                         overwriteIfExists:overwrite
+                                              failIfExists:failIfExists
+                                           progressHandler:nil
+                                                     error:error];
+}
+
+// TODO: replace BOOL flags with a option bits argument
+- (BOOL)makeTemporaryCopyIntoRootDirectoryWithURL:(NSURL *)rootURL
+                                overwriteIfExists:(BOOL)overwrite
+                                     failIfExists:(BOOL)failIfExists
+                                  progressHandler:(void (^)(double fractionCompleted, BOOL *stop))progressHandler
+                                            error:(NSError *__autoreleasing *)error
+{
+    if (!rootURL) {
+        if (error) {
+            *error = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                         code:MPDatabasePackageControllerErrorCodeRootURLMissing
+                                     userInfo:@{NSLocalizedDescriptionKey:@"Making a temporary copy of manuscript failed",
+                                                NSLocalizedFailureReasonErrorKey:@"Please contact support@manuscriptsapp.com if you continue to see this."}];
+        }
+        return NO;
+    }
+    
+    NSFileManager *fm = [[NSFileManager alloc] init];
+    BOOL isDirectory, exists = [fm fileExistsAtPath:rootURL.path isDirectory:&isDirectory];
     
     if (exists) {
         if (!overwrite) {
@@ -647,11 +1144,12 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
         }
     }
     
-    if (exists && overwrite)
+    // an existing copy is updated in place rather than removed.
+    if (exists && overwrite && !isDirectory)
     {
         BOOL success = [fm removeItemAtURL:rootURL error:error];
-        MPLog(@"Failed to remove existing temporary directory at '%@'", rootURL.path);
         if (!success) {
+            MPLog(@"Failed to remove existing file at '%@'", rootURL.path);
             return NO;
         }
         exists = NO;
@@ -667,10 +1165,13 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
         }
     }
     
+    NSArray<MPDatabase *> *databases = self.orderedDatabases;
+    NSArray<MPDatabase *> *copiedDatabases = [databases filteredArrayUsingPredicate:
+                                              [NSPredicate predicateWithBlock:^BOOL(MPDatabase *db, NSDictionary *bindings) {
+        return [self includesItemWithNameInTemporaryCopy:db.name];
+    }]];
     
-    MPTemporaryDatabasePackageCopyFileManagerDelegate *fmDelegate = [[MPTemporaryDatabasePackageCopyFileManagerDelegate alloc] init];
-    fm.delegate = fmDelegate;
-    
+    NSMutableSet<NSString *> *excludedNames = [[self itemNamesForDatabases:databases] mutableCopy];
     NSArray *contents = [fm contentsOfDirectoryAtPath:self.path error:error];
     if (!contents)
     {
@@ -680,18 +1181,31 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
     
     for (NSString *filename in contents)
     {
-        NSURL *sourceURL = [[NSURL fileURLWithPath:self.path] URLByAppendingPathComponent:filename];
-        NSURL *targetURL = [rootURL URLByAppendingPathComponent:filename];
-        
-        BOOL success = [fm copyItemAtURL:sourceURL toURL:targetURL error:error];
-        if (!success)
-        {
-            MPLog(@"Failed to copy '%@' into '%@': %@", sourceURL.path, targetURL, error ? *error : nil);
-            return NO;
-        }
+        if (![self includesItemWithNameInTemporaryCopy:filename])
+            [excludedNames addObject:filename];
     }
     
-    return YES;
+    NSMutableArray<MPDatabaseBackupTask> *tasks = [[self tasksForCopyingDatabases:copiedDatabases intoDirectoryAtURL:rootURL] mutableCopy];
+    
+    NSArray<MPDatabaseBackupTask> *fileTasks = [self tasksForCopyingFilesIntoDirectoryAtURL:rootURL excludingItemsWithNames:excludedNames error:error];
+    if (!fileTasks)
+        return NO;
+    [tasks addObjectsFromArray:fileTasks];
+    
+    BOOL success = [MPDatabaseBackup performTasks:tasks
+                       maximumConcurrentTaskCount:MPDatabasePackageCopyMaximumConcurrentTaskCount
+                                  progressHandler:progressHandler
+                                            error:error];
+    if (!success)
+        MPLog(@"Failed to copy '%@' into '%@': %@", self.path, rootURL.path, error ? *error : nil);
+    
+    return success;
+}
+
+- (BOOL)includesItemWithNameInTemporaryCopy:(NSString *)filename
+{
+    // snapshots are not needed in temporary copies.
+    return ![filename hasPrefix:@"snapshot"];
 }
 
 #pragma mark - Databases
@@ -773,6 +1287,10 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
 - (BOOL)close:(NSError **)error
 {
     NSParameterAssert(_managedObjectsControllers);
+    
+    if (!_readOnly && ![_autosaveScheduler flush:error])
+        return NO;
+    
     // multiple MOCs can be connected to the same database.
     NSSet *databases = [_managedObjectsControllers valueForKey:@"db"];
     
@@ -800,8 +1318,10 @@ NSString * const MPDatabasePackageControllerErrorDomain = @"MPDatabasePackageCon
     NSParameterAssert(databases.count > 0);
     
     [self.databaseListener stop];
+    [self closeFullTextIndex];
     
     for (MPDatabase *db in databases) {
+        [db closeReaderPool];
         mp_dispatch_sync(db.server.dispatchQueue, [db.packageController serverQueueToken], ^{
             [db.server close];
         });
@@ -1114,6 +1634,344 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
     return NO;
 }
 
+#pragma mark - Full-text index
+
+static NSString *MPFullTextIndexKeysSignature(Class cls)
+{
+    return [[cls indexablePropertyKeys] componentsJoinedByString:@","] ?: @"";
+}
+
+- (NSArray<NSString *> *)documentIDsMatchingFullTextQuery:(NSString *)query
+                                                   offset:(NSUInteger)offset
+                                                    limit:(NSUInteger)limit
+                                                    error:(NSError **)error
+{
+    NSParameterAssert(query);
+    
+    if (!_fullTextIndex) {
+        if (error)
+            *error = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                         code:MPDatabasePackageControllerErrorCodeFullTextIndexUnavailable
+                                     userInfo:@{NSLocalizedDescriptionKey:@"Full-text search is not available",
+                                                NSLocalizedFailureReasonErrorKey:@"The full-text index is not open"}];
+        return nil;
+    }
+    
+    return [_fullTextIndex documentIDsMatchingQuery:query offset:offset limit:limit error:error];
+}
+
+- (void)rebuildFullTextIndex
+{
+    [self rebuildFullTextIndexForDatabases:self.orderedDatabases objectTypes:nil];
+}
+
+#pragma mark - View warming
+
+- (BOOL)warmsViewsInBackground
+{
+    return YES;
+}
+
+- (void)warmViewsInBackground
+{
+    NSMutableArray<MPManagedObjectsController *> *controllers = [NSMutableArray arrayWithCapacity:_managedObjectsControllers.count];
+    NSMutableArray<NSString *> *viewNames = [NSMutableArray arrayWithCapacity:_managedObjectsControllers.count];
+    for (MPManagedObjectsController *moc in _managedObjectsControllers) {
+        for (NSString *viewName in moc.prewarmedViewNames) {
+            [controllers addObject:moc];
+            [viewNames addObject:viewName];
+        }
+    }
+    
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        dispatch_group_t group = dispatch_group_create();
+        
+        [controllers enumerateObjectsUsingBlock:^(MPManagedObjectsController *moc, NSUInteger i, BOOL *stop) {
+            MPDatabasePackageController *strongSelf = weakSelf;
+            if (!strongSelf) {
+                *stop = YES;
+                return;
+            }
+            
+            // one view per hop to the server queue, which is free for other work in between.
+            // the index is updated by CouchbaseLite's background database, off the server queue.
+            mp_dispatch_sync(moc.db.database.manager.dispatchQueue, [strongSelf serverQueueToken], ^{
+                CBLView *view = [moc.db viewNamed:viewNames[i]];
+                if (!view.mapBlock || !view.stale)
+                    return;
+                
+                dispatch_group_enter(group);
+                [view updateIndexAsync:^{
+                    dispatch_group_leave(group);
+                }];
+            });
+        }];
+        
+        dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+            MPDatabasePackageController *strongSelf = weakSelf;
+            [strongSelf.notificationCenter postNotificationName:MPDatabasePackageControllerDidWarmViewsNotification object:strongSelf];
+        });
+    });
+}
+
+- (void)openFullTextIndex
+{
+    NSError *err = nil;
+    _fullTextIndex = [[MPFullTextIndex alloc] initWithPath:[self.path stringByAppendingPathComponent:MPFullTextIndexFilename] error:&err];
+    if (!_fullTextIndex) {
+        NSLog(@"ERROR! Failed to open full-text index for %@: %@", self.path, err);
+        return;
+    }
+    
+    // the managed objects controllers of a subclass are created after this class's initializer returns.
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [weakSelf rebuildStaleFullTextIndexEntries];
+    });
+}
+
+- (void)closeFullTextIndex
+{
+    MPFullTextIndex *index = _fullTextIndex;
+    if (!index)
+        return;
+    
+    // the indexed sequence numbers mark the index up to date, unless it was closed mid-rebuild.
+    // only changes actually applied count: those still waiting to be delivered on the main queue leave the database stale.
+    BOOL rebuilding = NO;
+    @synchronized (self) {
+        rebuilding = _fullTextIndexRebuildCount > 0;
+    }
+    
+    if (!rebuilding) {
+        for (MPDatabase *db in self.orderedDatabases) {
+            NSNumber *appliedSequenceNumber = [index appliedSequenceNumberOfDatabaseNamed:db.name];
+            if (!appliedSequenceNumber)
+                continue;
+            
+            [index setStateValue:[NSString stringWithFormat:@"%llu", appliedSequenceNumber.unsignedLongLongValue]
+                          forKey:[@"sequence:" stringByAppendingString:db.name]];
+        }
+    }
+    
+    [index close];
+    _fullTextIndex = nil;
+}
+
+- (void)rebuildStaleFullTextIndexEntries
+{
+    MPFullTextIndex *index = _fullTextIndex;
+    if (!index)
+        return;
+    
+    NSArray<MPDatabase *> *databases = self.orderedDatabases;
+    
+    // sequence numbers are recorded on closing and cleared while open, so that after a crash the databases are indexed again.
+    NSDictionary<NSString *, NSString *> *indexedSequenceNumbers = [index stateValuesWithKeyPrefix:@"sequence:"];
+    NSMutableArray<MPDatabase *> *staleDatabases = [NSMutableArray array];
+    NSMutableArray<MPDatabase *> *currentDatabases = [NSMutableArray array];
+    
+    for (MPDatabase *db in databases) {
+        __block UInt64 lastSequenceNumber = 0;
+        mp_dispatch_sync(db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+            lastSequenceNumber = db.database.lastSequenceNumber;
+        });
+        
+        NSString *indexedSequenceNumber = indexedSequenceNumbers[db.name];
+        if (!indexedSequenceNumber || (UInt64)indexedSequenceNumber.longLongValue != lastSequenceNumber)
+            [staleDatabases addObject:db];
+        else
+            [currentDatabases addObject:db];
+        
+        [index setStateValue:nil forKey:[@"sequence:" stringByAppendingString:db.name]];
+        
+        // a current database is indexed up to here, and a stale one is once its rebuild (which reads it from now on) completes.
+        [index applyEntries:@[] throughSequenceNumber:lastSequenceNumber ofDatabaseNamed:db.name];
+    }
+    
+    NSMutableSet<NSString *> *staleObjectTypes = [NSMutableSet set];
+    [[index stateValuesWithKeyPrefix:@"keys:"] enumerateKeysAndObjectsUsingBlock:^(NSString *objectType, NSString *keysSignature, BOOL *stop) {
+        Class cls = NSClassFromString(objectType);
+        if (cls && ![keysSignature isEqualToString:MPFullTextIndexKeysSignature(cls)])
+            [staleObjectTypes addObject:objectType];
+    }];
+    
+    if (staleDatabases.count > 0)
+        [self rebuildFullTextIndexForDatabases:staleDatabases objectTypes:nil];
+    
+    if (staleObjectTypes.count > 0 && currentDatabases.count > 0)
+        [self rebuildFullTextIndexForDatabases:currentDatabases objectTypes:staleObjectTypes];
+}
+
+- (void)rebuildFullTextIndexForDatabases:(NSArray<MPDatabase *> *)databases objectTypes:(NSSet<NSString *> *)objectTypes
+{
+    MPFullTextIndex *index = _fullTextIndex;
+    if (!index)
+        return;
+    
+    @synchronized (self) {
+        _fullTextIndexRebuildCount++;
+    }
+    
+    // the removals are enqueued before any document is read, so that updates from the change feed made meanwhile are kept.
+    for (MPDatabase *db in databases)
+        [index removeEntriesInDatabaseNamed:db.name objectTypes:objectTypes];
+    
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_BACKGROUND, 0), ^{
+        NSMutableDictionary<NSString *, NSString *> *keysSignatures = [NSMutableDictionary dictionary];
+        BOOL completed = YES;
+        
+        for (MPDatabase *db in databases) {
+            __strong typeof(weakSelf) strongSelf = weakSelf;
+            if (!strongSelf || ![strongSelf indexFullTextContentsOfDatabase:db objectTypes:objectTypes keysSignatures:keysSignatures]) {
+                completed = NO;
+                break;
+            }
+        }
+        
+        // recorded last, so that an interrupted rebuild of a type is started again the next time.
+        if (completed) {
+            for (NSString *objectType in objectTypes) {
+                Class cls = NSClassFromString(objectType);
+                if (cls && !keysSignatures[objectType])
+                    keysSignatures[objectType] = MPFullTextIndexKeysSignature(cls);
+            }
+            
+            [keysSignatures enumerateKeysAndObjectsUsingBlock:^(NSString *objectType, NSString *keysSignature, BOOL *stop) {
+                [index setStateValue:keysSignature forKey:[@"keys:" stringByAppendingString:objectType]];
+            }];
+        }
+        
+        __strong typeof(weakSelf) strongSelf = weakSelf;
+        if (strongSelf) {
+            @synchronized (strongSelf) {
+                strongSelf->_fullTextIndexRebuildCount--;
+            }
+        }
+    });
+}
+
+- (BOOL)indexFullTextContentsOfDatabase:(MPDatabase *)db
+                            objectTypes:(NSSet<NSString *> *)objectTypes
+                         keysSignatures:(NSMutableDictionary<NSString *, NSString *> *)keysSignatures
+{
+    MPFullTextIndex *index = _fullTextIndex;
+    const NSUInteger pageSize = MPDatabaseQueryRowChunkSize;
+    __block NSString *lastDocumentID = nil;
+    __block BOOL lastPage = NO;
+    __block BOOL success = YES;
+    
+    while (!lastPage && success && index == _fullTextIndex) {
+        __block NSMutableArray<MPFullTextIndexEntry *> *entries = nil;
+        
+        mp_dispatch_sync(db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+            CBLQuery *q = [db.database createAllDocumentsQuery];
+            q.prefetch = YES;
+            q.startKey = lastDocumentID;
+            q.limit = pageSize + (lastDocumentID ? 1 : 0);
+            
+            NSError *err = nil;
+            CBLQueryEnumerator *rows = [q run:&err];
+            if (!rows) {
+                NSLog(@"ERROR! Failed to read %@ for full-text indexing: %@", db.name, err);
+                success = NO;
+                return;
+            }
+            
+            entries = [NSMutableArray arrayWithCapacity:rows.count];
+            for (CBLQueryRow *row in rows) {
+                if (lastDocumentID && [row.documentID isEqualToString:lastDocumentID])
+                    continue;
+                lastDocumentID = row.documentID;
+                
+                NSString *objectType = row.documentProperties[@"objectType"];
+                Class cls = objectType ? NSClassFromString(objectType) : Nil;
+                if (![cls isSubclassOfClass:[MPManagedObject class]])
+                    continue;
+                
+                if (objectTypes && ![objectTypes containsObject:objectType])
+                    continue;
+                
+                NSString *keysSignature = MPFullTextIndexKeysSignature(cls);
+                keysSignatures[objectType] = keysSignature;
+                if (keysSignature.length == 0)
+                    continue;
+                
+                MPManagedObject *mo = [cls modelForDocument:row.document];
+                [entries addObject:[[MPFullTextIndexEntry alloc] initWithDocumentID:row.documentID
+                                                                         objectType:objectType
+                                                                       databaseName:db.name
+                                                                         revisionID:row.documentRevisionID
+                                                                               text:mo.tokenizedFullTextString
+                                                                            deleted:NO
+                                                                      keysSignature:keysSignature]];
+            }
+            
+            lastPage = rows.count < q.limit;
+        });
+        
+        if (entries)
+            [index applyEntries:entries];
+    }
+    
+    return success;
+}
+
+/** Called on the documents' database queue, where their text is read as -indexFullTextContentsOfDatabase:objectTypes:keysSignatures: reads it. The entries are applied on the index's own queue. */
+- (void)updateFullTextIndexForDocuments:(NSArray<CBLDocument *> *)documents
+                       deletedDocuments:(NSArray<CBLDocument *> *)deletedDocuments
+                     lastSequenceNumber:(UInt64)lastSequenceNumber
+{
+    MPFullTextIndex *index = _fullTextIndex;
+    if (!index)
+        return;
+    
+    NSMutableArray<MPFullTextIndexEntry *> *entries = [NSMutableArray arrayWithCapacity:documents.count + deletedDocuments.count];
+    
+    for (CBLDocument *doc in documents) {
+        NSString *objectType = doc.properties[@"objectType"];
+        Class cls = objectType ? NSClassFromString(objectType) : Nil;
+        if (![cls isSubclassOfClass:[MPManagedObject class]])
+            continue;
+        
+        NSString *keysSignature = MPFullTextIndexKeysSignature(cls);
+        NSString *text = keysSignature.length > 0 ? [[cls modelForDocument:doc] tokenizedFullTextString] : nil;
+        
+        [entries addObject:[[MPFullTextIndexEntry alloc] initWithDocumentID:doc.documentID
+                                                                 objectType:objectType
+                                                               databaseName:doc.database.name
+                                                                 revisionID:doc.currentRevisionID
+                                                                       text:text
+                                                                    deleted:NO
+                                                              keysSignature:keysSignature]];
+    }
+    
+    for (CBLDocument *doc in deletedDocuments) {
+        // a deleted document has no properties left, its type is read from its ID.
+        NSString *objectType = [doc.documentID componentsSeparatedByString:@":"].firstObject;
+        Class cls = NSClassFromString(objectType);
+        if (![cls isSubclassOfClass:[MPManagedObject class]])
+            continue;
+        
+        NSString *keysSignature = MPFullTextIndexKeysSignature(cls);
+        if (keysSignature.length == 0)
+            continue;
+        
+        [entries addObject:[[MPFullTextIndexEntry alloc] initWithDocumentID:doc.documentID
+                                                                 objectType:objectType
+                                                               databaseName:doc.database.name
+                                                                 revisionID:doc.currentRevisionID
+                                                                       text:nil
+                                                                    deleted:YES
+                                                              keysSignature:keysSignature]];
+    }
+    
+    NSString *databaseName = (documents.firstObject ?: deletedDocuments.firstObject).database.name;
+    [index applyEntries:entries throughSequenceNumber:lastSequenceNumber ofDatabaseNamed:databaseName];
+}
+
 - (NSURL *)databaseListenerURL
 {
     NSURL *URL = [NSURL URLWithString:
@@ -1262,21 +2120,18 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
     __block MPSnapshot *snp = nil;
     MPSnapshotsController *sc = self.snapshotsController;
     [sc newSnapshotWithName:name snapshotHandler:^(MPSnapshot *snapshot, NSError *e) {
-        if (e)
+        if (e) {
+            if (err)
+                *err = e;
             return;
-        
-        for (MPManagedObjectsController *moc in self->_managedObjectsControllers) {
-            if (moc == sc) continue;
-            for (MPManagedObject *mo in [moc allObjects])
-            {
-                MPSnapshottedObject *so = [[MPSnapshottedObject alloc]
-                                           initWithController:sc snapshot:snapshot
-                                           snapshottedObject:mo];
-                if (![so save:err])
-                    return;
-            }
         }
         
+        NSMutableArray<MPDatabase *> *databases = [self.orderedDatabases mutableCopy];
+        [databases removeObject:sc.db];
+        
+        if (![sc recordObjectsOfDatabases:databases intoSnapshot:snapshot error:err])
+            return;
+        
         snp = snapshot;
     }];
     
@@ -1284,9 +2139,31 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
 }
 
 - (BOOL)restoreFromSnapshotWithName:(NSString *)name error:(NSError *__autoreleasing *)err
+{
+    return [self restoreFromSnapshotWithName:name progressHandler:nil error:err];
+}
+
+- (BOOL)restoreFromSnapshotWithName:(NSString *)name
+                    progressHandler:(void (^)(double))progressHandler
+                              error:(NSError *__autoreleasing *)err
+{
+    return [self restoreFromSnapshotWithName:name progressQueue:nil progressHandler:progressHandler error:err];
+}
+
+- (BOOL)restoreFromSnapshotWithName:(NSString *)name
+                      progressQueue:(dispatch_queue_t)progressQueue
+                    progressHandler:(void (^)(double))progressHandler
+                              error:(NSError *__autoreleasing *)err
 {
     MPSnapshotsController *sc = [self snapshotsController];
-    MPSnapshot *snapshot = [MPSnapshot modelForDocument:[sc.db.database documentWithID:name]];
+    
+    __block CBLDocument *snapshotDoc = nil;
+    mp_dispatch_sync(sc.db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+        snapshotDoc = [sc.db.database existingDocumentWithID:[MPSnapshot idForSnapshotWithName:name inDatabase:sc.db.database]]
+                   ?: [sc.db.database existingDocumentWithID:name];
+    });
+    
+    MPSnapshot *snapshot = snapshotDoc ? [MPSnapshot modelForDocument:snapshotDoc] : nil;
     
     if (!snapshot)
     {
@@ -1297,36 +2174,10 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
         return NO;
     }
     
-    NSArray *snapshottedObjects = [sc snapshottedObjectsForSnapshot:snapshot];
+    NSMutableArray<MPDatabase *> *databases = [self.orderedDatabases mutableCopy];
+    [databases removeObject:sc.db];
     
-    NSMutableArray *saveableObjects = [NSMutableArray arrayWithCapacity:snapshottedObjects.count];
-    for (MPSnapshottedObject *so in snapshottedObjects)
-    {
-        Class cls = [so snapshottedObjectClass];
-        assert([cls isSubclassOfClass:[MPManagedObject class]]);
-        assert(![cls isSubclassOfClass:[MPSnapshottedObject class]]);
-        
-        NSDictionary *props = [so snapshottedProperties];
-        
-        MPManagedObjectsController *moc = [self controllerForManagedObjectClass:cls];
-        assert(moc);
-        
-        MPManagedObject *mo = [cls modelForDocument:[moc.db.database documentWithID:so.snapshottedObject.documentID]];
-        assert(mo); // error? ignore silently?
-        
-        if ([[mo.document currentRevisionID] isEqualToString:so.snapshottedRevisionID] && ![mo needsSave])
-        {
-            assert([mo.document.properties isEqual:props]); // if revisions and there are no changes, contents should be equal
-            continue;
-        }
-        
-        [mo setValuesForPropertiesWithDictionary:props];
-    }
-    
-    if (saveableObjects.count > 0)
-        return [CBLModel saveModels:saveableObjects error:err];
-    
-    return YES;
+    return [sc restoreSnapshot:snapshot toDatabases:databases progressQueue:progressQueue progressHandler:progressHandler error:err];
 }
 
 #pragma mark - View function compilation
@@ -1371,6 +2222,9 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
 }
 
 - (BOOL)saveToURL:(NSURL *)URL error:(NSError *__autoreleasing *)error {
+    if (!_readOnly && ![_autosaveScheduler flush:error])
+        return NO;
+    
     NSArray <MPDatabase *> *databases = self.orderedDatabases;
     
     if (databases.count == 0) {
@@ -1391,6 +2245,8 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
     if (![self saveDictionaryRepresentation:error])
         return NO;
     
+    if (self.savesDatabasesOnline)
+        return [self saveDatabases:databases onlineToURL:URL error:error];
     
     if (![self checkpointDatabases:databases error:error])
         return NO;
@@ -1406,6 +2262,185 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
     return success;
 }
 
+- (BOOL)saveDatabases:(NSArray<MPDatabase *> *)databases onlineToURL:(NSURL *)URL error:(NSError **)error {
+    if ([URL.path.stringByStandardizingPath isEqualToString:self.path.stringByStandardizingPath])
+        return [self checkpointDatabases:databases error:error];
+    
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:URL withIntermediateDirectories:YES attributes:nil error:error])
+        return NO;
+    
+    NSMutableArray<MPDatabaseBackupTask> *tasks = [[self tasksForCopyingDatabases:databases intoDirectoryAtURL:URL] mutableCopy];
+    
+    NSArray<MPDatabaseBackupTask> *fileTasks = [self tasksForCopyingFilesIntoDirectoryAtURL:URL
+                                                                  excludingItemsWithNames:[self itemNamesForDatabases:databases]
+                                                                                    error:error];
+    if (!fileTasks)
+        return NO;
+    [tasks addObjectsFromArray:fileTasks];
+    
+    return [MPDatabaseBackup performTasks:tasks
+               maximumConcurrentTaskCount:MPDatabasePackageCopyMaximumConcurrentTaskCount
+                          progressHandler:nil
+                                    error:error];
+}
+
+#pragma mark - Copying
+
+- (NSSet<NSString *> *)itemNamesForDatabases:(NSArray<MPDatabase *> *)databases {
+    NSMutableSet<NSString *> *names = [NSMutableSet setWithCapacity:databases.count * 5];
+    
+    for (MPDatabase *db in databases) {
+        NSString *databaseFilename = [db.name stringByAppendingPathExtension:@"cblite"];
+        [names addObject:databaseFilename];
+        [names addObject:[databaseFilename stringByAppendingPathExtension:@"partial"]];
+        for (NSString *suffix in @[@"-wal", @"-shm", @"-journal"])
+            [names addObject:[databaseFilename stringByAppendingString:suffix]];
+        [names addObject:[NSString stringWithFormat:@"%@ attachments", db.name]];
+    }
+    
+    return names;
+}
+
+- (NSArray<MPDatabaseBackupTask> *)tasksForCopyingDatabases:(NSArray<MPDatabase *> *)databases intoDirectoryAtURL:(NSURL *)URL {
+    NSMutableArray<MPDatabaseBackupTask> *tasks = [NSMutableArray arrayWithCapacity:databases.count];
+    
+    for (MPDatabase *db in databases) {
+        NSString *databaseFilename = [db.name stringByAppendingPathExtension:@"cblite"];
+        NSString *attachmentsFilename = [NSString stringWithFormat:@"%@ attachments", db.name];
+        NSString *sourcePath = [self pathForDatabase:db];
+        NSString *targetPath = [URL.path stringByAppendingPathComponent:databaseFilename];
+        NSURL *attachmentsURL = [self.URL URLByAppendingPathComponent:attachmentsFilename];
+        NSURL *targetAttachmentsURL = [URL URLByAppendingPathComponent:attachmentsFilename];
+        
+        // read here rather than in the task, which runs on a worker thread while the caller may hold the server queue.
+        // read before the backup starts: changes made during it are then copied again the next time.
+        __block UInt64 lastSequenceNumber = 0;
+        mp_dispatch_sync(db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+            lastSequenceNumber = db.database.lastSequenceNumber;
+        });
+        
+        __weak typeof(self) weakSelf = self;
+        [tasks addObject:^BOOL(NSError **err) {
+            __strong typeof(weakSelf) strongSelf = weakSelf;
+            NSMutableDictionary<NSString *, NSDictionary *> *copiedStates = strongSelf ? strongSelf->_copiedDatabaseStatesByPath : nil;
+            NSFileManager *fm = [NSFileManager new];
+            NSString *copiedStateKey = targetPath.stringByStandardizingPath;
+            
+            NSDictionary *copiedState = nil;
+            @synchronized (copiedStates) {
+                copiedState = copiedStates[copiedStateKey];
+            }
+            
+            // the copy is reused only if neither the database nor the copy has changed since it was made.
+            NSDictionary *targetAttributes = [MPDatabasePackageController copiedDatabaseAttributesAtPath:targetPath];
+            BOOL copyIsCurrent = copiedState
+                && [copiedState[MPCopiedSequenceNumberKey] unsignedLongLongValue] == lastSequenceNumber
+                && targetAttributes
+                && [[copiedState dictionaryWithValuesForKeys:targetAttributes.allKeys] isEqualToDictionary:targetAttributes];
+            
+            if (!copyIsCurrent) {
+                @synchronized (copiedStates) {
+                    [copiedStates removeObjectForKey:copiedStateKey];
+                }
+                
+                if (![MPDatabaseBackup backupDatabaseAtPath:sourcePath
+                                                     toPath:targetPath
+                                               pagesPerStep:MPDatabaseBackupDefaultPagesPerStep
+                                                      error:err])
+                    return NO;
+                
+                NSMutableDictionary *state = [[MPDatabasePackageController copiedDatabaseAttributesAtPath:targetPath] mutableCopy];
+                state[MPCopiedSequenceNumberKey] = @(lastSequenceNumber);
+                @synchronized (copiedStates) {
+                    copiedStates[copiedStateKey] = state;
+                }
+            }
+            
+            if (![fm fileExistsAtPath:attachmentsURL.path])
+                return YES;
+            
+            return [MPDatabaseBackup synchronizeAttachmentsAtURL:attachmentsURL toURL:targetAttachmentsURL error:err];
+        }];
+    }
+    
+    return tasks;
+}
+
+/** The attributes of a database copy which change if the copy is modified or replaced, or nil if there is no copy at the path. */
++ (NSDictionary *)copiedDatabaseAttributesAtPath:(NSString *)path {
+    NSDictionary *attributes = [[NSFileManager new] attributesOfItemAtPath:path error:nil];
+    if (!attributes)
+        return nil;
+    
+    return [attributes dictionaryWithValuesForKeys:@[ NSFileSize, NSFileModificationDate, NSFileSystemFileNumber ]];
+}
+
+- (NSArray<MPDatabaseBackupTask> *)tasksForCopyingFilesIntoDirectoryAtURL:(NSURL *)URL
+                                                  excludingItemsWithNames:(NSSet<NSString *> *)excludedNames
+                                                                    error:(NSError **)error {
+    NSFileManager *fm = [NSFileManager new];
+    NSMutableArray<MPDatabaseBackupTask> *tasks = [NSMutableArray array];
+    NSMutableSet<NSString *> *relativePaths = [NSMutableSet set];
+    NSURL *packageURL = self.URL;
+    
+    // the full-text index is rebuilt when missing, and would need a backup of its own to be copied consistently.
+    excludedNames = [excludedNames setByAddingObjectsFromArray:@[ MPFullTextIndexFilename,
+                                                                  [MPFullTextIndexFilename stringByAppendingString:@"-wal"],
+                                                                  [MPFullTextIndexFilename stringByAppendingString:@"-shm"] ]];
+    
+    NSDirectoryEnumerator *sourceEnumerator = [fm enumeratorAtPath:self.path];
+    for (NSString *relativePath in sourceEnumerator) {
+        if (sourceEnumerator.level == 1 && [excludedNames containsObject:relativePath]) {
+            [sourceEnumerator skipDescendants];
+            continue;
+        }
+        
+        [relativePaths addObject:relativePath];
+        
+        NSURL *sourceURL = [packageURL URLByAppendingPathComponent:relativePath];
+        NSURL *targetURL = [URL URLByAppendingPathComponent:relativePath];
+        
+        if (![sourceEnumerator.fileAttributes.fileType isEqualToString:NSFileTypeDirectory]) {
+            [tasks addObject:^BOOL(NSError **err) {
+                return [MPDatabaseBackup synchronizeFileAtURL:sourceURL toURL:targetURL error:err];
+            }];
+            continue;
+        }
+        
+        // directories are created up front so that the files in them can be copied in any order.
+        BOOL isDirectory = NO;
+        if ([fm fileExistsAtPath:targetURL.path isDirectory:&isDirectory] && !isDirectory
+            && ![fm removeItemAtURL:targetURL error:error])
+            return nil;
+        
+        if (![fm createDirectoryAtURL:targetURL withIntermediateDirectories:YES attributes:nil error:error])
+            return nil;
+    }
+    
+    // remove what is no longer in the package from an existing copy.
+    NSMutableArray<NSURL *> *staleURLs = [NSMutableArray array];
+    NSDirectoryEnumerator *targetEnumerator = [fm enumeratorAtPath:URL.path];
+    for (NSString *relativePath in targetEnumerator) {
+        if (targetEnumerator.level == 1 && [excludedNames containsObject:relativePath]) {
+            [targetEnumerator skipDescendants];
+            continue;
+        }
+        
+        if ([relativePaths containsObject:relativePath])
+            continue;
+        
+        [staleURLs addObject:[URL URLByAppendingPathComponent:relativePath]];
+        [targetEnumerator skipDescendants];
+    }
+    
+    for (NSURL *staleURL in staleURLs) {
+        if (![fm removeItemAtURL:staleURL error:error])
+            return nil;
+    }
+    
+    return tasks;
+}
+
 - (NSURL *)URL {
     return [NSURL fileURLWithPath:self.path];
 }
@@ -1443,11 +2478,142 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
 }
 
 - (BOOL)saveDictionaryRepresentation:(NSError **)error {
-    NSData *data = [NSJSONSerialization dataWithJSONObject:self.dictionaryRepresentation options:NSJSONWritingPrettyPrinted error:error];
-    if (!data)
+    NSFileManager *fm = [NSFileManager defaultManager];
+    NSString *path = self.dictionaryRepresentationURL.path;
+    NSString *partialPath = [path stringByAppendingPathExtension:@"partial"];
+    NSArray<MPDatabase *> *databases = self.orderedDatabases;
+    
+    // read before exporting: changes made meanwhile are exported again the next time.
+    NSMutableDictionary<NSString *, NSNumber *> *lastSequenceNumbers = [NSMutableDictionary dictionaryWithCapacity:databases.count];
+    for (MPDatabase *db in databases) {
+        mp_dispatch_sync(db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+            lastSequenceNumbers[db.name] = @(db.database.lastSequenceNumber);
+        });
+    }
+    
+    NSDictionary<NSString *, MPDictionaryRepresentationSegment *> *previousSegments = nil;
+    NSData *previousData = nil;
+    
+    @synchronized (self) {
+        NSDictionary *attributes = [fm attributesOfItemAtPath:path error:nil];
+        if (self.updatesDictionaryRepresentationIncrementally
+            && _dictionaryRepresentationSegments
+            && attributes.fileSize == [_dictionaryRepresentationFileAttributes fileSize]
+            && [attributes.fileModificationDate isEqualToDate:[_dictionaryRepresentationFileAttributes fileModificationDate]]) {
+            previousSegments = _dictionaryRepresentationSegments;
+            previousData = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+        }
+    }
+    
+    MPJSONStreamWriter *writer = [[MPJSONStreamWriter alloc] initWithPath:partialPath error:error];
+    if (!writer)
+        return NO;
+    
+    NSMutableDictionary<NSString *, MPDictionaryRepresentationSegment *> *segments = [NSMutableDictionary dictionaryWithCapacity:databases.count];
+    BOOL success = [writer writeString:@"{" error:error];
+    
+    for (MPDatabase *db in databases) {
+        if (success && segments.count > 0)
+            success = [writer writeString:@"," error:error];
+        
+        if (!success)
+            break;
+        
+        UInt64 lastSequenceNumber = [lastSequenceNumbers[db.name] unsignedLongLongValue];
+        MPDictionaryRepresentationSegment *previousSegment = previousSegments[db.name];
+        unsigned long long location = writer.offset;
+        
+        if (previousData
+            && previousSegment.lastSequenceNumber == lastSequenceNumber
+            && NSMaxRange(previousSegment.range) <= previousData.length)
+            success = [writer writeData:[previousData subdataWithRange:previousSegment.range] error:error];
+        else
+            success = [self writeDictionaryRepresentationOfDatabase:db toWriter:writer error:error];
+        
+        segments[db.name] = [[MPDictionaryRepresentationSegment alloc] initWithLastSequenceNumber:lastSequenceNumber
+                                                                                            range:NSMakeRange(location, writer.offset - location)];
+    }
+    
+    success = success && [writer writeString:@"}" error:error];
+    success = [writer close:success ? error : NULL] && success;
+    previousData = nil;
+    
+    if (success && rename(partialPath.fileSystemRepresentation, path.fileSystemRepresentation) != 0) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey:path}];
+        success = NO;
+    }
+    
+    if (!success) {
+        [fm removeItemAtPath:partialPath error:nil];
         return NO;
+    }
     
-    return [data writeToURL:self.dictionaryRepresentationURL options:NSDataWritingAtomic error:error];
+    @synchronized (self) {
+        _dictionaryRepresentationSegments = [segments copy];
+        _dictionaryRepresentationFileAttributes = [fm attributesOfItemAtPath:path error:nil];
+    }
+    
+    return YES;
+}
+
+- (BOOL)writeDictionaryRepresentationOfDatabase:(MPDatabase *)db toWriter:(MPJSONStreamWriter *)writer error:(NSError **)error {
+    if (![writer writeJSONStringLiteral:db.name error:error] || ![writer writeString:@":[" error:error])
+        return NO;
+    
+    // documents are read a page at a time, keyed on the last document ID read, so that the server queue is not held for the whole export.
+    const NSUInteger pageSize = MPDatabaseQueryRowChunkSize;
+    __block NSString *lastDocumentID = nil;
+    __block BOOL lastPage = NO;
+    __block NSError *queryErr = nil;
+    BOOL first = YES;
+    
+    while (!lastPage) {
+        __block NSMutableArray<NSDictionary *> *page = nil;
+        
+        mp_dispatch_sync(db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+            CBLQuery *q = [db.database createAllDocumentsQuery];
+            q.prefetch = YES;
+            q.startKey = lastDocumentID;
+            q.limit = pageSize + (lastDocumentID ? 1 : 0);
+            
+            CBLQueryEnumerator *rows = [q run:&queryErr];
+            if (!rows)
+                return;
+            
+            page = [NSMutableArray arrayWithCapacity:rows.count];
+            for (CBLQueryRow *row in rows) {
+                if (lastDocumentID && [row.documentID isEqualToString:lastDocumentID])
+                    continue;
+                
+                NSDictionary *props = row.documentProperties;
+                if (props)
+                    [page addObject:props];
+                lastDocumentID = row.documentID;
+            }
+            
+            lastPage = rows.count < q.limit;
+        });
+        
+        if (!page) {
+            if (error)
+                *error = queryErr;
+            return NO;
+        }
+        
+        @autoreleasepool {
+            for (NSDictionary *props in page) {
+                if (!first && ![writer writeString:@"," error:error])
+                    return NO;
+                
+                if (![writer writeJSONObject:props error:error])
+                    return NO;
+                first = NO;
+            }
+        }
+    }
+    
+    return [writer writeString:@"]" error:error];
 }
 
 - (NSDictionary *)dictionaryRepresentation {
@@ -1565,9 +2731,321 @@ static const NSUInteger MPDatabasePackageListenerMaxRetryCount = 30;
     [moc didChangeDocument:document forObject:(id)document.modelObject source:source];
 }
 
+- (void)didChangeDocuments:(NSArray<CBLDocument *> *)documents
+          deletedDocuments:(NSArray<CBLDocument *> *)deletedDocuments
+        lastSequenceNumber:(UInt64)lastSequenceNumber
+                    source:(MPManagedObjectChangeSource)source
+{
+    if (documents.count == 0 && deletedDocuments.count == 0)
+        return;
+    
+    // the compatibility notifications are posted synchronously after the write, as they were before changes were batched.
+    if (self.postsPerObjectChangeNotifications) {
+        for (CBLDocument *doc in documents)
+            [self didChangeDocument:doc source:source];
+        
+        for (CBLDocument *doc in deletedDocuments) {
+            MPManagedObjectsController *moc = [self controllerForDocumentID:doc.documentID];
+            MPManagedObject *mo = (MPManagedObject *)doc.modelObject ?: [moc cachedObjectWithIdentifier:doc.documentID];
+            if (moc && mo)
+                [moc didDeleteObject:mo];
+        }
+    }
+    
+    // the documents are read here on the database's queue, and only their IDs, change types and loaded objects are handed to the main thread.
+    NSMutableArray<MPDocumentChange *> *changes = [NSMutableArray arrayWithCapacity:documents.count + deletedDocuments.count];
+    
+    for (CBLDocument *doc in documents) {
+        // ignores MPMetadata & MPLocalMetadata.
+        MPManagedObjectsController *moc = [self controllerForDocumentID:doc.documentID];
+        if (!moc)
+            continue;
+        
+        [changes addObject:[[MPDocumentChange alloc] initWithController:moc
+                                                             documentID:doc.documentID
+                                                             changeType:[moc changeTypeForDocument:doc]
+                                                                 object:(MPManagedObject *)doc.modelObject]];
+    }
+    
+    for (CBLDocument *doc in deletedDocuments) {
+        MPManagedObjectsController *moc = [self controllerForDocumentID:doc.documentID];
+        if (!moc)
+            continue;
+        
+        [changes addObject:[[MPDocumentChange alloc] initWithController:moc
+                                                             documentID:doc.documentID
+                                                             changeType:MPChangeTypeRemove
+                                                                 object:(MPManagedObject *)doc.modelObject]];
+    }
+    
+    [self updateFullTextIndexForDocuments:documents deletedDocuments:deletedDocuments lastSequenceNumber:lastSequenceNumber];
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self addDocumentChanges:changes source:source];
+        [self scheduleBatchChangeDelivery];
+    });
+}
+
+- (void)addDocumentChanges:(NSArray<MPDocumentChange *> *)changes source:(MPManagedObjectChangeSource)source
+{
+    NSParameterAssert([NSThread isMainThread]);
+    
+    for (MPDocumentChange *change in changes) {
+        // objects are only materialized if already loaded, so that a large replicated batch is not loaded just to be reported.
+        MPManagedObject *mo = change.object ?: [change.controller cachedObjectWithIdentifier:change.documentID];
+        MPManagedObjectsBatchChange *batchChange = [self pendingBatchChangeForController:change.controller];
+        
+        // only objects which have been loaded are reported as removed (nothing else can hold a reference to them).
+        if (mo)
+            [batchChange addObject:mo changeType:change.changeType source:source];
+        else if (change.changeType != MPChangeTypeRemove)
+            [batchChange addUnloadedObjectWithIdentifier:change.documentID source:source];
+    }
+}
+
+- (MPManagedObjectsBatchChange *)pendingBatchChangeForController:(MPManagedObjectsController *)moc
+{
+    NSParameterAssert(moc);
+    NSParameterAssert([NSThread isMainThread]);
+    
+    MPManagedObjectsBatchChange *batchChange = [_pendingBatchChanges objectForKey:moc];
+    if (!batchChange) {
+        batchChange = [[MPManagedObjectsBatchChange alloc] initWithController:moc];
+        [_pendingBatchChanges setObject:batchChange forKey:moc];
+    }
+    
+    return batchChange;
+}
+
+- (void)scheduleBatchChangeDelivery
+{
+    NSParameterAssert([NSThread isMainThread]);
+    
+    if (_batchChangeDeliveryScheduled || _pendingBatchChanges.count == 0)
+        return;
+    
+    _batchChangeDeliveryScheduled = YES;
+    
+    __weak typeof(self) weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(self.changeCoalescingInterval, 0) * NSEC_PER_SEC)),
+                   dispatch_get_main_queue(), ^{
+        [weakSelf deliverPendingBatchChanges];
+    });
+}
+
+- (void)deliverPendingBatchChanges
+{
+    NSParameterAssert([NSThread isMainThread]);
+    
+    _batchChangeDeliveryScheduled = NO;
+    
+    NSMapTable *batchChanges = _pendingBatchChanges;
+    _pendingBatchChanges = [NSMapTable strongToStrongObjectsMapTable];
+    
+    NSNotificationCenter *nc = [self notificationCenter];
+    for (MPManagedObjectsController *moc in batchChanges) {
+        MPManagedObjectsBatchChange *batchChange = [batchChanges objectForKey:moc];
+        if (batchChange.isEmpty)
+            continue;
+        
+        [moc didChangeObjects:batchChange];
+        [nc postNotificationName:MPManagedObjectsControllerDidChangeObjectsNotification
+                          object:moc
+                        userInfo:@{ MPManagedObjectsBatchChangeKey : batchChange }];
+    }
+}
+
+#pragma mark - Batch updates
+
+- (BOOL)performBatchUpdates:(void (^)(void))updates error:(NSError *__autoreleasing *)error
+{
+    NSParameterAssert(updates);
+    
+    if (![self ensureWritable:error])
+        return NO;
+    
+    // the changed objects are collected per thread, so that a batch on one thread is not mistaken for a nested batch of another.
+    NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+    NSMutableOrderedSet<MPManagedObject *> *changedObjects = threadDictionary[_batchUpdatesThreadKey];
+    
+    // a nested batch is saved by the outermost one.
+    if (changedObjects) {
+        updates();
+        return YES;
+    }
+    
+    changedObjects = [NSMutableOrderedSet new];
+    threadDictionary[_batchUpdatesThreadKey] = changedObjects;
+    @try {
+        updates();
+    }
+    @finally {
+        [threadDictionary removeObjectForKey:_batchUpdatesThreadKey];
+    }
+    
+    // objects changed in the block but saved or deleted within it are not saved again.
+    NSMutableArray<MPManagedObject *> *objects = [NSMutableArray arrayWithCapacity:changedObjects.count];
+    for (MPManagedObject *mo in changedObjects) {
+        if (mo.needsSave && !mo.isDeleted && mo.controller)
+            [objects addObject:mo];
+    }
+    
+    return [self saveObjects:objects error:error];
+}
+
+- (void)objectDidChange:(MPManagedObject *)object
+{
+    NSMutableOrderedSet<MPManagedObject *> *changedObjects = [NSThread currentThread].threadDictionary[_batchUpdatesThreadKey];
+    [changedObjects addObject:object];
+}
+
+- (BOOL)saveObjects:(NSArray<MPManagedObject *> *)objects error:(NSError *__autoreleasing *)error
+{
+    if (![self ensureWritable:error])
+        return NO;
+    
+    NSMutableArray<MPDatabase *> *databases = [NSMutableArray new];
+    NSMapTable<MPDatabase *, NSMutableArray<MPManagedObject *> *> *objectsByDatabase = [NSMapTable strongToStrongObjectsMapTable];
+    for (MPManagedObject *mo in objects) {
+        MPDatabase *db = mo.controller.db;
+        if (!db || !mo.document)
+            continue;
+        
+        NSMutableArray *databaseObjects = [objectsByDatabase objectForKey:db];
+        if (!databaseObjects) {
+            databaseObjects = [NSMutableArray new];
+            [objectsByDatabase setObject:databaseObjects forKey:db];
+            [databases addObject:db];
+        }
+        [databaseObjects addObject:mo];
+    }
+    
+    NSMapTable<MPManagedObjectsController *, MPManagedObjectsBatchChange *> *batchChanges = [NSMapTable strongToStrongObjectsMapTable];
+    
+    BOOL success = YES;
+    NSError *err = nil;
+    for (MPDatabase *db in databases) {
+        if (!(success = [self saveObjects:[objectsByDatabase objectForKey:db] inDatabase:db batchChanges:batchChanges error:&err]))
+            break;
+    }
+    
+    [self postBatchChanges:batchChanges];
+    
+    if (!success && error)
+        *error = err;
+    
+    return success;
+}
+
+- (void)postBatchChanges:(NSMapTable<MPManagedObjectsController *, MPManagedObjectsBatchChange *> *)batchChanges
+{
+    NSMutableArray<MPManagedObjectsBatchChange *> *changes = [NSMutableArray arrayWithCapacity:batchChanges.count];
+    for (MPManagedObjectsController *moc in batchChanges) {
+        MPManagedObjectsBatchChange *batchChange = [batchChanges objectForKey:moc];
+        if (!batchChange.isEmpty)
+            [changes addObject:batchChange];
+    }
+    
+    if (changes.count == 0)
+        return;
+    
+    [self.notificationCenter postNotificationName:MPDatabasePackageControllerDidPerformBatchUpdatesNotification
+                                           object:self
+                                         userInfo:@{ MPDatabasePackageControllerBatchChangesKey : changes }];
+    
+    if ([self.delegate respondsToSelector:@selector(updateChangeCount:)])
+        [self.delegate updateChangeCount:NSChangeDone];
+}
+
+- (BOOL)saveObjects:(NSArray<MPManagedObject *> *)objects
+         inDatabase:(MPDatabase *)db
+       batchChanges:(NSMapTable<MPManagedObjectsController *, MPManagedObjectsBatchChange *> *)batchChanges
+              error:(NSError *__autoreleasing *)error
+{
+    if (objects.count == 0)
+        return YES;
+    
+    NSMapTable<MPManagedObjectsController *, NSMutableArray<MPManagedObject *> *> *objectsByController = [NSMapTable strongToStrongObjectsMapTable];
+    for (MPManagedObject *mo in objects) {
+        NSMutableArray *controllerObjects = [objectsByController objectForKey:mo.controller];
+        if (!controllerObjects) {
+            controllerObjects = [NSMutableArray new];
+            [objectsByController setObject:controllerObjects forKey:mo.controller];
+        }
+        
+        [controllerObjects addObject:mo];
+    }
+    
+    for (MPManagedObjectsController *moc in objectsByController)
+        [moc willSaveObjects:[objectsByController objectForKey:moc]];
+    
+    for (MPManagedObject *mo in objects)
+        [mo prepareForSave];
+    
+    // objects saved before a failing one are marked saved although the transaction is rolled back, and are restored to be saved again.
+    NSMutableArray<NSDictionary *> *unsavedChanges = [NSMutableArray arrayWithCapacity:objects.count];
+    for (MPManagedObject *mo in objects)
+        [unsavedChanges addObject:mo.unsavedChanges];
+    
+    __block BOOL success = NO;
+    __block NSError *err = nil;
+    mp_dispatch_sync(db.database.manager.dispatchQueue, [self serverQueueToken], ^{
+        success = [db.database inTransaction:^BOOL{
+            for (MPManagedObject *mo in objects) {
+                NSError *saveErr = nil;
+                if (![mo saveDocument:&saveErr]) {
+                    err = saveErr;
+                    return NO;
+                }
+            }
+            return YES;
+        }];
+    });
+    
+    if (!success) {
+        [objects enumerateObjectsUsingBlock:^(MPManagedObject *mo, NSUInteger i, BOOL *stop) {
+            [mo restoreUnsavedChanges:unsavedChanges[i]];
+        }];
+        
+        if (error)
+            *error = err ?: [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                                code:MPDatabasePackageControllerErrorCodeBatchUpdateFailed
+                                            userInfo:@{ NSLocalizedDescriptionKey :
+                                                            [NSString stringWithFormat:@"Failed to save %lu objects to database '%@'", objects.count, db.name] }];
+        return NO;
+    }
+    
+    for (MPManagedObjectsController *moc in objectsByController) {
+        MPManagedObjectsBatchChange *batchChange = [batchChanges objectForKey:moc];
+        if (!batchChange) {
+            batchChange = [[MPManagedObjectsBatchChange alloc] initWithController:moc];
+            [batchChanges setObject:batchChange forKey:moc];
+        }
+        
+        for (MPManagedObject *mo in [objectsByController objectForKey:moc])
+            [mo saveCompletedInBatchChange:batchChange];
+        
+        [moc didSaveObjects:batchChange];
+    }
+    
+    return YES;
+}
+
+- (BOOL)ensureWritable:(NSError **)error {
+    if (!_readOnly)
+        return YES;
+    
+    if (error)
+        *error = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                     code:MPDatabasePackageControllerErrorCodeReadOnly
+                                 userInfo:@{ NSLocalizedDescriptionKey : @"The package was opened read-only, and cannot be modified.",
+                                             NSFilePathErrorKey : self.path }];
+    return NO;
+}
+
 - (CBLManager *)serverForDatabaseWithName:(NSString *)dbName {
     NSParameterAssert(_server);
-    return _server;
+    return _databaseServers[dbName] ?: _server;
 }
 
 @end
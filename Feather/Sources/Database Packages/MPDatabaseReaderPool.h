@@ -0,0 +1,83 @@
+//
+//  MPDatabaseReaderPool.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+@import Foundation;
+
+/** A read-only copy of the properties of a document, detached from the database: it does not change as the document does, and cannot be saved.
+  * Properties can be read with -valueForKey: or subscripting. Embedded objects are left as dictionaries. */
+@interface MPDetachedObject : NSObject
+
+- (nonnull instancetype)initWithProperties:(nonnull NSDictionary<NSString *, id> *)properties NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly, copy, nonnull) NSDictionary<NSString *, id> *properties;
+
+@property (readonly, copy, nonnull) NSString *documentID;
+@property (readonly, copy, nonnull) NSString *revisionID;
+@property (readonly, copy, nullable) NSString *objectType;
+
+/** The MPManagedObject subclass named by the objectType, if any. */
+@property (readonly, nullable) Class managedObjectClass;
+
+- (nullable id)objectForKeyedSubscript:(nonnull NSString *)key;
+
+@end
+
+/** Reads the current revisions of the documents of a database through a SQLite connection of its own, within one read transaction.
+  * All reads made with a reader see the database as it was when the reader was handed out by -[MPDatabaseReaderPool performRead:error:], regardless of writes made meanwhile.
+  * A reader must not be used outside the block it was passed to. Errors from SQLite are reported in the "SQLite" error domain with the SQLite result code. */
+@interface MPDatabaseReader : NSObject
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** The sequence number of the last change to the database visible to the reader. */
+@property (readonly) UInt64 lastSequenceNumber;
+
+/** The properties of the current revision of a document, including _id and _rev. nil, without an error, if the document does not exist or is deleted. */
+- (nullable NSDictionary<NSString *, id> *)propertiesOfDocumentWithID:(nonnull NSString *)documentID error:(NSError *__nullable *__nullable)error;
+
+/** Enumerates the properties of the current revision of each document that is not deleted, in the order the documents were created. */
+- (BOOL)enumerateDocumentPropertiesUsingBlock:(nonnull void (^)(NSDictionary<NSString *, id> *__nonnull properties, BOOL *__nonnull stop))block
+                                        error:(NSError *__nullable *__nullable)error;
+
+/** Enumerates the documents changed after a sequence number, with the revision that was current at that sequence number, reconstructed from their revision history.
+  * pastRevisionID is nil if the document did not exist or was deleted at the sequence number. pastRevisionKnown is NO if it cannot be told from the history:
+  * the document is in conflict, or its revisions up to the sequence number have been pruned. deleted tells whether the document is deleted now. */
+- (BOOL)enumerateDocumentsChangedSinceSequenceNumber:(UInt64)sequenceNumber
+                                          usingBlock:(nonnull void (^)(NSString *__nonnull documentID, BOOL deleted,
+                                                                       NSString *__nullable pastRevisionID, BOOL pastRevisionKnown, BOOL *__nonnull stop))block
+                                               error:(NSError *__nullable *__nullable)error;
+
+/** The document with the given identifier as a detached object. nil, without an error, if the document does not exist or is deleted. */
+- (nullable MPDetachedObject *)objectWithIdentifier:(nonnull NSString *)identifier error:(NSError *__nullable *__nullable)error;
+
+/** Detached objects of the documents whose objectType names the given class or one of its subclasses. */
+- (nullable NSArray<MPDetachedObject *> *)objectsOfClass:(nonnull Class)managedObjectClass error:(NSError *__nullable *__nullable)error;
+
+@end
+
+/** A pool of read-only SQLite connections to a database, for reading it concurrently with the writes made on its server's queue, from any thread.
+  * The database must be in write-ahead log mode, as CouchbaseLite databases are, for readers not to block, nor be blocked by, the writer. */
+@interface MPDatabaseReaderPool : NSObject
+
+- (nonnull instancetype)initWithPath:(nonnull NSString *)path maximumReaderCount:(NSUInteger)maximumReaderCount NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly, copy, nonnull) NSString *path;
+
+/** The number of connections opened at most. -performRead:error: waits for a reader when all are in use. */
+@property (readonly) NSUInteger maximumReaderCount;
+
+/** Runs the block on the calling thread with a reader whose read transaction is begun before, and ended after, the block.
+  * @return NO if a connection could not be opened or a read transaction begun, in which case the block is not run. */
+- (BOOL)performRead:(nonnull void (^)(MPDatabaseReader *__nonnull reader))block error:(NSError *__nullable *__nullable)error;
+
+/** Closes the idle connections, and those in use as their reads finish. Reading afterwards fails with SQLITE_MISUSE. */
+- (void)close;
+
+@end
@@ -0,0 +1,532 @@
+//
+//  MPDatabaseReaderPool.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPDatabaseReaderPool.h"
+#import "MPManagedObject.h"
+
+#import <sqlite3.h>
+
+static NSError *MPDatabaseReaderError(sqlite3 *db, int code, NSString *path)
+{
+    NSString *message = db ? @(sqlite3_errmsg(db)) : @(sqlite3_errstr(code));
+    return [NSError errorWithDomain:@"SQLite"
+                               code:code
+                           userInfo:@{NSLocalizedDescriptionKey:[NSString stringWithFormat:@"Failed to read database %@", path.lastPathComponent],
+                                      NSLocalizedFailureReasonErrorKey:message ?: @"Unknown SQLite error",
+                                      NSFilePathErrorKey:path}];
+}
+
+/** Parses the generation of a "generation-suffix" revision ID, returning the index of the suffix, or -1 if the ID is not of that form. */
+static int MPRevisionIDSuffixIndex(const char *revID, int length, long *generation)
+{
+    long gen = 0;
+    int i = 0;
+    for (; i < length && revID[i] >= '0' && revID[i] <= '9'; i++)
+        gen = gen * 10 + (revID[i] - '0');
+    
+    if (i == 0 || i >= length || revID[i] != '-')
+        return -1;
+    
+    *generation = gen;
+    return i + 1;
+}
+
+static int MPCompareBytes(const char *a, int lengthA, const char *b, int lengthB)
+{
+    int result = memcmp(a, b, MIN(lengthA, lengthB));
+    return result ? result : lengthA - lengthB;
+}
+
+/** The REVID collation CouchbaseLite declares the revs table's revid column with: generations compare numerically, then suffixes byte-wise.
+  * Defined on the readers' connections, as SQLite needs it for statements using the column. */
+static int MPCollateRevisionIDs(void *context, int lengthA, const void *bytesA, int lengthB, const void *bytesB)
+{
+    const char *a = bytesA, *b = bytesB;
+    long generationA = 0, generationB = 0;
+    int suffixA = MPRevisionIDSuffixIndex(a, lengthA, &generationA);
+    int suffixB = MPRevisionIDSuffixIndex(b, lengthB, &generationB);
+    
+    if (suffixA < 0 || suffixB < 0)
+        return MPCompareBytes(a, lengthA, b, lengthB);
+    
+    if (generationA != generationB)
+        return generationA < generationB ? -1 : 1;
+    
+    return MPCompareBytes(a + suffixA, lengthA - suffixA, b + suffixB, lengthB - suffixB);
+}
+
+#pragma mark -
+
+@implementation MPDetachedObject
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithProperties:(NSDictionary<NSString *, id> *)properties
+{
+    NSParameterAssert(properties[@"_id"]);
+    
+    if (self = [super init])
+    {
+        _properties = properties.copy;
+    }
+    
+    return self;
+}
+
+- (NSString *)documentID
+{
+    return _properties[@"_id"];
+}
+
+- (NSString *)revisionID
+{
+    return _properties[@"_rev"];
+}
+
+- (NSString *)objectType
+{
+    return _properties[@"objectType"];
+}
+
+- (Class)managedObjectClass
+{
+    Class cls = self.objectType ? NSClassFromString(self.objectType) : Nil;
+    return [cls isSubclassOfClass:MPManagedObject.class] ? cls : Nil;
+}
+
+- (id)objectForKeyedSubscript:(NSString *)key
+{
+    return _properties[key];
+}
+
+- (id)valueForUndefinedKey:(NSString *)key
+{
+    return _properties[key];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p %@ %@>", NSStringFromClass(self.class), self, self.documentID, self.revisionID];
+}
+
+@end
+
+#pragma mark -
+
+@interface MPDatabaseReader ()
+{
+    sqlite3 *_db;
+    sqlite3_stmt *_documentStatement;
+}
+@property (readonly, copy) NSString *path;
+@property (readwrite) UInt64 lastSequenceNumber;
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error;
+- (BOOL)beginRead:(NSError **)error;
+- (void)endRead;
+- (void)close;
+@end
+
+@implementation MPDatabaseReader
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+    if (self = [super init])
+    {
+        _path = path.copy;
+        
+        int rc = sqlite3_open_v2(path.fileSystemRepresentation, &_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
+        if (rc == SQLITE_OK)
+            rc = sqlite3_create_collation(_db, "REVID", SQLITE_UTF8, NULL, MPCollateRevisionIDs);
+        
+        if (rc != SQLITE_OK) {
+            if (error)
+                *error = MPDatabaseReaderError(_db, rc, path);
+            [self close];
+            return nil;
+        }
+        
+        sqlite3_busy_timeout(_db, 5000);
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [self close];
+}
+
+- (void)close
+{
+    sqlite3_finalize(_documentStatement);
+    _documentStatement = NULL;
+    
+    sqlite3_close(_db);
+    _db = NULL;
+}
+
+- (BOOL)execute:(const char *)SQL error:(NSError **)error
+{
+    int rc = sqlite3_exec(_db, SQL, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        if (error)
+            *error = MPDatabaseReaderError(_db, rc, _path);
+        return NO;
+    }
+    return YES;
+}
+
+/** Begins a read transaction, and reads from the database so that its snapshot is taken right away rather than on the first read made by the caller. */
+- (BOOL)beginRead:(NSError **)error
+{
+    if (![self execute:"BEGIN" error:error])
+        return NO;
+    
+    sqlite3_stmt *statement = NULL;
+    int rc = sqlite3_prepare_v2(_db, "SELECT MAX(sequence) FROM revs", -1, &statement, NULL);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_step(statement);
+    
+    if (rc == SQLITE_ROW)
+        self.lastSequenceNumber = (UInt64)sqlite3_column_int64(statement, 0);
+    sqlite3_finalize(statement);
+    
+    if (rc != SQLITE_ROW) {
+        if (error)
+            *error = MPDatabaseReaderError(_db, rc, _path);
+        [self endRead];
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (void)endRead
+{
+    [self execute:"COMMIT" error:nil];
+}
+
+- (NSDictionary<NSString *, id> *)propertiesWithJSONColumn:(int)column
+                                               ofStatement:(sqlite3_stmt *)statement
+                                                documentID:(NSString *)documentID
+                                                revisionID:(NSString *)revisionID
+                                                     error:(NSError **)error
+{
+    NSMutableDictionary *properties = nil;
+    
+    const void *bytes = sqlite3_column_blob(statement, column);
+    int length = sqlite3_column_bytes(statement, column);
+    
+    if (length > 0) {
+        NSData *data = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+        properties = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingMutableContainers error:error];
+        if (![properties isKindOfClass:NSMutableDictionary.class])
+            return nil;
+    }
+    else {
+        properties = [NSMutableDictionary dictionaryWithCapacity:2];
+    }
+    
+    // the stored revision bodies leave out the document and revision IDs.
+    properties[@"_id"] = documentID;
+    properties[@"_rev"] = revisionID;
+    return properties;
+}
+
+- (NSDictionary<NSString *, id> *)propertiesOfDocumentWithID:(NSString *)documentID error:(NSError **)error
+{
+    NSParameterAssert(documentID);
+    
+    if (!_documentStatement) {
+        // the winning revision of a document is its current, undeleted revision with the highest ID.
+        const char *SQL = "SELECT revs.revid, revs.json FROM revs JOIN docs ON docs.doc_id = revs.doc_id"
+                          " WHERE docs.docid = ? AND revs.current = 1 AND revs.deleted = 0"
+                          " ORDER BY revs.revid DESC LIMIT 1";
+        int rc = sqlite3_prepare_v2(_db, SQL, -1, &_documentStatement, NULL);
+        if (rc != SQLITE_OK) {
+            if (error)
+                *error = MPDatabaseReaderError(_db, rc, _path);
+            return nil;
+        }
+    }
+    
+    sqlite3_bind_text(_documentStatement, 1, documentID.UTF8String, -1, SQLITE_TRANSIENT);
+    
+    NSDictionary *properties = nil;
+    int rc = sqlite3_step(_documentStatement);
+    
+    if (rc == SQLITE_ROW) {
+        NSString *revisionID = @((const char *)sqlite3_column_text(_documentStatement, 0));
+        properties = [self propertiesWithJSONColumn:1 ofStatement:_documentStatement documentID:documentID revisionID:revisionID error:error];
+    }
+    else if (rc != SQLITE_DONE && error) {
+        *error = MPDatabaseReaderError(_db, rc, _path);
+    }
+    
+    sqlite3_reset(_documentStatement);
+    sqlite3_clear_bindings(_documentStatement);
+    return properties;
+}
+
+- (BOOL)enumerateDocumentPropertiesUsingBlock:(void (^)(NSDictionary<NSString *, id> *properties, BOOL *stop))block error:(NSError **)error
+{
+    NSParameterAssert(block);
+    
+    // rows of a document are consecutive, its winning revision first.
+    const char *SQL = "SELECT revs.doc_id, docs.docid, revs.revid, revs.json FROM revs JOIN docs ON docs.doc_id = revs.doc_id"
+                      " WHERE revs.current = 1 AND revs.deleted = 0"
+                      " ORDER BY revs.doc_id, revs.revid DESC";
+    
+    sqlite3_stmt *statement = NULL;
+    int rc = sqlite3_prepare_v2(_db, SQL, -1, &statement, NULL);
+    
+    sqlite3_int64 previousDocID = -1;
+    BOOL stop = NO;
+    NSError *readError = nil;
+    
+    while (rc == SQLITE_OK || rc == SQLITE_ROW) {
+        rc = sqlite3_step(statement);
+        if (rc != SQLITE_ROW)
+            break;
+        
+        sqlite3_int64 docID = sqlite3_column_int64(statement, 0);
+        if (docID == previousDocID)
+            continue;
+        previousDocID = docID;
+        
+        @autoreleasepool {
+            NSString *documentID = @((const char *)sqlite3_column_text(statement, 1));
+            NSString *revisionID = @((const char *)sqlite3_column_text(statement, 2));
+            NSDictionary *properties = [self propertiesWithJSONColumn:3 ofStatement:statement documentID:documentID revisionID:revisionID error:&readError];
+            if (!properties)
+                break;
+            
+            block(properties, &stop);
+        }
+        
+        if (stop)
+            break;
+    }
+    
+    if (!readError && !stop && rc != SQLITE_DONE)
+        readError = MPDatabaseReaderError(_db, rc, _path);
+    
+    sqlite3_finalize(statement);
+    
+    if (readError) {
+        if (error)
+            *error = readError;
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (BOOL)enumerateDocumentsChangedSinceSequenceNumber:(UInt64)sequenceNumber
+                                          usingBlock:(void (^)(NSString *documentID, BOOL deleted, NSString *pastRevisionID, BOOL pastRevisionKnown, BOOL *stop))block
+                                               error:(NSError **)error
+{
+    NSParameterAssert(block);
+    
+    // the current revisions of each document with a revision added after the sequence number, the revision added last up to it, and the document's first revision.
+    const char *SQL = "SELECT docs.docid, MIN(revs.deleted), COUNT(*), past.revid, past.deleted,"
+                      " (SELECT first.revid FROM revs AS first WHERE first.doc_id = revs.doc_id ORDER BY first.sequence LIMIT 1)"
+                      " FROM revs JOIN docs ON docs.doc_id = revs.doc_id"
+                      " LEFT JOIN revs AS past ON past.sequence = (SELECT MAX(r.sequence) FROM revs AS r WHERE r.doc_id = revs.doc_id AND r.sequence <= ?1)"
+                      " WHERE revs.current = 1 AND revs.doc_id IN (SELECT doc_id FROM revs WHERE sequence > ?1)"
+                      " GROUP BY revs.doc_id";
+    
+    sqlite3_stmt *statement = NULL;
+    int rc = sqlite3_prepare_v2(_db, SQL, -1, &statement, NULL);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_bind_int64(statement, 1, (sqlite3_int64)sequenceNumber);
+    
+    BOOL stop = NO;
+    
+    while (rc == SQLITE_OK || rc == SQLITE_ROW) {
+        rc = sqlite3_step(statement);
+        if (rc != SQLITE_ROW)
+            break;
+        
+        @autoreleasepool {
+            NSString *documentID = @((const char *)sqlite3_column_text(statement, 0));
+            BOOL deleted = sqlite3_column_int(statement, 1) != 0;
+            BOOL conflicted = sqlite3_column_int(statement, 2) > 1;
+            
+            NSString *pastRevisionID = nil;
+            BOOL pastRevisionKnown = !conflicted;
+            
+            if (sqlite3_column_type(statement, 3) != SQLITE_NULL) {
+                if (!sqlite3_column_int(statement, 4))
+                    pastRevisionID = @((const char *)sqlite3_column_text(statement, 3));
+            }
+            else {
+                // without revisions up to the sequence number, a document was created after it only if its first revision is kept.
+                const char *firstRevisionID = (const char *)sqlite3_column_text(statement, 5);
+                pastRevisionKnown = pastRevisionKnown && firstRevisionID && strncmp(firstRevisionID, "1-", 2) == 0;
+            }
+            
+            block(documentID, deleted, pastRevisionID, pastRevisionKnown, &stop);
+        }
+        
+        if (stop)
+            break;
+    }
+    
+    NSError *readError = nil;
+    if (!stop && rc != SQLITE_DONE)
+        readError = MPDatabaseReaderError(_db, rc, _path);
+    
+    sqlite3_finalize(statement);
+    
+    if (readError) {
+        if (error)
+            *error = readError;
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (MPDetachedObject *)objectWithIdentifier:(NSString *)identifier error:(NSError **)error
+{
+    NSDictionary *properties = [self propertiesOfDocumentWithID:identifier error:error];
+    return properties ? [[MPDetachedObject alloc] initWithProperties:properties] : nil;
+}
+
+- (NSArray<MPDetachedObject *> *)objectsOfClass:(Class)managedObjectClass error:(NSError **)error
+{
+    NSParameterAssert(managedObjectClass);
+    
+    NSMutableDictionary<NSString *, NSNumber *> *matchingTypes = [NSMutableDictionary dictionary];
+    NSMutableArray<MPDetachedObject *> *objects = [NSMutableArray array];
+    
+    BOOL success = [self enumerateDocumentPropertiesUsingBlock:^(NSDictionary<NSString *, id> *properties, BOOL *stop) {
+        NSString *objectType = properties[@"objectType"];
+        if (![objectType isKindOfClass:NSString.class])
+            return;
+        
+        NSNumber *matches = matchingTypes[objectType];
+        if (!matches)
+            matchingTypes[objectType] = matches = @([NSClassFromString(objectType) isSubclassOfClass:managedObjectClass]);
+        
+        if (matches.boolValue)
+            [objects addObject:[[MPDetachedObject alloc] initWithProperties:properties]];
+    } error:error];
+    
+    return success ? objects.copy : nil;
+}
+
+@end
+
+#pragma mark -
+
+@interface MPDatabaseReaderPool ()
+{
+    dispatch_semaphore_t _semaphore;
+    NSMutableArray<MPDatabaseReader *> *_idleReaders;
+    BOOL _closed;
+}
+@end
+
+@implementation MPDatabaseReaderPool
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithPath:(NSString *)path maximumReaderCount:(NSUInteger)maximumReaderCount
+{
+    NSParameterAssert(path);
+    NSParameterAssert(maximumReaderCount > 0);
+    
+    if (self = [super init])
+    {
+        _path = path.copy;
+        _maximumReaderCount = maximumReaderCount;
+        _semaphore = dispatch_semaphore_create(maximumReaderCount);
+        _idleReaders = [NSMutableArray arrayWithCapacity:maximumReaderCount];
+    }
+    
+    return self;
+}
+
+- (BOOL)performRead:(void (^)(MPDatabaseReader *reader))block error:(NSError **)error
+{
+    NSParameterAssert(block);
+    
+    dispatch_semaphore_wait(_semaphore, DISPATCH_TIME_FOREVER);
+    
+    MPDatabaseReader *reader = nil;
+    BOOL closed = NO;
+    
+    @synchronized (self) {
+        closed = _closed;
+        reader = _idleReaders.lastObject;
+        if (reader)
+            [_idleReaders removeLastObject];
+    }
+    
+    if (closed) {
+        dispatch_semaphore_signal(_semaphore);
+        if (error)
+            *error = MPDatabaseReaderError(NULL, SQLITE_MISUSE, _path);
+        return NO;
+    }
+    
+    if (!reader)
+        reader = [[MPDatabaseReader alloc] initWithPath:_path error:error];
+    
+    BOOL success = [reader beginRead:error];
+    
+    if (success) {
+        @autoreleasepool {
+            block(reader);
+        }
+        [reader endRead];
+    }
+    
+    @synchronized (self) {
+        // a reader that failed to begin reading is not reused.
+        if (success && !_closed)
+            [_idleReaders addObject:reader];
+        else
+            [reader close];
+    }
+    
+    dispatch_semaphore_signal(_semaphore);
+    return success;
+}
+
+- (void)close
+{
+    NSArray<MPDatabaseReader *> *idleReaders = nil;
+    
+    @synchronized (self) {
+        _closed = YES;
+        idleReaders = _idleReaders.copy;
+        [_idleReaders removeAllObjects];
+    }
+    
+    for (MPDatabaseReader *reader in idleReaders)
+        [reader close];
+}
+
+@end
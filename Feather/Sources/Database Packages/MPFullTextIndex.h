@@ -0,0 +1,85 @@
+//
+//  MPFullTextIndex.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+@import Foundation;
+
+/** Name of the full-text index database file inside a database package. */
+extern NSString * _Nonnull const MPFullTextIndexFilename;
+
+/** The indexed state of a document revision. */
+@interface MPFullTextIndexEntry : NSObject
+
+@property (readonly, copy, nonnull) NSString *documentID;
+@property (readonly, copy, nonnull) NSString *objectType;
+@property (readonly, copy, nonnull) NSString *databaseName;
+
+/** The generation of the revision (the number before the dash in its revision ID). */
+@property (readonly) NSUInteger generation;
+
+/** The tokenized full-text string of the revision, nil if the object is not indexable. */
+@property (readonly, copy, nullable) NSString *text;
+
+/** YES if the revision is a deletion. */
+@property (readonly) BOOL deleted;
+
+/** The indexable property keys of the object's class joined with commas, recorded to detect changes to them. */
+@property (readonly, copy, nonnull) NSString *keysSignature;
+
+- (nonnull instancetype)initWithDocumentID:(nonnull NSString *)documentID
+                                objectType:(nonnull NSString *)objectType
+                              databaseName:(nonnull NSString *)databaseName
+                                revisionID:(nonnull NSString *)revisionID
+                                      text:(nullable NSString *)text
+                                   deleted:(BOOL)deleted
+                             keysSignature:(nonnull NSString *)keysSignature;
+
+@end
+
+/** A SQLite FTS5 full-text index of the objects of a database package, stored in a database of its own next to the package's databases.
+  * Updates are applied in order on a serial queue of the index, and queries wait for the updates enqueued before them.
+  * An entry for an older revision of a document than the one indexed is ignored, so that entries read by a background rebuild do not replace newer ones from the change feed. */
+@interface MPFullTextIndex : NSObject
+
+- (nullable instancetype)initWithPath:(nonnull NSString *)path error:(NSError *__nullable *__nullable)error;
+
+@property (readonly, copy, nonnull) NSString *path;
+
+/** Enqueues the entries to be applied in one transaction. */
+- (void)applyEntries:(nonnull NSArray<MPFullTextIndexEntry *> *)entries;
+
+/** Enqueues the entries of the changes of a database up to a sequence number, which becomes the database's applied sequence number
+  * once the entries have been applied (the entries can be empty, to record a sequence number up to which the database is already indexed). */
+- (void)applyEntries:(nonnull NSArray<MPFullTextIndexEntry *> *)entries
+throughSequenceNumber:(UInt64)sequenceNumber
+     ofDatabaseNamed:(nonnull NSString *)databaseName;
+
+/** The highest sequence number of the database whose changes have all been applied, after waiting for the enqueued updates.
+  * Nil if none has been recorded, or if applying an update to the database's entries failed since the index was opened. */
+- (nullable NSNumber *)appliedSequenceNumberOfDatabaseNamed:(nonnull NSString *)databaseName;
+
+/** Enqueues the removal of the entries of a database, restricted to the given object types if non-nil, ahead of re-indexing them. */
+- (void)removeEntriesInDatabaseNamed:(nonnull NSString *)databaseName objectTypes:(nullable NSSet<NSString *> *)objectTypes;
+
+/** IDs of the documents whose text contains each word of the query as a prefix of a word, ranked by BM25 best match first.
+  * The query is normalized like the indexed text, with any characters other than letters and digits separating words. */
+- (nullable NSArray<NSString *> *)documentIDsMatchingQuery:(nonnull NSString *)query
+                                                    offset:(NSUInteger)offset
+                                                     limit:(NSUInteger)limit
+                                                     error:(NSError *__nullable *__nullable)error;
+
+/** Persistent state of the index, such as the indexable property keys of each object type. Writes are enqueued like updates. */
+- (nonnull NSDictionary<NSString *, NSString *> *)stateValuesWithKeyPrefix:(nonnull NSString *)prefix;
+- (void)setStateValue:(nullable NSString *)value forKey:(nonnull NSString *)key;
+
+/** Waits for the enqueued updates to be applied. */
+- (void)waitUntilUpdated;
+
+/** Waits for the enqueued updates and closes the index database. */
+- (void)close;
+
+@end
@@ -0,0 +1,451 @@
+//
+//  MPFullTextIndex.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPFullTextIndex.h"
+#import "NSString+MPSearchIndex.h"
+
+#import <sqlite3.h>
+
+NSString * const MPFullTextIndexFilename = @"fulltext.sqlite";
+
+static NSError *MPFullTextIndexSQLiteError(sqlite3 *db, int code)
+{
+    NSString *message = db ? @(sqlite3_errmsg(db)) : @(sqlite3_errstr(code));
+    return [NSError errorWithDomain:@"SQLite"
+                               code:code
+                           userInfo:@{NSLocalizedDescriptionKey:@"Full-text index operation failed",
+                                      NSLocalizedFailureReasonErrorKey:message ?: @"Unknown SQLite error"}];
+}
+
+@implementation MPFullTextIndexEntry
+
+- (instancetype)initWithDocumentID:(NSString *)documentID
+                        objectType:(NSString *)objectType
+                      databaseName:(NSString *)databaseName
+                        revisionID:(NSString *)revisionID
+                              text:(NSString *)text
+                           deleted:(BOOL)deleted
+                     keysSignature:(NSString *)keysSignature
+{
+    NSParameterAssert(documentID);
+    NSParameterAssert(objectType);
+    NSParameterAssert(databaseName);
+    NSParameterAssert(revisionID);
+    NSParameterAssert(keysSignature);
+
+    if (self = [super init])
+    {
+        _documentID = [documentID copy];
+        _objectType = [objectType copy];
+        _databaseName = [databaseName copy];
+        _generation = (NSUInteger)MAX(revisionID.integerValue, 0);
+        _text = [text copy];
+        _deleted = deleted;
+        _keysSignature = [keysSignature copy];
+    }
+
+    return self;
+}
+
+@end
+
+#pragma mark -
+
+@interface MPFullTextIndex ()
+{
+    sqlite3 *_db;
+    dispatch_queue_t _queue;
+    NSMutableDictionary<NSString *, NSValue *> *_statements;
+
+    /** Object types whose keys signature has been recorded, to record each only once per session. */
+    NSMutableSet<NSString *> *_recordedObjectTypes;
+
+    /** Sequence number up to which the changes of each database have been applied, or NSNull once an update to its entries has failed. */
+    NSMutableDictionary<NSString *, id> *_appliedSequenceNumbers;
+}
+@end
+
+@implementation MPFullTextIndex
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+    NSParameterAssert(path);
+
+    if (self = [super init])
+    {
+        _path = [path copy];
+        _statements = [NSMutableDictionary dictionaryWithCapacity:16];
+        _recordedObjectTypes = [NSMutableSet set];
+        _appliedSequenceNumbers = [NSMutableDictionary dictionary];
+        _queue = dispatch_queue_create(path.fileSystemRepresentation,
+                                       dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+
+        int rc = sqlite3_open_v2(path.fileSystemRepresentation, &_db,
+                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL);
+
+        if (rc == SQLITE_OK)
+            rc = sqlite3_exec(_db,
+                              "PRAGMA journal_mode = WAL;"
+                              "CREATE TABLE IF NOT EXISTS documents (id INTEGER PRIMARY KEY, documentID TEXT NOT NULL UNIQUE,"
+                              " objectType TEXT NOT NULL, databaseName TEXT NOT NULL, generation INTEGER NOT NULL, deleted INTEGER NOT NULL);"
+                              "CREATE INDEX IF NOT EXISTS documentsByDatabase ON documents (databaseName, objectType);"
+                              "CREATE VIRTUAL TABLE IF NOT EXISTS contents USING fts5(text, tokenize = 'unicode61');"
+                              "CREATE TABLE IF NOT EXISTS state (key TEXT PRIMARY KEY, value TEXT NOT NULL);",
+                              NULL, NULL, NULL);
+
+        if (rc != SQLITE_OK) {
+            if (error)
+                *error = MPFullTextIndexSQLiteError(_db, rc);
+            sqlite3_close(_db);
+            _db = NULL;
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self closeDatabase];
+}
+
+#pragma mark - Updates
+
+- (void)applyEntries:(NSArray<MPFullTextIndexEntry *> *)entries
+{
+    if (entries.count == 0)
+        return;
+
+    dispatch_async(_queue, ^{
+        [self performTransactionWithEntries:entries];
+    });
+}
+
+- (void)applyEntries:(NSArray<MPFullTextIndexEntry *> *)entries
+throughSequenceNumber:(UInt64)sequenceNumber
+     ofDatabaseNamed:(NSString *)databaseName
+{
+    NSParameterAssert(entries);
+    NSParameterAssert(databaseName);
+
+    dispatch_async(_queue, ^{
+        if (entries.count > 0 && ![self performTransactionWithEntries:entries])
+            return;
+
+        NSNumber *appliedSequenceNumber = _appliedSequenceNumbers[databaseName];
+        if ([appliedSequenceNumber isKindOfClass:[NSNull class]])
+            return;
+
+        if (!appliedSequenceNumber || appliedSequenceNumber.unsignedLongLongValue < sequenceNumber)
+            _appliedSequenceNumbers[databaseName] = @(sequenceNumber);
+    });
+}
+
+- (NSNumber *)appliedSequenceNumberOfDatabaseNamed:(NSString *)databaseName
+{
+    NSParameterAssert(databaseName);
+
+    __block NSNumber *sequenceNumber = nil;
+    dispatch_sync(_queue, ^{
+        id value = _appliedSequenceNumbers[databaseName];
+        sequenceNumber = [value isKindOfClass:[NSNumber class]] ? value : nil;
+    });
+    return sequenceNumber;
+}
+
+/** Applies the entries in one transaction, marking their databases as not up to date if it fails. */
+- (BOOL)performTransactionWithEntries:(NSArray<MPFullTextIndexEntry *> *)entries
+{
+    BOOL success = [self performTransaction:^BOOL{
+        for (MPFullTextIndexEntry *entry in entries) {
+            if (![self applyEntry:entry])
+                return NO;
+        }
+        return YES;
+    }];
+
+    if (!success) {
+        for (MPFullTextIndexEntry *entry in entries)
+            _appliedSequenceNumbers[entry.databaseName] = [NSNull null];
+    }
+
+    return success;
+}
+
+- (void)removeEntriesInDatabaseNamed:(NSString *)databaseName objectTypes:(NSSet<NSString *> *)objectTypes
+{
+    NSParameterAssert(databaseName);
+
+    dispatch_async(_queue, ^{
+        NSMutableString *condition = [NSMutableString stringWithString:@"databaseName = ?"];
+        NSArray<NSString *> *types = objectTypes.allObjects;
+        if (types) {
+            NSMutableArray *placeholders = [NSMutableArray arrayWithCapacity:types.count];
+            for (NSUInteger i = 0; i < types.count; i++)
+                [placeholders addObject:@"?"];
+            [condition appendFormat:@" AND objectType IN (%@)", [placeholders componentsJoinedByString:@","]];
+        }
+
+        NSArray *arguments = [@[ databaseName ] arrayByAddingObjectsFromArray:types ?: @[]];
+
+        BOOL success = [self performTransaction:^BOOL{
+            return [self executeSQL:[NSString stringWithFormat:@"DELETE FROM contents WHERE rowid IN (SELECT id FROM documents WHERE %@)", condition]
+                          arguments:arguments]
+                && [self executeSQL:[NSString stringWithFormat:@"DELETE FROM documents WHERE %@", condition]
+                          arguments:arguments];
+        }];
+
+        if (!success)
+            _appliedSequenceNumbers[databaseName] = [NSNull null];
+    });
+}
+
+- (void)setStateValue:(NSString *)value forKey:(NSString *)key
+{
+    NSParameterAssert(key);
+
+    dispatch_async(_queue, ^{
+        if (value)
+            [self executeSQL:@"INSERT OR REPLACE INTO state (key, value) VALUES (?, ?)" arguments:@[ key, value ]];
+        else
+            [self executeSQL:@"DELETE FROM state WHERE key = ?" arguments:@[ key ]];
+    });
+}
+
+- (void)waitUntilUpdated
+{
+    dispatch_sync(_queue, ^{ });
+}
+
+- (void)close
+{
+    dispatch_sync(_queue, ^{
+        [self closeDatabase];
+    });
+}
+
+#pragma mark - Queries
+
+- (NSArray<NSString *> *)documentIDsMatchingQuery:(NSString *)query
+                                           offset:(NSUInteger)offset
+                                            limit:(NSUInteger)limit
+                                            error:(NSError **)error
+{
+    NSParameterAssert(query);
+
+    NSMutableArray<NSString *> *terms = [NSMutableArray array];
+    NSCharacterSet *separators = [NSCharacterSet alphanumericCharacterSet].invertedSet;
+    for (NSString *word in [query.fullTextNormalizedString componentsSeparatedByCharactersInSet:separators]) {
+        if (word.length > 0)
+            [terms addObject:[NSString stringWithFormat:@"\"%@\"*", word]];
+    }
+
+    if (terms.count == 0 || limit == 0)
+        return @[];
+
+    __block NSMutableArray<NSString *> *documentIDs = nil;
+    __block NSError *queryError = nil;
+
+    dispatch_sync(_queue, ^{
+        sqlite3_stmt *statement = [self statementForSQL:@"SELECT d.documentID FROM"
+                                   " (SELECT rowid, rank FROM contents WHERE contents MATCH ? ORDER BY rank LIMIT ? OFFSET ?) AS m"
+                                   " JOIN documents d ON d.id = m.rowid ORDER BY m.rank"];
+        if (!statement) {
+            queryError = MPFullTextIndexSQLiteError(_db, _db ? sqlite3_errcode(_db) : SQLITE_MISUSE);
+            return;
+        }
+
+        sqlite3_bind_text(statement, 1, [terms componentsJoinedByString:@" "].UTF8String, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(statement, 2, (sqlite3_int64)MIN(limit, (NSUInteger)INT64_MAX));
+        sqlite3_bind_int64(statement, 3, (sqlite3_int64)offset);
+
+        documentIDs = [NSMutableArray arrayWithCapacity:MIN(limit, 256)];
+        int rc;
+        while ((rc = sqlite3_step(statement)) == SQLITE_ROW)
+            [documentIDs addObject:@((const char *)sqlite3_column_text(statement, 0))];
+
+        if (rc != SQLITE_DONE) {
+            queryError = MPFullTextIndexSQLiteError(_db, rc);
+            documentIDs = nil;
+        }
+
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
+    });
+
+    if (!documentIDs && error)
+        *error = queryError;
+
+    return documentIDs;
+}
+
+- (NSDictionary<NSString *, NSString *> *)stateValuesWithKeyPrefix:(NSString *)prefix
+{
+    NSParameterAssert(prefix);
+
+    NSMutableDictionary<NSString *, NSString *> *values = [NSMutableDictionary dictionary];
+
+    dispatch_sync(_queue, ^{
+        sqlite3_stmt *statement = [self statementForSQL:@"SELECT key, value FROM state WHERE substr(key, 1, length(?1)) = ?1"];
+        if (!statement)
+            return;
+
+        sqlite3_bind_text(statement, 1, prefix.UTF8String, -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(statement) == SQLITE_ROW) {
+            NSString *key = @((const char *)sqlite3_column_text(statement, 0));
+            values[[key substringFromIndex:prefix.length]] = @((const char *)sqlite3_column_text(statement, 1));
+        }
+
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
+    });
+
+    return values;
+}
+
+#pragma mark - SQLite (called on the index queue)
+
+- (BOOL)applyEntry:(MPFullTextIndexEntry *)entry
+{
+    if (![_recordedObjectTypes containsObject:entry.objectType]) {
+        // the signature is recorded when first seen and replaced once the type has been rebuilt after a change.
+        if (![self executeSQL:@"INSERT OR IGNORE INTO state (key, value) VALUES (?, ?)"
+                    arguments:@[ [@"keys:" stringByAppendingString:entry.objectType], entry.keysSignature ]])
+            return NO;
+        [_recordedObjectTypes addObject:entry.objectType];
+    }
+
+    sqlite3_stmt *lookup = [self statementForSQL:@"SELECT id, generation FROM documents WHERE documentID = ?"];
+    if (!lookup)
+        return NO;
+
+    sqlite3_bind_text(lookup, 1, entry.documentID.UTF8String, -1, SQLITE_TRANSIENT);
+
+    BOOL exists = NO;
+    sqlite3_int64 rowID = 0;
+    sqlite3_int64 generation = 0;
+    if (sqlite3_step(lookup) == SQLITE_ROW) {
+        exists = YES;
+        rowID = sqlite3_column_int64(lookup, 0);
+        generation = sqlite3_column_int64(lookup, 1);
+    }
+    sqlite3_reset(lookup);
+    sqlite3_clear_bindings(lookup);
+
+    if (exists && generation > (sqlite3_int64)entry.generation)
+        return YES;
+
+    if (exists && ![self executeSQL:@"DELETE FROM contents WHERE rowid = ?" arguments:@[ @(rowID) ]])
+        return NO;
+
+    if (!entry.deleted && !entry.text)
+        return !exists || [self executeSQL:@"DELETE FROM documents WHERE id = ?" arguments:@[ @(rowID) ]];
+
+    // deletions are kept as tombstones so that older entries of the document are not indexed again.
+    NSArray *values = @[ entry.objectType, entry.databaseName, @(entry.generation), @(entry.deleted) ];
+    if (exists) {
+        if (![self executeSQL:@"UPDATE documents SET objectType = ?, databaseName = ?, generation = ?, deleted = ? WHERE id = ?"
+                    arguments:[values arrayByAddingObject:@(rowID)]])
+            return NO;
+    }
+    else {
+        if (![self executeSQL:@"INSERT INTO documents (objectType, databaseName, generation, deleted, documentID) VALUES (?, ?, ?, ?, ?)"
+                    arguments:[values arrayByAddingObject:entry.documentID]])
+            return NO;
+        rowID = sqlite3_last_insert_rowid(_db);
+    }
+
+    if (entry.deleted)
+        return YES;
+
+    return [self executeSQL:@"INSERT INTO contents (rowid, text) VALUES (?, ?)" arguments:@[ @(rowID), entry.text ]];
+}
+
+- (BOOL)performTransaction:(BOOL (^)(void))block
+{
+    if (!_db)
+        return NO;
+
+    int rc = sqlite3_exec(_db, "BEGIN", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        NSLog(@"ERROR! Failed to begin updating full-text index %@: %@", _path, MPFullTextIndexSQLiteError(_db, rc));
+        return NO;
+    }
+
+    if (!block()) {
+        NSLog(@"ERROR! Failed to update full-text index %@: %@", _path, MPFullTextIndexSQLiteError(_db, sqlite3_errcode(_db)));
+        sqlite3_exec(_db, "ROLLBACK", NULL, NULL, NULL);
+        return NO;
+    }
+
+    rc = sqlite3_exec(_db, "COMMIT", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        NSLog(@"ERROR! Failed to commit update of full-text index %@: %@", _path, MPFullTextIndexSQLiteError(_db, rc));
+        sqlite3_exec(_db, "ROLLBACK", NULL, NULL, NULL);
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)executeSQL:(NSString *)SQL arguments:(NSArray *)arguments
+{
+    sqlite3_stmt *statement = [self statementForSQL:SQL];
+    if (!statement)
+        return NO;
+
+    int i = 1;
+    for (id argument in arguments) {
+        if ([argument isKindOfClass:[NSNumber class]])
+            sqlite3_bind_int64(statement, i, [argument longLongValue]);
+        else
+            sqlite3_bind_text(statement, i, [argument UTF8String], -1, SQLITE_TRANSIENT);
+        i++;
+    }
+
+    int rc = sqlite3_step(statement);
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+
+    return rc == SQLITE_DONE || rc == SQLITE_ROW;
+}
+
+- (sqlite3_stmt *)statementForSQL:(NSString *)SQL
+{
+    if (!_db)
+        return NULL;
+
+    sqlite3_stmt *statement = _statements[SQL].pointerValue;
+    if (statement)
+        return statement;
+
+    if (sqlite3_prepare_v2(_db, SQL.UTF8String, -1, &statement, NULL) != SQLITE_OK)
+        return NULL;
+
+    _statements[SQL] = [NSValue valueWithPointer:statement];
+    return statement;
+}
+
+- (void)closeDatabase
+{
+    for (NSValue *statement in _statements.allValues)
+        sqlite3_finalize(statement.pointerValue);
+    [_statements removeAllObjects];
+
+    sqlite3_close(_db);
+    _db = NULL;
+}
+
+@end
@@ -0,0 +1,39 @@
+//
+//  MPAsyncRequest.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Completion handler of an asynchronous request: result is nil if error is non-nil. */
+typedef void (^MPAsyncRequestCompletionHandler)(id _Nullable result, NSError *_Nullable error);
+
+/** A handle to an asynchronous fetch or save started with one of the completion handler methods of
+  * MPManagedObjectsController and MPManagedObject. The completion handler is called exactly once, on the completion queue given
+  * when starting the request (the main queue if none was given). */
+@interface MPAsyncRequest : NSObject
+
+- (nonnull instancetype)initWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+                              completionHandler:(nonnull MPAsyncRequestCompletionHandler)completionHandler NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly, strong, nonnull) dispatch_queue_t completionQueue;
+
+/** Completes the request with a NSCocoaErrorDomain NSUserCancelledError error, unless it has already completed.
+  * Work that has already begun on behalf of the request is not undone: a save whose write has started is still made. */
+- (void)cancel;
+
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+/** YES once the completion handler has been enqueued. */
+@property (readonly, getter=isCompleted) BOOL completed;
+
+/** Enqueues the completion handler on the completion queue unless the request is already completed (e.g. cancelled).
+  * @return NO if the request had already completed. */
+- (BOOL)completeWithResult:(nullable id)result error:(nullable NSError *)error;
+
+@end
@@ -0,0 +1,66 @@
+//
+//  MPAsyncRequest.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPAsyncRequest.h"
+#import "MPException.h"
+
+@interface MPAsyncRequest ()
+{
+    MPAsyncRequestCompletionHandler _completionHandler;
+}
+@property (readwrite, getter=isCancelled) BOOL cancelled;
+@property (readwrite, getter=isCompleted) BOOL completed;
+@end
+
+@implementation MPAsyncRequest
+
+- (instancetype)init {
+    @throw MPInvalidInitException;
+}
+
+- (instancetype)initWithCompletionQueue:(dispatch_queue_t)completionQueue
+                      completionHandler:(MPAsyncRequestCompletionHandler)completionHandler
+{
+    NSParameterAssert(completionHandler);
+
+    if (self = [super init]) {
+        _completionQueue = completionQueue ?: dispatch_get_main_queue();
+        _completionHandler = [completionHandler copy];
+    }
+    return self;
+}
+
+- (void)cancel
+{
+    @synchronized (self) {
+        if (_completed)
+            return;
+        self.cancelled = YES;
+    }
+
+    [self completeWithResult:nil error:[NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil]];
+}
+
+- (BOOL)completeWithResult:(id)result error:(NSError *)error
+{
+    MPAsyncRequestCompletionHandler handler = nil;
+    @synchronized (self) {
+        if (_completed)
+            return NO;
+        self.completed = YES;
+        handler = _completionHandler;
+        _completionHandler = nil;
+    }
+
+    dispatch_async(_completionQueue, ^{
+        handler(error ? nil : result, error);
+    });
+    return YES;
+}
+
+@end
@@ -76,10 +76,9 @@ NSString * const MPContributorRoleTranslator = @"translator";
     
     NSString *allObjsViewName = [self allObjectsViewName];
     
-    CBLView *view = [self.db.database viewNamed:allObjsViewName];
-    [view setMapBlock:self.allObjectsBlock version:@"1.1"];
+    [self.db defineViewNamed:allObjsViewName mapBlock:self.allObjectsBlock reduceBlock:nil version:@"1.1"];
     
-    [[self.db.database viewNamed:@"contributorsByRole"] setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+    [self.db defineViewNamed:@"contributorsByRole" mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
          if (![self managesDocumentWithDictionary:doc])
              return;
@@ -92,9 +91,9 @@ NSString * const MPContributorRoleTranslator = @"translator";
          }
          
          emit(doc[@"role"], nil);
-     } version:@"1.1"];
+     } reduceBlock:nil version:@"1.1"];
     
-    [[self.db.database viewNamed:@"contributorsByAddressBookID"] setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
+    [self.db defineViewNamed:@"contributorsByAddressBookID" mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
         if (![self managesDocumentWithDictionary:doc])
             return;
         
@@ -103,9 +102,9 @@ NSString * const MPContributorRoleTranslator = @"translator";
         
         for (NSString *uniqueID in doc[@"addressBookIDs"])
             emit(uniqueID, nil);
-    } version:@"1.0"];
+    } reduceBlock:nil version:@"1.0"];
     
-    [[self.db.database viewNamed:@"contributorsByFullName"] setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
+    [self.db defineViewNamed:@"contributorsByFullName" mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
         if (![self managesDocumentWithDictionary:doc])
             return;
         
@@ -113,7 +112,7 @@ NSString * const MPContributorRoleTranslator = @"translator";
             return;
         
         emit([doc[@"fullName"] lowercaseString], nil);
-    } version:@"1.2"];
+    } reduceBlock:nil version:@"1.2"];
 }
 
 - (MPContributor *)contributorWithAddressBookID:(NSString *)personUniqueID {
@@ -269,22 +268,22 @@ NSString * const MPContributorRoleTranslator = @"translator";
 - (void)configureViews {
     [super configureViews];
     
-    [[self.db.database viewNamed:@"contributor-identities-by-identifier"] setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
+    [self.db defineViewNamed:@"contributor-identities-by-identifier" mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
         if (![self managesDocumentWithDictionary:doc])
             return;
         
         emit(doc[@"identifier"], nil);
-    } version:@"1.0"];
+    } reduceBlock:nil version:@"1.0"];
     
-    [[self.db.database viewNamed:@"contributor-identities-by-contributor"] setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
+    [self.db defineViewNamed:@"contributor-identities-by-contributor" mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
         if (![self managesDocumentWithDictionary:doc])
             return;
         
         NSAssert(doc[@"contributor"], @"Expecting 'contributor' field in a contributor identity document: %@", doc);
         emit(doc[@"contributor"], nil);
-    } version:@"1.1"];
+    } reduceBlock:nil version:@"1.1"];
     
-    [[self.db.database viewNamed:self.allObjectsViewName] setMapBlock:self.allObjectsBlock version:@"1.0"];
+    [self.db defineViewNamed:self.allObjectsViewName mapBlock:self.allObjectsBlock reduceBlock:nil version:@"1.0"];
 }
 
 - (NSArray *)contributorIdentitiesForContributor:(MPContributor *)contributor {
@@ -0,0 +1,87 @@
+//
+//  MPLiveObjectCollection.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MPManagedObject;
+@class MPManagedObjectsController;
+@class MPLiveObjectCollection;
+
+/** A notification posted to the package controller's notification center with the collection as the object whenever its objects change.
+  * The change is found in the user info dictionary under MPLiveObjectCollectionChangeKey. */
+extern NSString *_Nonnull const MPLiveObjectCollectionDidChangeNotification;
+
+/** User info key for the MPLiveObjectCollectionChange of a MPLiveObjectCollectionDidChangeNotification. */
+extern NSString *_Nonnull const MPLiveObjectCollectionChangeKey;
+
+/** Decides whether an added or updated object belongs to a collection. */
+typedef BOOL (^MPLiveObjectCollectionFilter)(__kindof MPManagedObject *_Nonnull object);
+
+/** The changes to the objects of a live collection, with indexes like those of a batch update of a table or outline view:
+  * removed and moved-from indexes refer to the previous objects, inserted, moved-to and updated indexes to the current ones.
+  * With NSOutlineView, whose updates apply in sequence, a move can be applied as a removal from the previous index followed by an insertion at the current one. */
+@interface MPLiveObjectCollectionChange : NSObject
+
+@property (readonly, nonnull) NSArray<__kindof MPManagedObject *> *previousObjects;
+@property (readonly, nonnull) NSArray<__kindof MPManagedObject *> *objects;
+
+@property (readonly, nonnull) NSIndexSet *removedIndexes;
+@property (readonly, nonnull) NSIndexSet *insertedIndexes;
+
+/** The current index of each moved object, by its previous index. */
+@property (readonly, nonnull) NSDictionary<NSNumber *, NSNumber *> *movedIndexes;
+
+/** Indexes of objects which were updated without moving, whose rows need reloading. */
+@property (readonly, nonnull) NSIndexSet *updatedIndexes;
+
+/** YES if there are no changes. */
+@property (readonly, getter=isEmpty) BOOL empty;
+
+@end
+
+/** A sorted collection of the objects matching a view query, kept up to date with the batch changes of the objects controller
+  * (MPManagedObjectsControllerDidChangeObjectsNotification) without running the query again:
+  * only the changed objects are removed and reinserted at their sorted positions, and the affected indexes published.
+  *
+  * The objects are initially those returned by the view query that pass the filter. After that membership is decided by the filter alone,
+  * which therefore needs to agree with the view's map function for the queried keys. Changes are applied on the main thread. */
+@interface MPLiveObjectCollection : NSObject
+
+/** @param controller The controller whose objects the collection contains.
+  * @param view The view to query for the initial objects, or nil for all the objects of the controller.
+  * @param keys The keys to query the view with, or nil for all rows.
+  * @param filter Decides whether an added or updated object belongs to the collection, nil accepting all the objects of the controller.
+  * @param comparator The sort order of the objects. */
+- (nonnull instancetype)initWithController:(nonnull MPManagedObjectsController *)controller
+                                      view:(nullable NSString *)view
+                                      keys:(nullable NSArray *)keys
+                                    filter:(nullable MPLiveObjectCollectionFilter)filter
+                                comparator:(nonnull NSComparator)comparator NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly, weak, nullable) MPManagedObjectsController *controller;
+@property (readonly, copy, nullable) NSString *view;
+@property (readonly, copy, nullable) NSArray *keys;
+
+/** The objects of the collection in sort order. */
+@property (readonly, nonnull) NSArray<__kindof MPManagedObject *> *objects;
+
+/** Called on the main thread after each change, before MPLiveObjectCollectionDidChangeNotification is posted. */
+@property (copy, nullable) void (^changeHandler)(MPLiveObjectCollection *_Nonnull collection, MPLiveObjectCollectionChange *_Nonnull change);
+
+/** Applies changes to the collection and publishes them, returning the change.
+  * Called for each batch change of the controller; objects of other controllers are ignored. */
+- (nonnull MPLiveObjectCollectionChange *)applyAddedObjects:(nonnull NSArray<__kindof MPManagedObject *> *)addedObjects
+                                             updatedObjects:(nonnull NSArray<__kindof MPManagedObject *> *)updatedObjects
+                                             removedObjects:(nonnull NSArray<__kindof MPManagedObject *> *)removedObjects;
+
+/** Runs the view query again, replacing all the objects. */
+- (nonnull MPLiveObjectCollectionChange *)reload;
+
+@end
@@ -0,0 +1,270 @@
+//
+//  MPLiveObjectCollection.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPLiveObjectCollection.h"
+
+#import "MPManagedObject.h"
+#import "MPManagedObjectsController.h"
+#import "MPDatabasePackageController.h"
+
+NSString * const MPLiveObjectCollectionDidChangeNotification = @"MPLiveObjectCollectionDidChangeNotification";
+
+NSString * const MPLiveObjectCollectionChangeKey = @"change";
+
+@implementation MPLiveObjectCollectionChange
+
+- (instancetype)initWithPreviousObjects:(NSArray *)previousObjects
+                                objects:(NSArray *)objects
+                         removedIndexes:(NSIndexSet *)removedIndexes
+                        insertedIndexes:(NSIndexSet *)insertedIndexes
+                           movedIndexes:(NSDictionary<NSNumber *, NSNumber *> *)movedIndexes
+                         updatedIndexes:(NSIndexSet *)updatedIndexes
+{
+    if (self = [super init])
+    {
+        _previousObjects = previousObjects;
+        _objects = objects;
+        _removedIndexes = [removedIndexes copy];
+        _insertedIndexes = [insertedIndexes copy];
+        _movedIndexes = [movedIndexes copy];
+        _updatedIndexes = [updatedIndexes copy];
+    }
+
+    return self;
+}
+
+- (BOOL)isEmpty
+{
+    return _removedIndexes.count == 0 && _insertedIndexes.count == 0 && _movedIndexes.count == 0 && _updatedIndexes.count == 0;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p removed:%@ inserted:%@ moved:%@ updated:%@>",
+            self.class, self, _removedIndexes, _insertedIndexes, _movedIndexes, _updatedIndexes];
+}
+
+@end
+
+@interface MPLiveObjectCollection ()
+@property (readwrite, nonnull) NSArray *objects;
+@property (readonly, copy) MPLiveObjectCollectionFilter filter;
+@property (readonly, copy) NSComparator comparator;
+@end
+
+@implementation MPLiveObjectCollection
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithController:(MPManagedObjectsController *)controller
+                              view:(NSString *)view
+                              keys:(NSArray *)keys
+                            filter:(MPLiveObjectCollectionFilter)filter
+                        comparator:(NSComparator)comparator
+{
+    NSParameterAssert(controller);
+    NSParameterAssert(comparator);
+
+    if (self = [super init])
+    {
+        _controller = controller;
+        _view = [view copy];
+        _keys = [keys copy];
+        _filter = [filter copy];
+        _comparator = [comparator copy];
+        _objects = [self queriedObjects];
+
+        [[controller.packageController notificationCenter] addObserver:self
+                                                              selector:@selector(didChangeObjects:)
+                                                                  name:MPManagedObjectsControllerDidChangeObjectsNotification
+                                                                object:controller];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [[_controller.packageController notificationCenter] removeObserver:self];
+}
+
+- (NSArray *)queriedObjects
+{
+    MPManagedObjectsController *controller = _controller;
+    NSArray *objs = _view ? [controller objectsMatchingQueriedView:_view keys:_keys] : controller.allObjects;
+
+    NSMutableArray *members = [NSMutableArray arrayWithCapacity:objs.count];
+    for (MPManagedObject *mo in objs) {
+        if (!_filter || _filter(mo))
+            [members addObject:mo];
+    }
+
+    [members sortWithOptions:NSSortStable usingComparator:_comparator];
+    return [members copy];
+}
+
+- (void)didChangeObjects:(NSNotification *)notification
+{
+    MPManagedObjectsBatchChange *batchChange = notification.userInfo[MPManagedObjectsBatchChangeKey];
+
+    // objects changed before being loaded are not members yet, but may have become ones.
+    NSArray *addedObjects = batchChange.addedObjects;
+    if (batchChange.unloadedObjectIdentifiers.count > 0)
+        addedObjects = [addedObjects arrayByAddingObjectsFromArray:
+                        [_controller.packageController objectsWithIdentifiers:batchChange.unloadedObjectIdentifiers]];
+
+    [self applyAddedObjects:addedObjects
+             updatedObjects:batchChange.updatedObjects
+             removedObjects:batchChange.removedObjects];
+}
+
+- (MPLiveObjectCollectionChange *)reload
+{
+    NSParameterAssert([NSThread isMainThread]);
+
+    NSArray *previousObjects = self.objects;
+    self.objects = [self queriedObjects];
+
+    MPLiveObjectCollectionChange *change
+        = [[MPLiveObjectCollectionChange alloc] initWithPreviousObjects:previousObjects
+                                                                objects:self.objects
+                                                         removedIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, previousObjects.count)]
+                                                        insertedIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, self.objects.count)]
+                                                           movedIndexes:@{}
+                                                         updatedIndexes:[NSIndexSet indexSet]];
+    [self publishChange:change];
+    return change;
+}
+
+- (MPLiveObjectCollectionChange *)applyAddedObjects:(NSArray *)addedObjects
+                                     updatedObjects:(NSArray *)updatedObjects
+                                     removedObjects:(NSArray *)removedObjects
+{
+    NSParameterAssert([NSThread isMainThread]);
+    NSParameterAssert(addedObjects && updatedObjects && removedObjects);
+
+    MPManagedObjectsController *controller = _controller;
+
+    // whether each changed object belongs to the collection after the change, by identity.
+    NSMapTable<MPManagedObject *, NSNumber *> *membership = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality
+                                                                                  valueOptions:NSPointerFunctionsStrongMemory];
+    for (MPManagedObject *mo in removedObjects) {
+        if (mo.controller == controller)
+            [membership setObject:@NO forKey:mo];
+    }
+
+    for (NSArray *objs in @[ addedObjects, updatedObjects ]) {
+        for (MPManagedObject *mo in objs) {
+            if (mo.controller == controller && ![membership objectForKey:mo])
+                [membership setObject:@(!mo.document.isDeleted && (!_filter || _filter(mo))) forKey:mo];
+        }
+    }
+
+    NSArray *previousObjects = self.objects;
+
+    // one pass to find the previous indexes of the changed objects and keep the others, which remain sorted.
+    NSMapTable<MPManagedObject *, NSNumber *> *previousIndexes = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality
+                                                                                       valueOptions:NSPointerFunctionsStrongMemory];
+    NSMutableArray *objs = [NSMutableArray arrayWithCapacity:previousObjects.count + addedObjects.count];
+    NSMutableIndexSet *changedPreviousIndexes = [NSMutableIndexSet indexSet];
+    NSMutableIndexSet *removedIndexes = [NSMutableIndexSet indexSet];
+
+    [previousObjects enumerateObjectsUsingBlock:^(MPManagedObject *mo, NSUInteger i, BOOL *stop) {
+        NSNumber *isMember = [membership objectForKey:mo];
+        if (!isMember) {
+            [objs addObject:mo];
+            return;
+        }
+
+        [previousIndexes setObject:@(i) forKey:mo];
+        [changedPreviousIndexes addIndex:i];
+        if (!isMember.boolValue)
+            [removedIndexes addIndex:i];
+    }];
+
+    // the changed objects are reinserted at their sorted positions, as their sort keys may have changed.
+    NSHashTable<MPManagedObject *> *changedMembers = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+    for (MPManagedObject *mo in membership) {
+        if (![[membership objectForKey:mo] boolValue])
+            continue;
+
+        [changedMembers addObject:mo];
+        NSUInteger i = [objs indexOfObject:mo
+                             inSortedRange:NSMakeRange(0, objs.count)
+                                   options:NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual
+                           usingComparator:_comparator];
+        [objs insertObject:mo atIndex:i];
+    }
+
+    NSMutableIndexSet *insertedIndexes = [NSMutableIndexSet indexSet];
+    NSMutableIndexSet *updatedIndexes = [NSMutableIndexSet indexSet];
+    NSMutableDictionary<NSNumber *, NSNumber *> *movedIndexes = [NSMutableDictionary dictionary];
+
+    // an object that was already a member stays in place if it is in the same gap between unchanged objects as before,
+    // and in the same order as the other objects staying in place there; otherwise it has moved.
+    NSUInteger unchangedCount = 0;
+    NSUInteger lastPreviousIndex = NSNotFound;
+    NSUInteger lastGap = NSNotFound;
+
+    for (NSUInteger i = 0; i < objs.count; i++) {
+        MPManagedObject *mo = objs[i];
+        if (![changedMembers containsObject:mo]) {
+            unchangedCount++;
+            continue;
+        }
+
+        NSNumber *previousIndex = [previousIndexes objectForKey:mo];
+        if (!previousIndex) {
+            [insertedIndexes addIndex:i];
+            continue;
+        }
+
+        // the number of unchanged objects before the object's previous index.
+        NSUInteger previousGap = previousIndex.unsignedIntegerValue
+            - [changedPreviousIndexes countOfIndexesInRange:NSMakeRange(0, previousIndex.unsignedIntegerValue)];
+
+        BOOL inOrder = lastGap != unchangedCount || lastPreviousIndex == NSNotFound || lastPreviousIndex < previousIndex.unsignedIntegerValue;
+        if (previousGap == unchangedCount && inOrder) {
+            [updatedIndexes addIndex:i];
+            lastGap = unchangedCount;
+            lastPreviousIndex = previousIndex.unsignedIntegerValue;
+        }
+        else {
+            movedIndexes[previousIndex] = @(i);
+        }
+    }
+
+    self.objects = [objs copy];
+
+    MPLiveObjectCollectionChange *change = [[MPLiveObjectCollectionChange alloc] initWithPreviousObjects:previousObjects
+                                                                                                 objects:self.objects
+                                                                                          removedIndexes:removedIndexes
+                                                                                         insertedIndexes:insertedIndexes
+                                                                                            movedIndexes:movedIndexes
+                                                                                          updatedIndexes:updatedIndexes];
+    if (!change.isEmpty)
+        [self publishChange:change];
+
+    return change;
+}
+
+- (void)publishChange:(MPLiveObjectCollectionChange *)change
+{
+    if (self.changeHandler)
+        self.changeHandler(self, change);
+
+    [[_controller.packageController notificationCenter] postNotificationName:MPLiveObjectCollectionDidChangeNotification
+                                                                      object:self
+                                                                    userInfo:@{ MPLiveObjectCollectionChangeKey : change }];
+}
+
+@end
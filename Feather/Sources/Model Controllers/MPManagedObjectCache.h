@@ -0,0 +1,63 @@
+//
+//  MPManagedObjectCache.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MPManagedObject;
+
+/** A cache policy for the managed objects registered with a MPManagedObjectsController.
+  * Whichever policy is used, a registered object must be returned for its identifier for as long as the instance is alive
+  * (there is at most one managed object instance per document ID). */
+@protocol MPManagedObjectCachePolicy <NSObject>
+
+/** The object registered for the identifier, or nil if there is none alive. */
+- (nullable __kindof MPManagedObject *)objectForIdentifier:(nonnull NSString *)identifier;
+
+- (void)registerObject:(nonnull MPManagedObject *)object forIdentifier:(nonnull NSString *)identifier;
+
+/** Removes the object if it is the one registered for the identifier. */
+- (void)deregisterObject:(nonnull MPManagedObject *)object forIdentifier:(nonnull NSString *)identifier;
+
+/** Called when an object has become dirty or has been saved, with its needsSave state already updated. */
+- (void)objectNeedsSaveDidChange:(nonnull MPManagedObject *)object;
+
+/** Drops all strong references held by the cache. Objects still alive remain registered. */
+- (void)evictAllObjects;
+
+/** The registered objects with unsaved changes. */
+@property (readonly, nonnull) NSArray<MPManagedObject *> *dirtyObjects;
+
+/** The number of registered objects still alive. */
+@property (readonly) NSUInteger count;
+
+@property (readonly) NSUInteger hitCount;
+@property (readonly) NSUInteger missCount;
+@property (readonly) NSUInteger evictionCount;
+
+@end
+
+/** The default object cache policy:
+  * - every registered object is referenced weakly, which guarantees identity for as long as the object is alive.
+  * - dirty objects (needsSave = YES) are referenced strongly until they are saved.
+  * - the most recently used clean objects are referenced strongly, up to countLimit of them, and the least recently used ones evicted. */
+@interface MPManagedObjectCache : NSObject <MPManagedObjectCachePolicy>
+
+/** @param countLimit The maximum number of clean objects held strongly. 0 means no limit (no clean object is evicted). */
+- (nonnull instancetype)initWithCountLimit:(NSUInteger)countLimit NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly) NSUInteger countLimit;
+
+/** The number of clean objects currently held strongly. */
+@property (readonly) NSUInteger strongCount;
+
+/** The number of dirty objects currently held strongly. */
+@property (readonly) NSUInteger dirtyCount;
+
+@end
@@ -0,0 +1,295 @@
+//
+//  MPManagedObjectCache.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPManagedObjectCache.h"
+#import "MPManagedObject.h"
+
+/** A clean object held strongly, linked in least to most recently used order. */
+@interface MPManagedObjectCacheEntry : NSObject
+{
+@public
+    NSString *_identifier;
+    MPManagedObject *_object;
+    __unsafe_unretained MPManagedObjectCacheEntry *_previous;
+    MPManagedObjectCacheEntry *_next;
+}
+@end
+
+@implementation MPManagedObjectCacheEntry
+@end
+
+@interface MPManagedObjectCache ()
+{
+    /** Every registered object, for identity. */
+    NSMapTable<NSString *, MPManagedObject *> *_registeredObjects;
+
+    /** Dirty objects, held until they are saved. */
+    NSMutableDictionary<NSString *, MPManagedObject *> *_dirtyObjects;
+
+    /** Clean objects held strongly, by identifier. */
+    NSMutableDictionary<NSString *, MPManagedObjectCacheEntry *> *_recentEntries;
+
+    /** The least recently used of _recentEntries, which holds the rest through their _next references. */
+    MPManagedObjectCacheEntry *_leastRecentEntry;
+
+    /** The most recently used of _recentEntries. */
+    __unsafe_unretained MPManagedObjectCacheEntry *_mostRecentEntry;
+}
+
+@property (readwrite) NSUInteger hitCount;
+@property (readwrite) NSUInteger missCount;
+@property (readwrite) NSUInteger evictionCount;
+
+@end
+
+@implementation MPManagedObjectCache
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit
+{
+    if (self = [super init])
+    {
+        _countLimit = countLimit;
+        _registeredObjects = [NSMapTable strongToWeakObjectsMapTable];
+        _dirtyObjects = [NSMutableDictionary dictionaryWithCapacity:64];
+        _recentEntries = [NSMutableDictionary dictionaryWithCapacity:MIN(countLimit, 1000)];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    // unlinked one at a time, so that a long list is not released recursively.
+    while (_leastRecentEntry)
+        _leastRecentEntry = _leastRecentEntry->_next;
+}
+
+- (MPManagedObject *)objectForIdentifier:(NSString *)identifier
+{
+    NSParameterAssert(identifier);
+
+    @synchronized (self) {
+        MPManagedObject *mo = [_registeredObjects objectForKey:identifier];
+
+        if (!mo) {
+            _missCount++;
+            return nil;
+        }
+
+        _hitCount++;
+
+        if (!_dirtyObjects[identifier])
+            [self touchCleanObject:mo forIdentifier:identifier];
+
+        return mo;
+    }
+}
+
+- (void)registerObject:(MPManagedObject *)object forIdentifier:(NSString *)identifier
+{
+    NSParameterAssert(object);
+    NSParameterAssert(identifier);
+
+    @synchronized (self) {
+        MPManagedObject *existingObject = [_registeredObjects objectForKey:identifier];
+        if (existingObject && existingObject != object) {
+            // a different instance for the same document is replacing the registered one.
+            [self forgetIdentifier:identifier];
+        }
+
+        [_registeredObjects setObject:object forKey:identifier];
+        [self updateObject:object forIdentifier:identifier];
+    }
+}
+
+- (void)deregisterObject:(MPManagedObject *)object forIdentifier:(NSString *)identifier
+{
+    NSParameterAssert(identifier);
+
+    @synchronized (self) {
+        // the weak reference is already nil if the object is being deallocated.
+        MPManagedObject *registeredObject = [_registeredObjects objectForKey:identifier];
+        if (registeredObject && registeredObject != object)
+            return;
+
+        [_registeredObjects removeObjectForKey:identifier];
+        [self forgetIdentifier:identifier];
+    }
+}
+
+- (void)objectNeedsSaveDidChange:(MPManagedObject *)object
+{
+    NSString *identifier = object.document.documentID;
+    if (!identifier)
+        return;
+
+    @synchronized (self) {
+        if ([_registeredObjects objectForKey:identifier] != object)
+            return;
+
+        [self updateObject:object forIdentifier:identifier];
+    }
+}
+
+- (void)evictAllObjects
+{
+    @synchronized (self) {
+        _evictionCount += _recentEntries.count;
+        [_recentEntries removeAllObjects];
+
+        // unlinked one at a time, so that a long list is not released recursively.
+        while (_leastRecentEntry)
+            _leastRecentEntry = _leastRecentEntry->_next;
+        _mostRecentEntry = nil;
+    }
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self) {
+        // NSMapTable's count includes entries whose weak value has been zeroed.
+        NSUInteger count = 0;
+        for (NSString *identifier in _registeredObjects) {
+            if ([_registeredObjects objectForKey:identifier])
+                count++;
+        }
+        return count;
+    }
+}
+
+- (NSUInteger)strongCount
+{
+    @synchronized (self) {
+        return _recentEntries.count;
+    }
+}
+
+- (NSUInteger)dirtyCount
+{
+    @synchronized (self) {
+        return _dirtyObjects.count;
+    }
+}
+
+- (NSArray<MPManagedObject *> *)dirtyObjects
+{
+    @synchronized (self) {
+        return _dirtyObjects.allValues;
+    }
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p limit:%lu strong:%lu dirty:%lu hits:%lu misses:%lu evictions:%lu>",
+            self.class, self, _countLimit, self.strongCount, self.dirtyCount, self.hitCount, self.missCount, self.evictionCount];
+}
+
+#pragma mark - Tiers (called with the lock held)
+
+- (void)updateObject:(MPManagedObject *)object forIdentifier:(NSString *)identifier
+{
+    if (object.needsSave) {
+        [self removeRecentEntryForIdentifier:identifier];
+        _dirtyObjects[identifier] = object;
+    }
+    else {
+        [_dirtyObjects removeObjectForKey:identifier];
+        [self touchCleanObject:object forIdentifier:identifier];
+    }
+}
+
+- (void)touchCleanObject:(MPManagedObject *)object forIdentifier:(NSString *)identifier
+{
+    MPManagedObjectCacheEntry *entry = _recentEntries[identifier];
+    if (entry) {
+        // move to the most recently used end.
+        if (entry != _mostRecentEntry) {
+            [self unlinkEntry:entry];
+            [self appendEntry:entry];
+        }
+        return;
+    }
+
+    entry = [MPManagedObjectCacheEntry new];
+    entry->_identifier = identifier;
+    entry->_object = object;
+    _recentEntries[identifier] = entry;
+    [self appendEntry:entry];
+
+    while (_countLimit > 0 && _recentEntries.count > _countLimit) {
+        MPManagedObjectCacheEntry *evictedEntry = _leastRecentEntry;
+        NSString *evictedIdentifier = evictedEntry->_identifier;
+        MPManagedObject *evictedObject = evictedEntry->_object;
+
+        [self unlinkEntry:evictedEntry];
+        [_recentEntries removeObjectForKey:evictedIdentifier];
+
+        // an object which became dirty without the cache being told is kept rather than dropped.
+        if (evictedObject.needsSave)
+            _dirtyObjects[evictedIdentifier] = evictedObject;
+        else
+            _evictionCount++;
+    }
+}
+
+- (void)forgetIdentifier:(NSString *)identifier
+{
+    [_dirtyObjects removeObjectForKey:identifier];
+    [self removeRecentEntryForIdentifier:identifier];
+}
+
+- (void)removeRecentEntryForIdentifier:(NSString *)identifier
+{
+    MPManagedObjectCacheEntry *entry = _recentEntries[identifier];
+    if (!entry)
+        return;
+
+    [self unlinkEntry:entry];
+    [_recentEntries removeObjectForKey:identifier];
+}
+
+- (void)appendEntry:(MPManagedObjectCacheEntry *)entry
+{
+    entry->_previous = _mostRecentEntry;
+    entry->_next = nil;
+
+    if (_mostRecentEntry)
+        _mostRecentEntry->_next = entry;
+    else
+        _leastRecentEntry = entry;
+
+    _mostRecentEntry = entry;
+}
+
+- (void)unlinkEntry:(MPManagedObjectCacheEntry *)entry
+{
+    // the entry is kept alive by _recentEntries while its neighbours' references to it are replaced.
+    MPManagedObjectCacheEntry *previous = entry->_previous;
+    MPManagedObjectCacheEntry *next = entry->_next;
+
+    if (previous)
+        previous->_next = next;
+    else
+        _leastRecentEntry = next;
+
+    if (next)
+        next->_previous = previous;
+    else
+        _mostRecentEntry = previous;
+
+    entry->_previous = nil;
+    entry->_next = nil;
+}
+
+@end
@@ -0,0 +1,98 @@
+//
+//  MPManagedObjectsController+Async.swift
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright © 2026 Matias Piipari. All rights reserved.
+//
+
+import Foundation
+
+/** Holds the request of a task so that cancelling the task cancels the request, whichever of the two happens first. */
+private final class AsyncRequestBox {
+    private let lock = NSLock()
+    private var request: MPAsyncRequest?
+    private var cancelled = false
+
+    func setRequest(_ request: MPAsyncRequest) {
+        lock.lock()
+        self.request = request
+        let cancelled = self.cancelled
+        lock.unlock()
+
+        if cancelled {
+            request.cancel()
+        }
+    }
+
+    func cancel() {
+        lock.lock()
+        cancelled = true
+        let request = self.request
+        lock.unlock()
+
+        request?.cancel()
+    }
+}
+
+/** Awaits a request started with a completion handler, cancelling it if the task is cancelled. */
+@available(macOS 10.15, *)
+private func awaitRequest<T>(_ start: (@escaping (T?, Error?) -> Void) -> MPAsyncRequest) async throws -> T? {
+    let box = AsyncRequestBox()
+    return try await withTaskCancellationHandler(operation: {
+        try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<T?, Error>) in
+            box.setRequest(start { result, error in
+                if let error = error {
+                    continuation.resume(throwing: error)
+                } else {
+                    continuation.resume(returning: result)
+                }
+            })
+        }
+    }, onCancel: {
+        box.cancel()
+    })
+}
+
+@available(macOS 10.15, *)
+public extension MPManagedObjectsController {
+
+    /** Async equivalent of allObjects(), run off the main thread. */
+    func fetchAllObjects() async throws -> [MPManagedObject] {
+        return try await awaitRequest { self.fetchAllObjects(withCompletionQueue: nil, completionHandler: $0) } ?? []
+    }
+
+    func fetchObjects(withTitle title: String) async throws -> [MPManagedObject] {
+        return try await awaitRequest { self.fetchObjects(withTitle: title, completionQueue: nil, completionHandler: $0) } ?? []
+    }
+
+    func fetchObjects(matchingQueriedView view: String, keys: [Any]? = nil, options: MPQueryOptions = []) async throws -> [MPManagedObject] {
+        return try await awaitRequest {
+            self.fetchObjectsMatchingQueriedView(view, keys: keys, options: options, completionQueue: nil, completionHandler: $0)
+        } ?? []
+    }
+
+    func fetchObject(withIdentifier identifier: String) async throws -> MPManagedObject? {
+        return try await awaitRequest { self.fetchObject(withIdentifier: identifier, completionQueue: nil, completionHandler: $0) }
+    }
+}
+
+@available(macOS 10.15, *)
+public extension MPManagedObject {
+
+    /** Async equivalent of save(), with the write made off the main thread. Must be called on the main actor. */
+    @MainActor
+    func saveInBackground() async throws {
+        _ = try await awaitRequest { (handler: @escaping (Bool?, Error?) -> Void) in
+            self.save(withCompletionQueue: nil) { success, error in handler(success, error) }
+        }
+    }
+
+    /** Async equivalent of deleteDocument(), with the deletion made off the main thread. */
+    @MainActor
+    func deleteInBackground() async throws {
+        _ = try await awaitRequest { (handler: @escaping (Bool?, Error?) -> Void) in
+            self.delete(withCompletionQueue: nil) { success, error in handler(success, error) }
+        }
+    }
+}
@@ -20,13 +20,59 @@
 
 - (void)didUpdateObject:(MPManagedObject *)object;
 
+/** Called before the controller's objects are saved as part of -[MPDatabasePackageController performBatchUpdates:error:].
+  * The default implementation calls -willSaveObject: for each object. */
+- (void)willSaveObjects:(NSArray<MPManagedObject *> *)objects;
+
+/** Called after the controller's objects were saved as part of -[MPDatabasePackageController performBatchUpdates:error:], in place of -didSaveObject: and -didUpdateObject:.
+  * The default implementation clears the controller's cached values, and if the package controller -postsPerObjectChangeNotifications,
+  * posts the recent and past change notifications of each object as -didSaveObject: and -didUpdateObject: do.
+  * The change count is updated once for the batch rather than per object. */
+- (void)didSaveObjects:(MPManagedObjectsBatchChange *)batchChange;
+
 - (void)willDeleteObject:(MPManagedObject *)object;
 - (void)didDeleteObject:(MPManagedObject *)object;
 
+/** Called on the database's queue before the current revision of an object is deleted, for the controller to update objects depending on it.
+  * Returning NO fails the deletion. The default implementation returns YES. */
+- (BOOL)prepareToDeleteObject:(MPManagedObject *)object error:(NSError **)err;
+
 - (void)didChangeDocument:(CBLDocument *)doc forObject:(MPManagedObject *)object source:(MPManagedObjectChangeSource)source;
 - (void)didLoadObjectFromDocument:(MPManagedObject *)object;
 
 - (void)registerObject:(MPManagedObject *)mo;
 - (void)deregisterObject:(MPManagedObject *)mo;
 
+/** Called by a managed object when it has become dirty or has been saved. */
+- (void)objectNeedsSaveDidChange:(MPManagedObject *)mo;
+
+/** The object registered with the controller for the identifier, without touching the database. */
+- (MPManagedObject *)cachedObjectWithIdentifier:(NSString *)identifier;
+
+/** Fetches the non-deleted objects with the given identifiers from the controller's database with a single prefetching query.
+  * The identifiers can be of any managed object class stored in the same database. */
+- (NSDictionary<NSString *, MPManagedObject *> *)fetchedObjectsByIdentifierForIdentifiers:(NSArray<NSString *> *)identifiers;
+
+/** Fetches objects with the given identifiers from the shared package controller, if the controller -relaysFetchingByIdentifier. */
+- (NSDictionary<NSString *, MPManagedObject *> *)relayedObjectsByIdentifierForIdentifiers:(NSArray<NSString *> *)identifiers;
+
+/** The change type for a change to a document, based on its current revision. */
+- (MPChangeType)changeTypeForDocument:(CBLDocument *)doc;
+
+/** Called on the main queue with the coalesced database changes to the controller's objects, before MPManagedObjectsControllerDidChangeObjectsNotification is posted.
+  * The default implementation clears cached values if objects were added or removed. */
+- (void)didChangeObjects:(MPManagedObjectsBatchChange *)batchChange;
+
+@end
+
+@interface MPManagedObjectsBatchChange (Protected)
+
+- (instancetype)initWithController:(MPManagedObjectsController *)controller;
+
+/** Coalesces a change to an object with the changes already in the batch. */
+- (void)addObject:(MPManagedObject *)object changeType:(MPChangeType)changeType source:(MPManagedObjectChangeSource)source;
+
+/** Records a change to an object which has not been loaded, without loading it. */
+- (void)addUnloadedObjectWithIdentifier:(NSString *)identifier source:(MPManagedObjectChangeSource)source;
+
 @end
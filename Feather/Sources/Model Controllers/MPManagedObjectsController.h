@@ -9,6 +9,9 @@
 #import <Foundation/Foundation.h>
 
 #import "MPCacheable.h"
+#import "MPManagedObjectCache.h"
+#import "MPQueryResultCache.h"
+#import "MPAsyncRequest.h"
 #import "NSNotificationCenter+MPManagedObjectExtensions.h"
 
 @import CouchbaseLite;
@@ -18,11 +21,36 @@ extern NSString *_Nonnull const MPManagedObjectsControllerErrorDomain;
 /** A notification that is posted with the objects controller as the object whenever bundled resources have been finished loading. */
 extern NSString *_Nonnull const MPManagedObjectsControllerLoadedBundledResourcesNotification;
 
+/** A notification posted to the package controller's notification center with the objects controller as the object,
+  * at most once per coalescing window, when objects managed by the controller have changed in its database.
+  * The changes are found in the user info dictionary under MPManagedObjectsBatchChangeKey. */
+extern NSString *_Nonnull const MPManagedObjectsControllerDidChangeObjectsNotification;
+
+/** User info key for the MPManagedObjectsBatchChange of a MPManagedObjectsControllerDidChangeObjectsNotification. */
+extern NSString *_Nonnull const MPManagedObjectsBatchChangeKey;
+
+/** The default number of objects saved per batch by -importObjectsFromContentsOfArrayJSONAtURL:batchSize:progressHandler:error: (500). */
+extern const NSUInteger MPManagedObjectsControllerDefaultImportBatchSize;
+
+/** Progress of a streaming import: the number of objects saved so far, and the fraction of the input processed.
+  * Set *stop to YES to stop the import after the current batch. */
+typedef void (^MPManagedObjectsImportProgressHandler)(NSUInteger importedObjectCount, double fractionCompleted, BOOL *_Nonnull stop);
+
+/** Options for querying a view. */
+typedef NS_OPTIONS(NSUInteger, MPQueryOptions)
+{
+    MPQueryOptionsNone = 0,
+    /** Return the rows already in the view's index without indexing changes first, and update the index in the background afterwards (kCBLUpdateIndexAfter).
+      * Avoids blocking on an index which is still being built, at the cost of possibly missing the most recent changes. */
+    MPQueryOptionsAllowStale = 1 << 0
+};
+
 typedef enum MPManagedObjectsControllerErrorCode
 {
     MPManagedObjectsControllerErrorCodeUnknown = 0,
     MPManagedObjectsControllerErrorCodeInvalidJSON = 1,
-    MPManagedObjectsControllerErrorCodeFailedTempFileCreation = 2
+    MPManagedObjectsControllerErrorCodeFailedTempFileCreation = 2,
+    MPManagedObjectsControllerErrorCodeNoSuchView = 3
 } MPManagedObjectsControllerErrorCode;
 
 @class MPDatabase;
@@ -33,7 +61,7 @@ typedef enum MPManagedObjectsControllerErrorCode
 @class CBLQueryEnumerator;
 
 /** An abstract base class for controllers of MPManagedObject instances. 
- * - Caches managed objects strongly.
+ * - Caches managed objects: weakly when clean (with the most recently used ones held strongly), strongly when dirty.
  * - allows querying and creating new managed objects of a certain type
  * - deserialises managed objects from their JSON representation
  * - resolves conflicting managed object revision arising from replication. 
@@ -63,7 +91,27 @@ typedef enum MPManagedObjectsControllerErrorCode
 /** A weak backpointer to the database package controller of this object (the database controller is a subclass of MPDatabasePackageController). */
 @property (readonly, weak, nullable) __kindof MPDatabasePackageController *packageController;
 
-/** Returns YES if objects of the +managedObjectClass in this controller's database should be automatically saved upon changing. Overload in a subclass to provide autosaving upon change (default: NO). */
+/** The cache of managed objects registered with the controller, with its hit, miss and eviction counters. */
+@property (readonly, strong, nonnull) id<MPManagedObjectCachePolicy> objectCache;
+
+/** The maximum number of clean objects held strongly by the controller's object cache (default: 1000, 0 meaning no limit).
+  * Overload in a subclass to change the limit. */
+@property (readonly) NSUInteger objectCacheCountLimit;
+
+/** Creates the object cache of the controller, called once during initialization. 
+  * Overload in a subclass to provide a different cache policy (default: a MPManagedObjectCache with -objectCacheCountLimit). */
+- (nonnull id<MPManagedObjectCachePolicy>)newObjectCache;
+
+/** The cache of -objectsMatchingQueriedView:keys: results, with its hit, miss and eviction counters.
+  * Cached results hold their objects strongly. */
+@property (readonly, strong, nonnull) MPQueryResultCache *queryResultCache;
+
+/** The maximum number of query results held by the controller's query result cache (default: 100, 0 meaning no limit).
+  * Overload in a subclass to change the limit. */
+@property (readonly) NSUInteger queryResultCacheCountLimit;
+
+/** Returns YES if objects of the +managedObjectClass in this controller's database should be automatically saved upon changing. Overload in a subclass to provide autosaving upon change (default: NO).
+  * Changed objects are saved together with those of other controllers by the package controller's autosaveScheduler. */
 @property (readonly) BOOL autosavesObjects;
 
 /** Returns YES if objects managed by this controller receive notifications for changes (default: YES). Note that you do not need to implement the -didAdd...:, -didUpdate...:, -didRemove...: methods for MPManagedObjectsController subclasses, those are created for you automatically. */
@@ -162,15 +210,24 @@ typedef enum MPManagedObjectsControllerErrorCode
   * (you can run code dependent on other managed objects controller here). */
 - (BOOL)didInitialize:(NSError *__autoreleasing __nonnull *__nonnull)err;
 
-/** Configure the design document of this controller. Can (and commonly is) overloaded by subclasses, but not to be called manually. */
+/** Configure the design document of this controller. Can (and commonly is) overloaded by subclasses, but not to be called manually.
+  * Views are best defined with -viewNamed:setMapBlock:version: or -[MPDatabase defineViewNamed:mapBlock:reduceBlock:version:],
+  * which defer creating them until they are first queried. */
 - (void)configureViews __attribute__((objc_requires_super));
 
+/** Names of views whose indexes the package controller brings up to date in the background after opening the package,
+  * so that their first queries do not need to index the whole database (default: the -allObjectsViewName). */
+@property (readonly, nonnull) NSArray<NSString *> *prewarmedViewNames;
+
 /** Those objects for which userContributed = YES. */
 @property (readonly, strong, nonnull) NSArray<__kindof MPManagedObject *> *userContributedObjects;
 
 /** The name of the view which returns all objects managed by this controller. */
 @property (readonly, copy, nonnull) NSString *allObjectsViewName;
 
+/** The name of the view which emits the objects managed by this controller by their title. */
+@property (readonly, copy, nonnull) NSString *objectsByTitleViewName;
+
 /** A query which returns all objects managed by this controller. */
 - (nonnull CBLQuery *)allObjectsQuery;
 
@@ -180,6 +237,14 @@ typedef enum MPManagedObjectsControllerErrorCode
 /** @return an array of managed objects contained in the query enumerator given as argument. */
 - (nonnull NSArray *)managedObjectsForQueryEnumerator:(nonnull CBLQueryEnumerator *)rows;
 
+/** Streams the managed objects of a query enumerator's rows to a block without collecting them first. 
+  * Objects are materialized in chunks within a single hop to the server queue, on which the block is also called. 
+  * The object passed to the block is nil for rows with no document, or with a deleted document with no model object. */
+- (void)enumerateManagedObjectsForQueryEnumerator:(nonnull CBLQueryEnumerator *)rows
+                                       usingBlock:(nonnull void (^)(CBLQueryRow *_Nonnull row, MPManagedObject *_Nullable object, BOOL *_Nonnull stop))block;
+
+/** Defines a view in the controller's database lazily (see -[MPDatabase defineViewNamed:mapBlock:reduceBlock:version:]).
+  * Query it with a view from -[MPDatabase viewNamed:]. */
 - (void)viewNamed:(nonnull NSString *)name setMapBlock:(nonnull CBLMapBlock)block setReduceBlock:(nullable CBLReduceBlock)reduceBlock version:(nonnull NSString *)version;
 
 - (void)viewNamed:(nonnull NSString *)name setMapBlock:(nonnull CBLMapBlock)block version:(nonnull NSString *)version;
@@ -223,6 +288,12 @@ typedef enum MPManagedObjectsControllerErrorCode
   * from the shared package controller's database from its corresponding managed objects controller if one exists. */
 - (nullable __kindof MPManagedObject *)objectWithIdentifier:(nonnull NSString *)identifier;
 
+/** Batched equivalent of -objectWithIdentifier:. Cached objects are returned directly, and the remaining ones are fetched
+  * with a single prefetching all-documents query against the controller's database (relaying misses to the shared package
+  * controller if -relaysFetchingByIdentifier is YES).
+  * @return The objects found, in the order of the identifiers given as argument. Identifiers with no matching object are skipped. */
+- (nonnull NSArray<__kindof MPManagedObject *> *)objectsWithIdentifiers:(nonnull NSArray<NSString *> *)identifiers;
+
 /** Gets a document by documentID, allowing for depending on the allDocsMode argument for already deleted objects to be returned. */
 - (nullable CBLDocument *)documentWithIdentifier:(nonnull NSString *)identifier allDocsMode:(CBLAllDocsMode)allDocsMode;
 
@@ -237,11 +308,28 @@ typedef enum MPManagedObjectsControllerErrorCode
 /** Objects with the given 'title' field value (meaningless for objects with no title field) */
 - (nonnull NSArray<__kindof MPManagedObject *> *)objectsWithTitle:(nonnull NSString *)title;
 
+/** Objects with the given 'title' field value, or nil if querying them fails. */
+- (nullable NSArray<__kindof MPManagedObject *> *)objectsWithTitle:(nonnull NSString *)title error:(NSError *__nullable *__nullable)error;
+
 /** Loads objects from the contents of an array JSON field. Each record in this array is validated to be a serialized MPManagedObject.
+  * The file is read with -importObjectsFromContentsOfArrayJSONAtURL:batchSize:progressHandler:error:, collecting the saved objects.
   * @param url The URL to load the objects from.
   * @param err An error pointer. */
 - (nullable NSArray<__kindof MPManagedObject *> *)objectsFromContentsOfArrayJSONAtURL:(nonnull NSURL *)url error:(NSError *__nullable *__nullable)err;
 
+/** Imports objects from the contents of an array JSON file with memory use bounded by the batch size rather than the size of the file:
+  * the file is memory mapped, its records deserialized one at a time, and the objects saved in batches.
+  * Objects saved in earlier batches remain saved if a later batch fails.
+  * Each record is validated to be a serialized MPManagedObject, and records with a document ID already seen in the file are skipped.
+  * @param url The URL to load the objects from.
+  * @param batchSize The number of objects saved at a time (0 for MPManagedObjectsControllerDefaultImportBatchSize).
+  * @param progressHandler An optional block called after each saved batch.
+  * @param err An error pointer. */
+- (BOOL)importObjectsFromContentsOfArrayJSONAtURL:(nonnull NSURL *)url
+                                        batchSize:(NSUInteger)batchSize
+                                  progressHandler:(nullable MPManagedObjectsImportProgressHandler)progressHandler
+                                            error:(NSError *__nullable *__nullable)err;
+
 /** Loads objects from JSON data. Each record in the array is validated to be a serialized MPManagedObject. */
 - (nullable NSArray<__kindof MPManagedObject *> *)objectsFromArrayJSONData:(nonnull NSData *)objData error:(NSError *__autoreleasing __nullable * __nullable)err;
 
@@ -260,9 +348,68 @@ typedef enum MPManagedObjectsControllerErrorCode
                                                          dataChecksumMetadataKey:(nonnull NSString *)dataChecksumKey
                                                                            error:(NSError *__nullable __autoreleasing *__nullable)err;
 
-/** Query the given view with the given keys, with object prefetching enabled, and return managed object representations. */
+/** Query the given view with the given keys, with object prefetching enabled, and return managed object representations.
+  * Results are cached in -queryResultCache: while neither the database nor the view's index has changed,
+  * the same array is returned again without running the query. */
 - (nonnull NSArray<__kindof MPManagedObject *> *)objectsMatchingQueriedView:(nonnull NSString *)view keys:(nullable NSArray *)keys;
 
+/** Query the given view with the given keys and options, with object prefetching enabled. Results are cached per options. */
+- (nonnull NSArray<__kindof MPManagedObject *> *)objectsMatchingQueriedView:(nonnull NSString *)view
+                                                                       keys:(nullable NSArray *)keys
+                                                                    options:(MPQueryOptions)options;
+
+#pragma mark -
+#pragma mark Asynchronous fetching
+
+/* The fetches below run on a background queue and deliver their results to the completion handler on the given queue
+ * (the main queue if nil). A fetch identical to one still in flight joins it rather than running again,
+ * so a joining request can be given results read before it was made. Cancelling a request completes it with a
+ * NSUserCancelledError error, and a fetch all of whose requests have been cancelled before it started is not run. */
+
+/** Asynchronous equivalent of -allObjects:. */
+- (nonnull MPAsyncRequest *)fetchAllObjectsWithCompletionQueue:(nullable dispatch_queue_t)queue
+                                             completionHandler:(nonnull void (^)(NSArray<__kindof MPManagedObject *> *_Nullable objects, NSError *_Nullable error))completionHandler;
+
+/** Asynchronous equivalent of -objectsWithTitle:. */
+- (nonnull MPAsyncRequest *)fetchObjectsWithTitle:(nonnull NSString *)title
+                                  completionQueue:(nullable dispatch_queue_t)queue
+                                completionHandler:(nonnull void (^)(NSArray<__kindof MPManagedObject *> *_Nullable objects, NSError *_Nullable error))completionHandler;
+
+/** Asynchronous equivalent of -objectsMatchingQueriedView:keys:options:. Completes with an error if there is no such view. */
+- (nonnull MPAsyncRequest *)fetchObjectsMatchingQueriedView:(nonnull NSString *)view
+                                                       keys:(nullable NSArray *)keys
+                                                    options:(MPQueryOptions)options
+                                            completionQueue:(nullable dispatch_queue_t)queue
+                                          completionHandler:(nonnull void (^)(NSArray<__kindof MPManagedObject *> *_Nullable objects, NSError *_Nullable error))completionHandler;
+
+/** Asynchronous equivalent of -objectWithIdentifier:. An object that is not found is not an error: both arguments are nil. */
+- (nonnull MPAsyncRequest *)fetchObjectWithIdentifier:(nonnull NSString *)identifier
+                                      completionQueue:(nullable dispatch_queue_t)queue
+                                    completionHandler:(nonnull void (^)(__kindof MPManagedObject *_Nullable object, NSError *_Nullable error))completionHandler;
+
+@end
+
+/** The coalesced database changes to objects of one managed objects controller. 
+  * An object is listed under at most one change type: an object added and then updated in the same window is listed as added,
+  * and an object removed is listed only as removed. */
+@interface MPManagedObjectsBatchChange : NSObject
+
+@property (readonly, weak, nullable) MPManagedObjectsController *controller;
+
+@property (readonly, nonnull) NSArray<__kindof MPManagedObject *> *addedObjects;
+@property (readonly, nonnull) NSArray<__kindof MPManagedObject *> *updatedObjects;
+@property (readonly, nonnull) NSArray<__kindof MPManagedObject *> *removedObjects;
+
+/** Identifiers of objects added or updated in the database which had not been loaded when the change arrived, and are therefore
+  * not listed as objects (nothing can hold a reference to them). Fetch them with -objectWithIdentifier: if needed. */
+@property (readonly, nonnull) NSArray<NSString *> *unloadedObjectIdentifiers;
+
+/** YES if any of the changes came from outside the process (e.g. replication). */
+@property (readonly) BOOL containsExternalChanges;
+
+/** YES if there are no changes in the batch. */
+@property (readonly, getter=isEmpty) BOOL empty;
+
 @end
 
 @interface CBLDocument (MPManagedObjectExtensions)
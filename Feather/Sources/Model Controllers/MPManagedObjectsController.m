@@ -16,9 +16,12 @@
 #import "MPDatabasePackageController+Protected.h"
 
 #import "NSDictionary+MPManagedObjectExtensions.h"
+#import "NSData+MPExtensions.h"
 
 #import "MPException.h"
 #import "MPDatabase.h"
+#import "MPManagedObjectCache.h"
+#import "MPStartupTracer.h"
 
 #import "MPShoeboxPackageController.h"
 
@@ -35,11 +38,19 @@ NSString * const MPManagedObjectsControllerErrorDomain = @"MPManagedObjectsContr
 
 NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification = @"MPManagedObjectsControllerLoadedBundledResourcesNotification";
 
+NSString * const MPManagedObjectsControllerDidChangeObjectsNotification = @"MPManagedObjectsControllerDidChangeObjectsNotification";
+
+NSString * const MPManagedObjectsBatchChangeKey = @"batchChange";
+
+const NSUInteger MPManagedObjectsControllerDefaultImportBatchSize = 500;
+
 @interface MPManagedObjectsController ()  <CBLReplicationDelegate>
 {
     NSSet *_managedObjectSubclasses;
+    
+    /** Requests waiting on each fetch in flight, keyed by an array describing the fetch. */
+    NSMutableDictionary<NSArray *, NSMutableArray<MPAsyncRequest *> *> *_inFlightFetches;
 }
-@property (readonly, strong) NSMutableDictionary *objectCache;
 
 @property (readonly) BOOL loadingBundledDatabaseResources;
 
@@ -79,7 +90,11 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         _packageController = packageController;
         _db = db;
 
-        _objectCache = [NSMutableDictionary dictionaryWithCapacity:1000];
+        MPStartupTraceSpan *span = [packageController.startupTracer beginSpanNamed:NSStringFromClass(self.class) category:@"controller"];
+
+        _objectCache = [self newObjectCache];
+        _queryResultCache = [[MPQueryResultCache alloc] initWithCountLimit:self.queryResultCacheCountLimit];
+        _inFlightFetches = [NSMutableDictionary new];
 
         [packageController registerManagedObjectsController:self];
 
@@ -111,6 +126,8 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         }
         
         [self implementDefaultScriptObjectAccessor];
+        
+        [span end];
     }
 
     return self;
@@ -159,6 +176,10 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     if ([NSBundle isCommandLineTool] || [NSBundle isXPCService])
         return YES; // Only the main application can set up the shared databases under the group container
     
+    // loading bundled data writes to the database, which a read-only package is opened as it is.
+    if (self.packageController.isReadOnly)
+        return YES;
+    
     // only load bundled data if the database itself is not intended to be started from bootstrapped data.
     if (![self.packageController bootstrapDatabaseURLForDatabaseWithName:self.db.name]) {
         if (![self loadBundledDatabaseResources:error])
@@ -419,29 +440,30 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 - (void)viewNamed:(NSString *)name setMapBlock:(CBLMapBlock)block version:(NSString *)version
 {
     [self.packageController registerViewName:name];
-    [[self.db.database viewNamed:name] setMapBlock:block version:version];
+    [self.db defineViewNamed:name mapBlock:block reduceBlock:nil version:version];
 }
 
 - (void)viewNamed:(NSString *)name setMapBlock:(CBLMapBlock)block setReduceBlock:(CBLReduceBlock)reduceBlock version:(NSString *)version
 {
     [self.packageController registerViewName:name];
-    [[self.db.database viewNamed:name] setMapBlock:block reduceBlock:reduceBlock version:version];
+    [self.db defineViewNamed:name mapBlock:block reduceBlock:reduceBlock version:version];
 }
 
 - (void)configureViews
 {
-    [[self.db.database viewNamed:@"objectsByPrototypeID"]
-     setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+    // views are defined lazily, and only applied to the database when first queried.
+    [self.db defineViewNamed:@"objectsByPrototypeID"
+                    mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
          if (doc[@"prototype"])
              emit(doc[@"prototype"], nil);
          else
              emit([NSNull null], nil);
 
-     } version:@"1.0"];
+     } reduceBlock:nil version:@"1.0"];
     
-    [[self.db.database viewNamed:[self userContributedObjectsViewName]]
-     setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+    [self.db defineViewNamed:[self userContributedObjectsViewName]
+                    mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
          if (![self managesDocumentWithDictionary:doc])
              return;
@@ -451,10 +473,10 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
          }
          
          emit(doc.managedObjectDocumentID, nil);
-     } version:@"1.3"];
+     } reduceBlock:nil version:@"1.3"];
     
-    [[self.db.database viewNamed:self.objectsByTitleViewName]
-     setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+    [self.db defineViewNamed:self.objectsByTitleViewName
+                    mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
     {
         if (![self managesDocumentWithDictionary:doc])
             return;
@@ -463,7 +485,7 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
             return;
         
         emit(doc[@"title"], nil);
-    } version:@"1.0"];
+    } reduceBlock:nil version:@"1.0"];
     
     __weak id weakSelf = self;
     [self.db.database setFilterNamed:MPStringF(@"%@/managed-objects-filter", NSStringFromClass(self.class))
@@ -488,8 +510,8 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         return managesBasedOnDict || managesBasedOnID;
     }];
     
-    [[self.db.database viewNamed:self.bundledJSONDataViewName]
-                    setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+    [self.db defineViewNamed:self.bundledJSONDataViewName
+                    mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
          if (![self managesDocumentWithDictionary:doc])
              return;
@@ -498,7 +520,12 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
              return;
          
          emit(doc.managedObjectDocumentID, nil);
-     } version:@"1.1"];
+     } reduceBlock:nil version:@"1.1"];
+}
+
+- (NSArray<NSString *> *)prewarmedViewNames
+{
+    return @[ self.allObjectsViewName ];
 }
 
 - (NSString *)allObjectsViewName
@@ -508,14 +535,14 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 
 - (CBLQuery *)allObjectsQuery
 {
-    CBLQuery *query = [[self.db.database viewNamed:self.allObjectsViewName] createQuery];
+    CBLQuery *query = [self.db createQueryForViewNamed:self.allObjectsViewName];
     query.prefetch = YES;
     return query;
 }
 
 - (CBLQuery *)objectsByPrototypeQuery
 {
-    CBLQuery *query = [[self.db.database viewNamed:@"objectsByPrototypeID"] createQuery];
+    CBLQuery *query = [self.db createQueryForViewNamed:@"objectsByPrototypeID"];
     query.prefetch = YES;
     return query;
 }
@@ -531,12 +558,21 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 }
 
 - (NSArray *)objectsWithTitle:(NSString *)title
+{
+    return [self objectsWithTitle:title error:nil] ?: @[];
+}
+
+- (NSArray *)objectsWithTitle:(NSString *)title error:(NSError **)error
 {
     NSParameterAssert(title);
-    CBLQuery *q = [[self.db.database viewNamed:self.objectsByTitleViewName] createQuery];
+    CBLQuery *q = [self.db createQueryForViewNamed:self.objectsByTitleViewName];
     q.keys = @[title];
     
-    return [self managedObjectsForQueryEnumerator:q.run];
+    CBLQueryEnumerator *rows = [q run:error];
+    if (!rows)
+        return nil;
+    
+    return [self managedObjectsForQueryEnumerator:rows];
 }
 
 - (NSString *)userContributedObjectsViewName {
@@ -606,7 +642,7 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     NSAssert([[MPManagedObject managedObjectClassFromDocumentID:identifier] isSubclassOfClass:self.managedObjectClass],
              @"Identifier is for an unexpected kind of object: %@ (%@)", identifier, self);
     
-    __block MPManagedObject *mo = _objectCache[identifier];
+    __block MPManagedObject *mo = [_objectCache objectForIdentifier:identifier];
     if (mo)
     {
         NSAssert(mo.controller == self, @"Object has unexpected controller: %@", mo.controller);
@@ -669,10 +705,65 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     return mo;
 }
 
+- (NSArray *)objectsWithIdentifiers:(NSArray<NSString *> *)identifiers
+{
+    NSParameterAssert(identifiers);
+    if (identifiers.count == 0)
+        return @[];
+
+    NSMutableDictionary<NSString *, MPManagedObject *> *objectsByID = [NSMutableDictionary dictionaryWithCapacity:identifiers.count];
+    NSMutableOrderedSet<NSString *> *missingIDs = [NSMutableOrderedSet orderedSetWithCapacity:identifiers.count];
+
+    for (NSString *identifier in identifiers)
+    {
+        NSAssert([[MPManagedObject managedObjectClassFromDocumentID:identifier] isSubclassOfClass:self.managedObjectClass],
+                 @"Identifier is for an unexpected kind of object: %@ (%@)", identifier, self);
+
+        MPManagedObject *mo = [self cachedObjectWithIdentifier:identifier];
+        if (mo)
+            objectsByID[identifier] = mo;
+        else
+            [missingIDs addObject:identifier];
+    }
+
+    if (missingIDs.count > 0)
+    {
+        [objectsByID addEntriesFromDictionary:[self fetchedObjectsByIdentifierForIdentifiers:missingIDs.array]];
+        [missingIDs removeObjectsInArray:objectsByID.allKeys];
+    }
+
+    if (missingIDs.count > 0)
+        [objectsByID addEntriesFromDictionary:[self relayedObjectsByIdentifierForIdentifiers:missingIDs.array]];
+
+    NSMutableArray *objs = [NSMutableArray arrayWithCapacity:identifiers.count];
+    for (NSString *identifier in identifiers)
+    {
+        MPManagedObject *mo = objectsByID[identifier];
+        if (mo)
+            [objs addObject:mo];
+        else
+            MPLog(@"WARNING! Failed to find object by ID: %@", identifier);
+    }
+
+    return [objs copy];
+}
+
 - (BOOL)relaysFetchingByIdentifier {
     return NO;
 }
 
+- (NSUInteger)objectCacheCountLimit {
+    return 1000;
+}
+
+- (id<MPManagedObjectCachePolicy>)newObjectCache {
+    return [[MPManagedObjectCache alloc] initWithCountLimit:self.objectCacheCountLimit];
+}
+
+- (NSUInteger)queryResultCacheCountLimit {
+    return 100;
+}
+
 - (id)newObjectOfClass:(Class)cls {
     if (!cls) {
         cls = [[self class] managedObjectClass];
@@ -745,15 +836,127 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 
 - (NSArray *)objectsFromContentsOfArrayJSONAtURL:(NSURL *)url error:(NSError **)err
 {
-    NSData *objData = [NSData dataWithContentsOfURL:url options:0 error:err];
+    NSMutableArray *mos = [NSMutableArray new];
+    if (![self importObjectsFromContentsOfArrayJSONAtURL:url
+                                               batchSize:0
+                                         importedObjects:mos
+                                         progressHandler:nil
+                                                   error:err])
+        return nil;
+    
+    return mos.copy;
+}
+
+- (BOOL)importObjectsFromContentsOfArrayJSONAtURL:(NSURL *)url
+                                        batchSize:(NSUInteger)batchSize
+                                  progressHandler:(MPManagedObjectsImportProgressHandler)progressHandler
+                                            error:(NSError **)err
+{
+    return [self importObjectsFromContentsOfArrayJSONAtURL:url
+                                                 batchSize:batchSize
+                                           importedObjects:nil
+                                           progressHandler:progressHandler
+                                                     error:err];
+}
+
+- (BOOL)importObjectsFromContentsOfArrayJSONAtURL:(NSURL *)url
+                                        batchSize:(NSUInteger)batchSize
+                                  importedObjects:(NSMutableArray *)importedObjects
+                                  progressHandler:(MPManagedObjectsImportProgressHandler)progressHandler
+                                            error:(NSError **)err
+{
+    NSError *e = nil;
+    NSData *objData = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedAlways error:&e];
     if (!objData) {
-        if (*err) {
-            NSLog(@"Failed to read data from URL %@: %@", url, *err);
+        NSLog(@"Failed to read data from URL %@: %@", url, e);
+        if (err)
+            *err = e;
+        return NO;
+    }
+    
+    if (batchSize == 0)
+        batchSize = MPManagedObjectsControllerDefaultImportBatchSize;
+    
+    NSMutableArray<MPManagedObject *> *batch = [NSMutableArray arrayWithCapacity:batchSize];
+    NSMutableSet<NSString *> *docIDs = [NSMutableSet new];
+    __block NSUInteger importedCount = 0;
+    __block NSError *importError = nil;
+    __block BOOL stopped = NO;
+    
+    BOOL (^saveBatch)(double) = ^BOOL(double fractionCompleted) {
+        if (batch.count > 0) {
+            NSError *saveError = nil;
+            if (![MPManagedObject saveModels:batch error:&saveError]) {
+                importError = saveError;
+                return NO;
+            }
+            
+            importedCount += batch.count;
+            [importedObjects addObjectsFromArray:batch];
+            [batch removeAllObjects];
         }
-        return nil;
+        
+        if (progressHandler)
+            progressHandler(importedCount, fractionCompleted, &stopped);
+        
+        return YES;
+    };
+    
+    BOOL scanned = [objData enumerateJSONArrayElementsUsingBlock:^(NSData *elementData, NSRange range, BOOL *stop) {
+        NSError *elementError = nil;
+        NSDictionary *d = [NSJSONSerialization JSONObjectWithData:elementData options:0 error:&elementError];
+        if (![d isKindOfClass:NSDictionary.class]) {
+            NSLog(@"Failed to deserialize JSON record at offset %lu in %@: %@", range.location, url, elementError);
+            importError = elementError ?: [NSError errorWithDomain:MPManagedObjectsControllerErrorDomain
+                                                              code:MPManagedObjectsControllerErrorCodeInvalidJSON
+                                                          userInfo:@{ NSLocalizedDescriptionKey :
+                                                                          [NSString stringWithFormat:@"Expecting a JSON object at offset %lu", range.location] }];
+            *stop = YES;
+            return;
+        }
+        
+        NSString *docID = [d managedObjectDocumentID];
+        if (docID && [docIDs containsObject:docID]) {
+            NSLog(@"ERROR! Duplicate template with ID '%@'", docID);
+            NSAssert(false, @"There should be no duplicate document IDs amongst the saved objects.");
+            return;
+        }
+        
+        BOOL isExisting = NO;
+        MPManagedObject *mo = [self objectFromJSONDictionary:d isExisting:&isExisting error:&elementError];
+        if (!mo) {
+            NSLog(@"Failed to construct managed object from JSON dictionary %@", d);
+            importError = elementError;
+            *stop = YES;
+            return;
+        }
+        
+        [docIDs addObject:mo.documentID];
+        
+        if (mo.needsSave || !isExisting)
+            [batch addObject:mo];
+        
+        if (batch.count >= batchSize) {
+            if (!saveBatch((double)NSMaxRange(range) / objData.length) || stopped)
+                *stop = YES;
+        }
+    } error:&e];
+    
+    if (!scanned) {
+        NSLog(@"Failed to deserialize JSON array in %@: %@", url, e);
+        importError = e;
     }
-
-    return [self objectsFromArrayJSONData:objData error:err];
+    
+    if (!importError && !stopped)
+        saveBatch(1.0);
+    
+    if (importError) {
+        if (err)
+            *err = importError;
+        return NO;
+    }
+    
+    return YES;
 }
 
 - (NSArray *)objectsFromArrayJSONData:(NSData *)objData error:(NSError *__autoreleasing *)err
@@ -836,7 +1039,7 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     NSAssert(moClass, @"Expecting object type in dictionary: %@", d);
     
     __block CBLDocument *doc = nil;
-    mp_dispatch_sync([(CBLManager *)[self.packageController server] dispatchQueue],
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue,
                      [self.packageController serverQueueToken], ^{
                          doc = [self.db.database existingDocumentWithID:docID];
                      });
@@ -863,29 +1066,10 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 - (NSDictionary *)managedObjectByKeyMapForQueryEnumerator:(CBLQueryEnumerator *)rows
 {
     NSMutableDictionary *entries = [NSMutableDictionary dictionaryWithCapacity:rows.count];
-    for (CBLQueryRow *row in rows) {
-        mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
-            MPManagedObject *modelObj = (id)[row.document modelObject];
-
-            if (!modelObj) {
-                modelObj = self->_objectCache[row.document.documentID];
-                modelObj.document = row.document;
-
-                if (!modelObj) {
-                    modelObj = [[row.document managedObjectClass] modelForDocument:row.document];
-                }
-            }
-            else
-            {
-                assert(modelObj.document);
-                //modelObj.document = row.document;
-            }
-
-            assert([modelObj isKindOfClass:[MPManagedObject class]]);
-
+    [self enumerateManagedObjectsForQueryEnumerator:rows usingBlock:^(CBLQueryRow *row, MPManagedObject *modelObj, BOOL *stop) {
+        if (modelObj)
             entries[row.key] = modelObj;
-        });
-    }
+    }];
 
     return [entries copy];
 }
@@ -893,40 +1077,26 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 - (NSArray *)managedObjectsForQueryEnumerator:(CBLQueryEnumerator *)rows
 {
     NSMutableArray* entries = [NSMutableArray arrayWithCapacity:rows.count];
-    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
-        for (CBLQueryRow* row in rows)
-        {
-            MPManagedObject *modelObj = (MPManagedObject *)[row.document modelObject];
-            
-            if (!modelObj) {
-                modelObj = self->_objectCache[row.document.documentID];
-                modelObj.document = row.document;
-                
-                if (!modelObj) {
-                    if (![row.document isDeleted]) {
-                        modelObj = [[row.document managedObjectClass] modelForDocument:row.document];
-                    }
-                }
-            }
-            else {
-                NSAssert(modelObj.document == row.document,
-                         @"Unexpected row.document: %@ != %@ (%@ ; %@)",
-                         modelObj.document, row.document,
-                         modelObj.propertiesToSave, row.document.properties);
-            }
-            
-            if (modelObj) {
-                NSAssert([modelObj isKindOfClass:[MPManagedObject class]],
-                         @"Model object is of unexpected class: %@", modelObj);
-                
-                [entries addObject:modelObj];
-            }
-        }
-    });
+    [self enumerateManagedObjectsForQueryEnumerator:rows usingBlock:^(CBLQueryRow *row, MPManagedObject *modelObj, BOOL *stop) {
+        if (modelObj)
+            [entries addObject:modelObj];
+    }];
     
     return [entries copy];
 }
 
+- (void)enumerateManagedObjectsForQueryEnumerator:(CBLQueryEnumerator *)rows
+                                       usingBlock:(void (^)(CBLQueryRow *row, MPManagedObject *object, BOOL *stop))block
+{
+    NSParameterAssert(block);
+    id<MPManagedObjectCachePolicy> objectCache = _objectCache;
+    [self.db.database enumerateManagedObjectsForQueryEnumerator:rows
+                                                      chunkSize:MPDatabaseQueryRowChunkSize
+                                              cachedObjectBlock:^MPManagedObject *(NSString *documentID) {
+        return [objectCache objectForIdentifier:documentID];
+    }
+                                                     usingBlock:block];
+}
 
 #pragma mark - Notification observing
 
@@ -960,7 +1130,7 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         return nil;
     
     NSParameterAssert(self.bundledJSONDataViewName);
-    CBLQuery *q = [[self.db.database viewNamed:self.bundledJSONDataViewName] createQuery];
+    CBLQuery *q = [self.db createQueryForViewNamed:self.bundledJSONDataViewName];
     q.prefetch = YES;
     
     return q;
@@ -994,6 +1164,8 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     NSParameterAssert(!_loadingBundledJSONResources);
     _loadingBundledJSONResources = YES;
     
+    MPStartupTraceSpan *span = [self.packageController.startupTracer beginSpanNamed:NSStringFromClass(self.class) category:@"bundledData"];
+    
     NSParameterAssert(self.bundledJSONDataQuery);
     
     NSArray *foundBundledObjs =
@@ -1013,6 +1185,7 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         _bundledJSONDerivedData = [_bundledJSONDerivedData sortedArrayUsingComparator:self.bundledJSONDataComparator];
     
     NSParameterAssert(_bundledJSONDerivedData);
+    [span end];
     return YES;
 }
 
@@ -1261,10 +1434,21 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 #pragma mark - 
 
 - (NSArray *)objectsMatchingQueriedView:(NSString *)view keys:(NSArray *)keys {
+    return [self objectsMatchingQueriedView:view keys:keys options:MPQueryOptionsNone];
+}
+
+- (NSArray *)objectsMatchingQueriedView:(NSString *)view keys:(NSArray *)keys options:(MPQueryOptions)options {
     // Assertions here are safe because query may be sent once database is already torn down during shutdown.
     //NSParameterAssert(view);
     
-    CBLQuery *q = [self.db.database existingViewNamed:view].createQuery;
+    __block CBLView *v = nil;
+    __block UInt64 lastSequenceNumber = 0;
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        v = [self.db viewNamed:view];
+        lastSequenceNumber = self.db.database.lastSequenceNumber;
+    });
+    
+    CBLQuery *q = v.createQuery;
 //#ifdef DEBUG
 //    NSParameterAssert(q);
 //#endif
@@ -1274,9 +1458,131 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         return nil;
     }
     
+    NSArray *objs = [_queryResultCache objectsForView:view keys:keys options:options
+                                   lastSequenceNumber:lastSequenceNumber
+                                  lastSequenceIndexed:v.lastSequenceIndexed];
+    if (objs)
+        return objs;
+    
     q.keys = keys;
     q.prefetch = YES;
-    return [self managedObjectsForQueryEnumerator:q.run];
+    if (self.db.isReadOnly)
+        q.indexUpdateMode = kCBLUpdateIndexNever;
+    else if (options & MPQueryOptionsAllowStale)
+        q.indexUpdateMode = kCBLUpdateIndexAfter;
+    objs = [self managedObjectsForQueryEnumerator:q.run];
+    
+    // recorded with the sequence number read before running the query, so that a change made meanwhile makes the result stale.
+    // a stale result is recorded with the index as it was queried, so that it is replaced once the index has caught up.
+    [_queryResultCache setObjects:objs forView:view keys:keys options:options
+               lastSequenceNumber:lastSequenceNumber
+              lastSequenceIndexed:v.lastSequenceIndexed];
+    return objs;
+}
+
+#pragma mark - Asynchronous fetching
+
+- (MPAsyncRequest *)fetchWithKey:(NSArray *)key
+                 completionQueue:(dispatch_queue_t)queue
+               completionHandler:(MPAsyncRequestCompletionHandler)completionHandler
+                           fetch:(id (^)(NSError **error))fetch
+{
+    MPAsyncRequest *request = [[MPAsyncRequest alloc] initWithCompletionQueue:queue completionHandler:completionHandler];
+    
+    @synchronized (_inFlightFetches) {
+        NSMutableArray *requests = _inFlightFetches[key];
+        if (requests) {
+            [requests addObject:request];
+            return request;
+        }
+        _inFlightFetches[key] = [NSMutableArray arrayWithObject:request];
+    }
+    
+    // run on the database's queue rather than a concurrent one, as the fetch would in any case be serialised there.
+    dispatch_queue_t fetchQueue = self.db.database.manager.dispatchQueue ?: dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    dispatch_async(fetchQueue, ^{
+        @synchronized (_inFlightFetches) {
+            BOOL pending = NO;
+            for (MPAsyncRequest *r in _inFlightFetches[key])
+                pending = pending || !r.isCompleted;
+            
+            // requests joining after this point are given the result of the fetch below.
+            if (!pending) {
+                [_inFlightFetches removeObjectForKey:key];
+                return;
+            }
+        }
+        
+        id result = nil;
+        NSError *error = nil;
+        @autoreleasepool {
+            NSError *fetchError = nil;
+            result = fetch(&fetchError);
+            error = fetchError;
+        }
+        
+        NSArray *requests = nil;
+        @synchronized (_inFlightFetches) {
+            requests = _inFlightFetches[key];
+            [_inFlightFetches removeObjectForKey:key];
+        }
+        
+        for (MPAsyncRequest *r in requests)
+            [r completeWithResult:result error:error];
+    });
+    
+    return request;
+}
+
+- (MPAsyncRequest *)fetchAllObjectsWithCompletionQueue:(dispatch_queue_t)queue
+                                     completionHandler:(void (^)(NSArray *objects, NSError *error))completionHandler
+{
+    return [self fetchWithKey:@[ @"allObjects" ] completionQueue:queue completionHandler:completionHandler
+                        fetch:^id(NSError **error) {
+        return [self allObjects:error];
+    }];
+}
+
+- (MPAsyncRequest *)fetchObjectsWithTitle:(NSString *)title
+                          completionQueue:(dispatch_queue_t)queue
+                        completionHandler:(void (^)(NSArray *objects, NSError *error))completionHandler
+{
+    NSParameterAssert(title);
+    return [self fetchWithKey:@[ @"title", title ] completionQueue:queue completionHandler:completionHandler
+                        fetch:^id(NSError **error) {
+        return [self objectsWithTitle:title error:error];
+    }];
+}
+
+- (MPAsyncRequest *)fetchObjectsMatchingQueriedView:(NSString *)view
+                                               keys:(NSArray *)keys
+                                            options:(MPQueryOptions)options
+                                    completionQueue:(dispatch_queue_t)queue
+                                  completionHandler:(void (^)(NSArray *objects, NSError *error))completionHandler
+{
+    NSParameterAssert(view);
+    NSArray *fetchKey = @[ @"view", view, keys ?: [NSNull null], @(options) ];
+    return [self fetchWithKey:fetchKey completionQueue:queue completionHandler:completionHandler
+                        fetch:^id(NSError **error) {
+        NSArray *objs = [self objectsMatchingQueriedView:view keys:keys options:options];
+        if (!objs && error)
+            *error = [NSError errorWithDomain:MPManagedObjectsControllerErrorDomain
+                                         code:MPManagedObjectsControllerErrorCodeNoSuchView
+                                     userInfo:@{ NSLocalizedDescriptionKey :
+                                                     [NSString stringWithFormat:@"No view with name '%@' in database '%@'", view, self.db.name] }];
+        return objs;
+    }];
+}
+
+- (MPAsyncRequest *)fetchObjectWithIdentifier:(NSString *)identifier
+                              completionQueue:(dispatch_queue_t)queue
+                            completionHandler:(void (^)(MPManagedObject *object, NSError *error))completionHandler
+{
+    NSParameterAssert(identifier);
+    return [self fetchWithKey:@[ @"identifier", identifier ] completionQueue:queue completionHandler:completionHandler
+                        fetch:^id(NSError **error) {
+        return [self objectWithIdentifier:identifier];
+    }];
 }
 
 + (NSString *)managedObjectSingular {
@@ -1343,6 +1649,45 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
         [(id<MPDatabasePackageControllerDelegate>)[self.packageController delegate] updateChangeCount:NSChangeDone];
 }
 
+- (void)willSaveObjects:(NSArray<MPManagedObject *> *)objects
+{
+    for (MPManagedObject *mo in objects)
+        [self willSaveObject:mo];
+}
+
+- (void)didSaveObjects:(MPManagedObjectsBatchChange *)batchChange
+{
+    assert(batchChange.controller == self);
+    assert(self.db);
+    
+    if (batchChange.isEmpty)
+        return;
+    
+    // cleared once for the whole batch (saved properties may change the results of cached queries too).
+    [self clearCachedValues];
+    
+    // per-object notifications are posted only in the compatibility mode; otherwise the package controller posts the batch once.
+    if (!_packageController.postsPerObjectChangeNotifications)
+        return;
+    
+    NSNotificationCenter *nc = [_packageController notificationCenter]; assert(nc);
+    NSDictionary *userInfo = @{@"source":@(MPManagedObjectChangeSourceInternal)};
+    
+    for (MPManagedObject *mo in batchChange.addedObjects) {
+        [nc postNotificationName:[NSNotificationCenter notificationNameForRecentChangeOfType:MPChangeTypeAdd
+                                                                         forManagedObjectClass:[mo class]] object:mo userInfo:userInfo];
+        [nc postNotificationName:[NSNotificationCenter notificationNameForPastChangeOfType:MPChangeTypeAdd
+                                                                       forManagedObjectClass:[mo class]] object:mo userInfo:userInfo];
+    }
+    
+    for (MPManagedObject *mo in batchChange.updatedObjects) {
+        [nc postNotificationName:[NSNotificationCenter notificationNameForRecentChangeOfType:MPChangeTypeUpdate
+                                                                         forManagedObjectClass:[mo class]] object:mo userInfo:userInfo];
+        [nc postNotificationName:[NSNotificationCenter notificationNameForPastChangeOfType:MPChangeTypeUpdate
+                                                                       forManagedObjectClass:[mo class]] object:mo userInfo:userInfo];
+    }
+}
+
 - (void)willDeleteObject:(MPManagedObject *)object
 {
     assert(object.controller == self);
@@ -1352,6 +1697,11 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     [self deregisterObject:object];
 }
 
+- (BOOL)prepareToDeleteObject:(MPManagedObject *)object error:(NSError **)err
+{
+    return YES;
+}
+
 - (void)didDeleteObject:(MPManagedObject *)object
 {
     assert(object.controller == self);
@@ -1377,16 +1727,9 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 {
     NSNotificationCenter *nc = [_packageController notificationCenter]; assert(nc);
 
-    // TODO: get rid of this hack and reason properly about whether an object is new or updated.
-    BOOL documentIsNew = [doc.currentRevision.revisionID isMatchedByRegex:@"^1-"];
-    BOOL documentIsDeleted = doc.currentRevision.isDeletion;
-
     NSDictionary *changeDict = @{ @"source":@(source) };
 
-    // document new => add change type.
-    // document is not new &  document is deleted => remove change type
-    // document is now new & document is NOT deleted => update change type
-    MPChangeType changeType = documentIsNew ? MPChangeTypeAdd : (documentIsDeleted ? MPChangeTypeRemove : MPChangeTypeUpdate);
+    MPChangeType changeType = [self changeTypeForDocument:doc];
     NSString *recentChangeName
         = [NSNotificationCenter notificationNameForRecentChangeOfType:changeType
                                                 forManagedObjectClass:[object class]];
@@ -1399,6 +1742,29 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     [nc postNotificationName:pastChangeName object:object userInfo:changeDict];
 }
 
+- (MPChangeType)changeTypeForDocument:(CBLDocument *)doc
+{
+    // TODO: get rid of this hack and reason properly about whether an object is new or updated.
+    BOOL documentIsNew = [doc.currentRevision.revisionID isMatchedByRegex:@"^1-"];
+    BOOL documentIsDeleted = doc.currentRevision.isDeletion;
+
+    // document new => add change type.
+    // document is not new &  document is deleted => remove change type
+    // document is now new & document is NOT deleted => update change type
+    return documentIsNew ? MPChangeTypeAdd : (documentIsDeleted ? MPChangeTypeRemove : MPChangeTypeUpdate);
+}
+
+- (void)didChangeObjects:(MPManagedObjectsBatchChange *)batchChange
+{
+    NSParameterAssert(batchChange.controller == self);
+    NSParameterAssert([NSThread isMainThread]);
+
+    // unloaded objects may be new ones, so they invalidate cached values as additions do.
+    if (batchChange.addedObjects.count > 0 || batchChange.removedObjects.count > 0
+        || batchChange.unloadedObjectIdentifiers.count > 0)
+        [self clearCachedValues];
+}
+
 - (void)didLoadObjectFromDocument:(MPManagedObject *)object
 {
     assert(object.controller == self);
@@ -1416,16 +1782,99 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
     assert([mo isKindOfClass:self.managedObjectClass]);
     assert(_objectCache);
     assert(mo.document.documentID);
-    _objectCache[mo.document.documentID] = mo;
+    [_objectCache registerObject:mo forIdentifier:mo.document.documentID];
 }
 
 - (void)deregisterObject:(MPManagedObject *)mo
 {
     NSParameterAssert([mo isKindOfClass:[self managedObjectClass]]);
     NSParameterAssert(_objectCache);
-    if (mo.document.documentID && _objectCache[mo.document.documentID] == mo) {
-        [_objectCache removeObjectForKey:mo.document.documentID];
+    if (mo.document.documentID) {
+        [_objectCache deregisterObject:mo forIdentifier:mo.document.documentID];
+    }
+}
+
+- (void)objectNeedsSaveDidChange:(MPManagedObject *)mo
+{
+    NSParameterAssert([mo isKindOfClass:[self managedObjectClass]]);
+    [_objectCache objectNeedsSaveDidChange:mo];
+}
+
+- (MPManagedObject *)cachedObjectWithIdentifier:(NSString *)identifier
+{
+    NSParameterAssert(identifier);
+    MPManagedObject *mo = [_objectCache objectForIdentifier:identifier];
+    if (mo)
+    {
+        NSAssert(mo.controller == self, @"Object has unexpected controller: %@", mo.controller);
+        NSAssert([mo isKindOfClass:self.managedObjectClass], @"Object is of unexpected kind: %@", mo);
     }
+    return mo;
+}
+
+- (NSDictionary *)fetchedObjectsByIdentifierForIdentifiers:(NSArray<NSString *> *)identifiers
+{
+    NSParameterAssert(identifiers);
+    if (identifiers.count == 0)
+        return @{};
+
+    NSMutableDictionary<NSString *, MPManagedObject *> *objectsByID = [NSMutableDictionary dictionaryWithCapacity:identifiers.count];
+
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        CBLQueryEnumerator *rows = [self.db.database getDocumentsWithIDs:identifiers];
+
+        // the enumeration is already on the server queue so it does not hop again.
+        [self enumerateManagedObjectsForQueryEnumerator:rows usingBlock:^(CBLQueryRow *row, MPManagedObject *mo, BOOL *stop) {
+            // rows for missing keys have no document, and deleted documents resolve to no object (as with -objectWithIdentifier:).
+            if (!mo || row.document.isDeleted)
+                return;
+
+            objectsByID[row.document.documentID] = mo;
+        }];
+    });
+
+    return [objectsByID copy];
+}
+
+- (NSDictionary *)relayedObjectsByIdentifierForIdentifiers:(NSArray<NSString *> *)identifiers
+{
+    NSParameterAssert(identifiers);
+    MPShoeboxPackageController *shoebox = [MPShoeboxPackageController sharedShoeboxController];
+    if (identifiers.count == 0
+        || !self.relaysFetchingByIdentifier
+        || self.packageController == shoebox)
+        return @{};
+
+    // group by the shared package's controllers so that each of them is queried once.
+    NSMapTable<MPManagedObjectsController *, NSMutableArray *> *identifiersByController = [NSMapTable strongToStrongObjectsMapTable];
+    for (NSString *identifier in identifiers)
+    {
+        Class cls = [MPManagedObject managedObjectClassFromDocumentID:identifier];
+        NSAssert(cls, @"Class unexpectedly missing from document ID: %@", identifier);
+
+        MPManagedObjectsController *moc = [shoebox controllerForManagedObjectClass:cls];
+        NSAssert(moc != self, @"Attempting to recursively get object by ID from self.");
+        if (!moc)
+            continue;
+
+        NSMutableArray *controllerIDs = [identifiersByController objectForKey:moc];
+        if (!controllerIDs)
+        {
+            controllerIDs = [NSMutableArray new];
+            [identifiersByController setObject:controllerIDs forKey:moc];
+        }
+        [controllerIDs addObject:identifier];
+    }
+
+    NSMutableDictionary<NSString *, MPManagedObject *> *objectsByID = [NSMutableDictionary dictionaryWithCapacity:identifiers.count];
+    for (MPManagedObjectsController *moc in identifiersByController)
+    {
+        NSArray *objs = [moc objectsWithIdentifiers:[identifiersByController objectForKey:moc]];
+        for (MPManagedObject *mo in objs)
+            objectsByID[mo.documentID] = mo;
+    }
+
+    return [objectsByID copy];
 }
 
 #pragma mark - Scripting support
@@ -1586,6 +2035,106 @@ NSString * const MPManagedObjectsControllerLoadedBundledResourcesNotification =
 @end
 
 
+#pragma mark -
+
+@interface MPManagedObjectsBatchChange ()
+{
+    NSMutableOrderedSet<MPManagedObject *> *_addedObjects;
+    NSMutableOrderedSet<MPManagedObject *> *_updatedObjects;
+    NSMutableOrderedSet<MPManagedObject *> *_removedObjects;
+    NSMutableOrderedSet<NSString *> *_unloadedObjectIdentifiers;
+}
+@property (readwrite, weak) MPManagedObjectsController *controller;
+@property (readwrite) BOOL containsExternalChanges;
+@end
+
+@implementation MPManagedObjectsBatchChange
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (NSArray *)addedObjects { return _addedObjects.array; }
+
+- (NSArray *)updatedObjects { return _updatedObjects.array; }
+
+- (NSArray *)removedObjects { return _removedObjects.array; }
+
+- (NSArray *)unloadedObjectIdentifiers { return _unloadedObjectIdentifiers.array; }
+
+- (BOOL)isEmpty
+{
+    return _addedObjects.count == 0 && _updatedObjects.count == 0 && _removedObjects.count == 0
+        && _unloadedObjectIdentifiers.count == 0;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p controller:%@ added:%lu updated:%lu removed:%lu unloaded:%lu>",
+            self.class, self, self.controller.class,
+            _addedObjects.count, _updatedObjects.count, _removedObjects.count, _unloadedObjectIdentifiers.count];
+}
+
+@end
+
+@implementation MPManagedObjectsBatchChange (Protected)
+
+- (instancetype)initWithController:(MPManagedObjectsController *)controller
+{
+    NSParameterAssert(controller);
+    if (self = [super init])
+    {
+        _controller = controller;
+        _addedObjects = [NSMutableOrderedSet new];
+        _updatedObjects = [NSMutableOrderedSet new];
+        _removedObjects = [NSMutableOrderedSet new];
+        _unloadedObjectIdentifiers = [NSMutableOrderedSet new];
+    }
+    return self;
+}
+
+- (void)addObject:(MPManagedObject *)object changeType:(MPChangeType)changeType source:(MPManagedObjectChangeSource)source
+{
+    NSParameterAssert(object);
+
+    if (source == MPManagedObjectChangeSourceExternal)
+        self.containsExternalChanges = YES;
+
+    switch (changeType)
+    {
+        case MPChangeTypeAdd:
+            [_removedObjects removeObject:object];
+            [_updatedObjects removeObject:object];
+            [_addedObjects addObject:object];
+            break;
+
+        case MPChangeTypeUpdate:
+            if (![_addedObjects containsObject:object] && ![_removedObjects containsObject:object])
+                [_updatedObjects addObject:object];
+            break;
+
+        case MPChangeTypeRemove:
+            [_addedObjects removeObject:object];
+            [_updatedObjects removeObject:object];
+            [_removedObjects addObject:object];
+            break;
+    }
+}
+
+- (void)addUnloadedObjectWithIdentifier:(NSString *)identifier source:(MPManagedObjectChangeSource)source
+{
+    NSParameterAssert(identifier);
+
+    if (source == MPManagedObjectChangeSourceExternal)
+        self.containsExternalChanges = YES;
+
+    [_unloadedObjectIdentifiers addObject:identifier];
+}
+
+@end
+
 @implementation CBLDocument (MPManagedObjectExtensions)
 
 - (Class)managedObjectClass
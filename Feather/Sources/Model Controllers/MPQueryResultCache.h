@@ -0,0 +1,48 @@
+//
+//  MPQueryResultCache.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** A cache of view query results of a MPManagedObjectsController, keyed by view name, query keys and query options.
+  * Each result is recorded with the database's last sequence number before the query was run
+  * and the view's last indexed sequence after it, and is only returned while both are unchanged:
+  * any change to the database, or a view whose index was reset by a new map function version, makes it stale.
+  * The least recently used results are evicted beyond the count limit. */
+@interface MPQueryResultCache : NSObject
+
+/** @param countLimit The maximum number of cached results. 0 means no limit. */
+- (nonnull instancetype)initWithCountLimit:(NSUInteger)countLimit NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+@property (readonly) NSUInteger countLimit;
+
+/** The cached result for the query if it is still valid, otherwise nil (and a stale result is removed). */
+- (nullable NSArray *)objectsForView:(nonnull NSString *)view
+                                keys:(nullable NSArray *)keys
+                             options:(NSUInteger)options
+                  lastSequenceNumber:(UInt64)lastSequenceNumber
+                 lastSequenceIndexed:(SInt64)lastSequenceIndexed;
+
+- (void)setObjects:(nonnull NSArray *)objects
+           forView:(nonnull NSString *)view
+              keys:(nullable NSArray *)keys
+           options:(NSUInteger)options
+lastSequenceNumber:(UInt64)lastSequenceNumber
+lastSequenceIndexed:(SInt64)lastSequenceIndexed;
+
+- (void)removeAllObjects;
+
+/** The number of cached results. */
+@property (readonly) NSUInteger count;
+
+@property (readonly) NSUInteger hitCount;
+@property (readonly) NSUInteger missCount;
+@property (readonly) NSUInteger evictionCount;
+
+@end
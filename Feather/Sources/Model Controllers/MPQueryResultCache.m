@@ -0,0 +1,203 @@
+//
+//  MPQueryResultCache.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPQueryResultCache.h"
+
+@interface MPQueryResultCacheKey : NSObject <NSCopying>
+@property (readonly, copy) NSString *view;
+@property (readonly, copy) NSArray *keys;
+@property (readonly) NSUInteger options;
+@end
+
+@implementation MPQueryResultCacheKey
+{
+    NSUInteger _hash;
+}
+
+- (instancetype)initWithView:(NSString *)view keys:(NSArray *)keys options:(NSUInteger)options
+{
+    if (self = [super init])
+    {
+        _view = [view copy];
+        _keys = [keys copy];
+        _options = options;
+
+        // NSArray's own hash is its count, so the keys' elements are mixed in.
+        _hash = _view.hash ^ options;
+        for (id key in _keys)
+            _hash = _hash * 31 + [key hash];
+    }
+
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    return self;
+}
+
+- (NSUInteger)hash
+{
+    return _hash;
+}
+
+- (BOOL)isEqual:(id)object
+{
+    if (object == self)
+        return YES;
+
+    if (![object isKindOfClass:MPQueryResultCacheKey.class])
+        return NO;
+
+    MPQueryResultCacheKey *key = object;
+    return key->_hash == _hash
+        && key.options == _options
+        && [key.view isEqualToString:_view]
+        && (key.keys == _keys || [key.keys isEqualToArray:_keys]);
+}
+
+@end
+
+@interface MPQueryResultCacheEntry : NSObject
+@property (readonly) NSArray *objects;
+@property (readonly) UInt64 lastSequenceNumber;
+@property (readonly) SInt64 lastSequenceIndexed;
+@end
+
+@implementation MPQueryResultCacheEntry
+
+- (instancetype)initWithObjects:(NSArray *)objects lastSequenceNumber:(UInt64)lastSequenceNumber lastSequenceIndexed:(SInt64)lastSequenceIndexed
+{
+    if (self = [super init])
+    {
+        _objects = objects;
+        _lastSequenceNumber = lastSequenceNumber;
+        _lastSequenceIndexed = lastSequenceIndexed;
+    }
+
+    return self;
+}
+
+@end
+
+@interface MPQueryResultCache ()
+{
+    NSMutableDictionary<MPQueryResultCacheKey *, MPQueryResultCacheEntry *> *_entries;
+
+    /** Keys of _entries, least recently used first. */
+    NSMutableOrderedSet<MPQueryResultCacheKey *> *_recentKeys;
+}
+
+@property (readwrite) NSUInteger hitCount;
+@property (readwrite) NSUInteger missCount;
+@property (readwrite) NSUInteger evictionCount;
+
+@end
+
+@implementation MPQueryResultCache
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit
+{
+    if (self = [super init])
+    {
+        _countLimit = countLimit;
+        _entries = [NSMutableDictionary dictionaryWithCapacity:MIN(countLimit, 100)];
+        _recentKeys = [NSMutableOrderedSet orderedSetWithCapacity:MIN(countLimit, 100)];
+    }
+
+    return self;
+}
+
+- (NSArray *)objectsForView:(NSString *)view
+                       keys:(NSArray *)keys
+                    options:(NSUInteger)options
+         lastSequenceNumber:(UInt64)lastSequenceNumber
+        lastSequenceIndexed:(SInt64)lastSequenceIndexed
+{
+    NSParameterAssert(view);
+    MPQueryResultCacheKey *key = [[MPQueryResultCacheKey alloc] initWithView:view keys:keys options:options];
+
+    @synchronized (self) {
+        MPQueryResultCacheEntry *entry = _entries[key];
+
+        if (!entry
+            || entry.lastSequenceNumber != lastSequenceNumber
+            || entry.lastSequenceIndexed != lastSequenceIndexed)
+        {
+            if (entry) {
+                [_entries removeObjectForKey:key];
+                [_recentKeys removeObject:key];
+            }
+            _missCount++;
+            return nil;
+        }
+
+        _hitCount++;
+
+        // move to the most recently used end.
+        [_recentKeys removeObject:key];
+        [_recentKeys addObject:key];
+
+        return entry.objects;
+    }
+}
+
+- (void)setObjects:(NSArray *)objects
+           forView:(NSString *)view
+              keys:(NSArray *)keys
+           options:(NSUInteger)options
+lastSequenceNumber:(UInt64)lastSequenceNumber
+lastSequenceIndexed:(SInt64)lastSequenceIndexed
+{
+    NSParameterAssert(objects);
+    NSParameterAssert(view);
+    MPQueryResultCacheKey *key = [[MPQueryResultCacheKey alloc] initWithView:view keys:keys options:options];
+
+    @synchronized (self) {
+        _entries[key] = [[MPQueryResultCacheEntry alloc] initWithObjects:[objects copy]
+                                                      lastSequenceNumber:lastSequenceNumber
+                                                     lastSequenceIndexed:lastSequenceIndexed];
+        [_recentKeys removeObject:key];
+        [_recentKeys addObject:key];
+
+        while (_countLimit > 0 && _recentKeys.count > _countLimit) {
+            [_entries removeObjectForKey:_recentKeys.firstObject];
+            [_recentKeys removeObjectAtIndex:0];
+            _evictionCount++;
+        }
+    }
+}
+
+- (void)removeAllObjects
+{
+    @synchronized (self) {
+        [_entries removeAllObjects];
+        [_recentKeys removeAllObjects];
+    }
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self) {
+        return _entries.count;
+    }
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p limit:%lu count:%lu hits:%lu misses:%lu evictions:%lu>",
+            self.class, self, _countLimit, self.count, self.hitCount, self.missCount, self.evictionCount];
+}
+
+@end
@@ -9,6 +9,7 @@
 #import "MPSnapshotsController.h"
 
 @class MPSnapshottedObjectsController, MPSnapshottedAttachmentsController;
+@class MPDatabase;
 
 @interface MPSnapshotsController (Protected)
 
@@ -17,6 +18,28 @@
 
 /** The controller of MPSnapshottedAttachment instances for this MPSnapshotsController's database.  */
 @property (readonly, strong) MPSnapshottedAttachmentsController *snapshottedAttachmentsController;
+
+/** Records the current revisions of the managed objects in the databases into a snapshot.
+  * Only revisions not contained in an earlier snapshot are copied, in batched transactions; the rest are shared with the earlier snapshots.
+  * The snapshot lists its snapshotted objects as its difference to the last snapshot recorded, with a full list every few snapshots.
+  * Deleting a snapshot lists the snapshots based on it relative to its own base snapshot instead, or in full.
+  * @param databases The databases whose objects to snapshot (not including the snapshots database).
+  * @param snapshot A saved snapshot, whose list of snapshotted objects is set and saved. */
+- (BOOL)recordObjectsOfDatabases:(NSArray<MPDatabase *> *)databases intoSnapshot:(MPSnapshot *)snapshot error:(NSError **)err;
+
+/** Restores the objects in the databases to their revisions in a snapshot.
+  * The difference between the snapshot and the current revisions is computed from the revisions added to each database since the snapshot's sequence number,
+  * falling back to comparing the snapshot's contents with the database's revision list when these do not tell the revisions at the snapshot,
+  * so that only the snapshotted objects of changed revisions are loaded. The changes are written in one transaction per database,
+  * including the deletion of objects created after the snapshot. A snapshot not listing its contents (see -[MPSnapshot listsSnapshottedObjects])
+  * only restores the objects it contains, and deletes none.
+  * @param progressQueue The queue the progress handler is called on asynchronously, or nil for the main queue.
+  * @param progressHandler An optional block called with the fraction of the changed objects restored so far, whenever it has advanced by at least a percent, and with 1.0 once all are restored. */
+- (BOOL)restoreSnapshot:(MPSnapshot *)snapshot
+            toDatabases:(NSArray<MPDatabase *> *)databases
+          progressQueue:(dispatch_queue_t)progressQueue
+        progressHandler:(void (^)(double fractionCompleted))progressHandler
+                  error:(NSError **)err;
 @end
 
 
@@ -35,6 +58,27 @@
   * @param snapshot The snapshot for which to return snapshotted objects for. */
 - (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot;
 
+- (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot offset:(NSUInteger)offset limit:(NSUInteger)limit;
+
+/** The IDs of the snapshotted objects of a snapshot: its full list, or for an incremental snapshot,
+  * the list of the snapshot it is based on with the differences of each incremental snapshot since applied.
+  * For a snapshot taken before snapshots listed their contents, the IDs of the snapshotted objects created for it. */
+- (NSArray<NSString *> *)snapshottedObjectIDsForSnapshot:(MPSnapshot *)snapshot error:(NSError **)err;
+
+/** A prefetching query for the snapshotted objects of a snapshot, keyed by their IDs, or nil if these cannot be resolved. */
+- (CBLQuery *)snapshottedObjectsQueryForSnapshot:(MPSnapshot *)snapshot;
+
+/** A page of -snapshottedObjectsQueryForSnapshot:, keyed by a range of the snapshot's resolved (and cached) contents rather than skipping rows. */
+- (CBLQuery *)snapshottedObjectsQueryForSnapshot:(MPSnapshot *)snapshot offset:(NSUInteger)offset limit:(NSUInteger)limit;
+
+- (BOOL)enumerateSnapshottedPropertiesForSnapshot:(MPSnapshot *)snapshot
+                                       usingBlock:(MPSnapshottedPropertiesBlock)block
+                                            error:(NSError **)err;
+
+- (BOOL)enumerateSnapshottedRevisionsForSnapshot:(MPSnapshot *)snapshot
+                                      usingBlock:(MPSnapshottedRevisionBlock)block
+                                           error:(NSError **)err;
+
 @end
 
 
@@ -52,6 +96,13 @@
   * @param snapshot The snapshot for which to return snapshotted objects for. */
 - (NSArray *)snapshottedAttachmentsForSnapshot:(MPSnapshot *)snapshot;
 
+/** A prefetching query for the snapshotted attachments of a snapshot, keyed by the snapshot's document ID. */
+- (CBLQuery *)snapshottedAttachmentsQueryForSnapshot:(MPSnapshot *)snapshot;
+
+/** A page of -snapshottedAttachmentsQueryForSnapshot:, starting from the snapshotted attachment with the given document ID
+  * (the last one of the previous page, whose row is then the first row and should be skipped), or from the first one if nil. */
+- (CBLQuery *)snapshottedAttachmentsQueryForSnapshot:(MPSnapshot *)snapshot afterDocumentID:(NSString *)documentID limit:(NSUInteger)limit;
+
 /** Returns a snapshotted attachment for a SHA1 checksum.
   * @param sha The SHA1 checksum string to return a MPSnapshottedAttachment for */
 - (MPSnapshottedAttachment *)snapshottedAttachmentForSHA:(NSString *)sha;
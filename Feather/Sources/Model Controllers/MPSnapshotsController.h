@@ -11,6 +11,12 @@
 @class MPSnapshot, MPSnapshottedObject;
 @class MPSnapshottedObject, MPSnapshottedAttachment;
 
+/** A block called with the document ID and revision ID of an object contained in a snapshot, and the ID of the MPSnapshottedObject document containing it. */
+typedef void (^MPSnapshottedRevisionBlock)(NSString *documentID, NSString *revisionID, NSString *snapshottedObjectID, BOOL *stop);
+
+/** A block called with the document ID, revision ID and snapshotted properties of an object contained in a snapshot. */
+typedef void (^MPSnapshottedPropertiesBlock)(NSString *documentID, NSString *revisionID, NSDictionary *properties, BOOL *stop);
+
 /** A MPSnapshotsController manages MPSnapshot objects: allows creating snapshots, and returning snapshotted data associated with a snapshot. Read more about snapshots from the (Snapshot programming guide)[docs/snapshots.html]. */
 @interface MPSnapshotsController : MPManagedObjectsController
 
@@ -29,6 +35,29 @@
  */
 - (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot;
 
+/** Returns a page of the snapshotted objects belonging to a snapshot, in the order they were recorded.
+ * @param snapshot A snapshot for which to return snapshotted objects.
+ * @param offset The number of snapshotted objects to skip.
+ * @param limit The maximum number of snapshotted objects to return. */
+- (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot offset:(NSUInteger)offset limit:(NSUInteger)limit;
+
+/** Returns the document IDs of the MPSnapshottedObject instances contained in a snapshot, resolved from the snapshot's list,
+ * or for an incremental snapshot, from the lists of the snapshots it is based on.
+ * @param snapshot A snapshot for which to return the snapshotted object IDs. */
+- (NSArray<NSString *> *)snapshottedObjectIDsForSnapshot:(MPSnapshot *)snapshot error:(NSError **)err;
+
+/** Enumerates the contents of a snapshot as raw properties, without creating MPSnapshottedObject instances.
+ * The snapshot is read a page at a time, and the block called on the database server's queue. */
+- (BOOL)enumerateSnapshottedPropertiesForSnapshot:(MPSnapshot *)snapshot
+                                       usingBlock:(MPSnapshottedPropertiesBlock)block
+                                            error:(NSError **)err;
+
+/** Enumerates the document and revision IDs contained in a snapshot from the IDs of its snapshotted objects, without loading any of them.
+ * Intended for listing and diffing snapshots. */
+- (BOOL)enumerateSnapshottedRevisionsForSnapshot:(MPSnapshot *)snapshot
+                                      usingBlock:(MPSnapshottedRevisionBlock)block
+                                           error:(NSError **)err;
+
 /** Returns a snapshotted attachment for a SHA1 checksum. 
   * @param sha SHA1 checksum for which to get snapshotted attachments for. */
 - (MPSnapshottedAttachment *)snapshottedAttachmentForSHA:(NSString *)sha;
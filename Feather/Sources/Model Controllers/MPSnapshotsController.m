@@ -9,6 +9,8 @@
 #import "MPSnapshotsController.h"
 #import "MPSnapshot+Protected.h"
 #import "MPDatabase.h"
+#import "MPDatabaseReaderPool.h"
+#import "MPDatabasePackageController.h"
 
 #import <MPSnapshotsController+Protected.h>
 #import <MPManagedObjectsController+Protected.h>
@@ -24,6 +26,33 @@
 @property (readonly, strong) MPSnapshottedAttachmentsController *snapshottedAttachmentsController;
 @end
 
+/** The number of snapshotted objects saved per transaction when recording a snapshot. */
+static const NSUInteger MPSnapshotsControllerSaveBatchSize = 500;
+
+/** The number of snapshots listed incrementally in a row before a snapshot lists its contents in full again,
+  * bounding the number of listings read to resolve the contents of a snapshot. */
+static const NSUInteger MPSnapshotsControllerMaxBaseSnapshotDepth = 16;
+
+/** The least advance in the fraction of objects restored for which restore progress is reported. */
+static const double MPSnapshotsControllerProgressGranularity = 0.01;
+
+/** The metadata key of the ID of the last snapshot recorded, relative to which the next snapshot is listed. */
+static NSString *const MPSnapshotsControllerLastSnapshotIDKey = @"lastSnapshotID";
+
+/** The IDs of a not in aExcluded followed by those of b not in bExcluded, without duplicates. */
+static NSArray<NSString *> *MPSnapshottedObjectIDsUnion(NSArray<NSString *> *a, NSArray<NSString *> *aExcluded,
+                                                        NSArray<NSString *> *b, NSArray<NSString *> *bExcluded)
+{
+    NSMutableOrderedSet<NSString *> *IDs = [NSMutableOrderedSet orderedSetWithArray:a];
+    [IDs minusSet:[NSSet setWithArray:aExcluded]];
+    
+    NSMutableOrderedSet<NSString *> *bIDs = [NSMutableOrderedSet orderedSetWithArray:b];
+    [bIDs minusSet:[NSSet setWithArray:bExcluded]];
+    [IDs unionOrderedSet:bIDs];
+    
+    return IDs.array;
+}
+
 @implementation MPSnapshotsController
 
 - (instancetype)initWithPackageController:(MPDatabasePackageController *)packageController
@@ -71,13 +100,581 @@
     assert(![self.db.database documentWithID:[MPSnapshottedObject idForSnapshottedObjectWithDocumentID:obj.document.documentID
                                                                                     revisionID:obj.document.currentRevisionID inDatabase:self.db.database]]);
     
-    MPSnapshottedObject *sobj = [[MPSnapshottedObject alloc] initWithController:self snapshot:snapshot snapshottedObject:obj];
+    MPSnapshottedObject *sobj = [[MPSnapshottedObject alloc] initWithController:self.snapshottedObjectsController snapshot:snapshot snapshottedObject:obj];
     return sobj;
 }
 
+#pragma mark - Recording snapshots
+
+- (BOOL)recordObjectsOfDatabases:(NSArray<MPDatabase *> *)databases intoSnapshot:(MPSnapshot *)snapshot error:(NSError **)err
+{
+    NSParameterAssert(snapshot.document);
+    NSParameterAssert(![databases containsObject:self.db]);
+    
+    NSMutableArray<NSString *> *snapshottedObjectIDs = [NSMutableArray new];
+    NSMutableDictionary<NSString *, NSNumber *> *sequenceNumbers = [NSMutableDictionary new];
+    for (MPDatabase *db in databases) {
+        UInt64 sequenceNumber = 0;
+        if (![self recordObjectsOfDatabase:db intoSnapshot:snapshot snapshottedObjectIDs:snapshottedObjectIDs sequenceNumber:&sequenceNumber error:err])
+            return NO;
+        
+        // a database changed while its objects were snapshotted may have revisions newer than its listed sequence number in the snapshot.
+        __block UInt64 lastSequenceNumber = 0;
+        mp_dispatch_sync(db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+            lastSequenceNumber = db.database.lastSequenceNumber;
+        });
+        
+        if (lastSequenceNumber == sequenceNumber)
+            sequenceNumbers[db.name] = @(sequenceNumber);
+    }
+    
+    // the snapshot is listed as its difference to the last snapshot, unless the full list is as short or the chain of differences is too long.
+    MPMetadata *metadata = [self.db metadata];
+    NSString *baseSnapshotID = [metadata getValueOfProperty:MPSnapshotsControllerLastSnapshotIDKey];
+    MPSnapshot *baseSnapshot = baseSnapshotID && ![baseSnapshotID isEqualToString:snapshot.documentID]
+                             ? [self objectWithIdentifier:baseSnapshotID] : nil;
+    NSArray<NSString *> *baseSnapshottedObjectIDs = nil;
+    if (baseSnapshot.listsSnapshottedObjects && baseSnapshot.baseSnapshotDepth < MPSnapshotsControllerMaxBaseSnapshotDepth)
+        baseSnapshottedObjectIDs = [self snapshottedObjectIDsForSnapshot:baseSnapshot error:nil];
+    
+    NSMutableOrderedSet<NSString *> *addedIDs = [NSMutableOrderedSet orderedSetWithArray:snapshottedObjectIDs];
+    [addedIDs minusSet:[NSSet setWithArray:baseSnapshottedObjectIDs ?: @[]]];
+    NSMutableOrderedSet<NSString *> *removedIDs = [NSMutableOrderedSet orderedSetWithArray:baseSnapshottedObjectIDs ?: @[]];
+    [removedIDs minusSet:[NSSet setWithArray:snapshottedObjectIDs]];
+    
+    if (baseSnapshottedObjectIDs && addedIDs.count + removedIDs.count < snapshottedObjectIDs.count)
+        [snapshot setBaseSnapshot:baseSnapshot addedSnapshottedObjectIDs:addedIDs.array removedSnapshottedObjectIDs:removedIDs.array];
+    else
+        snapshot.snapshottedObjectIDs = snapshottedObjectIDs;
+    
+    snapshot.snapshottedSequenceNumbers = sequenceNumbers;
+    
+    if (![snapshot save:err])
+        return NO;
+    
+    [metadata setValue:snapshot.documentID ofProperty:MPSnapshotsControllerLastSnapshotIDKey];
+    
+    __block BOOL success = NO;
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        success = [metadata save:err];
+    });
+    
+    return success;
+}
+
+- (BOOL)recordObjectsOfDatabase:(MPDatabase *)db
+                   intoSnapshot:(MPSnapshot *)snapshot
+           snapshottedObjectIDs:(NSMutableArray<NSString *> *)snapshottedObjectIDs
+                 sequenceNumber:(UInt64 *)sequenceNumber
+                          error:(NSError **)err
+{
+    MPDatabasePackageController *pkgc = self.packageController;
+    
+    NSMutableDictionary<NSString *, NSString *> *documentIDsBySnapshottedObjectID = [NSMutableDictionary new];
+    NSMutableSet<NSString *> *existingSnapshottedObjectIDs = [NSMutableSet new];
+    __block BOOL success = YES;
+    
+    // the current revisions of the database's managed objects, without loading their contents.
+    NSMutableDictionary<NSString *, NSString *> *revisionIDsByDocumentID = [NSMutableDictionary new];
+    mp_dispatch_sync(db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+        *sequenceNumber = db.database.lastSequenceNumber;
+        
+        CBLQueryEnumerator *rows = [[db.database createAllDocumentsQuery] run:err];
+        if (!rows) {
+            success = NO;
+            return;
+        }
+        
+        for (CBLQueryRow *row in rows) {
+            if (row.documentRevisionID && [self isSnapshottableDocumentWithID:row.documentID])
+                revisionIDsByDocumentID[row.documentID] = row.documentRevisionID;
+        }
+    });
+    
+    if (!success)
+        return NO;
+    
+    if (revisionIDsByDocumentID.count == 0)
+        return YES;
+    
+    // the database may have a queue of its own, so the snapshots database is read on its queue separately.
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+        [revisionIDsByDocumentID enumerateKeysAndObjectsUsingBlock:^(NSString *docID, NSString *revID, BOOL *stop) {
+            NSString *snapshottedObjectID = [MPSnapshottedObject idForSnapshottedObjectWithDocumentID:docID
+                                                                                          revisionID:revID
+                                                                                          inDatabase:self.db.database];
+            documentIDsBySnapshottedObjectID[snapshottedObjectID] = docID;
+        }];
+        
+        // revisions contained in an earlier snapshot already have a snapshotted object.
+        CBLQuery *q = [self.db.database createAllDocumentsQuery];
+        q.keys = documentIDsBySnapshottedObjectID.allKeys;
+        
+        CBLQueryEnumerator *existingRows = [q run:err];
+        if (!existingRows) {
+            success = NO;
+            return;
+        }
+        
+        for (CBLQueryRow *row in existingRows) {
+            if (row.documentRevisionID && ![row.value[@"deleted"] boolValue])
+                [existingSnapshottedObjectIDs addObject:row.key];
+        }
+    });
+    
+    if (!success)
+        return NO;
+    
+    [snapshottedObjectIDs addObjectsFromArray:existingSnapshottedObjectIDs.allObjects];
+    
+    NSMutableArray<NSString *> *changedDocumentIDs = [NSMutableArray new];
+    [documentIDsBySnapshottedObjectID enumerateKeysAndObjectsUsingBlock:^(NSString *snapshottedObjectID, NSString *docID, BOOL *stop) {
+        if (![existingSnapshottedObjectIDs containsObject:snapshottedObjectID])
+            [changedDocumentIDs addObject:docID];
+    }];
+    
+    for (NSUInteger i = 0; i < changedDocumentIDs.count; i += MPSnapshotsControllerSaveBatchSize) {
+        @autoreleasepool {
+            NSArray *batchIDs = [changedDocumentIDs subarrayWithRange:NSMakeRange(i, MIN(MPSnapshotsControllerSaveBatchSize, changedDocumentIDs.count - i))];
+            
+            NSMutableArray<MPSnapshottedObject *> *batch = [NSMutableArray arrayWithCapacity:batchIDs.count];
+            for (MPManagedObject *mo in [pkgc objectsWithIdentifiers:batchIDs]) {
+                NSString *snapshottedObjectID = [MPSnapshottedObject idForSnapshottedObjectWithDocumentID:mo.documentID
+                                                                                              revisionID:mo.document.currentRevisionID
+                                                                                              inDatabase:self.db.database];
+                
+                // the object was saved again after its revision was listed, and that revision is snapshotted already.
+                if ([existingSnapshottedObjectIDs containsObject:snapshottedObjectID]) {
+                    [snapshottedObjectIDs addObject:snapshottedObjectID];
+                    continue;
+                }
+                
+                MPSnapshottedObject *so = [[MPSnapshottedObject alloc] initWithController:self.snapshottedObjectsController snapshot:snapshot snapshottedObject:mo];
+                [batch addObject:so];
+            }
+            
+            if (batch.count > 0 && ![MPManagedObject saveModels:batch error:err])
+                return NO;
+            
+            [snapshottedObjectIDs addObjectsFromArray:[batch valueForKey:@"documentID"]];
+        }
+    }
+    
+    return YES;
+}
+
+- (BOOL)isSnapshottableDocumentWithID:(NSString *)docID
+{
+    return [self controllerForSnapshottableDocumentWithID:docID] != nil;
+}
+
+- (MPManagedObjectsController *)controllerForSnapshottableDocumentWithID:(NSString *)docID
+{
+    NSRange separatorRange = [docID rangeOfString:@":"];
+    if (separatorRange.location == NSNotFound)
+        return nil;
+    
+    // MPMetadata, MPLocalMetadata and design documents are not managed objects.
+    Class cls = NSClassFromString([docID substringToIndex:separatorRange.location]);
+    if (![cls isSubclassOfClass:MPManagedObject.class])
+        return nil;
+    
+    if (![self.packageController controllerExistsForManagedObjectClass:cls])
+        return nil;
+    
+    return [self.packageController controllerForManagedObjectClass:cls];
+}
+
+#pragma mark - Restoring snapshots
+
+- (BOOL)restoreSnapshot:(MPSnapshot *)snapshot
+            toDatabases:(NSArray<MPDatabase *> *)databases
+          progressQueue:(dispatch_queue_t)progressQueue
+        progressHandler:(void (^)(double))progressHandler
+                  error:(NSError **)err
+{
+    NSParameterAssert(snapshot.document);
+    NSParameterAssert(![databases containsObject:self.db]);
+    
+    NSMutableDictionary<NSString *, NSString *> *snapshottedObjectIDs = [NSMutableDictionary new];
+    __block NSMutableDictionary<NSString *, NSString *> *snapshottedRevisionIDs = nil;
+    
+    // the snapshot's contents from the IDs of its snapshotted objects, without loading them, resolved only for databases whose changes since the snapshot are not known.
+    BOOL (^resolveSnapshottedRevisionIDs)(NSError **) = ^BOOL(NSError **resolveErr) {
+        if (snapshottedRevisionIDs)
+            return YES;
+        
+        NSMutableDictionary<NSString *, NSString *> *revisionIDs = [NSMutableDictionary new];
+        BOOL resolved = [self.snapshottedObjectsController enumerateSnapshottedRevisionsForSnapshot:snapshot
+                                                                                         usingBlock:^(NSString *docID, NSString *revID, NSString *snapshottedObjectID, BOOL *stop) {
+            revisionIDs[docID] = revID;
+            snapshottedObjectIDs[docID] = snapshottedObjectID;
+        } error:resolveErr];
+        
+        if (resolved)
+            snapshottedRevisionIDs = revisionIDs;
+        return resolved;
+    };
+    
+    // a snapshot taken before snapshots listed their contents only has the objects it created itself:
+    // which objects existed when it was taken is unknown, so it restores them without deleting any.
+    BOOL deletesObjects = snapshot.listsSnapshottedObjects;
+    
+    NSMutableArray<NSArray<NSString *> *> *restoredDocIDsByDatabase = [NSMutableArray arrayWithCapacity:databases.count];
+    NSMutableArray<NSArray<NSString *> *> *deletedDocIDsByDatabase = [NSMutableArray arrayWithCapacity:databases.count];
+    NSUInteger totalCount = 0;
+    
+    for (MPDatabase *db in databases) {
+        NSArray<NSString *> *restoredDocIDs = nil;
+        NSArray<NSString *> *deletedDocIDs = nil;
+        NSNumber *sequenceNumber = deletesObjects ? snapshot.snapshottedSequenceNumbers[db.name] : nil;
+        
+        // the documents changed since the snapshot are diffed against it, rather than every document against its full contents.
+        BOOL diffed = sequenceNumber && [self getRestoredDocumentIDs:&restoredDocIDs
+                                                  deletedDocumentIDs:&deletedDocIDs
+                                                snapshottedObjectIDs:snapshottedObjectIDs
+                                          changedSinceSequenceNumber:sequenceNumber.unsignedLongLongValue
+                                                          inDatabase:db];
+        
+        if (!diffed) {
+            if (!resolveSnapshottedRevisionIDs(err))
+                return NO;
+            
+            if (![self getRestoredDocumentIDs:&restoredDocIDs
+                           deletedDocumentIDs:deletesObjects ? &deletedDocIDs : NULL
+                    forSnapshottedRevisionIDs:snapshottedRevisionIDs
+                                   inDatabase:db
+                                        error:err])
+                return NO;
+        }
+        
+        [restoredDocIDsByDatabase addObject:restoredDocIDs];
+        [deletedDocIDsByDatabase addObject:deletedDocIDs ?: @[]];
+        totalCount += restoredDocIDs.count + deletedDocIDs.count;
+    }
+    
+    // progress is reported asynchronously, so that the handler runs outside the transactions restoring the objects.
+    dispatch_queue_t queue = progressQueue ?: dispatch_get_main_queue();
+    void (^reportProgress)(double) = progressHandler ? ^(double fraction) {
+        dispatch_async(queue, ^{
+            progressHandler(fraction);
+        });
+    } : nil;
+    
+    if (reportProgress)
+        reportProgress(0.0);
+    
+    __block NSUInteger completedCount = 0;
+    __block double reportedFraction = 0.0;
+    void (^objectRestored)(void) = reportProgress ? ^{
+        double fraction = (double)++completedCount / totalCount;
+        if (completedCount < totalCount && fraction - reportedFraction >= MPSnapshotsControllerProgressGranularity) {
+            reportedFraction = fraction;
+            reportProgress(fraction);
+        }
+    } : nil;
+    
+    for (NSUInteger i = 0; i < databases.count; i++) {
+        if (![self restoreDocumentIDs:restoredDocIDsByDatabase[i]
+                  deleteDocumentIDs:deletedDocIDsByDatabase[i]
+               snapshottedObjectIDs:snapshottedObjectIDs
+                         inDatabase:databases[i]
+                     objectRestored:objectRestored
+                              error:err])
+            return NO;
+    }
+    
+    if (reportProgress)
+        reportProgress(1.0);
+    
+    return YES;
+}
+
+/** The objects of a database changed since the sequence number its snapshot was listed at, which are read from the database's revision history
+  * rather than from all its documents: those which existed at the snapshot are restored to their revision then, and the others deleted.
+  * Objects with unsaved changes are restored to their saved revision. The snapshotted objects of the restored revisions are added to snapshottedObjectIDs.
+  * @return NO if the revisions at the snapshot cannot all be told from the history, or their snapshotted objects are missing, for the snapshot's full contents to be compared instead. */
+- (BOOL)getRestoredDocumentIDs:(NSArray<NSString *> **)restoredDocIDs
+            deletedDocumentIDs:(NSArray<NSString *> **)deletedDocIDs
+          snapshottedObjectIDs:(NSMutableDictionary<NSString *, NSString *> *)snapshottedObjectIDs
+    changedSinceSequenceNumber:(UInt64)sequenceNumber
+                    inDatabase:(MPDatabase *)db
+{
+    MPDatabasePackageController *pkgc = self.packageController;
+    NSMutableDictionary<NSString *, NSString *> *restoredObjectIDs = [NSMutableDictionary new];
+    NSMutableArray<NSString *> *deleted = [NSMutableArray new];
+    __block BOOL known = YES;
+    
+    BOOL success = [db.readerPool performRead:^(MPDatabaseReader *reader) {
+        // a database replaced since the snapshot has a history of its own.
+        if (reader.lastSequenceNumber < sequenceNumber) {
+            known = NO;
+            return;
+        }
+        
+        known = [reader enumerateDocumentsChangedSinceSequenceNumber:sequenceNumber
+                                                          usingBlock:^(NSString *docID, BOOL isDeleted, NSString *pastRevID, BOOL pastRevisionKnown, BOOL *stop) {
+            if (![self isSnapshottableDocumentWithID:docID])
+                return;
+            
+            if (!pastRevisionKnown) {
+                known = NO;
+                *stop = YES;
+            }
+            else if (pastRevID) {
+                restoredObjectIDs[docID] = [MPSnapshottedObject idForSnapshottedObjectWithDocumentID:docID revisionID:pastRevID inDatabase:self.db.database];
+            }
+            else if (!isDeleted) {
+                [deleted addObject:docID];
+            }
+        } error:nil] && known;
+    } error:nil];
+    
+    if (!success || !known)
+        return NO;
+    
+    // unchanged objects with unsaved changes are at the snapshot's revision, which is written again to discard the changes.
+    for (MPManagedObjectsController *moc in pkgc.managedObjectsControllers) {
+        if (moc.db != db)
+            continue;
+        
+        for (MPManagedObject *mo in moc.objectCache.dirtyObjects) {
+            __block NSString *revID = nil;
+            mp_dispatch_sync(db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+                revID = mo.document.currentRevisionID;
+            });
+            
+            if (revID && !restoredObjectIDs[mo.documentID] && ![deleted containsObject:mo.documentID] && [self isSnapshottableDocumentWithID:mo.documentID])
+                restoredObjectIDs[mo.documentID] = [MPSnapshottedObject idForSnapshottedObjectWithDocumentID:mo.documentID revisionID:revID inDatabase:self.db.database];
+        }
+    }
+    
+    // a revision reconstructed from the history is restored only if it was snapshotted.
+    if (restoredObjectIDs.count > 0) {
+        mp_dispatch_sync(self.db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+            CBLQuery *q = [self.db.database createAllDocumentsQuery];
+            q.keys = restoredObjectIDs.allValues;
+            
+            NSUInteger snapshottedCount = 0;
+            for (CBLQueryRow *row in [q run:nil]) {
+                if (row.documentRevisionID && ![row.value[@"deleted"] boolValue])
+                    snapshottedCount++;
+            }
+            known = snapshottedCount == restoredObjectIDs.count;
+        });
+        
+        if (!known)
+            return NO;
+    }
+    
+    [snapshottedObjectIDs addEntriesFromDictionary:restoredObjectIDs];
+    *restoredDocIDs = restoredObjectIDs.allKeys;
+    *deletedDocIDs = deleted;
+    
+    return YES;
+}
+
+/** The objects of a database whose revision differs from the snapshot's (or which have been deleted since) are restored,
+  * and if deletedDocIDs is given, objects created after the snapshot are deleted. */
+- (BOOL)getRestoredDocumentIDs:(NSArray<NSString *> **)restoredDocIDs
+            deletedDocumentIDs:(NSArray<NSString *> **)deletedDocIDs
+     forSnapshottedRevisionIDs:(NSDictionary<NSString *, NSString *> *)snapshottedRevisionIDs
+                    inDatabase:(MPDatabase *)db
+                         error:(NSError **)err
+{
+    MPDatabasePackageController *pkgc = self.packageController;
+    NSMutableDictionary<NSString *, NSString *> *currentRevisionIDs = [NSMutableDictionary new];
+    __block BOOL success = YES;
+    
+    mp_dispatch_sync(db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+        CBLQueryEnumerator *rows = [[db.database createAllDocumentsQuery] run:err];
+        if (!rows) {
+            success = NO;
+            return;
+        }
+        
+        for (CBLQueryRow *row in rows) {
+            if (row.documentRevisionID && [self isSnapshottableDocumentWithID:row.documentID])
+                currentRevisionIDs[row.documentID] = row.documentRevisionID;
+        }
+    });
+    
+    if (!success)
+        return NO;
+    
+    NSMutableArray<NSString *> *restored = [NSMutableArray new];
+    [snapshottedRevisionIDs enumerateKeysAndObjectsUsingBlock:^(NSString *docID, NSString *revID, BOOL *stop) {
+        MPManagedObjectsController *moc = [self controllerForSnapshottableDocumentWithID:docID];
+        if (moc.db != db)
+            return;
+        
+        MPManagedObject *cachedObject = [moc cachedObjectWithIdentifier:docID];
+        if ([currentRevisionIDs[docID] isEqualToString:revID] && !cachedObject.needsSave)
+            return;
+        
+        [restored addObject:docID];
+    }];
+    *restoredDocIDs = restored;
+    
+    if (deletedDocIDs) {
+        NSMutableArray<NSString *> *deleted = [NSMutableArray new];
+        for (NSString *docID in currentRevisionIDs) {
+            if (!snapshottedRevisionIDs[docID])
+                [deleted addObject:docID];
+        }
+        *deletedDocIDs = deleted;
+    }
+    
+    return YES;
+}
+
+- (BOOL)restoreDocumentIDs:(NSArray<NSString *> *)restoredDocIDs
+         deleteDocumentIDs:(NSArray<NSString *> *)deletedDocIDs
+      snapshottedObjectIDs:(NSDictionary<NSString *, NSString *> *)snapshottedObjectIDs
+                inDatabase:(MPDatabase *)db
+            objectRestored:(void (^)(void))objectRestored
+                     error:(NSError **)err
+{
+    if (restoredDocIDs.count == 0 && deletedDocIDs.count == 0)
+        return YES;
+    
+    // unsaved changes would otherwise be saved on top of the restored revisions.
+    for (NSString *docID in [restoredDocIDs arrayByAddingObjectsFromArray:deletedDocIDs]) {
+        MPManagedObject *cachedObject = [[self controllerForSnapshottableDocumentWithID:docID] cachedObjectWithIdentifier:docID];
+        if (cachedObject.needsSave)
+            [cachedObject revertChanges];
+    }
+    
+    MPDatabasePackageController *pkgc = self.packageController;
+    __block BOOL success = YES;
+    __block NSError *restoreErr = nil;
+    
+    // the snapshotted properties are read on the snapshots database's queue, and written on the restored database's queue.
+    NSMutableDictionary<NSString *, NSDictionary *> *snapshottedProperties = [NSMutableDictionary dictionaryWithCapacity:restoredDocIDs.count];
+    if (restoredDocIDs.count > 0) {
+        mp_dispatch_sync(self.db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+            CBLQuery *q = [self.db.database createAllDocumentsQuery];
+            q.keys = [snapshottedObjectIDs objectsForKeys:restoredDocIDs notFoundMarker:[NSNull null]];
+            q.prefetch = YES;
+            
+            CBLQueryEnumerator *rows = [q run:&restoreErr];
+            if (!rows) {
+                success = NO;
+                return;
+            }
+            
+            for (CBLQueryRow *row in rows) {
+                NSString *docID = nil;
+                if ([MPSnapshottedObject getDocumentID:&docID revisionID:NULL fromSnapshottedObjectID:row.key]
+                    && row.documentProperties[@"snapshottedProperties"])
+                    snapshottedProperties[docID] = row.documentProperties[@"snapshottedProperties"];
+            }
+        });
+    }
+    
+    if (!success) {
+        if (err)
+            *err = restoreErr;
+        return NO;
+    }
+    
+    mp_dispatch_sync(db.database.manager.dispatchQueue, [pkgc serverQueueToken], ^{
+        success = [db.database inTransaction:^BOOL{
+            for (NSString *docID in restoredDocIDs) {
+                NSDictionary *props = snapshottedProperties[docID];
+                if (!props) {
+                    restoreErr = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                                     code:MPDatabasePackageControllerErrorCodeNoSuchSnapshot
+                                                 userInfo:@{ NSLocalizedDescriptionKey :
+                                                                 [NSString stringWithFormat:@"Missing snapshotted object %@", snapshottedObjectIDs[docID]] }];
+                    return NO;
+                }
+                
+                CBLDocument *doc = [db.database documentWithID:docID];
+                
+                // attachments are not snapshotted, so the current ones are kept.
+                NSMutableDictionary *restoredProps = [props mutableCopy];
+                [restoredProps removeObjectsForKeys:@[ @"_id", @"_rev", @"_attachments", @"_deleted" ]];
+                if (doc.properties[@"_attachments"])
+                    restoredProps[@"_attachments"] = doc.properties[@"_attachments"];
+                if (doc.currentRevisionID)
+                    restoredProps[@"_rev"] = doc.currentRevisionID;
+                
+                if (![doc putProperties:restoredProps error:&restoreErr])
+                    return NO;
+                
+                if (objectRestored)
+                    objectRestored();
+            }
+            
+            for (NSString *docID in deletedDocIDs) {
+                CBLDocument *doc = [db.database existingDocumentWithID:docID];
+                if (doc && ![doc deleteDocument:&restoreErr])
+                    return NO;
+                
+                if (objectRestored)
+                    objectRestored();
+            }
+            
+            return YES;
+        }];
+    });
+    
+    if (!success && err)
+        *err = restoreErr;
+    
+    return success;
+}
+
+#pragma mark - Deleting snapshots
+
+- (BOOL)prepareToDeleteObject:(MPManagedObject *)object error:(NSError **)err
+{
+    if (![super prepareToDeleteObject:object error:err])
+        return NO;
+    
+    MPSnapshot *snapshot = (MPSnapshot *)object;
+    NSParameterAssert([snapshot isKindOfClass:MPSnapshot.class]);
+    
+    MPSnapshot *baseSnapshot = snapshot.baseSnapshotID ? [self objectWithIdentifier:snapshot.baseSnapshotID] : nil;
+    
+    // the snapshots listed relative to the deleted snapshot are listed relative to its base instead,
+    // with the two differences combined, or in full if the deleted snapshot lists its contents in full.
+    for (MPSnapshot *successor in [self objectsMatchingQueriedView:@"snapshotsByBaseSnapshotID" keys:@[ snapshot.documentID ]]) {
+        if (baseSnapshot.listsSnapshottedObjects) {
+            NSArray<NSString *> *added = snapshot.addedSnapshottedObjectIDs, *removed = snapshot.removedSnapshottedObjectIDs;
+            NSArray<NSString *> *successorAdded = successor.addedSnapshottedObjectIDs, *successorRemoved = successor.removedSnapshottedObjectIDs;
+            
+            // an object added by one difference and removed by the other is in neither combined list.
+            [successor setBaseSnapshot:baseSnapshot
+             addedSnapshottedObjectIDs:MPSnapshottedObjectIDsUnion(added, successorRemoved, successorAdded, removed)
+           removedSnapshottedObjectIDs:MPSnapshottedObjectIDsUnion(removed, successorAdded, successorRemoved, added)];
+        }
+        else {
+            NSArray<NSString *> *snapshottedObjectIDs = [self snapshottedObjectIDsForSnapshot:successor error:err];
+            if (!snapshottedObjectIDs)
+                return NO;
+            
+            successor.snapshottedObjectIDs = snapshottedObjectIDs;
+        }
+        
+        if (![successor save:err])
+            return NO;
+    }
+    
+    return YES;
+}
+
 - (void)configureViews
 {
     [super configureViews];
+    
+    // the snapshots listed relative to a snapshot, which are listed relative to its base instead when it is deleted.
+    [self viewNamed:@"snapshotsByBaseSnapshotID" setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
+     {
+         if ([doc[@"objectType"] isEqualToString:@"MPSnapshot"] && doc[@"baseSnapshotID"])
+             emit(doc[@"baseSnapshotID"], nil);
+     } version:@"1.0"];
 }
 
 - (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot
@@ -86,6 +683,34 @@
     return [self.snapshottedObjectsController snapshottedObjectsForSnapshot:snapshot];
 }
 
+- (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot offset:(NSUInteger)offset limit:(NSUInteger)limit
+{
+    assert(_snapshottedObjectsController);
+    return [self.snapshottedObjectsController snapshottedObjectsForSnapshot:snapshot offset:offset limit:limit];
+}
+
+- (NSArray<NSString *> *)snapshottedObjectIDsForSnapshot:(MPSnapshot *)snapshot error:(NSError **)err
+{
+    assert(_snapshottedObjectsController);
+    return [self.snapshottedObjectsController snapshottedObjectIDsForSnapshot:snapshot error:err];
+}
+
+- (BOOL)enumerateSnapshottedPropertiesForSnapshot:(MPSnapshot *)snapshot
+                                       usingBlock:(MPSnapshottedPropertiesBlock)block
+                                            error:(NSError **)err
+{
+    assert(_snapshottedObjectsController);
+    return [self.snapshottedObjectsController enumerateSnapshottedPropertiesForSnapshot:snapshot usingBlock:block error:err];
+}
+
+- (BOOL)enumerateSnapshottedRevisionsForSnapshot:(MPSnapshot *)snapshot
+                                      usingBlock:(MPSnapshottedRevisionBlock)block
+                                           error:(NSError **)err
+{
+    assert(_snapshottedObjectsController);
+    return [self.snapshottedObjectsController enumerateSnapshottedRevisionsForSnapshot:snapshot usingBlock:block error:err];
+}
+
 - (MPSnapshottedAttachment *)snapshottedAttachmentForSHA:(NSString *)sha
 {
     assert(_snapshottedAttachmentsController);
@@ -101,11 +726,27 @@
 @end
 
 @implementation MPSnapshottedObjectsController
+{
+    /** Resolved snapshot contents, keyed by snapshot document ID and revision, so that reading a snapshot a page at a time resolves it once. */
+    NSCache<NSString *, NSArray<NSString *> *> *_snapshottedObjectIDsCache;
+}
+
+- (instancetype)initWithPackageController:(MPDatabasePackageController *)packageController
+                                 database:(MPDatabase *)db
+                                    error:(NSError *__autoreleasing *)err
+{
+    if (self = [super initWithPackageController:packageController database:db error:err])
+    {
+        _snapshottedObjectIDsCache = [NSCache new];
+    }
+    
+    return self;
+}
 
 - (instancetype)initWithSnapshotsController:(MPSnapshotsController *)controller
                                       error:(NSError **)err
 {
-    if (self = [super initWithPackageController:controller.packageController database:controller.db error:err])
+    if (self = [self initWithPackageController:controller.packageController database:controller.db error:err])
     {
         _snapshotsController = controller;
     }
@@ -117,26 +758,144 @@
 {
     [super configureViews];
     
+    // snapshotted objects are shared between snapshots, whose lists of them are resolved by -snapshottedObjectIDsForSnapshot:error:.
+    // snapshots taken before snapshots listed their contents consist of the snapshotted objects created for them, indexed here.
     [self viewNamed:@"snapshottedObjectsBySnapshotID" setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
-         if ([doc[@"objectType"] isEqualToString:@"MPSnapshottedObject"])
-             emit(doc[@"snapshotID"], nil);
-     } version:@"1.0"];
+         if ([doc[@"objectType"] isEqualToString:@"MPSnapshottedObject"] && doc[@"snapshot"])
+             emit(doc[@"snapshot"], nil);
+     } version:@"3.0"];
 }
 
-- (CBLQuery *)snapshottedObjectsQueryForSnapshot:(MPSnapshot *)snapshot
+- (NSArray<NSString *> *)snapshottedObjectIDsForSnapshot:(MPSnapshot *)snapshot error:(NSError **)err
 {
-    CBLQuery *q = [[self.db.database viewNamed:@"snapshottedObjectsBySnapshotID"] createQuery];
-    q.prefetch = YES;
-    assert(q);
+    NSParameterAssert(snapshot.documentID);
+    
+    NSString *cacheKey = [NSString stringWithFormat:@"%@ %@", snapshot.documentID, snapshot.document.currentRevisionID];
+    NSArray<NSString *> *snapshottedObjectIDs = [_snapshottedObjectIDsCache objectForKey:cacheKey];
+    if (!snapshottedObjectIDs) {
+        snapshottedObjectIDs = [self resolveSnapshottedObjectIDsForSnapshot:snapshot error:err];
+        if (snapshottedObjectIDs && !snapshot.needsSave)
+            [_snapshottedObjectIDsCache setObject:snapshottedObjectIDs forKey:cacheKey];
+    }
+    
+    return snapshottedObjectIDs;
+}
+
+- (NSArray<NSString *> *)resolveSnapshottedObjectIDsForSnapshot:(MPSnapshot *)snapshot error:(NSError **)err
+{
+    if (!snapshot.listsSnapshottedObjects)
+        return [self snapshottedObjectIDsForUnlistedSnapshot:snapshot error:err];
+    
+    if (snapshot.snapshottedObjectIDs)
+        return snapshot.snapshottedObjectIDs;
+    
+    NSMutableArray<NSDictionary *> *incrementalListings
+        = [NSMutableArray arrayWithObject:@{ @"addedSnapshottedObjectIDs" : snapshot.addedSnapshottedObjectIDs,
+                                             @"removedSnapshottedObjectIDs" : snapshot.removedSnapshottedObjectIDs }];
+    NSString *baseSnapshotID = snapshot.baseSnapshotID;
+    __block NSArray<NSString *> *fullListing = nil;
+    __block NSString *missingSnapshotID = nil;
+    
+    // the listings of the base snapshots, back to the one listing its contents in full.
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        NSString *snapshotID = baseSnapshotID;
+        while (!fullListing) {
+            NSDictionary *properties = snapshotID ? [self.db.database existingDocumentWithID:snapshotID].properties : nil;
+            if (!properties) {
+                missingSnapshotID = snapshotID ?: snapshot.documentID;
+                return;
+            }
+            
+            fullListing = properties[@"snapshottedObjectIDs"];
+            if (!fullListing) {
+                [incrementalListings addObject:properties];
+                snapshotID = properties[@"baseSnapshotID"];
+            }
+        }
+    });
+    
+    if (!fullListing) {
+        if (err)
+            *err = [NSError errorWithDomain:MPDatabasePackageControllerErrorDomain
+                                       code:MPDatabasePackageControllerErrorCodeNoSuchSnapshot
+                                   userInfo:@{ NSLocalizedDescriptionKey :
+                                                   [NSString stringWithFormat:@"Missing base snapshot %@ of snapshot %@", missingSnapshotID, snapshot.documentID] }];
+        return nil;
+    }
     
+    NSMutableOrderedSet<NSString *> *snapshottedObjectIDs = [NSMutableOrderedSet orderedSetWithArray:fullListing];
+    for (NSDictionary *listing in incrementalListings.reverseObjectEnumerator) {
+        [snapshottedObjectIDs removeObjectsInArray:listing[@"removedSnapshottedObjectIDs"] ?: @[]];
+        [snapshottedObjectIDs addObjectsFromArray:listing[@"addedSnapshottedObjectIDs"] ?: @[]];
+    }
+    
+    return snapshottedObjectIDs.array;
+}
+
+- (NSArray<NSString *> *)snapshottedObjectIDsForUnlistedSnapshot:(MPSnapshot *)snapshot error:(NSError **)err
+{
+    CBLQuery *q = [self.db createQueryForViewNamed:@"snapshottedObjectsBySnapshotID"];
+    q.keys = @[ snapshot.documentID ];
+    
+    __block NSMutableArray<NSString *> *snapshottedObjectIDs = nil;
+    mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+        CBLQueryEnumerator *rows = [q run:err];
+        if (!rows)
+            return;
+        
+        snapshottedObjectIDs = [NSMutableArray arrayWithCapacity:rows.count];
+        for (CBLQueryRow *row in rows)
+            [snapshottedObjectIDs addObject:row.documentID];
+    });
+    
+    return snapshottedObjectIDs;
+}
+
+- (CBLQuery *)snapshottedObjectsQueryForSnapshottedObjectIDs:(NSArray<NSString *> *)snapshottedObjectIDs
+{
+    CBLQuery *q = [self.db.database createAllDocumentsQuery];
+    q.keys = snapshottedObjectIDs;
+    q.prefetch = YES;
     return q;
 }
 
+- (CBLQuery *)snapshottedObjectsQueryForSnapshot:(MPSnapshot *)snapshot
+{
+    return [self snapshottedObjectsQueryForSnapshot:snapshot offset:0 limit:NSUIntegerMax];
+}
+
+- (CBLQuery *)snapshottedObjectsQueryForSnapshot:(MPSnapshot *)snapshot offset:(NSUInteger)offset limit:(NSUInteger)limit
+{
+    NSError *err = nil;
+    NSArray<NSString *> *snapshottedObjectIDs = [self snapshottedObjectIDsForSnapshot:snapshot error:&err];
+    if (!snapshottedObjectIDs) {
+        [[(id)self.packageController notificationCenter] postErrorNotification:err];
+        return nil;
+    }
+    
+    offset = MIN(offset, snapshottedObjectIDs.count);
+    limit = MIN(limit, snapshottedObjectIDs.count - offset);
+    return [self snapshottedObjectsQueryForSnapshottedObjectIDs:[snapshottedObjectIDs subarrayWithRange:NSMakeRange(offset, limit)]];
+}
+
 - (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot
 {
+    return [self snapshottedObjectsForQuery:[self snapshottedObjectsQueryForSnapshot:snapshot]];
+}
+
+- (NSArray *)snapshottedObjectsForSnapshot:(MPSnapshot *)snapshot offset:(NSUInteger)offset limit:(NSUInteger)limit
+{
+    return [self snapshottedObjectsForQuery:[self snapshottedObjectsQueryForSnapshot:snapshot offset:offset limit:limit]];
+}
+
+- (NSArray *)snapshottedObjectsForQuery:(CBLQuery *)query
+{
+    if (!query)
+        return nil;
+    
     NSError *err = nil;
-    CBLQueryEnumerator *qenum = [[self snapshottedObjectsQueryForSnapshot:snapshot] run:&err];
+    CBLQueryEnumerator *qenum = [query run:&err];
     if (!qenum)
     {
         assert(err);
@@ -145,6 +904,81 @@
     return [self managedObjectsForQueryEnumerator:qenum];
 }
 
+- (BOOL)enumerateSnapshottedRevisionsForSnapshot:(MPSnapshot *)snapshot
+                                      usingBlock:(MPSnapshottedRevisionBlock)block
+                                           error:(NSError **)err
+{
+    NSParameterAssert(block);
+    
+    NSArray<NSString *> *snapshottedObjectIDs = [self snapshottedObjectIDsForSnapshot:snapshot error:err];
+    if (!snapshottedObjectIDs)
+        return NO;
+    
+    BOOL stop = NO;
+    for (NSString *snapshottedObjectID in snapshottedObjectIDs) {
+        NSString *docID = nil;
+        NSString *revID = nil;
+        if (![MPSnapshottedObject getDocumentID:&docID revisionID:&revID fromSnapshottedObjectID:snapshottedObjectID])
+            continue;
+        
+        block(docID, revID, snapshottedObjectID, &stop);
+        if (stop)
+            break;
+    }
+    
+    return YES;
+}
+
+- (BOOL)enumerateSnapshottedPropertiesForSnapshot:(MPSnapshot *)snapshot
+                                       usingBlock:(MPSnapshottedPropertiesBlock)block
+                                            error:(NSError **)err
+{
+    NSParameterAssert(block);
+    
+    NSArray<NSString *> *snapshottedObjectIDs = [self snapshottedObjectIDsForSnapshot:snapshot error:err];
+    if (!snapshottedObjectIDs)
+        return NO;
+    
+    // prefetched rows are loaded by the query as a whole, so the snapshot is read a page at a time.
+    const NSUInteger pageSize = MPDatabaseQueryRowChunkSize;
+    __block BOOL success = YES;
+    __block BOOL stop = NO;
+    __block NSError *queryErr = nil;
+    
+    for (NSUInteger offset = 0; success && !stop && offset < snapshottedObjectIDs.count; offset += pageSize) {
+        NSArray<NSString *> *pageIDs = [snapshottedObjectIDs subarrayWithRange:NSMakeRange(offset, MIN(pageSize, snapshottedObjectIDs.count - offset))];
+        
+        mp_dispatch_sync(self.db.database.manager.dispatchQueue, [self.packageController serverQueueToken], ^{
+            @autoreleasepool {
+                NSError *e = nil;
+                CBLQueryEnumerator *rows = [[self snapshottedObjectsQueryForSnapshottedObjectIDs:pageIDs] run:&e];
+                queryErr = e;
+                if (!rows) {
+                    success = NO;
+                    return;
+                }
+                
+                for (CBLQueryRow *row in rows) {
+                    NSString *docID = nil;
+                    NSString *revID = nil;
+                    NSDictionary *properties = row.documentProperties[@"snapshottedProperties"];
+                    if (!properties || ![MPSnapshottedObject getDocumentID:&docID revisionID:&revID fromSnapshottedObjectID:row.key])
+                        continue;
+                    
+                    block(docID, revID, properties, &stop);
+                    if (stop)
+                        break;
+                }
+            }
+        });
+    }
+    
+    if (!success && err)
+        *err = queryErr;
+    
+    return success;
+}
+
 @end
 
 
@@ -168,9 +1002,9 @@
     
     [self viewNamed:@"snapshottedAttachmentsBySnapshotID" setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
-         if ([doc[@"objectType"] isEqualToString:@"MPSnapshottedAttachment"])
-             emit(doc[@"snapshotID"], nil);
-     } version:@"1.0"];
+         if ([doc[@"objectType"] isEqualToString:@"MPSnapshottedAttachment"] && doc[@"snapshot"])
+             emit(doc[@"snapshot"], nil);
+     } version:@"1.1"];
     
     [self viewNamed:@"snapshottedAttachmentsBySHA" setMapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit)
      {
@@ -181,7 +1015,24 @@
 
 - (CBLQuery *)snapshottedAttachmentsQueryForSnapshot:(MPSnapshot *)snapshot
 {
-    CBLQuery *q = [[self.db.database viewNamed:@"snapshottedAttachmentsBySnapshotID"] createQuery];
+    NSParameterAssert(snapshot.documentID);
+    
+    CBLQuery *q = [self.db createQueryForViewNamed:@"snapshottedAttachmentsBySnapshotID"];
+    q.keys = @[ snapshot.documentID ];
+    q.prefetch = YES;
+    return q;
+}
+
+- (CBLQuery *)snapshottedAttachmentsQueryForSnapshot:(MPSnapshot *)snapshot afterDocumentID:(NSString *)documentID limit:(NSUInteger)limit
+{
+    NSParameterAssert(snapshot.documentID);
+    
+    // the page starts from the given row by key rather than by skipping the rows before it.
+    CBLQuery *q = [self.db createQueryForViewNamed:@"snapshottedAttachmentsBySnapshotID"];
+    q.startKey = snapshot.documentID;
+    q.endKey = snapshot.documentID;
+    q.startKeyDocID = documentID;
+    q.limit = limit + (documentID ? 1 : 0);
     q.prefetch = YES;
     return q;
 }
@@ -202,7 +1053,7 @@
 
 - (CBLQuery *)snapshottedAttachmentsQueryForSHA:(NSString *)sha
 {
-    CBLQuery *q = [[self.db.database viewNamed:@"snapshottedAttachmentsBySHA"] createQuery];
+    CBLQuery *q = [self.db createQueryForViewNamed:@"snapshottedAttachmentsBySHA"];
     q.prefetch = YES;
     q.keys = @[sha];
     return q;
@@ -0,0 +1,25 @@
+//
+//  MPDecodedPropertyValueCache.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Values decoded from the raw values of an object's properties, such as the embedded objects of an embedded object array.
+  * A decoded value is returned only for the very raw value it was decoded from (compared by identity, and held strongly so that
+  * its address cannot be reused): a property whose raw value has been replaced is decoded again. */
+@interface MPDecodedPropertyValueCache : NSObject
+
+/** The value decoded from the raw value of the property, or nil if the property's raw value has changed since it was decoded. */
+- (nullable id)decodedValueOfProperty:(nonnull NSString *)property rawValue:(nullable id)rawValue;
+
+- (void)setDecodedValue:(nonnull id)decodedValue ofProperty:(nonnull NSString *)property rawValue:(nonnull id)rawValue;
+
+- (void)removeDecodedValueOfProperty:(nonnull NSString *)property;
+
+- (void)removeAllDecodedValues;
+
+@end
@@ -0,0 +1,76 @@
+//
+//  MPDecodedPropertyValueCache.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPDecodedPropertyValueCache.h"
+
+@interface MPDecodedPropertyValue : NSObject
+{
+@public
+    id _rawValue;
+    id _decodedValue;
+}
+@end
+
+@implementation MPDecodedPropertyValue
+@end
+
+@implementation MPDecodedPropertyValueCache
+{
+    NSMutableDictionary<NSString *, MPDecodedPropertyValue *> *_values;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _values = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (id)decodedValueOfProperty:(NSString *)property rawValue:(id)rawValue
+{
+    if (!rawValue)
+        return nil;
+
+    @synchronized (self) {
+        MPDecodedPropertyValue *value = _values[property];
+        return value && value->_rawValue == rawValue ? value->_decodedValue : nil;
+    }
+}
+
+- (void)setDecodedValue:(id)decodedValue ofProperty:(NSString *)property rawValue:(id)rawValue
+{
+    NSParameterAssert(decodedValue);
+    NSParameterAssert(rawValue);
+
+    @synchronized (self) {
+        MPDecodedPropertyValue *value = _values[property];
+        if (!value) {
+            value = [MPDecodedPropertyValue new];
+            _values[property] = value;
+        }
+        value->_rawValue = rawValue;
+        value->_decodedValue = decodedValue;
+    }
+}
+
+- (void)removeDecodedValueOfProperty:(NSString *)property
+{
+    @synchronized (self) {
+        [_values removeObjectForKey:property];
+    }
+}
+
+- (void)removeAllDecodedValues
+{
+    @synchronized (self) {
+        [_values removeAllObjects];
+    }
+}
+
+@end
@@ -18,6 +18,7 @@
 @import FeatherExtensions;
 
 #import "MPDeepSaver.h"
+#import "MPDecodedPropertyValueCache.h"
 
 #import "Mixin.h"
 
@@ -31,6 +32,7 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
 @interface MPEmbeddedObject ()
 {
     NSString *_embeddingKey;
+    MPDecodedPropertyValueCache *_decodedPropertyValues;
 }
 @property (readwrite, strong) NSMutableDictionary *embeddedObjectCache;
 @end
@@ -267,6 +269,8 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
     
     MPManagedObject *o = ((MPManagedObject *)self.embeddingObject);
     
+    [_decodedPropertyValues removeDecodedValueOfProperty:property];
+    
     if (value) {
         _properties[property] = value;
         _needsSave = true;
@@ -320,6 +324,10 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
 
 - (void)cacheValue:(id)value ofProperty:(NSString *)property changed:(BOOL)changed {
     NSAssert(property, @"Attempting to set value of property with nil property argument: %@", self);
+    
+    // reached when an embedded object in the property's collection changes.
+    [_decodedPropertyValues removeDecodedValueOfProperty:property];
+
     NSAssert(self.embeddingObject, @"Object should have a non-nil embeddingObject: %@", self);
     NSAssert(self.embeddingKey, @"Object should have a non-nil embeddingKey: %@", self);
     NSAssert(_properties, @"Object should have its _properties set when setting value to a property: %@", self);
@@ -624,6 +632,10 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
     
     assert([rawValue isKindOfClass:[NSArray class]]);
     
+    NSArray *decodedObjs = [_decodedPropertyValues decodedValueOfProperty:property rawValue:rawValue];
+    if (decodedObjs)
+        return decodedObjs;
+    
     NSMutableArray *embeddedObjs = [NSMutableArray arrayWithCapacity:rawValue.count];
     for (id rawObj in rawValue) {
         if (![rawObj isKindOfClass:[NSString class]]) {
@@ -654,7 +666,9 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
         [embeddedObjs addObject:obj];
     }
     
-    return embeddedObjs;
+    decodedObjs = [embeddedObjs copy];
+    [self cacheDecodedValue:decodedObjs ofProperty:property rawValue:rawValue];
+    return decodedObjs;
 }
 
 - (NSDictionary *)getEmbeddedObjectDictionaryProperty:(NSString *)property
@@ -665,6 +679,10 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
     
     assert([rawValue isKindOfClass:[NSDictionary class]]);
     
+    NSDictionary *decodedObjs = [_decodedPropertyValues decodedValueOfProperty:property rawValue:rawValue];
+    if (decodedObjs)
+        return decodedObjs;
+    
     NSMutableDictionary *embeddedObjs = [NSMutableDictionary dictionaryWithCapacity:rawValue.count];
     for (id key in rawValue)
     {
@@ -705,7 +723,16 @@ NSString *const MPPasteboardTypeEmbeddedObjectIDArray = @"com.piipari.eo.id.arra
         embeddedObjs[key] = obj;
     }
     
-    return embeddedObjs;
+    decodedObjs = [embeddedObjs copy];
+    [self cacheDecodedValue:decodedObjs ofProperty:property rawValue:rawValue];
+    return decodedObjs;
+}
+
+- (void)cacheDecodedValue:(id)decodedValue ofProperty:(NSString *)property rawValue:(id)rawValue
+{
+    if (!_decodedPropertyValues)
+        _decodedPropertyValues = [MPDecodedPropertyValueCache new];
+    [_decodedPropertyValues setDecodedValue:decodedValue ofProperty:property rawValue:rawValue];
 }
 
 - (NSDate *)getDateProperty:(NSString *)property
@@ -11,6 +11,7 @@
 @import CouchbaseLite;
 
 @class MPEmbeddedObject;
+@class MPManagedObjectsBatchChange;
 
 @interface MPManagedObject (Protected)
 
@@ -35,6 +36,23 @@
 
 @property (readwrite, nullable) NSString *cloudKitChangeTag;
 
+/** Updates the timestamps, session ID and change tag of the object before it is written. */
+- (void)prepareForSave;
+
+/** Writes the object's document on the server queue, without calling the controller's save hooks. */
+- (BOOL)saveDocument:(NSError *_Nullable *_Nullable)outError;
+
+/** Records an object saved by -[MPDatabasePackageController performBatchUpdates:error:] into the batch change,
+  * in place of the per-object notifications posted by -saveCompleted. */
+- (void)saveCompletedInBatchChange:(nonnull MPManagedObjectsBatchChange *)batchChange;
+
+/** The values of the properties changed since the object was last saved, with NSNull for removed ones. */
+@property (readonly, nonnull) NSDictionary<NSString *, id> *unsavedChanges;
+
+/** Undoes a save rolled back with the transaction it was made in: the document is reloaded from the database,
+  * and the object is left needing saving with the changes it had before the save. */
+- (void)restoreUnsavedChanges:(nonnull NSDictionary<NSString *, id> *)changes;
+
 @end
 
 // MARK: -
@@ -48,8 +66,13 @@
 - (nullable CBLModel *)getModelProperty:(nonnull NSString *)property;
 - (void)markNeedsSave;
 - (void)markPropertyNeedsSave:(nonnull NSString *)property;
+- (void)didSave;
+
 
+@end
 
+@interface CBLDocument (Private)
+- (void)forgetCurrentRevision;
 @end
 
 @interface CBLModel (PrivateExtensions) <MPEmbeddingObject>
@@ -62,6 +62,7 @@ extern NSString * _Nonnull const MPPasteboardTypeManagedObjectIDArray;
 
 @class MPManagedObjectsController;
 @class MPContributor;
+@class MPAsyncRequest;
 
 /**
  * An abstract base class for all objects contained in a MPDatabase (n per MPDatabase), except for MPMetadata (1 per MPDatabase).
@@ -198,6 +199,23 @@ extern NSString * _Nonnull const MPPasteboardTypeManagedObjectIDArray;
 /** Synonymous to -deleteDocument to make the Swift compiler (that does not like the ambiguous -deleteDocument and -deleteDocument:) happy. Hack hack! */
 - (BOOL)deleteObject;
 
+/** Asynchronous equivalent of -save:. The object is prepared for saving on the calling thread, which should be the main thread,
+  * and written on its database's queue. The save notifications are posted on the main thread before the completion handler
+  * is called on the given queue (the main queue if nil).
+  *
+  * A copy of the object's properties is taken on the calling thread and written on the database's queue, so the object can be changed
+  * while the write is in progress: a changed object is left needing saving with all its changes once the write completes.
+  *
+  * Cancelling the request before the write has begun leaves the object unsaved, but with -willSaveObject: already sent to its
+  * controller and the changes of -prepareForSave (such as updated timestamps) made: these are saved with the object's next save. */
+- (nonnull MPAsyncRequest *)saveWithCompletionQueue:(nullable dispatch_queue_t)queue
+                                  completionHandler:(nonnull void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+
+/** Asynchronous equivalent of -deleteDocument:, with the deletion written on the object's database's queue
+  * and the deletion notification posted on the main thread, as with -saveWithCompletionQueue:completionHandler:. */
+- (nonnull MPAsyncRequest *)deleteWithCompletionQueue:(nullable dispatch_queue_t)queue
+                                    completionHandler:(nonnull void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+
 /** The full-text indexable properties for objects of this class. 
   * Default implementation includes none.
   * @return nil if object should not be included in the full-text index, and an array of property key strings. */
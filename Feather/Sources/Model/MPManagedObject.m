@@ -17,6 +17,9 @@
 
 #import "NSString+MPSearchIndex.h"
 #import "MPDeepSaver.h"
+#import "MPAsyncRequest.h"
+#import "MPAutosaveScheduler.h"
+#import "MPDecodedPropertyValueCache.h"
 #import "Mixin.h"
 #import "MPCacheableMixin.h"
 
@@ -39,6 +42,11 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     __weak MPManagedObjectsController *_controller;
     NSString *_newDocumentID;
     NSString *_cloudKitChangeTag;
+    BOOL _autosavesWithScheduler;
+    MPDecodedPropertyValueCache *_decodedPropertyValues;
+    
+    /** Incremented by every change, to find out if the object was changed while it was being saved asynchronously. */
+    NSUInteger _changeCount;
 }
 
 @property (readwrite) BOOL isNewObject;
@@ -421,6 +429,9 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
 
 + (BOOL)saveModels:(NSArray *)models error:(NSError *__autoreleasing *)outError {
     MPManagedObjectsController *moc = [[models firstObject] controller];
+    if (moc && ![moc.packageController ensureWritable:outError])
+        return NO;
+    
     for (MPManagedObject *mo in models)
     {
         assert([mo isKindOfClass:[MPManagedObject class]]);
@@ -437,6 +448,12 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
         success = [super saveModels:models error:outError];
     });
     
+    if (success) {
+        // saved objects are no longer pinned by the controller's object cache.
+        for (MPManagedObject *mo in models)
+            [moc objectNeedsSaveDidChange:mo];
+    }
+    
     return success;
 }
 
@@ -490,8 +507,23 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     
     NSAssert(_controller, @"Unexpectedly missing controller when attempting to save.");
     NSAssert(self.document, @"Unexpectedly missing document when attempting to save.");
+    
+    if (![_controller.packageController ensureWritable:outError])
+        return NO;
+    
     [_controller willSaveObject:self];
     
+    [self prepareForSave];
+    
+    BOOL success = [self saveDocument:outError];
+    
+    if (success)
+        [self saveCompleted];
+    
+    return success;
+}
+
+- (void)prepareForSave {
     assert(self.document.modelObject);
     if (!self.document.modelObject)
         self.document.modelObject = self;
@@ -507,24 +539,40 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     if (currentChangeTag && savedChangeTag) {
         [self setValue:currentChangeTag ofProperty:@"cloudKitChangeTag"];
     }
+}
 
+- (BOOL)saveDocument:(NSError *__autoreleasing *)outError {
     __block BOOL success = NO;
     
     mp_dispatch_sync(self.database.manager.dispatchQueue, [self.database.packageController serverQueueToken], ^{
         success = [super save:outError];
     });
     
-    if (success) {
-        for (NSString *propertyKey in self.class.embeddedProperties) {
-            MPEmbeddedObject *embeddedObj = [self valueForKey:propertyKey];
-            assert(!embeddedObj
-                   || [embeddedObj isKindOfClass:MPEmbeddedObject.class]);
-            [embeddedObj setNeedsSave:false];
-        }
+    if (success)
+        [self markEmbeddedObjectsSaved];
+    
+    return success;
+}
+
+- (void)markEmbeddedObjectsSaved {
+    for (NSString *propertyKey in self.class.embeddedProperties) {
+        MPEmbeddedObject *embeddedObj = [self valueForKey:propertyKey];
+        assert(!embeddedObj
+               || [embeddedObj isKindOfClass:MPEmbeddedObject.class]);
+        [embeddedObj setNeedsSave:false];
     }
+}
+
+/** Writes properties copied from the object to its document on the server queue, leaving the object itself as it is. */
+- (BOOL)saveDocumentProperties:(NSDictionary *)properties error:(NSError *__autoreleasing *)outError {
+    __block BOOL success = NO;
     
-    if (success)
-        [self saveCompleted];
+    mp_dispatch_sync(self.database.manager.dispatchQueue, [self.database.packageController serverQueueToken], ^{
+        // as in -[CBLModel save:], the document's change notification for the write is not taken for an external change of the object.
+        [self setValue:@YES forKey:@"saving"];
+        success = [self.document putProperties:properties error:outError] != nil;
+        [self setValue:@NO forKey:@"saving"];
+    });
     
     return success;
 }
@@ -541,6 +589,73 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     {
         [_controller didUpdateObject:self];
     }
+    
+    [_controller objectNeedsSaveDidChange:self];
+}
+
+- (void)saveCompletedInBatchChange:(MPManagedObjectsBatchChange *)batchChange {
+    assert(_controller);
+    
+    [batchChange addObject:self
+                changeType:self.isNewObject ? MPChangeTypeAdd : MPChangeTypeUpdate
+                    source:MPManagedObjectChangeSourceInternal];
+    self.isNewObject = NO;
+    
+    [_controller objectNeedsSaveDidChange:self];
+}
+
+- (NSDictionary *)unsavedChanges {
+    NSMutableDictionary *changes = [NSMutableDictionary new];
+    for (NSString *property in [self valueForKey:@"changedNames"])
+        changes[property] = [self getValueOfProperty:property] ?: [NSNull null];
+    
+    return changes;
+}
+
+- (void)restoreUnsavedChanges:(NSDictionary *)changes {
+    // the document's current revision may be one written in a transaction since rolled back.
+    mp_dispatch_sync(self.database.manager.dispatchQueue, [self.database.packageController serverQueueToken], ^{
+        [self.document forgetCurrentRevision];
+    });
+    
+    NSSet *embeddedProperties = self.class.embeddedProperties;
+    [changes enumerateKeysAndObjectsUsingBlock:^(NSString *property, id value, BOOL *stop) {
+        [self cacheValue:value == [NSNull null] ? nil : value ofProperty:property changed:YES];
+        
+        // -saveDocument: marked the embedded objects saved too.
+        if ([embeddedProperties containsObject:property])
+            [[self valueForKey:property] setNeedsSave:true];
+    }];
+    
+    [self markNeedsSave];
+}
+
+- (void)markNeedsSave {
+    BOOL wasDirty = self.needsSave;
+    _changeCount++;
+    [super markNeedsSave];
+    
+    [_controller.packageController objectDidChange:self];
+    
+    // dirty objects are held strongly by the controller's object cache until saved.
+    if (!wasDirty && self.needsSave) {
+        [_controller objectNeedsSaveDidChange:self];
+        
+        if (_autosavesWithScheduler)
+            [_controller.packageController.autosaveScheduler scheduleSaveOfObject:self];
+    }
+}
+
+// autosaving objects are saved together by the package's autosave scheduler, rather than each by CBLModel in a transaction of its own.
+- (bool)autosaves {
+    return _autosavesWithScheduler;
+}
+
+- (void)setAutosaves:(bool)autosaves {
+    _autosavesWithScheduler = autosaves;
+    
+    if (autosaves && self.needsSave)
+        [_controller.packageController.autosaveScheduler scheduleSaveOfObject:self];
 }
 
 - (BOOL)deleteDocument {
@@ -565,6 +680,9 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
 
 
 - (BOOL)deleteDocument:(NSError *__autoreleasing *)error {
+    if (![self.database.packageController ensureWritable:error])
+        return NO;
+    
     __block BOOL success = NO;
     
     
@@ -584,18 +702,27 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
 }
 
 - (BOOL)_deleteDocument:(NSError *__autoreleasing *)outError {
+    BOOL success;
+    if ((success = [self _deleteDocumentWithoutNotifying:outError]))
+        [_controller didDeleteObject:self];
+    
+    return success;
+}
+
+- (BOOL)_deleteDocumentWithoutNotifying:(NSError *__autoreleasing *)outError {
     assert(_controller);
     
     NSString *deletedDocumentID = self.document.documentID;
     assert(deletedDocumentID);
     
+    if (![_controller prepareToDeleteObject:self error:outError])
+        return NO;
+    
     BOOL success;
     if ((success = [super deleteDocument:outError]))
     {
         _deletedDocumentID = deletedDocumentID;
         
-        [_controller didDeleteObject:self];
-        
 #if MP_DEBUG_ZOMBIE_MODELS
         NSString *docID = self.document.documentID;
         
@@ -607,6 +734,105 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     return success;
 }
 
+#pragma mark - Asynchronous saving
+
+- (MPAsyncRequest *)saveWithCompletionQueue:(dispatch_queue_t)queue
+                          completionHandler:(void (^)(BOOL success, NSError *error))completionHandler
+{
+    NSParameterAssert(completionHandler);
+    MPAsyncRequest *request = [[MPAsyncRequest alloc] initWithCompletionQueue:queue
+                                                            completionHandler:^(id result, NSError *error) {
+        completionHandler(result != nil, error);
+    }];
+    
+    if (self.isClean) {
+        [request completeWithResult:@YES error:nil];
+        return request;
+    }
+    
+    NSAssert(_controller, @"Unexpectedly missing controller when attempting to save.");
+    NSAssert(self.document, @"Unexpectedly missing document when attempting to save.");
+    
+    NSError *err = nil;
+    if (![_controller.packageController ensureWritable:&err]) {
+        [request completeWithResult:nil error:err];
+        return request;
+    }
+    
+    [_controller willSaveObject:self];
+    
+    [self prepareForSave];
+    
+    NSUInteger changeCount = _changeCount;
+    
+    // the object's properties may change on this thread while being written, so an immutable copy of them is written instead.
+    NSDictionary *properties = [[NSDictionary alloc] initWithDictionary:self.propertiesToSave copyItems:YES];
+    
+    dispatch_async(self.database.manager.dispatchQueue, ^{
+        if (request.isCompleted)
+            return;
+        
+        NSError *saveError = nil;
+        BOOL success = [self saveDocumentProperties:properties error:&saveError];
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (success) {
+                // an object changed while its copy was written is left needing saving with all its changes.
+                if (self->_changeCount == changeCount) {
+                    mp_dispatch_sync(self.database.manager.dispatchQueue, [self.database.packageController serverQueueToken], ^{
+                        [self didSave];
+                    });
+                    [self markEmbeddedObjectsSaved];
+                }
+                
+                [self saveCompleted];
+            }
+            
+            [request completeWithResult:success ? @YES : nil error:saveError];
+        });
+    });
+    
+    return request;
+}
+
+- (MPAsyncRequest *)deleteWithCompletionQueue:(dispatch_queue_t)queue
+                            completionHandler:(void (^)(BOOL success, NSError *error))completionHandler
+{
+    NSParameterAssert(completionHandler);
+    MPAsyncRequest *request = [[MPAsyncRequest alloc] initWithCompletionQueue:queue
+                                                            completionHandler:^(id result, NSError *error) {
+        completionHandler(result != nil, error);
+    }];
+    
+    NSError *err = nil;
+    if (![self.database.packageController ensureWritable:&err]) {
+        [request completeWithResult:nil error:err];
+        return request;
+    }
+    
+    dispatch_async(self.database.manager.dispatchQueue, ^{
+        if (request.isCompleted)
+            return;
+        
+        // an object with no current revision is already deleted, or was never saved.
+        NSError *deleteError = nil;
+        BOOL deleted = NO;
+        BOOL success = !self.document.currentRevision
+                    || (deleted = [self _deleteDocumentWithoutNotifying:&deleteError]);
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (deleted)
+                [self.controller didDeleteObject:self];
+            
+            [self clearCachedValues];
+            
+            [request completeWithResult:success ? @YES : nil error:deleteError];
+        });
+    });
+    
+    return request;
+}
+
 - (void)document:(CBLDocument *)doc
        didChange:(CBLDatabaseChange *)change {
     [super document:doc didChange:change];
@@ -621,6 +847,10 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     
     assert(doc == self.document);
     
+    // the change is otherwise delivered batched from the database change feed.
+    if (![_controller.packageController postsPerObjectChangeNotifications])
+        return;
+    
     [_controller didChangeDocument:doc forObject:self source:
      [change.source.scheme isEqualTo:@"cbl"]
         ? MPManagedObjectChangeSourceInternal
@@ -1065,39 +1295,25 @@ static NSMapTable *_modelObjectByIdentifierMap = nil;
     if (!ids) return @[];
     if (ids.count == 0) return @[];
     
-    NSString *str = [[[ids firstObject] componentsSeparatedByString:@":"] firstObject];
-    Class moClass = NSClassFromString(str);
-    assert(moClass);
-    assert([moClass isSubclassOfClass:[MPManagedObject class]]);
-    
-    // determine if all objects are of the same MO subclass.
-    __block BOOL allSameClass = YES;
-    [ids enumerateObjectsUsingBlock:^(NSString *objID, NSUInteger idx, BOOL *stop) {
-        NSString *classStr = [[objID componentsSeparatedByString:@":"] firstObject];
-        assert(classStr);
-        Class class = NSClassFromString(str);
-        if (class != moClass) { *stop = YES; allSameClass = NO; }
-    }];
+    // resolved in one batch: cached objects directly, the rest with one query per database.
+    NSArray *objs = [self.controller.packageController objectsWithIdentifiers:ids];
     
-    NSMutableArray *objs = [NSMutableArray arrayWithCapacity:ids.count];
-    [ids enumerateObjectsUsingBlock:^(NSString *objID, NSUInteger idx, BOOL *stop) {
-        Class cls = [[self class] managedObjectClassFromDocumentID:objID];
-        assert(cls);
-        MPManagedObjectsController *moc = [self.controller.packageController controllerForManagedObjectClass:cls];
-        MPManagedObject *mo = [moc objectWithIdentifier:objID];
-        
-        if (!mo)
+    if (objs.count != ids.count)
+    {
+        NSSet *foundIDs = [NSSet setWithArray:[objs valueForKey:@"documentID"]];
+        for (NSString *objID in ids)
         {
+            if ([foundIDs containsObject:objID])
+                continue;
+            
+            Class cls = [[self class] managedObjectClassFromDocumentID:objID];
+            MPManagedObjectsController *moc = [self.controller.packageController controllerForManagedObjectClass:cls];
             NSLog(@"WARNING! Could not find object with ID '%@' from '%@'",
                   objID, moc.db.database.internalURL);
         }
-        else
-        {
-            [objs addObject:mo];            
-        }
-    }];
+    }
     
-    return [objs copy];
+    return objs;
 }
 
 - (void)setDictionaryEmbeddedValue:(id)value forKey:(NSString *)embeddedKey ofProperty:(NSString *)dictPropertyKey
@@ -2111,9 +2327,28 @@ NS_INLINE BOOL isEffectiveGetter(const char* name) {
     [self setValue:[embeddedObjs copy] ofProperty:property];
 }
 
+- (void)cacheValue:(id)value ofProperty:(NSString *)property changed:(BOOL)changed {
+    // also reached when an embedded object in the property's collection changes.
+    [_decodedPropertyValues removeDecodedValueOfProperty:property];
+    [super cacheValue:value ofProperty:property changed:changed];
+}
+
+- (void)cacheDecodedValue:(id)decodedValue ofProperty:(NSString *)property rawValue:(id)rawValue {
+    if (!rawValue)
+        return;
+    
+    if (!_decodedPropertyValues)
+        _decodedPropertyValues = [MPDecodedPropertyValueCache new];
+    [_decodedPropertyValues setDecodedValue:decodedValue ofProperty:property rawValue:rawValue];
+}
+
 - (NSArray *)getEmbeddedObjectArrayProperty:(NSString *)property {
     NSArray *objs = [self getValueOfProperty:property];
-    NSMutableArray *embeddedObjs = [NSMutableArray arrayWithCapacity:10];
+    NSArray *decodedObjs = [_decodedPropertyValues decodedValueOfProperty:property rawValue:objs];
+    if (decodedObjs)
+        return decodedObjs;
+    
+    NSMutableArray *embeddedObjs = [NSMutableArray arrayWithCapacity:objs.count];
     for (id obj in objs)
     {
         MPEmbeddedObject *emb = nil;
@@ -2138,12 +2373,18 @@ NS_INLINE BOOL isEffectiveGetter(const char* name) {
             [embeddedObjs addObject:emb];
     }
     
-    return embeddedObjs;
+    decodedObjs = [embeddedObjs copy];
+    [self cacheDecodedValue:decodedObjs ofProperty:property rawValue:objs];
+    return decodedObjs;
 }
 
 - (NSDictionary *)getEmbeddedObjectDictionaryProperty:(NSString *)property {
     NSDictionary *objs = [self getValueOfProperty:property];
-    NSMutableDictionary *embeddedObjs = [NSMutableDictionary dictionaryWithCapacity:10];
+    NSDictionary *decodedObjs = [_decodedPropertyValues decodedValueOfProperty:property rawValue:objs];
+    if (decodedObjs)
+        return decodedObjs;
+    
+    NSMutableDictionary *embeddedObjs = [NSMutableDictionary dictionaryWithCapacity:objs.count];
     for (id key in objs.allKeys)
     {
         id obj = objs[key];
@@ -2166,7 +2407,9 @@ NS_INLINE BOOL isEffectiveGetter(const char* name) {
         embeddedObjs[key] = emb;
     }
     
-    return embeddedObjs;
+    decodedObjs = [embeddedObjs copy];
+    [self cacheDecodedValue:decodedObjs ofProperty:property rawValue:objs];
+    return decodedObjs;
 }
 
 - (void)setEmbeddedObjectDictionary:(NSDictionary *)value ofProperty:(NSString *)property {
@@ -8,8 +8,17 @@
 
 #import "MPRootSection.h"
 
+@class MPLiveObjectCollection;
+
 @interface MPRootSection ()
 - (void)refreshCachedValues;
 @property (readwrite, nullable) NSArray<id<MPTreeItem>> *cachedChildren;
 @property (readwrite, nullable) NSArray<id<MPTreeItem>> *fixedChildren;
+
+/** The collection backing -children if -newLiveChildren returns one, created on first access. A live collection is only accessed on the main thread.
+  * Its objects are kept up to date incrementally, rather than recomputed through -refreshCachedValues whenever cached values are cleared. */
+@property (readonly, nullable) MPLiveObjectCollection *liveChildren;
+
+/** Overload in a subclass to back the section's children with a live collection (default: nil). */
+- (nullable MPLiveObjectCollection *)newLiveChildren;
 @end
\ No newline at end of file
@@ -15,12 +15,17 @@
 
 #import <Feather/MPVirtualSection.h>
 #import <Feather/MPCacheableMixin.h>
+#import <Feather/MPLiveObjectCollection.h>
 
 NSString *const MPPasteboardTypeRootSection = @"com.piipari.root-section.id.plist";
 
 @implementation MPRootSection
+{
+    BOOL _liveChildrenCreated;
+}
 
 @synthesize inEditMode;
+@synthesize liveChildren = _liveChildren;
 
 - (instancetype)init
 {
@@ -72,6 +77,11 @@ NSString *const MPPasteboardTypeRootSection = @"com.piipari.root-section.id.plis
          ^(MPRootSection *_self, NSNotification *notification)
         { [_self hasRemovedManagedObject:notification.object]; }];
         
+        MPManagedObjectsController *moc = [packageController controllerForManagedObjectClass:moClass];
+        if (moc)
+            [nc addObserver:self selector:@selector(didChangeManagedObjects:)
+                       name:MPManagedObjectsControllerDidChangeObjectsNotification object:moc];
+        
         [self refreshCachedValues];
     }
     
@@ -96,6 +106,12 @@ NSString *const MPPasteboardTypeRootSection = @"com.piipari.root-section.id.plis
     });
 }
 
+- (void)didChangeManagedObjects:(NSNotification *)notification {
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self clearCachedValues];
+    });
+}
+
 - (void)dealloc
 {
     // Commented out on 2013-01-22 as unnecessary (as discussed with Matias): the package controller's dealloc may already have destroyed the notification center by this point -- @2pii
@@ -137,8 +153,30 @@ NSString *const MPPasteboardTypeRootSection = @"com.piipari.root-section.id.plis
     return nil;
 }
 
+- (MPLiveObjectCollection *)newLiveChildren {
+    return nil;
+}
+
+- (MPLiveObjectCollection *)liveChildren
+{
+    if (!_liveChildrenCreated) {
+        _liveChildren = [self newLiveChildren];
+        _liveChildrenCreated = YES;
+    }
+    
+    // sections without a live collection keep being readable off the main thread.
+    if (_liveChildren)
+        NSParameterAssert([NSThread isMainThread]);
+    
+    return _liveChildren;
+}
+
 - (NSArray *)children
 {
+    MPLiveObjectCollection *liveChildren = self.liveChildren;
+    if (liveChildren)
+        return liveChildren.objects;
+    
     if (!self.cachedChildren)
     {
         [self refreshCachedValues];
@@ -8,9 +8,21 @@
 
 #import "MPSnapshot.h"
 
+@class MPSnapshottedObjectsController;
+
 /** An additional interface for MPSnapshot intended to be used by MPSnapshotsController. */
 @interface MPSnapshot (Protected)
++ (NSString *)idForSnapshotWithName:(NSString *)name inDatabase:(CBLDatabase *)db;
+
 - (MPSnapshot *)initWithController:(MPSnapshotsController *)packageController name:(NSString *)name;
+
+@property (readwrite, strong) NSArray<NSString *> *snapshottedObjectIDs;
+@property (readwrite, strong) NSDictionary<NSString *, NSNumber *> *snapshottedSequenceNumbers;
+
+/** Lists the snapshot's contents relative to a base snapshot, clearing -snapshottedObjectIDs. */
+- (void)setBaseSnapshot:(MPSnapshot *)baseSnapshot
+addedSnapshottedObjectIDs:(NSArray<NSString *> *)addedSnapshottedObjectIDs
+removedSnapshottedObjectIDs:(NSArray<NSString *> *)removedSnapshottedObjectIDs;
 @end
 
 /** An additional interface for MPSnapshottedObject intended to be used by MPSnapshotsController. */
@@ -20,7 +32,13 @@
                                         revisionID:(NSString *)revisionID
                                         inDatabase:(CBLDatabase *)db;
 
-- (MPSnapshottedObject *)initWithController:(MPSnapshotsController *)sc
+/** Parses the document ID and revision ID of the object snapshotted in a MPSnapshottedObject from its document ID.
+  * @return NO if the identifier is not a snapshotted object identifier. */
++ (BOOL)getDocumentID:(NSString **)documentID
+           revisionID:(NSString **)revisionID
+fromSnapshottedObjectID:(NSString *)snapshottedObjectID;
+
+- (MPSnapshottedObject *)initWithController:(MPSnapshottedObjectsController *)sc
                                    snapshot:(MPSnapshot *)snapshot
                           snapshottedObject:(MPManagedObject *)obj;
 
@@ -18,6 +18,30 @@
 
 /** A timestamp for the moment the snapshot was created. Not the exact time the snapshot creation was registered, but the time soon before it was sent for saving to the database. */
 @property (readonly, strong) NSDate *timestamp;
+
+/** Document IDs of the MPSnapshottedObject instances contained in the snapshot, if the snapshot lists them in full.
+  * A snapshotted object is keyed by the document ID and revision of the object it contains, and shared by all snapshots taken while the object was at that revision.
+  * Nil for an incremental snapshot, whose contents are resolved with -[MPSnapshotsController snapshottedObjectIDsForSnapshot:error:]. */
+@property (readonly, strong) NSArray<NSString *> *snapshottedObjectIDs;
+
+/** The document ID of the snapshot which an incremental snapshot lists its contents relative to (nil for a snapshot listing them in full). */
+@property (readonly, copy) NSString *baseSnapshotID;
+
+/** The number of incremental snapshots between this snapshot and the one listing its contents in full (0 for one listing them in full). */
+@property (readonly) NSUInteger baseSnapshotDepth;
+
+/** IDs of the snapshotted objects contained in an incremental snapshot but not in its base snapshot. */
+@property (readonly, strong) NSArray<NSString *> *addedSnapshottedObjectIDs;
+
+/** IDs of the snapshotted objects contained in the base snapshot of an incremental snapshot but not in the snapshot itself. */
+@property (readonly, strong) NSArray<NSString *> *removedSnapshottedObjectIDs;
+
+/** NO for a snapshot taken before snapshots listed their contents, whose contents are known only from the snapshotted objects created for it. */
+@property (readonly) BOOL listsSnapshottedObjects;
+
+/** The last sequence number of each snapshotted database when its objects were listed, keyed by database name:
+  * the snapshot contains the revisions current at that sequence number. Databases changed while the snapshot was recorded are left out. */
+@property (readonly, strong) NSDictionary<NSString *, NSNumber *> *snapshottedSequenceNumbers;
 @end
 
 /** MPSnapshottedObject instances contain serialised data of other managed objects from the same database package as where it is stored. */
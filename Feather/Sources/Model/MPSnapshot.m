@@ -70,6 +70,54 @@
 - (NSDate *)timestamp
 { return [NSDate dateWithTimeIntervalSince1970:[[self getValueOfProperty:@"timestamp"] doubleValue]]; }
 
+- (void)setSnapshottedObjectIDs:(NSArray<NSString *> *)snapshottedObjectIDs
+{
+    [self setValue:snapshottedObjectIDs ofProperty:@"snapshottedObjectIDs"];
+    [self setValue:nil ofProperty:@"baseSnapshotID"];
+    [self setValue:nil ofProperty:@"baseSnapshotDepth"];
+    [self setValue:nil ofProperty:@"addedSnapshottedObjectIDs"];
+    [self setValue:nil ofProperty:@"removedSnapshottedObjectIDs"];
+}
+
+- (NSArray<NSString *> *)snapshottedObjectIDs
+{ return [self getValueOfProperty:@"snapshottedObjectIDs"]; }
+
+- (void)setBaseSnapshot:(MPSnapshot *)baseSnapshot
+addedSnapshottedObjectIDs:(NSArray<NSString *> *)addedSnapshottedObjectIDs
+removedSnapshottedObjectIDs:(NSArray<NSString *> *)removedSnapshottedObjectIDs
+{
+    NSParameterAssert(baseSnapshot.documentID);
+    NSParameterAssert(addedSnapshottedObjectIDs);
+    NSParameterAssert(removedSnapshottedObjectIDs);
+    
+    [self setValue:nil ofProperty:@"snapshottedObjectIDs"];
+    [self setValue:baseSnapshot.documentID ofProperty:@"baseSnapshotID"];
+    [self setValue:@(baseSnapshot.baseSnapshotDepth + 1) ofProperty:@"baseSnapshotDepth"];
+    [self setValue:addedSnapshottedObjectIDs ofProperty:@"addedSnapshottedObjectIDs"];
+    [self setValue:removedSnapshottedObjectIDs ofProperty:@"removedSnapshottedObjectIDs"];
+}
+
+- (NSString *)baseSnapshotID
+{ return [self getValueOfProperty:@"baseSnapshotID"]; }
+
+- (NSUInteger)baseSnapshotDepth
+{ return [[self getValueOfProperty:@"baseSnapshotDepth"] unsignedIntegerValue]; }
+
+- (NSArray<NSString *> *)addedSnapshottedObjectIDs
+{ return [self getValueOfProperty:@"addedSnapshottedObjectIDs"] ?: @[]; }
+
+- (NSArray<NSString *> *)removedSnapshottedObjectIDs
+{ return [self getValueOfProperty:@"removedSnapshottedObjectIDs"] ?: @[]; }
+
+- (BOOL)listsSnapshottedObjects
+{ return self.snapshottedObjectIDs != nil || self.baseSnapshotID != nil; }
+
+- (NSDictionary<NSString *, NSNumber *> *)snapshottedSequenceNumbers
+{ return [self getValueOfProperty:@"snapshottedSequenceNumbers"]; }
+
+- (void)setSnapshottedSequenceNumbers:(NSDictionary<NSString *, NSNumber *> *)snapshottedSequenceNumbers
+{ [self setValue:snapshottedSequenceNumbers ofProperty:@"snapshottedSequenceNumbers"]; }
+
 @end
 
 @interface MPSnapshottedObject ()
@@ -124,6 +172,27 @@
             NSStringFromClass(self), documentID, revisionID];
 }
 
++ (BOOL)getDocumentID:(NSString **)documentID
+           revisionID:(NSString **)revisionID
+fromSnapshottedObjectID:(NSString *)snapshottedObjectID
+{
+    NSString *prefix = [NSStringFromClass(self) stringByAppendingString:@":"];
+    if (![snapshottedObjectID hasPrefix:prefix])
+        return NO;
+    
+    // document IDs contain colons but revision IDs do not.
+    NSRange separatorRange = [snapshottedObjectID rangeOfString:@":" options:NSBackwardsSearch];
+    if (separatorRange.location < prefix.length)
+        return NO;
+    
+    if (documentID)
+        *documentID = [snapshottedObjectID substringWithRange:NSMakeRange(prefix.length, separatorRange.location - prefix.length)];
+    if (revisionID)
+        *revisionID = [snapshottedObjectID substringFromIndex:NSMaxRange(separatorRange)];
+    
+    return YES;
+}
+
 - (NSString *)idForNewDocumentInDatabase:(CBLDatabase *)db
 {
     assert(__snapshottedDocumentID);
@@ -9,6 +9,8 @@
 #import <Feather/MPVirtualSection.h>
 #import <Feather/MPObjectWrappingSection.h>
 
+@class MPLiveObjectCollection;
+
 @interface MPVirtualSection ()
 @property (readwrite, weak, nullable) id<MPTreeItem> parent;
 @property (readwrite, strong, nullable) NSImage *cachedThumbnailImage;
@@ -18,6 +20,12 @@
 @property (readwrite) BOOL childrenCacheIsStale;
 @property (readwrite) BOOL representedObjectsCacheIsStale;
 
+/** The collection backing -children if -newLiveChildren returns one, created on first access. A live collection is only accessed on the main thread. */
+@property (readonly, nullable) MPLiveObjectCollection *liveChildren;
+
+/** Overload in a subclass to back the section's children with a live collection, instead of overloading -children (default: nil). */
+- (nullable MPLiveObjectCollection *)newLiveChildren;
+
 - (void)observeManagedObjectChanges;
 
 @end
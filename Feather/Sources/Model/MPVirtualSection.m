@@ -13,11 +13,16 @@
 
 @import FeatherExtensions;
 #import <Feather/MPException.h>
+#import <Feather/MPLiveObjectCollection.h>
 
 @implementation MPVirtualSection
+{
+    BOOL _liveChildrenCreated;
+}
 
 @synthesize inEditMode;
 @synthesize identifier = _identifier;
+@synthesize liveChildren = _liveChildren;
 
 + (void)load
 {
@@ -100,7 +105,28 @@
     @throw [[MPAbstractMethodException alloc] initWithSelector:_cmd]; return nil;
 }
 
+- (MPLiveObjectCollection *)newLiveChildren {
+    return nil;
+}
+
+- (MPLiveObjectCollection *)liveChildren {
+    if (!_liveChildrenCreated) {
+        _liveChildren = [self newLiveChildren];
+        _liveChildrenCreated = YES;
+    }
+    
+    // sections without a live collection keep being readable off the main thread.
+    if (_liveChildren)
+        NSParameterAssert([NSThread isMainThread]);
+    
+    return _liveChildren;
+}
+
 - (NSArray *)children {
+    MPLiveObjectCollection *liveChildren = self.liveChildren;
+    if (liveChildren)
+        return liveChildren.objects;
+    
     @throw [[MPAbstractMethodException alloc] initWithSelector:_cmd]; return nil;
 }
 
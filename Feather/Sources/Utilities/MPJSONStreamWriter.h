@@ -0,0 +1,35 @@
+//
+//  MPJSONStreamWriter.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Writes compact JSON to a file a piece at a time, through a fixed size buffer, so that a large document need not be held in memory as a whole.
+  * The writer does not check that the pieces written form valid JSON: structural characters are written with -writeString:error:. */
+@interface MPJSONStreamWriter : NSObject
+
+- (nullable instancetype)initWithPath:(nonnull NSString *)path error:(NSError *__nullable *__nullable)error;
+
+/** Number of bytes written so far, including those still buffered. */
+@property (readonly) unsigned long long offset;
+
+/** Writes the UTF-8 encoding of a string as is. */
+- (BOOL)writeString:(nonnull NSString *)string error:(NSError *__nullable *__nullable)error;
+
+/** Writes a string as a JSON string literal. */
+- (BOOL)writeJSONStringLiteral:(nonnull NSString *)string error:(NSError *__nullable *__nullable)error;
+
+/** Writes a JSON encodable array or dictionary in compact form. */
+- (BOOL)writeJSONObject:(nonnull id)object error:(NSError *__nullable *__nullable)error;
+
+/** Writes bytes as is, for instance a range of a previously written file. */
+- (BOOL)writeData:(nonnull NSData *)data error:(NSError *__nullable *__nullable)error;
+
+/** Writes out buffered bytes and closes the file. */
+- (BOOL)close:(NSError *__nullable *__nullable)error;
+
+@end
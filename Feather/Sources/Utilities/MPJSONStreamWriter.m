@@ -0,0 +1,135 @@
+//
+//  MPJSONStreamWriter.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPJSONStreamWriter.h"
+
+static const NSUInteger MPJSONStreamWriterBufferSize = 64 * 1024;
+
+@interface MPJSONStreamWriter ()
+{
+    NSOutputStream *_stream;
+    NSMutableData *_buffer;
+}
+@property (readwrite) unsigned long long offset;
+@end
+
+@implementation MPJSONStreamWriter
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+    NSParameterAssert(path);
+
+    if (self = [super init])
+    {
+        _stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+        [_stream open];
+
+        if (_stream.streamStatus == NSStreamStatusError) {
+            if (error)
+                *error = _stream.streamError;
+            return nil;
+        }
+
+        _buffer = [NSMutableData dataWithCapacity:MPJSONStreamWriterBufferSize];
+    }
+
+    return self;
+}
+
+- (BOOL)writeString:(NSString *)string error:(NSError **)error
+{
+    return [self writeData:[string dataUsingEncoding:NSUTF8StringEncoding] error:error];
+}
+
+- (BOOL)writeJSONStringLiteral:(NSString *)string error:(NSError **)error
+{
+    // a bare string is not a valid top level object for NSJSONSerialization, so it is encoded in an array and the brackets dropped.
+    NSData *data = [NSJSONSerialization dataWithJSONObject:@[ string ] options:0 error:error];
+    if (!data)
+        return NO;
+
+    return [self writeData:[data subdataWithRange:NSMakeRange(1, data.length - 2)] error:error];
+}
+
+- (BOOL)writeJSONObject:(id)object error:(NSError **)error
+{
+    NSData *data = [NSJSONSerialization dataWithJSONObject:object options:0 error:error];
+    if (!data)
+        return NO;
+
+    return [self writeData:data error:error];
+}
+
+- (BOOL)writeData:(NSData *)data error:(NSError **)error
+{
+    NSParameterAssert(_stream);
+
+    self.offset += data.length;
+
+    if (_buffer.length + data.length <= MPJSONStreamWriterBufferSize) {
+        [_buffer appendData:data];
+        return YES;
+    }
+
+    if (![self flush:error])
+        return NO;
+
+    if (data.length <= MPJSONStreamWriterBufferSize) {
+        [_buffer appendData:data];
+        return YES;
+    }
+
+    return [self writeBytes:data.bytes length:data.length error:error];
+}
+
+- (BOOL)close:(NSError **)error
+{
+    BOOL success = [self flush:error];
+    [_stream close];
+    _stream = nil;
+    return success;
+}
+
+- (void)dealloc
+{
+    [_stream close];
+}
+
+#pragma mark -
+
+- (BOOL)flush:(NSError **)error
+{
+    BOOL success = [self writeBytes:_buffer.bytes length:_buffer.length error:error];
+    _buffer.length = 0;
+    return success;
+}
+
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)length error:(NSError **)error
+{
+    NSUInteger written = 0;
+
+    while (written < length) {
+        NSInteger count = [_stream write:(const uint8_t *)bytes + written maxLength:length - written];
+        if (count <= 0) {
+            if (error)
+                *error = _stream.streamError ?: [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+            return NO;
+        }
+        written += count;
+    }
+
+    return YES;
+}
+
+@end
@@ -0,0 +1,62 @@
+//
+//  MPStartupTracer.h
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MPStartupTracer;
+
+/** A named, timed span of work recorded by a MPStartupTracer. */
+@interface MPStartupTraceSpan : NSObject
+
+@property (readonly, copy, nonnull) NSString *name;
+
+/** The kind of work measured, for instance "database" or "controller", under which spans of the same name are totalled. */
+@property (readonly, copy, nonnull) NSString *category;
+
+/** Seconds from the start of the tracer to the beginning of the span. */
+@property (readonly) NSTimeInterval startTime;
+
+/** Seconds elapsed between beginning and ending the span. Zero until it ends. */
+@property (readonly) NSTimeInterval wallTime;
+
+/** CPU seconds used by the thread that began the span until it ended. Zero if the span was ended on another thread. */
+@property (readonly) NSTimeInterval CPUTime;
+
+@property (readonly) uint64_t threadID;
+
+@property (readonly, getter=isEnded) BOOL ended;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** Records the span with its tracer. Ending a span more than once has no effect. */
+- (void)end;
+
+@end
+
+/** Records the time spent in the phases of a task such as opening a database package, as spans of wall and CPU time.
+  * A tracer is thread safe. Code traced with an optional tracer costs a message to nil when tracing is off. */
+@interface MPStartupTracer : NSObject
+
+/** Spans are timed relative to this. */
+@property (readonly, strong, nonnull) NSDate *startDate;
+
+/** Begins a span on the current thread, to be ended with -[MPStartupTraceSpan end]. */
+- (nonnull MPStartupTraceSpan *)beginSpanNamed:(nonnull NSString *)name category:(nonnull NSString *)category;
+
+/** The ended spans, in the order they ended. */
+@property (readonly, copy, nonnull) NSArray<MPStartupTraceSpan *> *spans;
+
+/** The spans as dictionaries under "spans", and their wall time, CPU time and count totalled by category and name under "totals". Times are in seconds. */
+@property (readonly, copy, nonnull) NSDictionary<NSString *, id> *dictionaryRepresentation;
+
+/** The spans as complete ("X") events of the Chrome trace event format, viewable in chrome://tracing. */
+- (nullable NSData *)chromeTraceEventJSONData:(NSError *__nullable *__nullable)error;
+
+- (BOOL)writeChromeTraceEventJSONToURL:(nonnull NSURL *)URL error:(NSError *__nullable *__nullable)error;
+
+@end
@@ -0,0 +1,228 @@
+//
+//  MPStartupTracer.m
+//  Feather
+//
+//  Created by agent on 17/10/2026.
+//  Copyright (c) 2026 Matias Piipari. All rights reserved.
+//
+
+#import "MPStartupTracer.h"
+
+#import <pthread.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+
+NS_INLINE uint64_t MPCurrentThreadID(void)
+{
+    uint64_t threadID = 0;
+    pthread_threadid_np(NULL, &threadID);
+    return threadID;
+}
+
+/** Monotonic time in nanoseconds (clock_gettime_nsec_np is not available before 10.12). */
+static uint64_t MPUptimeNanoseconds(void)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+/** User and system CPU time of the current thread in nanoseconds. */
+static uint64_t MPThreadCPUNanoseconds(void)
+{
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    
+    mach_port_t thread = mach_thread_self();
+    kern_return_t kr = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    
+    if (kr != KERN_SUCCESS)
+        return 0;
+    
+    return ((uint64_t)info.user_time.seconds + info.system_time.seconds) * NSEC_PER_SEC
+         + ((uint64_t)info.user_time.microseconds + info.system_time.microseconds) * NSEC_PER_USEC;
+}
+
+@interface MPStartupTracer ()
+{
+    NSMutableArray<MPStartupTraceSpan *> *_spans;
+}
+@property (readonly) uint64_t startNanoseconds;
+- (void)didEndSpan:(MPStartupTraceSpan *)span;
+@end
+
+@interface MPStartupTraceSpan ()
+{
+    MPStartupTracer *_tracer;
+    uint64_t _startNanoseconds;
+    uint64_t _startCPUNanoseconds;
+}
+@property (readwrite) NSTimeInterval wallTime;
+@property (readwrite) NSTimeInterval CPUTime;
+@property (readwrite, getter=isEnded) BOOL ended;
+@end
+
+@implementation MPStartupTraceSpan
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"MPInvalidInitException" reason:nil userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithTracer:(MPStartupTracer *)tracer name:(NSString *)name category:(NSString *)category
+{
+    if (self = [super init])
+    {
+        _tracer = tracer;
+        _name = name.copy;
+        _category = category.copy;
+        _threadID = MPCurrentThreadID();
+        _startNanoseconds = MPUptimeNanoseconds();
+        _startCPUNanoseconds = MPThreadCPUNanoseconds();
+        _startTime = (_startNanoseconds - tracer.startNanoseconds) / (double)NSEC_PER_SEC;
+    }
+    
+    return self;
+}
+
+- (void)end
+{
+    uint64_t endNanoseconds = MPUptimeNanoseconds();
+    uint64_t endCPUNanoseconds = MPThreadCPUNanoseconds();
+    
+    @synchronized (self) {
+        if (self.ended)
+            return;
+        
+        self.wallTime = (endNanoseconds - _startNanoseconds) / (double)NSEC_PER_SEC;
+        
+        // the CPU clock read is that of the current thread.
+        if (MPCurrentThreadID() == _threadID)
+            self.CPUTime = (endCPUNanoseconds - _startCPUNanoseconds) / (double)NSEC_PER_SEC;
+        
+        self.ended = YES;
+    }
+    
+    [_tracer didEndSpan:self];
+    _tracer = nil;
+}
+
+- (NSDictionary *)dictionaryRepresentation
+{
+    return @{ @"name" : self.name,
+              @"category" : self.category,
+              @"startTime" : @(self.startTime),
+              @"wallTime" : @(self.wallTime),
+              @"cpuTime" : @(self.CPUTime),
+              @"thread" : @(self.threadID) };
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p %@/%@ wall: %.3fms cpu: %.3fms>",
+            NSStringFromClass(self.class), self, self.category, self.name, self.wallTime * 1000.0, self.CPUTime * 1000.0];
+}
+
+@end
+
+#pragma mark -
+
+@implementation MPStartupTracer
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _startDate = [NSDate date];
+        _startNanoseconds = MPUptimeNanoseconds();
+        _spans = [NSMutableArray arrayWithCapacity:64];
+    }
+    
+    return self;
+}
+
+- (MPStartupTraceSpan *)beginSpanNamed:(NSString *)name category:(NSString *)category
+{
+    NSParameterAssert(name);
+    NSParameterAssert(category);
+    return [[MPStartupTraceSpan alloc] initWithTracer:self name:name category:category];
+}
+
+- (void)didEndSpan:(MPStartupTraceSpan *)span
+{
+    @synchronized (self) {
+        [_spans addObject:span];
+    }
+}
+
+- (NSArray<MPStartupTraceSpan *> *)spans
+{
+    @synchronized (self) {
+        return _spans.copy;
+    }
+}
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    NSArray<MPStartupTraceSpan *> *spans = self.spans;
+    
+    NSMutableArray *spanDictionaries = [NSMutableArray arrayWithCapacity:spans.count];
+    NSMutableDictionary<NSString *, NSMutableDictionary *> *totals = [NSMutableDictionary dictionary];
+    
+    for (MPStartupTraceSpan *span in spans)
+    {
+        [spanDictionaries addObject:span.dictionaryRepresentation];
+        
+        NSMutableDictionary *categoryTotals = totals[span.category];
+        if (!categoryTotals)
+            totals[span.category] = categoryTotals = [NSMutableDictionary dictionary];
+        
+        NSDictionary *total = categoryTotals[span.name];
+        categoryTotals[span.name] = @{ @"wallTime" : @([total[@"wallTime"] doubleValue] + span.wallTime),
+                                       @"cpuTime" : @([total[@"cpuTime"] doubleValue] + span.CPUTime),
+                                       @"count" : @([total[@"count"] unsignedIntegerValue] + 1) };
+    }
+    
+    return @{ @"spans" : spanDictionaries, @"totals" : totals };
+}
+
+- (NSData *)chromeTraceEventJSONData:(NSError **)error
+{
+    NSArray<MPStartupTraceSpan *> *spans = self.spans;
+    NSMutableArray *events = [NSMutableArray arrayWithCapacity:spans.count];
+    int pid = [[NSProcessInfo processInfo] processIdentifier];
+    
+    // timestamps and durations of trace events are in microseconds.
+    for (MPStartupTraceSpan *span in spans)
+    {
+        [events addObject:@{ @"name" : span.name,
+                             @"cat" : span.category,
+                             @"ph" : @"X",
+                             @"ts" : @(span.startTime * USEC_PER_SEC),
+                             @"dur" : @(span.wallTime * USEC_PER_SEC),
+                             @"pid" : @(pid),
+                             @"tid" : @(span.threadID),
+                             @"args" : @{ @"cpuTime" : @(span.CPUTime * USEC_PER_SEC) } }];
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{ @"traceEvents" : events, @"displayTimeUnit" : @"ms" }
+                                           options:0
+                                             error:error];
+}
+
+- (BOOL)writeChromeTraceEventJSONToURL:(NSURL *)URL error:(NSError **)error
+{
+    NSData *data = [self chromeTraceEventJSONData:error];
+    if (!data)
+        return NO;
+    
+    return [data writeToURL:URL options:NSDataWritingAtomic error:error];
+}
+
+@end
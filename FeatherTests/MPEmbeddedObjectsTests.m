@@ -117,4 +117,30 @@
     XCTAssertTrue([obj deleteDocument:nil], @"Deleting the document succeeds");
 }
 
+- (void)testDecodedEmbeddedObjectArrayCaching
+{
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObject *obj = [[MPTestObject alloc] initWithNewDocumentForController:tpkg.testObjectsController];
+    MPEmbeddedTestObject *container = [[MPEmbeddedTestObject alloc] initWithEmbeddingObject:obj embeddingKey:@"embeddedTestObject"];
+    obj.embeddedTestObject = container;
+    
+    MPEmbeddedTestObject *foo = [[MPEmbeddedTestObject alloc] initWithEmbeddingObject:container embeddingKey:@"embeddedArrayOfTestObjects"];
+    container.properties[@"embeddedArrayOfTestObjects"] = @[ [foo JSONStringRepresentation:nil] ];
+    
+    NSArray *objs = container.embeddedArrayOfTestObjects;
+    XCTAssertEqual(objs.firstObject, foo);
+    XCTAssertEqual(container.embeddedArrayOfTestObjects, objs, @"An unchanged property is not decoded again.");
+    
+    // a change to an embedded object in the array invalidates the decoded array.
+    foo.aStringTypedProperty = @"foo";
+    NSArray *changedObjs = container.embeddedArrayOfTestObjects;
+    XCTAssertNotEqual(changedObjs, objs);
+    XCTAssertEqual(changedObjs.firstObject, foo);
+    
+    // as does replacing the raw value.
+    MPEmbeddedTestObject *bar = [[MPEmbeddedTestObject alloc] initWithEmbeddingObject:container embeddingKey:@"embeddedArrayOfTestObjects"];
+    container.properties[@"embeddedArrayOfTestObjects"] = @[ [bar JSONStringRepresentation:nil] ];
+    XCTAssertEqual(container.embeddedArrayOfTestObjects.firstObject, bar);
+}
+
 @end
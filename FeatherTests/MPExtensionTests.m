@@ -24,6 +24,36 @@
 }
 @end
 
+/** The full-text normalization as it was before its ASCII fast path, as a reference. */
+static NSString *MPReferenceFullTextNormalizedString(NSString *string)
+{
+    NSMutableString *result = [NSMutableString stringWithString:string];
+    CFStringNormalize((__bridge CFMutableStringRef)result, kCFStringNormalizationFormD);
+    CFStringFold((__bridge CFMutableStringRef)result,
+                 kCFCompareCaseInsensitive
+                 | kCFCompareDiacriticInsensitive
+                 | kCFCompareWidthInsensitive, NULL);
+    return result;
+}
+
+static NSString *MPRandomFullTextString(NSUInteger length)
+{
+    // ASCII, precomposed and combining diacritics, case pairs outside ASCII, full width forms, ligatures and surrogate pairs.
+    static NSArray<NSString *> *pieces = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pieces = @[ @"a", @"Z", @"q", @"M", @"0", @" ", @".", @"-", @"\n", @"\t", @"@", @"[", @"`", @"{", @"~",
+                    @"\u00E9", @"\u00C9", @"e\u0301", @"E\u0301", @"\u0301", @"\u0323\u0302", @"\u00DF", @"\u1E9E",
+                    @"\u03A3", @"\u03C2", @"\u0130", @"\u0131", @"\uFF21", @"\uFF41", @"\uFB01", @"\u00C5", @"\u212B",
+                    @"\u4E2D", @"\uD83D\uDE00", @"\u00E4", @"\u0419", @"\u0439" ];
+    });
+
+    NSMutableString *string = [NSMutableString stringWithCapacity:length * 2];
+    for (NSUInteger i = 0; i < length; i++)
+        [string appendString:pieces[arc4random_uniform((uint32_t)pieces.count)]];
+    return string;
+}
+
 @implementation MPExtensionTests
 
 - (void)testCommonAncestry
@@ -97,4 +127,77 @@
     XCTAssertTrue([obj exampleMethod:NO],   @"After swizzling should return YES when argument is NO");
 }
 
+- (void)testJSONArrayElementEnumeration {
+    NSData *data = [@" [ {\"a\": \"x,]\\\"}\"}, {\"b\": [1, {\"c\": 2}]}, 3 ]" dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray *expected = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:nil];
+    XCTAssertEqual(expected.count, 3);
+    
+    NSMutableArray *elements = [NSMutableArray new];
+    NSError *err = nil;
+    XCTAssertTrue([data enumerateJSONArrayElementsUsingBlock:^(NSData *elementData, NSRange range, BOOL *stop) {
+        [elements addObject:[NSJSONSerialization JSONObjectWithData:elementData options:NSJSONReadingAllowFragments error:nil]];
+    } error:&err], @"Enumeration unexpectedly failed: %@", err);
+    XCTAssertEqualObjects(elements, expected);
+    
+    for (NSString *invalid in @[ @"{}", @"[1,]", @"[1", @"[{\"a\": 1}}]" ]) {
+        err = nil;
+        XCTAssertFalse([[invalid dataUsingEncoding:NSUTF8StringEncoding] enumerateJSONArrayElementsUsingBlock:^(NSData *elementData, NSRange range, BOOL *stop) {} error:&err]);
+        XCTAssertNotNil(err);
+    }
+}
+
+- (void)testFullTextNormalizationEquivalence {
+    for (NSString *string in @[ @"", @"ABC xyz", @"Caf\u00E9", @"Cafe\u0301 AU LAIT", @"\u0301leading mark", @"STRASSE Stra\u00DFe" ])
+        XCTAssertEqualObjects(string.fullTextNormalizedString, MPReferenceFullTextNormalizedString(string), @"%@", string);
+
+    for (NSUInteger i = 0; i < 10000; i++) {
+        NSString *string = MPRandomFullTextString(arc4random_uniform(600));
+        XCTAssertEqualObjects(string.fullTextNormalizedString, MPReferenceFullTextNormalizedString(string), @"%@", string);
+    }
+}
+
+- (void)testFullTextNormalizationPerformance {
+    NSMutableArray<NSString *> *strings = [NSMutableArray arrayWithCapacity:10000];
+    for (NSUInteger i = 0; i < 10000; i++) {
+        // mostly ASCII, as most indexed contents are.
+        NSString *string = [NSString stringWithFormat:@"Title %lu of A Document About Something, With Some Description Text", i];
+        [strings addObject:i % 10 == 0 ? [string stringByAppendingString:@" na\u00EFve caf\u00E9"] : string];
+    }
+
+    [self measureBlock:^{
+        for (NSString *string in strings)
+            (void)string.fullTextNormalizedString;
+    }];
+}
+
+- (void)testStartupTracer {
+    MPStartupTracer *tracer = [[MPStartupTracer alloc] init];
+    
+    MPStartupTraceSpan *outer = [tracer beginSpanNamed:@"open" category:@"package"];
+    for (NSUInteger i = 0; i < 2; i++) {
+        MPStartupTraceSpan *span = [tracer beginSpanNamed:@"shared" category:@"database"];
+        usleep(1000);
+        [span end];
+        [span end];
+    }
+    [outer end];
+    
+    XCTAssertEqual(tracer.spans.count, 3);
+    XCTAssertEqualObjects(tracer.spans.lastObject, outer);
+    XCTAssertGreaterThanOrEqual(outer.wallTime, 0.002);
+    XCTAssertGreaterThanOrEqual(outer.wallTime, outer.CPUTime);
+    
+    NSDictionary *total = tracer.dictionaryRepresentation[@"totals"][@"database"][@"shared"];
+    XCTAssertEqualObjects(total[@"count"], @2);
+    XCTAssertGreaterThanOrEqual([total[@"wallTime"] doubleValue], 0.002);
+    
+    NSError *err = nil;
+    NSData *data = [tracer chromeTraceEventJSONData:&err];
+    XCTAssertNotNil(data, @"%@", err);
+    NSArray *events = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil][@"traceEvents"];
+    XCTAssertEqual(events.count, 3);
+    XCTAssertEqualObjects(events.lastObject[@"ph"], @"X");
+    XCTAssertEqualObjects(events.lastObject[@"cat"], @"package");
+}
+
 @end
@@ -41,6 +41,15 @@
 @end
 
 @interface MPTestObjectsController : MPManagedObjectsController
+
+/** All of the controller's objects, cached until the controller's cached values are cleared. */
+@property (readonly) NSArray *testObjects;
+@property (readwrite, strong) NSArray *cachedTestObjects;
+
+/** A JSON array of test objects, loaded as bundled data by the controllers created while it is set (nil by default). */
++ (NSURL *)bundledTestObjectsURL;
++ (void)setBundledTestObjectsURL:(NSURL *)URL;
+
 @end
 
 
@@ -52,3 +61,14 @@
 
 @property (readonly, strong) MPTestObjectsController *testObjectsController;
 @end
+
+/** A document package of test objects, whose controller is created in -didOpenDatabases so that the package can be opened in the background. */
+@interface MPFeatherTestDocumentPackageController : MPDatabasePackageController
+
+@property (readonly, strong) MPDatabase *mainDatabase;
+@property (readonly, strong) MPTestObjectsController *testObjectsController;
+
+/** The readiness of the package when -didOpenDatabases was called. */
+@property (readonly) MPDatabasePackageControllerReadiness readinessOnOpeningDatabases;
+
+@end
@@ -56,6 +56,25 @@
 
 @end
 
+@implementation MPFeatherTestDocumentPackageController
+
++ (NSString *)primaryDatabaseName { return @"main"; }
+
+- (NSString *)identifier { return self.path.lastPathComponent; }
+
+- (void)didOpenDatabases
+{
+    [super didOpenDatabases];
+    
+    _readinessOnOpeningDatabases = self.readiness;
+    
+    NSError *err = nil;
+    _testObjectsController = [[MPTestObjectsController alloc] initWithPackageController:self database:self.mainDatabase error:&err];
+    NSAssert(_testObjectsController, @"Failed to create test objects controller: %@", err);
+}
+
+@end
+
 @implementation MPTestObject
 @dynamic embeddedTestObject;
 @dynamic title, subtitle, desc, contents;
@@ -83,5 +102,31 @@
 @dynamic embeddedDictionaryOfTestObjects;
 @end
 
+static NSURL *_bundledTestObjectsURL = nil;
+
 @implementation MPTestObjectsController
+
+- (NSArray *)testObjects
+{
+    if (!self.cachedTestObjects)
+        self.cachedTestObjects = self.allObjects;
+    return self.cachedTestObjects;
+}
+
++ (NSURL *)bundledTestObjectsURL { return _bundledTestObjectsURL; }
+
++ (void)setBundledTestObjectsURL:(NSURL *)URL { _bundledTestObjectsURL = URL; }
+
+- (NSString *)bundledJSONDataFilename
+{
+    return _bundledTestObjectsURL.lastPathComponent.stringByDeletingPathExtension;
+}
+
+- (NSBundle *)resourcesBundle
+{
+    if (!_bundledTestObjectsURL)
+        return [super resourcesBundle];
+    return [NSBundle bundleWithURL:_bundledTestObjectsURL.URLByDeletingLastPathComponent];
+}
+
 @end
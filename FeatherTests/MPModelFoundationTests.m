@@ -9,6 +9,10 @@
 #import "MPModelFoundationTests.h"
 #import "MPFeatherTestClasses.h"
 
+#import <Feather/NSObject+MPExtensions.h>
+#import <Feather/MPSnapshot+Protected.h>
+#import <Feather/MPSnapshotsController+Protected.h>
+
 //
 // MPManagedObject
 // |____MPManagedObjectConcretenessTest
@@ -65,6 +69,12 @@
 + (BOOL)isConcrete { return YES; }
 @end
 
+/** An object which fails validation, to make the transaction it is saved in fail. */
+@interface MPFeatherTestUnsavable : MPFeatherTestB @end
+@implementation MPFeatherTestUnsavable
++ (BOOL)validateRevision:(CBLRevision *)revision { return NO; }
+@end
+
 @implementation MPModelFoundationTests
 
 - (void)testNotifications
@@ -116,6 +126,992 @@
     XCTAssertTrue([[[obj propertiesToSave] managedObjectRevisionID] isEqualToString:obj.document.currentRevisionID]);
 }
 
+- (void)testSavedDictionaryRepresentation {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = @"exported";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+
+    NSString *(^savedTitle)(void) = ^NSString *{
+        NSError *err = nil;
+        XCTAssertTrue([tpkg saveDictionaryRepresentation:&err], @"Saving dictionary representation unexpectedly failed: %@", err);
+
+        NSDictionary *dict = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfURL:tpkg.dictionaryRepresentationURL] options:0 error:&err];
+        XCTAssertNotNil(dict, @"Dictionary representation is not valid JSON: %@", err);
+        XCTAssertEqual(dict.count, tpkg.databases.count);
+
+        NSArray *docs = [dict[ac.db.name] filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"_id == %@", b.documentID]];
+        return [docs.firstObject objectForKey:@"title"];
+    };
+
+    XCTAssertEqualObjects(savedTitle(), @"exported");
+
+    // the second save copies unchanged databases from the first, the third writes the changed one again.
+    XCTAssertEqualObjects(savedTitle(), @"exported");
+
+    b.title = @"changed";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    XCTAssertEqualObjects(savedTitle(), @"changed");
+}
+
+- (void)testObjectsWithIdentifiers {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    MPTestObject *e = [[MPFeatherTestE alloc] initWithNewDocumentForController:ac];
+
+    XCTAssertTrue([b save] && [c save] && [e save], @"Save unexpectedly failed.");
+
+    NSString *missingID = @"MPFeatherTestB:missing";
+    NSArray *ids = @[e.documentID, missingID, b.documentID, c.documentID, e.documentID];
+
+    NSArray *expected = @[e, b, c, e];
+    XCTAssertEqualObjects([ac objectsWithIdentifiers:ids], expected, @"Objects should be returned in input order, skipping missing IDs.");
+    XCTAssertEqualObjects([tpkg objectsWithIdentifiers:ids], expected, @"Package level lookup should match the controller.");
+    XCTAssertEqualObjects([ac objectsWithIdentifiers:@[]], @[]);
+}
+
+- (void)testObjectCacheEviction {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    MPTestObject *d = [[MPFeatherTestD alloc] initWithNewDocumentForController:ac];
+    
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+    d.title = @"unsaved";
+    
+    MPManagedObjectCache *cache = [[MPManagedObjectCache alloc] initWithCountLimit:1];
+    [cache registerObject:b forIdentifier:b.documentID];
+    [cache registerObject:c forIdentifier:c.documentID];
+    [cache registerObject:d forIdentifier:d.documentID];
+    
+    XCTAssertEqual(cache.strongCount, 1, @"Only one clean object should be held strongly.");
+    XCTAssertEqual(cache.dirtyCount, 1, @"The unsaved object should be held until saved.");
+    XCTAssertEqual(cache.evictionCount, 1);
+    
+    // evicted objects that are still alive keep their identity.
+    XCTAssertEqual([cache objectForIdentifier:b.documentID], b);
+    XCTAssertNil([cache objectForIdentifier:@"MPFeatherTestB:missing"]);
+    XCTAssertEqual(cache.hitCount, 1);
+    XCTAssertEqual(cache.missCount, 1);
+    
+    XCTAssertTrue([d save], @"Save unexpectedly failed.");
+    [cache objectNeedsSaveDidChange:d];
+    XCTAssertEqual(cache.dirtyCount, 0);
+    XCTAssertEqual(cache.strongCount, 1);
+}
+
+- (void)testQueryResultCache {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    NSString *title = [[NSUUID UUID] UUIDString];
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = title;
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+
+    NSUInteger hitCount = ac.queryResultCache.hitCount;
+    NSArray *objs = [ac objectsMatchingQueriedView:ac.objectsByTitleViewName keys:@[ title ]];
+    XCTAssertEqualObjects(objs, @[ b ]);
+
+    // unchanged data returns the same array.
+    XCTAssertEqual([ac objectsMatchingQueriedView:ac.objectsByTitleViewName keys:@[ title ]], objs);
+    XCTAssertEqual(ac.queryResultCache.hitCount, hitCount + 1);
+
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    c.title = title;
+    XCTAssertTrue([c save], @"Save unexpectedly failed.");
+
+    NSArray *changedObjs = [ac objectsMatchingQueriedView:ac.objectsByTitleViewName keys:@[ title ]];
+    XCTAssertNotEqual(changedObjs, objs);
+    XCTAssertTrue([changedObjs containsObject:c]);
+
+    MPQueryResultCache *cache = [[MPQueryResultCache alloc] initWithCountLimit:1];
+    [cache setObjects:@[ b ] forView:@"a" keys:@[ @"x" ] options:0 lastSequenceNumber:1 lastSequenceIndexed:1];
+    [cache setObjects:@[ c ] forView:@"b" keys:nil options:0 lastSequenceNumber:1 lastSequenceIndexed:1];
+    XCTAssertEqual(cache.count, 1);
+    XCTAssertEqual(cache.evictionCount, 1);
+    XCTAssertNil([cache objectsForView:@"b" keys:nil options:0 lastSequenceNumber:1 lastSequenceIndexed:0], @"A reset view index should make the result stale.");
+    XCTAssertEqual(cache.count, 0);
+}
+
+- (void)testQueryEnumeratorChunking {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    
+    NSMutableArray *ids = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 5; i++) {
+        MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+        XCTAssertTrue([b save], @"Save unexpectedly failed.");
+        [ids addObject:b.documentID];
+    }
+    
+    const char *dbQueueLabel = dispatch_queue_get_label(ac.db.database.manager.dispatchQueue);
+    NSArray *(^enumeratedIDs)(CBLQueryEnumerator *, NSUInteger, NSUInteger) = ^(CBLQueryEnumerator *rows, NSUInteger chunkSize, NSUInteger stopCount) {
+        NSMutableArray *enumerated = [NSMutableArray new];
+        [ac.db enumerateQueryEnumerator:rows chunkSize:chunkSize usingBlock:^(CBLQueryRow *row, BOOL *stop) {
+            XCTAssertEqual(strcmp(dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL), dbQueueLabel), 0, @"Rows should be enumerated on the server queue.");
+            [enumerated addObject:row.documentID];
+            *stop = enumerated.count == stopCount;
+        }];
+        return enumerated;
+    };
+    
+    // chunks smaller than, equal to and larger than the row count, and the default chunk size, all enumerate every row in order.
+    for (NSNumber *chunkSize in @[ @1, @2, @5, @6, @0 ])
+        XCTAssertEqualObjects(enumeratedIDs([ac.db getDocumentsWithIDs:ids], chunkSize.unsignedIntegerValue, NSNotFound), ids, @"Chunk size %@", chunkSize);
+    
+    // stopping ends the enumeration on the row it is set for, whether within a chunk or at its end, leaving the rest of the rows.
+    for (NSNumber *stopCount in @[ @3, @4 ]) {
+        CBLQueryEnumerator *rows = [ac.db getDocumentsWithIDs:ids];
+        NSUInteger count = stopCount.unsignedIntegerValue;
+        XCTAssertEqualObjects(enumeratedIDs(rows, 2, count), [ids subarrayWithRange:NSMakeRange(0, count)]);
+        XCTAssertEqualObjects(enumeratedIDs(rows, 2, NSNotFound), [ids subarrayWithRange:NSMakeRange(count, ids.count - count)]);
+    }
+    
+    XCTAssertEqualObjects(enumeratedIDs([ac.db getDocumentsWithIDs:@[]], 2, NSNotFound), @[]);
+}
+
+- (void)testAsyncRequests {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    NSString *title = [[NSUUID UUID] UUIDString];
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = title;
+
+    XCTestExpectation *saved = [self expectationWithDescription:@"saved"];
+    [b saveWithCompletionQueue:nil completionHandler:^(BOOL success, NSError *error) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertTrue(success, @"Save unexpectedly failed: %@", error);
+        [saved fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    XCTAssertFalse(b.needsSave);
+
+    // the properties of the object when the save began are written, and an object changed before the save completes is left needing saving, rather than its change being lost.
+    XCTestExpectation *resaved = [self expectationWithDescription:@"resaved"];
+    b.desc = @"Saving";
+    [b saveWithCompletionQueue:nil completionHandler:^(BOOL success, NSError *error) {
+        XCTAssertTrue(success, @"Save unexpectedly failed: %@", error);
+        [resaved fulfill];
+    }];
+    b.desc = @"Changed while saving";
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    XCTAssertEqualObjects([ac.db.database existingDocumentWithID:b.documentID].properties[@"desc"], @"Saving");
+    XCTAssertEqualObjects(b.desc, @"Changed while saving");
+    XCTAssertTrue(b.needsSave);
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    XCTAssertFalse(b.needsSave);
+
+    // identical fetches made together are coalesced, and each request is completed.
+    XCTestExpectation *fetched = [self expectationWithDescription:@"fetched"];
+    XCTestExpectation *joined = [self expectationWithDescription:@"joined"];
+    dispatch_queue_t queue = dispatch_queue_create("MPModelFoundationTests.async", DISPATCH_QUEUE_SERIAL);
+    [ac fetchObjectsMatchingQueriedView:ac.objectsByTitleViewName keys:@[ title ] options:MPQueryOptionsNone
+                        completionQueue:queue completionHandler:^(NSArray *objects, NSError *error) {
+        XCTAssertEqualObjects(objects, @[ b ]);
+        [fetched fulfill];
+    }];
+    [ac fetchObjectsMatchingQueriedView:ac.objectsByTitleViewName keys:@[ title ] options:MPQueryOptionsNone
+                        completionQueue:queue completionHandler:^(NSArray *objects, NSError *error) {
+        XCTAssertEqualObjects(objects, @[ b ]);
+        [joined fulfill];
+    }];
+
+    // the database queue is held so that the request is cancelled before the fetch runs.
+    dispatch_queue_t dbQueue = ac.db.database.manager.dispatchQueue;
+    dispatch_suspend(dbQueue);
+    XCTestExpectation *cancelled = [self expectationWithDescription:@"cancelled"];
+    MPAsyncRequest *request = [ac fetchObjectWithIdentifier:b.documentID completionQueue:nil
+                                          completionHandler:^(MPManagedObject *object, NSError *error) {
+        XCTAssertNil(object);
+        XCTAssertEqual(error.code, NSUserCancelledError);
+        [cancelled fulfill];
+    }];
+    [request cancel];
+    XCTAssertTrue(request.isCancelled);
+    dispatch_resume(dbQueue);
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+
+    XCTestExpectation *deleted = [self expectationWithDescription:@"deleted"];
+    [b deleteWithCompletionQueue:nil completionHandler:^(BOOL success, NSError *error) {
+        XCTAssertTrue(success, @"Delete unexpectedly failed: %@", error);
+        [deleted fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    XCTAssertTrue(b.isDeleted);
+}
+
+- (void)testAutosaveScheduler {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPAutosaveScheduler *scheduler = tpkg.autosaveScheduler;
+    XCTAssertTrue([scheduler flush:nil]);
+    [scheduler resetMetrics];
+
+    NSMutableArray<MPTestObject *> *objs = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 10; i++) {
+        MPTestObject *o = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+        o.autosaves = YES;
+        o.title = [[NSUUID UUID] UUIDString];
+        [objs addObject:o];
+    }
+    XCTAssertEqual(scheduler.pendingObjectCount, 10);
+
+    // an object saved explicitly is not saved again by the flush.
+    XCTAssertTrue([objs.lastObject save]);
+
+    __block NSUInteger batchNotificationCount = 0;
+    id observer = [tpkg.notificationCenter addObserverForName:MPDatabasePackageControllerDidPerformBatchUpdatesNotification
+                                                       object:tpkg queue:nil usingBlock:^(NSNotification *note) {
+        batchNotificationCount++;
+    }];
+
+    XCTAssertTrue([scheduler flush:nil]);
+    [tpkg.notificationCenter removeObserver:observer];
+
+    XCTAssertEqual(scheduler.pendingObjectCount, 0);
+    XCTAssertEqual(batchNotificationCount, 1);
+    XCTAssertEqual(scheduler.flushCount, 1);
+    XCTAssertEqual(scheduler.lastBatchSize, 9);
+    XCTAssertGreaterThan(scheduler.lastCommitLatency, 0);
+    for (MPTestObject *o in objs) {
+        XCTAssertFalse(o.needsSave);
+        XCTAssertEqualObjects([ac objectsWithTitle:o.title], @[ o ]);
+    }
+
+    // reaching the threshold flushes without waiting for the interval.
+    scheduler.dirtyCountThreshold = 2;
+    scheduler.interval = 60.0;
+    objs[0].title = [[NSUUID UUID] UUIDString];
+    objs[1].title = [[NSUUID UUID] UUIDString];
+    XCTestExpectation *flushed = [self expectationForPredicate:[NSPredicate predicateWithFormat:@"pendingObjectCount == 0"]
+                                           evaluatedWithObject:scheduler handler:nil];
+    [self waitForExpectations:@[ flushed ] timeout:10.0];
+    XCTAssertFalse(objs[0].needsSave);
+    XCTAssertEqual(scheduler.flushCount, 2);
+
+    scheduler.dirtyCountThreshold = 500;
+    scheduler.interval = 1.0;
+}
+
+- (void)testLazyViewDefinitions {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    XCTAssertTrue([ac.db.definedViewNames containsObject:ac.objectsByTitleViewName]);
+
+    NSString *title = [[NSUUID UUID] UUIDString];
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = title;
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+
+    NSString *viewName = [@"lazy-" stringByAppendingString:title];
+    [ac.db defineViewNamed:viewName mapBlock:^(NSDictionary *doc, CBLMapEmitBlock emit) {
+        if ([doc[@"title"] isEqual:title])
+            emit(doc[@"_id"], nil);
+    } reduceBlock:nil version:@"1.0"];
+    XCTAssertNil([ac.db.database existingViewNamed:viewName], @"A view should not be created before it is first used.");
+
+    // a stale query returns what is indexed so far, without failing.
+    XCTAssertNotNil([ac objectsMatchingQueriedView:viewName keys:nil options:MPQueryOptionsAllowStale]);
+    XCTAssertNotNil([ac.db.database existingViewNamed:viewName]);
+    XCTAssertEqualObjects([ac objectsMatchingQueriedView:viewName keys:nil], @[ b ]);
+}
+
+- (void)testLiveObjectCollection {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    NSString *prefix = [NSString stringWithFormat:@"live-%@-", [[NSUUID UUID] UUIDString]];
+
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = [prefix stringByAppendingString:@"b"];
+    MPTestObject *d = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    d.title = [prefix stringByAppendingString:@"d"];
+    XCTAssertTrue([b save] && [d save], @"Save unexpectedly failed.");
+
+    MPLiveObjectCollection *collection
+        = [[MPLiveObjectCollection alloc] initWithController:ac view:ac.objectsByTitleViewName keys:nil filter:^BOOL(MPTestObject *mo) {
+        return [mo.title hasPrefix:prefix];
+    } comparator:^NSComparisonResult(MPTestObject *x, MPTestObject *y) {
+        return [x.title compare:y.title];
+    }];
+    XCTAssertEqualObjects(collection.objects, (@[ b, d ]));
+
+    MPTestObject *c = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    c.title = [prefix stringByAppendingString:@"c"];
+    b.title = [prefix stringByAppendingString:@"z"];
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+
+    __block MPLiveObjectCollectionChange *publishedChange = nil;
+    collection.changeHandler = ^(MPLiveObjectCollection *collection, MPLiveObjectCollectionChange *change) {
+        publishedChange = change;
+    };
+
+    MPLiveObjectCollectionChange *change = [collection applyAddedObjects:@[ c ] updatedObjects:@[ b ] removedObjects:@[]];
+    XCTAssertEqual(publishedChange, change);
+    XCTAssertEqualObjects(collection.objects, (@[ c, d, b ]));
+    XCTAssertEqualObjects(change.insertedIndexes, [NSIndexSet indexSetWithIndex:0]);
+    XCTAssertEqualObjects(change.movedIndexes, (@{ @0 : @2 }));
+    XCTAssertEqual(change.removedIndexes.count, 0);
+
+    d.title = [prefix stringByAppendingString:@"e"];
+    XCTAssertTrue([d save], @"Save unexpectedly failed.");
+    change = [collection applyAddedObjects:@[] updatedObjects:@[ d ] removedObjects:@[ c ]];
+    XCTAssertEqualObjects(collection.objects, (@[ d, b ]));
+    XCTAssertEqualObjects(change.removedIndexes, [NSIndexSet indexSetWithIndex:0]);
+    XCTAssertEqualObjects(change.updatedIndexes, [NSIndexSet indexSetWithIndex:0], @"An object updated in place should not be moved.");
+    XCTAssertEqual(change.movedIndexes.count, 0);
+}
+
+- (void)testPerformBatchUpdates {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    
+    __block MPTestObject *c = nil;
+    __block NSUInteger notificationCount = 0;
+    __block NSArray *batchChanges = nil;
+    id observer = [tpkg.notificationCenter addObserverForName:MPDatabasePackageControllerDidPerformBatchUpdatesNotification
+                                                       object:tpkg queue:nil usingBlock:^(NSNotification *note) {
+        notificationCount++;
+        batchChanges = note.userInfo[MPDatabasePackageControllerBatchChangesKey];
+    }];
+    
+    NSError *err = nil;
+    BOOL success = [tpkg performBatchUpdates:^{
+        b.title = @"updated in batch";
+        [tpkg performBatchUpdates:^{
+            c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+            c.title = @"added in batch";
+        } error:nil];
+    } error:&err];
+    
+    [tpkg.notificationCenter removeObserver:observer];
+    
+    XCTAssertTrue(success, @"Batch update unexpectedly failed: %@", err);
+    XCTAssertFalse(b.needsSave);
+    XCTAssertFalse(c.needsSave);
+    XCTAssertEqual(notificationCount, 1, @"Nested batches should be saved and reported once.");
+    
+    MPManagedObjectsBatchChange *batchChange = [[batchChanges filteredArrayUsingPredicate:
+                                                 [NSPredicate predicateWithFormat:@"controller == %@", ac]] firstObject];
+    XCTAssertTrue([batchChange.addedObjects containsObject:c]);
+    XCTAssertTrue([batchChange.updatedObjects containsObject:b]);
+}
+
+- (void)testBatchUpdatesClearCachedValues {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    NSUInteger count = ac.testObjects.count;
+    
+    __block MPTestObject *b = nil;
+    NSError *err = nil;
+    XCTAssertTrue([tpkg performBatchUpdates:^{
+        b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    } error:&err], @"Batch update unexpectedly failed: %@", err);
+    
+    XCTAssertEqual(ac.testObjects.count, count + 1);
+    XCTAssertTrue([ac.testObjects containsObject:b]);
+}
+
+- (void)testFailedBatchUpdatesLeaveObjectsUnsaved {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    
+    MPTestObject *existing = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    existing.title = [[NSUUID UUID] UUIDString];
+    XCTAssertTrue([existing save], @"Save unexpectedly failed.");
+    
+    NSMutableArray<MPTestObject *> *objs = [NSMutableArray arrayWithObject:existing];
+    __block MPTestObject *unsavable = nil;
+    NSError *err = nil;
+    
+    // the objects changed before the unsavable one are saved first in the transaction that it makes fail.
+    XCTAssertFalse([tpkg performBatchUpdates:^{
+        existing.title = [[NSUUID UUID] UUIDString];
+        for (NSUInteger i = 0; i < 3; i++) {
+            MPTestObject *o = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+            o.title = [[NSUUID UUID] UUIDString];
+            [objs addObject:o];
+        }
+        unsavable = [[MPFeatherTestUnsavable alloc] initWithNewDocumentForController:ac];
+        unsavable.title = [[NSUUID UUID] UUIDString];
+    } error:&err]);
+    XCTAssertNotNil(err);
+    
+    for (MPTestObject *o in objs) {
+        XCTAssertTrue(o.needsSave, @"An object saved in a rolled back transaction should still need saving.");
+        XCTAssertEqual([ac objectsWithTitle:o.title].count, 0);
+    }
+    XCTAssertTrue(unsavable.needsSave);
+    [unsavable revertChanges];
+    
+    // the restored objects save their changes on top of the database's current revisions.
+    for (MPTestObject *o in objs) {
+        XCTAssertTrue([o save], @"Save unexpectedly failed.");
+        XCTAssertFalse(o.needsSave);
+        XCTAssertEqualObjects([ac objectsWithTitle:o.title], @[ o ]);
+    }
+}
+
+- (void)testBatchedChangeDelivery {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    NSTimeInterval changeCoalescingInterval = tpkg.changeCoalescingInterval;
+    tpkg.changeCoalescingInterval = 0.5;
+    
+    __block MPManagedObjectsBatchChange *deliveredChange = nil;
+    __block NSUInteger deliveryCount = 0;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    id observer = [tpkg.notificationCenter addObserverForName:MPManagedObjectsControllerDidChangeObjectsNotification
+                                                       object:ac queue:nil usingBlock:^(NSNotification *note) {
+        MPManagedObjectsBatchChange *batchChange = note.userInfo[MPManagedObjectsBatchChangeKey];
+        if ([batchChange.addedObjects containsObject:b]) {
+            deliveredChange = batchChange;
+            deliveryCount++;
+        }
+    }];
+    
+    // changes written in separate transactions within the coalescing window are delivered together.
+    MPTestObject *c = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = [[NSUUID UUID] UUIDString];
+    c.title = [[NSUUID UUID] UUIDString];
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+    
+    // a document written without a managed object is reported by its identifier, without being loaded.
+    NSString *unloadedID = [NSString stringWithFormat:@"%@:%@", NSStringFromClass(MPFeatherTestB.class), [[NSUUID UUID] UUIDString]];
+    mp_dispatch_sync(ac.db.database.manager.dispatchQueue, tpkg.serverQueueToken, ^{
+        NSError *err = nil;
+        XCTAssertNotNil([[ac.db.database documentWithID:unloadedID] putProperties:@{ @"objectType" : NSStringFromClass(MPFeatherTestB.class),
+                                                                                     @"title" : [[NSUUID UUID] UUIDString] }
+                                                                            error:&err], @"%@", err);
+    });
+    XCTAssertEqual(deliveryCount, 0, @"Changes should be delivered on the main thread once the coalescing window has passed.");
+    
+    XCTestExpectation *delivered = [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL(id evaluatedObject, NSDictionary *bindings) {
+        return deliveryCount > 0;
+    }] evaluatedWithObject:self handler:nil];
+    [self waitForExpectations:@[ delivered ] timeout:10.0];
+    
+    XCTAssertEqual(deliveryCount, 1);
+    XCTAssertTrue([deliveredChange.addedObjects containsObject:c]);
+    XCTAssertTrue([deliveredChange.unloadedObjectIdentifiers containsObject:unloadedID]);
+    [tpkg.notificationCenter removeObserver:observer];
+    
+    // in the compatibility mode, the per-object notifications of a database change are posted before the write returns.
+    tpkg.postsPerObjectChangeNotifications = YES;
+    __block NSUInteger perObjectNotificationCount = 0;
+    observer = [tpkg.notificationCenter addObserverForName:[NSNotificationCenter notificationNameForRecentChangeOfType:MPChangeTypeUpdate
+                                                                                             forManagedObjectClass:b.class]
+                                                    object:b queue:nil usingBlock:^(NSNotification *note) {
+        if ([note.userInfo[@"source"] integerValue] == MPManagedObjectChangeSourceAPI)
+            perObjectNotificationCount++;
+    }];
+    b.title = [[NSUUID UUID] UUIDString];
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    XCTAssertEqual(perObjectNotificationCount, 1);
+    [tpkg.notificationCenter removeObserver:observer];
+    
+    tpkg.postsPerObjectChangeNotifications = NO;
+    tpkg.changeCoalescingInterval = changeCoalescingInterval;
+}
+
+- (void)testIncrementalSnapshots {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+    
+    NSError *err = nil;
+    MPSnapshot *first = [tpkg newSnapshotWithName:[[NSUUID UUID] UUIDString] error:&err];
+    XCTAssertNotNil(first, @"Snapshot unexpectedly failed: %@", err);
+    
+    b.title = @"changed after the first snapshot";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    
+    MPSnapshot *second = [tpkg newSnapshotWithName:[[NSUUID UUID] UUIDString] error:&err];
+    XCTAssertNotNil(second, @"Snapshot unexpectedly failed: %@", err);
+    
+    MPSnapshotsController *sc = tpkg.snapshotsController;
+    NSArray<NSString *> *firstIDs = [sc snapshottedObjectIDsForSnapshot:first error:&err];
+    NSArray<NSString *> *secondIDs = [sc snapshottedObjectIDsForSnapshot:second error:&err];
+    XCTAssertNotNil(firstIDs, @"Resolving snapshot contents unexpectedly failed: %@", err);
+    XCTAssertNotNil(secondIDs, @"Resolving snapshot contents unexpectedly failed: %@", err);
+    
+    NSMutableSet *onlyInFirst = [NSMutableSet setWithArray:firstIDs];
+    [onlyInFirst minusSet:[NSSet setWithArray:secondIDs]];
+    NSMutableSet *onlyInSecond = [NSMutableSet setWithArray:secondIDs];
+    [onlyInSecond minusSet:[NSSet setWithArray:firstIDs]];
+    
+    // only the changed object's revision differs, the rest are shared between the snapshots.
+    XCTAssertEqual(firstIDs.count, secondIDs.count);
+    XCTAssertEqual(onlyInFirst.count, 1);
+    XCTAssertEqual(onlyInSecond.count, 1);
+    XCTAssertTrue([onlyInSecond.anyObject containsString:b.documentID]);
+    
+    // the second snapshot stores only its difference to the first.
+    XCTAssertNil(second.snapshottedObjectIDs);
+    XCTAssertEqualObjects(second.baseSnapshotID, first.documentID);
+    XCTAssertEqualObjects(second.addedSnapshottedObjectIDs, onlyInSecond.allObjects);
+    XCTAssertEqualObjects(second.removedSnapshottedObjectIDs, onlyInFirst.allObjects);
+    
+    // keyed snapshot queries only return the snapshot's own contents.
+    XCTAssertEqual([sc snapshottedObjectsForSnapshot:second].count, secondIDs.count);
+    XCTAssertEqual([sc snapshottedObjectsForSnapshot:second offset:0 limit:1].count, 1);
+    
+    __block NSUInteger propertiesCount = 0;
+    __block NSDictionary *changedProperties = nil;
+    XCTAssertTrue([sc enumerateSnapshottedPropertiesForSnapshot:second usingBlock:^(NSString *documentID, NSString *revisionID, NSDictionary *properties, BOOL *stop) {
+        propertiesCount++;
+        if ([documentID isEqualToString:b.documentID])
+            changedProperties = properties;
+    } error:&err], @"Enumeration unexpectedly failed: %@", err);
+    
+    XCTAssertEqual(propertiesCount, secondIDs.count);
+    XCTAssertEqualObjects(changedProperties[@"title"], @"changed after the first snapshot");
+}
+
+- (void)testDeletingBaseSnapshot {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPSnapshotsController *sc = tpkg.snapshotsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+    
+    NSError *err = nil;
+    MPSnapshot *first = [tpkg newSnapshotWithName:[[NSUUID UUID] UUIDString] error:&err];
+    XCTAssertNotNil(first, @"Snapshot unexpectedly failed: %@", err);
+    
+    b.title = @"changed after the first snapshot";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    MPSnapshot *second = [tpkg newSnapshotWithName:[[NSUUID UUID] UUIDString] error:&err];
+    XCTAssertNotNil(second, @"Snapshot unexpectedly failed: %@", err);
+    
+    // the third snapshot removes the revision of b which the second added.
+    b.title = @"changed after the second snapshot";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    MPSnapshot *third = [tpkg newSnapshotWithName:[[NSUUID UUID] UUIDString] error:&err];
+    XCTAssertNotNil(third, @"Snapshot unexpectedly failed: %@", err);
+    XCTAssertEqualObjects(third.baseSnapshotID, second.documentID);
+    
+    NSArray<NSString *> *thirdIDs = [sc snapshottedObjectIDsForSnapshot:third error:&err];
+    XCTAssertNotNil(thirdIDs, @"Resolving snapshot contents unexpectedly failed: %@", err);
+    
+    // deleting the middle snapshot lists the last relative to the first, with the same contents: the revision of b the second added is in neither list.
+    XCTAssertTrue([second deleteDocument:&err], @"Delete unexpectedly failed: %@", err);
+    XCTAssertEqualObjects(third.baseSnapshotID, first.documentID);
+    XCTAssertEqualObjects([NSSet setWithArray:[sc snapshottedObjectIDsForSnapshot:third error:&err]], [NSSet setWithArray:thirdIDs],
+                          @"Resolving snapshot contents unexpectedly failed: %@", err);
+    XCTAssertEqual(third.addedSnapshottedObjectIDs.count, 1);
+    XCTAssertEqual(third.removedSnapshottedObjectIDs.count, 1);
+    
+    // deleting the first snapshot lists the last relative to the first's own base snapshot, or in full if it has none.
+    NSString *firstBaseSnapshotID = first.baseSnapshotID;
+    XCTAssertTrue([first deleteDocument:&err], @"Delete unexpectedly failed: %@", err);
+    XCTAssertEqualObjects(third.baseSnapshotID, firstBaseSnapshotID);
+    XCTAssertEqualObjects([NSSet setWithArray:[sc snapshottedObjectIDsForSnapshot:third error:&err]], [NSSet setWithArray:thirdIDs],
+                          @"Resolving snapshot contents unexpectedly failed: %@", err);
+}
+
+- (void)testSnapshotRestore {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    MPTestObject *d = [[MPFeatherTestD alloc] initWithNewDocumentForController:ac];
+    b.title = @"snapshotted";
+    d.title = @"snapshotted";
+    XCTAssertTrue([b save] && [d save], @"Save unexpectedly failed.");
+    
+    NSString *name = [[NSUUID UUID] UUIDString];
+    NSError *err = nil;
+    MPSnapshot *snapshot = [tpkg newSnapshotWithName:name error:&err];
+    XCTAssertNotNil(snapshot, @"Snapshot unexpectedly failed: %@", err);
+    XCTAssertNotNil(snapshot.snapshottedSequenceNumbers[ac.db.name], @"The changes since the snapshot should be restorable from the database's sequence number.");
+    
+    b.title = @"changed after the snapshot";
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+    
+    // an unsaved change to an object otherwise unchanged since the snapshot is discarded too.
+    d.title = @"changed after the snapshot, unsaved";
+    
+    // progress is reported on the main queue after the restore has returned.
+    XCTestExpectation *completed = [self expectationWithDescription:@"completed"];
+    __block double fractionCompleted = 0.0;
+    XCTAssertTrue([tpkg restoreFromSnapshotWithName:name progressHandler:^(double fraction) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertGreaterThanOrEqual(fraction, fractionCompleted);
+        fractionCompleted = fraction;
+        if (fraction == 1.0)
+            [completed fulfill];
+    } error:&err], @"Restore unexpectedly failed: %@", err);
+    
+    XCTAssertEqual(fractionCompleted, 0.0);
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    XCTAssertEqualObjects([ac.db.database existingDocumentWithID:b.documentID].properties[@"title"], @"snapshotted");
+    XCTAssertNil([ac.db.database existingDocumentWithID:c.documentID], @"Objects created after the snapshot should be deleted.");
+    XCTAssertFalse(d.needsSave);
+    XCTAssertEqualObjects(d.title, @"snapshotted");
+}
+
+- (void)testUnlistedSnapshotRestore {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPSnapshotsController *sc = tpkg.snapshotsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = @"snapshotted";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    
+    // a snapshot as taken before snapshots listed their contents: only the snapshotted objects created for it refer to it.
+    NSString *name = [[NSUUID UUID] UUIDString];
+    MPSnapshot *snapshot = [[MPSnapshot alloc] initWithController:sc name:name];
+    XCTAssertTrue([snapshot save], @"Save unexpectedly failed.");
+    MPSnapshottedObject *so = [[MPSnapshottedObject alloc] initWithController:sc.snapshottedObjectsController snapshot:snapshot snapshottedObject:b];
+    XCTAssertTrue([so save], @"Save unexpectedly failed.");
+    XCTAssertFalse(snapshot.listsSnapshottedObjects);
+    
+    NSError *err = nil;
+    XCTAssertEqualObjects([sc snapshottedObjectIDsForSnapshot:snapshot error:&err], @[ so.documentID ]);
+    
+    b.title = @"changed after the snapshot";
+    MPTestObject *c = [[MPFeatherTestC alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save] && [c save], @"Save unexpectedly failed.");
+    NSUInteger objectCount = ac.allObjects.count;
+    
+    XCTAssertTrue([tpkg restoreFromSnapshotWithName:name error:&err], @"Restore unexpectedly failed: %@", err);
+    
+    XCTAssertEqualObjects([ac.db.database existingDocumentWithID:b.documentID].properties[@"title"], @"snapshotted");
+    XCTAssertNotNil([ac.db.database existingDocumentWithID:c.documentID], @"Restoring a snapshot not listing its contents should delete nothing.");
+    XCTAssertEqual(ac.allObjects.count, objectCount);
+}
+
+- (void)testOnlineSave {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+
+    NSURL *URL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSString *databasePath = [URL.path stringByAppendingPathComponent:[ac.db.name stringByAppendingPathExtension:@"cblite"]];
+    NSFileManager *fm = [NSFileManager defaultManager];
+
+    NSError *err = nil;
+    XCTAssertTrue(tpkg.savesDatabasesOnline);
+    XCTAssertTrue([tpkg saveToURL:URL error:&err], @"Save unexpectedly failed: %@", err);
+    NSNumber *fileNumber = [fm attributesOfItemAtPath:databasePath error:nil][NSFileSystemFileNumber];
+    XCTAssertNotNil(fileNumber);
+
+    // an unchanged database is not copied again.
+    XCTAssertTrue([tpkg saveToURL:URL error:&err], @"Save unexpectedly failed: %@", err);
+    XCTAssertEqualObjects([fm attributesOfItemAtPath:databasePath error:nil][NSFileSystemFileNumber], fileNumber);
+
+    b.title = @"changed after saving";
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    XCTAssertTrue([tpkg saveToURL:URL error:&err], @"Save unexpectedly failed: %@", err);
+    XCTAssertNotEqualObjects([fm attributesOfItemAtPath:databasePath error:nil][NSFileSystemFileNumber], fileNumber);
+
+    [fm removeItemAtURL:URL error:nil];
+}
+
+- (void)testTemporaryCopy {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+
+    NSURL *URL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSString *databasePath = [URL.path stringByAppendingPathComponent:[ac.db.name stringByAppendingPathExtension:@"cblite"]];
+    NSFileManager *fm = [NSFileManager defaultManager];
+
+    __block double fractionCompleted = 0.0;
+    NSError *err = nil;
+    XCTAssertTrue([tpkg makeTemporaryCopyIntoRootDirectoryWithURL:URL overwriteIfExists:YES failIfExists:NO progressHandler:^(double fraction, BOOL *stop) {
+        fractionCompleted = fraction;
+    } error:&err], @"Copy unexpectedly failed: %@", err);
+    XCTAssertEqual(fractionCompleted, 1.0);
+    XCTAssertFalse([fm fileExistsAtPath:[URL.path stringByAppendingPathComponent:@"snapshots.cblite"]], @"Snapshots should not be copied.");
+
+    // overwriting updates the copy in place.
+    NSNumber *fileNumber = [fm attributesOfItemAtPath:databasePath error:nil][NSFileSystemFileNumber];
+    XCTAssertNotNil(fileNumber);
+    XCTAssertTrue([tpkg makeTemporaryCopyIntoRootDirectoryWithURL:URL overwriteIfExists:YES failIfExists:NO error:&err], @"Copy unexpectedly failed: %@", err);
+    XCTAssertEqualObjects([fm attributesOfItemAtPath:databasePath error:nil][NSFileSystemFileNumber], fileNumber);
+
+    NSURL *cancelledURL = [URL URLByAppendingPathExtension:@"cancelled"];
+    XCTAssertFalse([tpkg makeTemporaryCopyIntoRootDirectoryWithURL:cancelledURL overwriteIfExists:YES failIfExists:NO progressHandler:^(double fraction, BOOL *stop) {
+        *stop = YES;
+    } error:&err]);
+    XCTAssertEqualObjects(err.domain, NSCocoaErrorDomain);
+    XCTAssertEqual(err.code, NSUserCancelledError);
+
+    [fm removeItemAtURL:URL error:nil];
+    [fm removeItemAtURL:cancelledURL error:nil];
+}
+
+- (void)testReaderPool {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    NSString *title = [[NSUUID UUID] UUIDString];
+    b.title = title;
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+    
+    NSError *err = nil;
+    __block MPDetachedObject *detached = nil;
+    __block NSArray<MPDetachedObject *> *objects = nil;
+    XCTAssertTrue([ac.db.readerPool performRead:^(MPDatabaseReader *reader) {
+        detached = [reader objectWithIdentifier:b.documentID error:nil];
+        
+        // a write made meanwhile is not seen within the read.
+        b.title = @"changed";
+        XCTAssertTrue([b save]);
+        XCTAssertEqualObjects([reader propertiesOfDocumentWithID:b.documentID error:nil][@"_rev"], detached.revisionID);
+        
+        objects = [reader objectsOfClass:MPTestObject.class error:nil];
+    } error:&err], @"Read unexpectedly failed: %@", err);
+    
+    XCTAssertNotNil(detached);
+    XCTAssertEqualObjects(detached.objectType, NSStringFromClass(MPFeatherTestB.class));
+    XCTAssertEqual(detached.managedObjectClass, MPFeatherTestB.class);
+    XCTAssertEqualObjects(detached[@"title"], title);
+    XCTAssertTrue([[objects valueForKey:@"documentID"] containsObject:b.documentID]);
+    
+    XCTAssertTrue([ac.db.readerPool performRead:^(MPDatabaseReader *reader) {
+        XCTAssertEqualObjects([reader propertiesOfDocumentWithID:b.documentID error:nil][@"title"], @"changed");
+        XCTAssertNil([reader propertiesOfDocumentWithID:@"MPTestObject:missing" error:nil]);
+    } error:&err], @"Read unexpectedly failed: %@", err);
+}
+
+- (void)testFullTextSearch {
+    MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
+    MPTestObjectsController *ac = tpkg.testObjectsController;
+
+    NSString *word = [@"zebra" stringByAppendingString:[[[NSUUID UUID] UUIDString] stringByReplacingOccurrencesOfString:@"-" withString:@""]];
+    MPTestObject *b = [[MPFeatherTestB alloc] initWithNewDocumentForController:ac];
+    b.title = [NSString stringWithFormat:@"Quixotic %@", word];
+    XCTAssertTrue([b save], @"Save unexpectedly failed.");
+
+    // the index is updated from the change feed, delivered on the main queue.
+    NSArray *(^documentIDsMatching)(NSString *, BOOL) = ^NSArray *(NSString *query, BOOL expectMatch) {
+        NSArray *documentIDs = nil;
+        NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+        do {
+            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+            NSError *err = nil;
+            documentIDs = [tpkg documentIDsMatchingFullTextQuery:query offset:0 limit:10 error:&err];
+            XCTAssertNotNil(documentIDs, @"Query unexpectedly failed: %@", err);
+        } while ([documentIDs containsObject:b.documentID] != expectMatch && timeout.timeIntervalSinceNow > 0);
+        return documentIDs;
+    };
+
+    XCTAssertEqualObjects(documentIDsMatching([word substringToIndex:10], YES), @[ b.documentID ]);
+    XCTAssertTrue([documentIDsMatching([NSString stringWithFormat:@"QUIXÖT %@", word], YES) containsObject:b.documentID],
+                  @"Matching should be prefix, case and diacritic insensitive.");
+
+    XCTAssertTrue([b deleteDocument], @"Delete unexpectedly failed.");
+    XCTAssertFalse([documentIDsMatching(word, NO) containsObject:b.documentID]);
+}
+
+/** Creates a closed document package with test objects in it. */
+- (NSString *)newDocumentPackagePathWithObjectCount:(NSUInteger)objectCount {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:NO delegate:nil error:&err];
+    XCTAssertNotNil(pkgc, @"Opening unexpectedly failed: %@", err);
+    
+    for (NSUInteger i = 0; i < objectCount; i++)
+        XCTAssertTrue([[[MPFeatherTestB alloc] initWithNewDocumentForController:pkgc.testObjectsController] save], @"Save unexpectedly failed.");
+    
+    XCTAssertTrue([pkgc close:&err], @"Closing unexpectedly failed: %@", err);
+    return path;
+}
+
+- (void)testViewWarmingIncludesSubclassControllers {
+    NSString *path = [self newDocumentPackagePathWithObjectCount:10];
+    
+    // the controller of the reopened package is created in -didOpenDatabases, after the base class's own controllers.
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:NO delegate:nil error:&err];
+    XCTAssertNotNil(pkgc, @"Opening unexpectedly failed: %@", err);
+    
+    XCTestExpectation *warmed = [self expectationWithDescription:@"warmed"];
+    id observer = [pkgc.notificationCenter addObserverForName:MPDatabasePackageControllerDidWarmViewsNotification object:pkgc queue:nil
+                                                   usingBlock:^(NSNotification *notification) {
+        [warmed fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    [pkgc.notificationCenter removeObserver:observer];
+    
+    MPTestObjectsController *ac = pkgc.testObjectsController;
+    __block BOOL stale = YES;
+    mp_dispatch_sync(ac.db.database.manager.dispatchQueue, pkgc.serverQueueToken, ^{
+        stale = [ac.db viewNamed:ac.allObjectsViewName].stale;
+    });
+    XCTAssertFalse(stale, @"The views of a subclass's controllers should be indexed by warming.");
+    
+    XCTAssertTrue([pkgc close:&err], @"Closing unexpectedly failed: %@", err);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testOpeningInBackground {
+    NSString *path = [self newDocumentPackagePathWithObjectCount:5];
+    NSMutableArray<NSString *> *events = [NSMutableArray array];
+    XCTestExpectation *completed = [self expectationWithDescription:@"completed"];
+    
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc
+        = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:NO delegate:nil opensDatabasesInBackground:YES
+                                                     completionHandler:^(MPDatabasePackageController *packageController, NSError *error) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertNil(error);
+        XCTAssertEqual(packageController.readiness, MPDatabasePackageControllerReadinessReady);
+        [events addObject:@"completion"];
+        [completed fulfill];
+    } error:&err];
+    XCTAssertNotNil(pkgc, @"Opening unexpectedly failed: %@", err);
+    
+    // only the primary database is open when the initializer returns.
+    XCTAssertEqual(pkgc.readiness, MPDatabasePackageControllerReadinessPrimaryDatabaseReady);
+    XCTAssertNotNil(pkgc.mainDatabase);
+    XCTAssertNil(pkgc.testObjectsController);
+    
+    id observer = [pkgc.notificationCenter addObserverForName:MPDatabasePackageControllerDidBecomeReadyNotification object:pkgc queue:nil
+                                                   usingBlock:^(NSNotification *notification) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqual(pkgc.readiness, MPDatabasePackageControllerReadinessReady);
+        XCTAssertNotNil(pkgc.testObjectsController, @"-didOpenDatabases should be called before the package becomes ready.");
+        [events addObject:@"didBecomeReady"];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    [pkgc.notificationCenter removeObserver:observer];
+    
+    XCTAssertEqualObjects(events, (@[ @"didBecomeReady", @"completion" ]));
+    XCTAssertEqual(pkgc.readinessOnOpeningDatabases, MPDatabasePackageControllerReadinessPrimaryDatabaseReady);
+    XCTAssertNotNil(pkgc.snapshotsController);
+    XCTAssertEqual(pkgc.testObjectsController.allObjects.count, 5);
+    
+    XCTAssertTrue([pkgc close:&err], @"Closing unexpectedly failed: %@", err);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testOpeningInBackgroundFailure {
+    NSString *path = [self newDocumentPackagePathWithObjectCount:1];
+    
+    // a read-only package is not bootstrapped, so opening its missing secondary database fails.
+    XCTAssertTrue([[NSFileManager defaultManager] removeItemAtPath:[path stringByAppendingPathComponent:@"snapshots.cblite"] error:nil]);
+    
+    NSMutableArray<NSString *> *events = [NSMutableArray array];
+    XCTestExpectation *completed = [self expectationWithDescription:@"completed"];
+    
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc
+        = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:YES delegate:nil opensDatabasesInBackground:YES
+                                                     completionHandler:^(MPDatabasePackageController *packageController, NSError *error) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertNotNil(error);
+        [events addObject:@"completion"];
+        [completed fulfill];
+    } error:&err];
+    XCTAssertNotNil(pkgc, @"The primary database should open: %@", err);
+    XCTAssertEqual(pkgc.readiness, MPDatabasePackageControllerReadinessPrimaryDatabaseReady);
+    
+    __block NSError *notifiedError = nil;
+    id observer = [pkgc.notificationCenter addObserverForName:MPDatabasePackageControllerDidFailToOpenNotification object:pkgc queue:nil
+                                                   usingBlock:^(NSNotification *notification) {
+        XCTAssertTrue([NSThread isMainThread]);
+        notifiedError = notification.userInfo[MPDatabasePackageControllerErrorKey];
+        [events addObject:@"didFailToOpen"];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+    [pkgc.notificationCenter removeObserver:observer];
+    
+    XCTAssertEqualObjects(events, (@[ @"didFailToOpen", @"completion" ]));
+    XCTAssertNotNil(notifiedError);
+    XCTAssertEqual(pkgc.readiness, MPDatabasePackageControllerReadinessFailed);
+    XCTAssertNil(pkgc.testObjectsController, @"-didOpenDatabases should not be called when opening fails.");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testReadOnlyPackage {
+    NSString *path = [self newDocumentPackagePathWithObjectCount:3];
+    
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:YES delegate:nil error:&err];
+    XCTAssertNotNil(pkgc, @"Opening unexpectedly failed: %@", err);
+    XCTAssertTrue(pkgc.isReadOnly);
+    
+    NSArray<MPTestObject *> *objs = pkgc.testObjectsController.allObjects;
+    XCTAssertEqual(objs.count, 3);
+    
+    MPTestObject *obj = objs.firstObject;
+    obj.title = @"Changed";
+    err = nil;
+    XCTAssertFalse([obj save:&err], @"Saving to a read-only package should fail.");
+    XCTAssertEqualObjects(err.domain, MPDatabasePackageControllerErrorDomain);
+    XCTAssertEqual(err.code, MPDatabasePackageControllerErrorCodeReadOnly);
+    
+    err = nil;
+    XCTAssertFalse([obj deleteDocument:&err], @"Deleting from a read-only package should fail.");
+    XCTAssertEqual(err.code, MPDatabasePackageControllerErrorCodeReadOnly);
+    
+    XCTAssertTrue([pkgc close:&err], @"Closing unexpectedly failed: %@", err);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testReadOnlyPackageIsNotCreated {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    
+    // the databases of a read-only package are opened without creating them.
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:YES delegate:nil error:&err];
+    XCTAssertNil(pkgc, @"Opening a missing package read-only should fail.");
+    XCTAssertNotNil(err);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[path stringByAppendingPathComponent:@"main.cblite"]]);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testReadOnlyPackageWithBundledData {
+    NSURL *directoryURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    XCTAssertTrue([[NSFileManager defaultManager] createDirectoryAtURL:directoryURL withIntermediateDirectories:YES attributes:nil error:nil]);
+    NSURL *bundledURL = [directoryURL URLByAppendingPathComponent:@"bundled-test-objects.json"];
+    
+    BOOL (^writeBundledObjects)(NSUInteger) = ^BOOL(NSUInteger count) {
+        NSMutableArray *objs = [NSMutableArray array];
+        for (NSUInteger i = 0; i < count; i++)
+            [objs addObject:@{ @"_id" : [NSString stringWithFormat:@"MPTestObject:bundled-%lu", (unsigned long)i],
+                               @"objectType" : @"MPTestObject",
+                               @"bundled" : @YES,
+                               @"title" : [NSString stringWithFormat:@"Bundled %lu", (unsigned long)i] }];
+        return [[NSJSONSerialization dataWithJSONObject:objs options:0 error:nil] writeToURL:bundledURL atomically:YES];
+    };
+    
+    XCTAssertTrue(writeBundledObjects(2));
+    [MPTestObjectsController setBundledTestObjectsURL:bundledURL];
+    
+    NSString *path = [self newDocumentPackagePathWithObjectCount:1];
+    
+    // the changed data would be loaded again by a writable package, which a read-only one is not.
+    XCTAssertTrue(writeBundledObjects(3));
+    
+    NSError *err = nil;
+    MPFeatherTestDocumentPackageController *pkgc = [[MPFeatherTestDocumentPackageController alloc] initWithPath:path readOnly:YES delegate:nil error:&err];
+    XCTAssertNotNil(pkgc, @"Opening a read-only package with bundled data unexpectedly failed: %@", err);
+    XCTAssertNil(pkgc.testObjectsController.bundledJSONDerivedData);
+    XCTAssertEqual(pkgc.testObjectsController.allObjects.count, 3, @"The bundled objects loaded when writable are expected to stay as they were.");
+    
+    [MPTestObjectsController setBundledTestObjectsURL:nil];
+    XCTAssertTrue([pkgc close:&err], @"Closing unexpectedly failed: %@", err);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    [[NSFileManager defaultManager] removeItemAtURL:directoryURL error:nil];
+}
+
 - (void)testConcreteness
 {
     MPFeatherTestPackageController *tpkg = [MPFeatherTestPackageController sharedPackageController];
@@ -140,4 +1136,85 @@
     XCTAssertNoThrow(e = [[MPFeatherTestE alloc] initWithNewDocumentForController:ac], @"E can be instantiated");
 }
 
+/** Reads one database while writing another, concurrently, the way MPDatabasePackageController dispatches to the queue of each database's manager.
+  * With a shared manager both databases are worked on serially on its queue; with a manager per database the work proceeds in parallel. */
+- (void)measureMixedDatabaseThroughputWithServerPerDatabase:(BOOL)serverPerDatabase
+{
+    NSURL *URL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    XCTAssertTrue([fm createDirectoryAtURL:URL withIntermediateDirectories:YES attributes:nil error:nil]);
+    
+    const NSUInteger token = arc4random() + 1;
+    NSMutableArray<CBLDatabase *> *databases = [NSMutableArray arrayWithCapacity:2];
+    CBLManager *sharedServer = nil;
+    
+    for (NSString *name in @[ @"primary", @"snapshots" ]) {
+        CBLManager *server = sharedServer;
+        if (!server) {
+            NSError *err = nil;
+            server = [[CBLManager alloc] initWithDirectory:URL.path options:NULL error:&err];
+            XCTAssertNotNil(server, @"%@", err);
+            server.dispatchQueue = mp_dispatch_queue_create([URL.path stringByAppendingPathComponent:name], token, DISPATCH_QUEUE_SERIAL);
+            if (!serverPerDatabase)
+                sharedServer = server;
+        }
+        
+        __block CBLDatabase *db = nil;
+        mp_dispatch_sync(server.dispatchQueue, token, ^{
+            db = [server databaseNamed:name error:nil];
+        });
+        XCTAssertNotNil(db);
+        [databases addObject:db];
+    }
+    
+    CBLDatabase *primary = databases[0], *snapshots = databases[1];
+    const NSUInteger documentCount = 200;
+    mp_dispatch_sync(primary.manager.dispatchQueue, token, ^{
+        for (NSUInteger i = 0; i < documentCount; i++)
+            XCTAssertNotNil([[primary createDocument] putProperties:@{ @"title" : [NSString stringWithFormat:@"Object %lu", i] } error:nil]);
+    });
+    
+    [self measureBlock:^{
+        dispatch_group_t group = dispatch_group_create();
+        
+        dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            for (NSUInteger i = 0; i < 2000; i++) {
+                mp_dispatch_sync(primary.manager.dispatchQueue, token, ^{
+                    CBLQuery *q = [primary createAllDocumentsQuery];
+                    q.skip = i % (documentCount - 20);
+                    q.limit = 20;
+                    (void)[q run:nil].allObjects;
+                });
+            }
+        });
+        
+        dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            for (NSUInteger i = 0; i < 200; i++) {
+                mp_dispatch_sync(snapshots.manager.dispatchQueue, token, ^{
+                    [[snapshots createDocument] putProperties:@{ @"payload" : [[NSUUID UUID] UUIDString] } error:nil];
+                });
+            }
+        });
+        
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    }];
+    
+    for (CBLDatabase *db in databases) {
+        mp_dispatch_sync(db.manager.dispatchQueue, token, ^{
+            [db.manager close];
+        });
+    }
+    [fm removeItemAtURL:URL error:nil];
+}
+
+- (void)testMixedDatabaseThroughputWithSharedServer
+{
+    [self measureMixedDatabaseThroughputWithServerPerDatabase:NO];
+}
+
+- (void)testMixedDatabaseThroughputWithServerPerDatabase
+{
+    [self measureMixedDatabaseThroughputWithServerPerDatabase:YES];
+}
+
 @end